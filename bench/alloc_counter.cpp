@@ -0,0 +1,79 @@
+/**
+ * @file alloc_counter.cpp
+ * @brief --wrap hooks for malloc/calloc/realloc/free and operator new/delete
+ */
+
+#include "alloc_counter.h"
+#include <stdlib.h>
+#include <new>
+#include <atomic>
+
+static std::atomic<uint32_t> _allocations{0};
+static std::atomic<uint32_t> _bytes{0};
+
+namespace AllocCounter {
+
+uint32_t allocations() { return _allocations.load(std::memory_order_relaxed); }
+uint32_t bytesAllocated() { return _bytes.load(std::memory_order_relaxed); }
+
+} // namespace AllocCounter
+
+#ifdef BENCH_COUNT_ALLOCS
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size) {
+    _allocations.fetch_add(1, std::memory_order_relaxed);
+    _bytes.fetch_add(size, std::memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    _allocations.fetch_add(1, std::memory_order_relaxed);
+    _bytes.fetch_add(n * size, std::memory_order_relaxed);
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    _allocations.fetch_add(1, std::memory_order_relaxed);
+    _bytes.fetch_add(size, std::memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void* ptr) {
+    __real_free(ptr);
+}
+
+} // extern "C"
+
+// Route C++ allocations through the wrapped malloc so they are counted
+// (libstdc++'s own operator new calls the unwrapped symbol)
+void* operator new(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (!p) abort();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+#endif // BENCH_COUNT_ALLOCS
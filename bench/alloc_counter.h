@@ -0,0 +1,24 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+/**
+ * @file alloc_counter.h
+ * @brief Heap allocation counter for the benchmark builds
+ *
+ * Counts every malloc/calloc/realloc (and operator new, which forwards to
+ * malloc). Active only when linked with
+ *   -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+ * and BENCH_COUNT_ALLOCS defined; otherwise allocations() stays 0.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace AllocCounter {
+
+uint32_t allocations();
+uint32_t bytesAllocated();
+
+} // namespace AllocCounter
+
+#endif // ALLOC_COUNTER_H
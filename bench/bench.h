@@ -0,0 +1,314 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/**
+ * @file bench.h
+ * @brief Minimal Google-Benchmark-style harness for host and ESP32
+ *
+ *   static void BM_Something(Bench::State& state) {
+ *       for (auto _ : state) { ... }
+ *       state.setBytesProcessed(bytesPerIteration);
+ *   }
+ *   BENCHMARK(BM_Something);
+ *
+ * Each case is re-run with growing iteration counts until it takes at
+ * least BENCH_MIN_TIME_MS. Reported per operation: ns (cycle counter on
+ * ESP32, monotonic clock on host), heap bytes and heap allocations (from
+ * the malloc wrappers), and the bytes the case processed
+ * (setBytesProcessed()).
+ *
+ * Cases registered with BENCHMARK_ZERO_ALLOC are steady-state paths that
+ * must not touch the heap; with BENCH_COUNT_ALLOCS any allocation in the
+ * timed region fails the run.
+ *
+ * Accuracy cases report a figure with state.setCounter() and fail the
+ * run with state.fail() when it is out of bounds.
+ */
+
+#include <Arduino.h>
+#include "alloc_counter.h"
+#include "../src/config.h"
+
+#ifndef BENCH_MIN_TIME_MS
+#define BENCH_MIN_TIME_MS 200
+#endif
+
+#ifndef BENCH_MAX_CASES
+#define BENCH_MAX_CASES 48
+#endif
+
+#if !defined(ESP_PLATFORM)
+#include <chrono>
+#endif
+
+namespace Bench {
+
+/**
+ * Nanosecond timestamp for measurements
+ */
+#if defined(ESP_PLATFORM)
+// Cycle counter, extended across wraps by sampling at least every few seconds
+inline uint64_t nowNanos() {
+    static uint32_t last = 0;
+    static uint64_t high = 0;
+    const uint32_t c = ESP.getCycleCount();
+    if (c < last) high += 1ULL << 32;
+    last = c;
+    return (high + c) * 1000ULL / ESP.getCpuFreqMHz();
+}
+#else
+inline uint64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+class State {
+public:
+    explicit State(uint32_t iterations) : _iterations(iterations) {}
+
+    /**
+     * What `for (auto _ : state)` binds; the user-provided destructor keeps
+     * -Wunused-variable quiet about the unused loop variable
+     */
+    struct Value {
+        ~Value() {}
+    };
+
+    struct Iterator {
+        State* state;
+        uint32_t remaining;
+
+        bool operator!=(const Iterator&) {
+            if (remaining != 0) return true;
+            state->stop();
+            return false;
+        }
+        void operator++() { remaining--; }
+        Value operator*() const { return {}; }
+    };
+
+    Iterator begin() {
+        start();
+        return Iterator{this, _iterations};
+    }
+    Iterator end() { return Iterator{this, 0}; }
+
+    /**
+     * Exclude setup work from the measurement
+     */
+    void pauseTiming() { accumulate(); _running = false; }
+    void resumeTiming() { mark(); _running = true; }
+
+    /**
+     * Payload size handled per op (input parsed, output written)
+     */
+    void setBytesProcessed(uint64_t bytesPerIteration) { _processedPerOp = bytesPerIteration; }
+
+    /**
+     * One named figure reported with the case (e.g. an error bound)
+     */
+    void setCounter(const char* name, double value) {
+        _counterName = name;
+        _counterValue = value;
+    }
+
+    /**
+     * Fail the run (reason must be a literal)
+     */
+    void fail(const char* reason) { _failReason = reason; }
+
+    uint32_t iterations() const { return _iterations; }
+    uint64_t elapsedNanos() const { return _elapsedNanos; }
+    uint64_t allocations() const { return _allocs; }
+    uint64_t allocatedBytes() const { return _allocBytes; }
+    uint64_t processedPerOp() const { return _processedPerOp; }
+    const char* counterName() const { return _counterName; }
+    double counterValue() const { return _counterValue; }
+    const char* failReason() const { return _failReason; }
+
+private:
+    const uint32_t _iterations;
+    bool _running = false;
+    uint64_t _markNanos = 0;
+    uint32_t _markAllocs = 0;
+    uint32_t _markBytes = 0;
+    uint64_t _elapsedNanos = 0;
+    uint64_t _allocs = 0;
+    uint64_t _allocBytes = 0;
+    uint64_t _processedPerOp = 0;
+    const char* _counterName = nullptr;
+    double _counterValue = 0;
+    const char* _failReason = nullptr;
+
+    void mark() {
+        _markAllocs = AllocCounter::allocations();
+        _markBytes = AllocCounter::bytesAllocated();
+        _markNanos = nowNanos();
+    }
+    void accumulate() {
+        if (!_running) return;
+        const uint64_t now = nowNanos();
+        _elapsedNanos += now - _markNanos;
+        _allocs += AllocCounter::allocations() - _markAllocs;
+        _allocBytes += AllocCounter::bytesAllocated() - _markBytes;
+    }
+    void start() { _running = true; mark(); }
+    void stop() { accumulate(); _running = false; }
+};
+
+typedef void (*CaseFn)(State&);
+
+struct Case {
+    const char* name;
+    CaseFn fn;
+    bool zeroAlloc;
+};
+
+struct Result {
+    const char* name;
+    uint32_t iterations;
+    double nsPerOp;
+    double bytesPerOp;          // Heap bytes allocated
+    double allocsPerOp;
+    double processedPerOp;      // setBytesProcessed()
+    bool zeroAlloc;
+    bool failed;
+    const char* failReason;
+    const char* counterName;    // nullptr = none
+    double counterValue;
+};
+
+inline Case* cases() {
+    static Case list[BENCH_MAX_CASES];
+    return list;
+}
+
+inline size_t& caseCount() {
+    static size_t count = 0;
+    return count;
+}
+
+struct Registrar {
+    Registrar(const char* name, CaseFn fn, bool zeroAlloc = false) {
+        if (caseCount() < BENCH_MAX_CASES) {
+            cases()[caseCount()++] = Case{name, fn, zeroAlloc};
+        }
+    }
+};
+
+/**
+ * Run one case to BENCH_MIN_TIME_MS
+ */
+inline Result run(const Case& c) {
+    uint32_t iterations = 1;
+    for (;;) {
+        State state(iterations);
+        c.fn(state);
+
+        const uint64_t minNanos = (uint64_t)BENCH_MIN_TIME_MS * 1000000ULL;
+        if (state.elapsedNanos() >= minNanos || iterations >= 100000000UL) {
+            Result r;
+            r.name = c.name;
+            r.iterations = iterations;
+            r.nsPerOp = (double)state.elapsedNanos() / iterations;
+            r.bytesPerOp = (double)state.allocatedBytes() / iterations;
+            r.allocsPerOp = (double)state.allocations() / iterations;
+            r.processedPerOp = (double)state.processedPerOp();
+            r.zeroAlloc = c.zeroAlloc;
+            r.counterName = state.counterName();
+            r.counterValue = state.counterValue();
+            r.failReason = state.failReason();
+#ifdef BENCH_COUNT_ALLOCS
+            if (!r.failReason && c.zeroAlloc && state.allocations() > 0) r.failReason = "allocates";
+#endif
+            r.failed = r.failReason != nullptr;
+            return r;
+        }
+
+        // Aim for the target time with some headroom, at most 10x per step
+        const double perOp = state.elapsedNanos() > 0 ? (double)state.elapsedNanos() / iterations : 1.0;
+        double next = (double)minNanos * 1.4 / perOp;
+        if (next > iterations * 10.0) next = iterations * 10.0;
+        if (next < iterations + 1.0) next = iterations + 1.0;
+        iterations = (uint32_t)next;
+    }
+}
+
+inline Result* results() {
+    static Result list[BENCH_MAX_CASES];
+    return list;
+}
+
+inline size_t& resultCount() {
+    static size_t count = 0;
+    return count;
+}
+
+/**
+ * Run all cases whose name contains filter (nullptr = all) and print a
+ * human-readable table
+ * @return number of cases run
+ */
+inline size_t runAll(Print& out, const char* filter = nullptr) {
+    resultCount() = 0;
+
+    out.println(F("Benchmark                              ns/op     bytes/op   allocs/op   iterations  processed/op"));
+    out.println(F("------------------------------------------------------------------------------------------------"));
+    for (size_t i = 0; i < caseCount(); i++) {
+        if (filter && *filter && !strstr(cases()[i].name, filter)) continue;
+        const Result r = run(cases()[i]);
+        results()[resultCount()++] = r;
+        out.printf("%-32s %12.1f %12.1f %11.2f %12u %13.0f",
+                   r.name, r.nsPerOp, r.bytesPerOp, r.allocsPerOp, (unsigned)r.iterations, r.processedPerOp);
+        if (r.counterName) out.printf("  %s=%g", r.counterName, r.counterValue);
+        if (r.failed) out.printf("  FAIL: %s", r.failReason);
+        out.printf("\n");
+    }
+    return resultCount();
+}
+
+/**
+ * Cases that failed in the last runAll() (allocated, or out of bounds)
+ */
+inline size_t failures() {
+    size_t n = 0;
+    for (size_t i = 0; i < resultCount(); i++) {
+        if (results()[i].failed) n++;
+    }
+    return n;
+}
+
+/**
+ * Write the last runAll() results as JSON (read by tools/bench/compare.py)
+ */
+inline void writeJson(Print& out) {
+    out.printf("{\"context\":{\"firmware\":\"%s\",\"build\":\"%s\",\"platform\":\"%s\",\"cpu_mhz\":%u},\n",
+               FIRMWARE_VERSION, FIRMWARE_BUILD,
+#if defined(ESP_PLATFORM)
+               "esp32",
+#else
+               "native",
+#endif
+               (unsigned)ESP.getCpuFreqMHz());
+    out.print(F("\"benchmarks\":["));
+    for (size_t i = 0; i < resultCount(); i++) {
+        const Result& r = results()[i];
+        out.printf("%s\n{\"name\":\"%s\",\"iterations\":%u,\"ns_per_op\":%.2f,"
+                   "\"bytes_per_op\":%.1f,\"allocs_per_op\":%.3f,\"processed_bytes_per_op\":%.0f,\"zero_alloc\":%s",
+                   i ? "," : "", r.name, (unsigned)r.iterations,
+                   r.nsPerOp, r.bytesPerOp, r.allocsPerOp, r.processedPerOp, r.zeroAlloc ? "true" : "false");
+        if (r.counterName) out.printf(",\"counters\":{\"%s\":%g}", r.counterName, r.counterValue);
+        out.print('}');
+    }
+    out.println(F("]}"));
+}
+
+} // namespace Bench
+
+#define BENCH_CONCAT_INNER(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_INNER(a, b)
+#define BENCHMARK(fn) static Bench::Registrar BENCH_CONCAT(_benchRegistrar, __LINE__)(#fn, fn)
+#define BENCHMARK_ZERO_ALLOC(fn) static Bench::Registrar BENCH_CONCAT(_benchRegistrar, __LINE__)(#fn, fn, true)
+
+#endif // BENCH_H
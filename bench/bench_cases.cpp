@@ -0,0 +1,1549 @@
+/**
+ * @file bench_cases.cpp
+ * @brief Hot-path benchmark cases
+ *
+ * Each case drives the same code the firmware runs, against in-memory
+ * sinks so results do not depend on the UART or the network.
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+#if defined(ARDUINO_NATIVE)
+#include <esp_ota_ops.h>     // nativeSetFlashDir
+#include <native_clock.h>
+#endif
+#include "bench.h"
+#include "delta_builder.h"
+#include "fence_builder.h"
+#include "filter_track.h"
+#include "nmea_capture.h"
+#include "route_builder.h"
+#include "trip_track.h"
+#include "../src/config.h"
+#include "../src/modules/arena.h"
+#include "../src/modules/buffered_print.h"
+#include "../src/modules/delta_patch.h"
+#include "../src/modules/geofence.h"
+#include "../src/modules/gpsd_server.h"
+#include "../src/modules/gps_module.h"
+#include "../src/modules/http_upload.h"
+#include "../src/modules/link_selector.h"
+#include "../src/modules/logger.h"
+#include "../src/modules/position_filter.h"
+#include "../src/modules/power_manager.h"
+#include "../src/modules/report_outbox.h"
+#include "../src/modules/route_tracker.h"
+#include "../src/modules/timer_wheel.h"
+#include "../src/modules/track_archive.h"
+#include "../src/modules/track_chart.h"
+#include "../src/modules/track_export.h"
+#include "../src/modules/trip_analytics.h"
+#include "../src/modules/upload_fanout.h"
+#include "../src/modules/webpage_renderer.h"
+#if defined(ARDUINO_NATIVE) && W5500_DRIVER_ENABLE
+#include <native_socket.h>      // nativeListenPort
+#include <w5500_sim.h>          // nativeW5500Stats
+#include "http_peer.h"
+#include "../src/modules/webserver_module.h"
+#endif
+
+/**
+ * Print that only counts bytes
+ */
+class CountingPrint : public Print {
+public:
+    size_t write(uint8_t) override { _bytes++; return 1; }
+    size_t write(const uint8_t*, size_t size) override { _bytes += size; return size; }
+
+    size_t bytes() const { return _bytes; }
+    void reset() { _bytes = 0; }
+
+private:
+    size_t _bytes = 0;
+};
+
+/**
+ * Client that accepts everything and never responds
+ */
+class NullClient : public Client {
+public:
+    int connect(IPAddress, uint16_t) override { return 1; }
+    int connect(const char*, uint16_t) override { return 1; }
+    size_t write(uint8_t) override { _bytes++; return 1; }
+    size_t write(const uint8_t*, size_t size) override { _bytes += size; return size; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int read(uint8_t*, size_t) override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+    void stop() override {}
+    uint8_t connected() override { return 1; }
+    operator bool() override { return true; }
+
+    size_t bytes() const { return _bytes; }
+    void reset() { _bytes = 0; }
+
+private:
+    size_t _bytes = 0;
+};
+
+/**
+ * Client that answers every request with a fixed response
+ */
+class CannedClient : public NullClient {
+public:
+    explicit CannedClient(const char* response) : _response(response) {}
+
+    int connect(IPAddress ip, uint16_t port) override { _pos = 0; return NullClient::connect(ip, port); }
+    int available() override { return (int)(strlen(_response) - _pos); }
+    int read() override { return available() > 0 ? (uint8_t)_response[_pos++] : -1; }
+    int peek() override { return available() > 0 ? (uint8_t)_response[_pos] : -1; }
+
+private:
+    const char* _response;
+    size_t _pos = 0;
+};
+
+static GPSData sampleFix() {
+    GPSData data;
+    data.clear();
+    data.valid = true;
+    data.latitude = -6.0999608;
+    data.longitude = 106.8000395;
+    data.speed = 22.22;
+    data.altitude = 12.3;
+    data.course = 45.0;
+    data.satellites = 9;
+    strncpy(data.datetime, "2024-05-01T02:00:00Z", sizeof(data.datetime) - 1);
+    return data;
+}
+
+static TripStatus sampleTrip() {
+    TripStatus trip{};
+    trip.motion = Motion::MOVING;
+    trip.inTrip = true;
+    trip.dwellS = 1834;
+    trip.odometerM = 152340;
+    trip.trips = 12;
+    trip.trip = TripSummary{12, 1714528800, 0, 21450, 5540, 420, 1, 772, 617, 82};
+    return trip;
+}
+
+// Prevent the compiler from discarding benchmarked results
+template <typename T>
+static inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * NMEA bytes -> TinyGPSPlus -> GPSData, one capture (20 epochs) per op
+ */
+static void BM_GpsParse(Bench::State& state) {
+    static GPSModule gps(GPS_RX_PIN, GPS_TX_PIN, GPS_BAUD_RATE);
+    GPSData data;
+    data.clear();
+    const size_t len = sizeof(NMEA_CAPTURE) - 1;
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < len; i++) {
+            gps.encode((uint8_t)NMEA_CAPTURE[i], data);
+        }
+        doNotOptimize(data);
+    }
+    state.setBytesProcessed(len);
+}
+BENCHMARK_ZERO_ALLOC(BM_GpsParse);
+
+static void BM_BuildJsonPayload(Bench::State& state) {
+    const GPSData data = sampleFix();
+    char buffer[384];
+
+    for (auto _ : state) {
+        HttpUpload::buildJsonPayload(buffer, sizeof(buffer), "GPS_BENCH", data, "192.168.1.177");
+        doNotOptimize(buffer);
+    }
+    state.setBytesProcessed(strlen(buffer));
+}
+BENCHMARK_ZERO_ALLOC(BM_BuildJsonPayload);
+
+static void BM_SendHttpPost(Bench::State& state) {
+    const GPSData data = sampleFix();
+    char payload[384];
+    HttpUpload::buildJsonPayload(payload, sizeof(payload), "GPS_BENCH", data, "192.168.1.177");
+    NullClient client;
+
+    for (auto _ : state) {
+        client.reset();
+        HttpUpload::sendHttpPost(client, SERVER_HOST, SERVER_PATH, payload);
+    }
+    state.setBytesProcessed(client.bytes());
+}
+BENCHMARK_ZERO_ALLOC(BM_SendHttpPost);
+
+static void BM_WebPageRender(Bench::State& state) {
+    const GPSData data = sampleFix();
+    const TripStatus trip = sampleTrip();
+    CountingPrint out;
+
+    for (auto _ : state) {
+        out.reset();
+        ArenaScope scope(Memory::web);
+        BufferedPrint buffered(out, Memory::web, HTTP_BUFFER_SIZE);
+        WebPage::render(buffered, data, true, &trip);
+    }
+    state.setBytesProcessed(out.bytes());
+}
+BENCHMARK_ZERO_ALLOC(BM_WebPageRender);
+
+/**
+ * Caller-side cost of a log record (drained outside the timed region)
+ */
+static void BM_LogWrite(Bench::State& state) {
+    CountingPrint out;
+    uint32_t n = 0;
+
+    for (auto _ : state) {
+        Log::write(Log::Id::APP_FIX_VALID, -6.0999608, 106.8000395, (uint8_t)9, 22.22);
+        if (++n % (LOG_QUEUE_RECORDS / 2) == 0) {
+            state.pauseTiming();
+            Log::drain(out);
+            state.resumeTiming();
+        }
+    }
+    Log::drain(out);
+}
+BENCHMARK_ZERO_ALLOC(BM_LogWrite);
+
+/**
+ * Drain-side cost: format one record into a line
+ */
+static void BM_LogFormat(Bench::State& state) {
+    Log::Record record;
+    record.timestampMs = 123456;
+    record.id = (uint16_t)Log::Id::APP_FIX_VALID;
+    Log::Encoder e(record);
+    Log::encodeArgs(e, -6.0999608, 106.8000395, (uint8_t)9, 22.22);
+    char line[160];
+    size_t len = 0;
+
+    for (auto _ : state) {
+        len = Log::format(record, line, sizeof(line));
+        doNotOptimize(line);
+    }
+    state.setBytesProcessed(len);
+}
+BENCHMARK_ZERO_ALLOC(BM_LogFormat);
+
+/**
+ * Timer wheel: one 10 ms tick with 64 periodic timers armed (send,
+ * maintain, LED, watchdog-style periods), including their callbacks
+ */
+static void BM_TimerWheelTick(Bench::State& state) {
+    static uint32_t fired;
+    static const uint32_t periods[] = {10, 20, 100, 200, 1000, 2000, 30000, 60000};
+    struct Counted {
+        Timer timer{[](void*) { fired++; }, nullptr};
+    };
+    static Counted counted[64];
+    TimerWheel wheel(0);
+    for (size_t i = 0; i < 64; i++) {
+        wheel.schedule(counted[i].timer, periods[i % 8], periods[i % 8]);
+    }
+    uint32_t now = 0;
+
+    for (auto _ : state) {
+        now += TIMER_TICK_MS;
+        wheel.advance(now);
+    }
+    doNotOptimize(fired);
+    for (Counted& c : counted) wheel.cancel(c.timer);
+}
+BENCHMARK_ZERO_ALLOC(BM_TimerWheelTick);
+
+/**
+ * One steady-state loop cycle: GPS epoch, upload against a canned 200,
+ * dashboard render, log records. Must not allocate.
+ */
+static void BM_SteadyStateCycle(Bench::State& state) {
+    static GPSModule gps(GPS_RX_PIN, GPS_TX_PIN, GPS_BAUD_RATE);
+    GPSData data;
+    data.clear();
+    CannedClient client("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+    CountingPrint page;
+    CountingPrint logs;
+    const size_t epochLen = (sizeof(NMEA_CAPTURE) - 1) / NMEA_CAPTURE_EPOCHS;
+    size_t cursor = 0;
+    uint32_t n = 0;
+
+    for (auto _ : state) {
+        Memory::cycle.reset();
+        for (size_t i = 0; i < epochLen; i++) {
+            gps.encode((uint8_t)NMEA_CAPTURE[cursor], data);
+            cursor = (cursor + 1) % (sizeof(NMEA_CAPTURE) - 1);
+        }
+        Log::write(Log::Id::APP_FIX_VALID, data.latitude, data.longitude, data.satellites, data.speed);
+
+        const HttpResponse response = HttpUpload::post(client, IPAddress(127, 0, 0, 1), SERVER_HOST,
+                                                       SERVER_PATH, SERVER_PORT, "GPS_BENCH", data,
+                                                       "192.168.1.177");
+        Log::write(Log::Id::APP_SEND_OK, response.statusCode);
+
+        Memory::web.reset();
+        {
+            ArenaScope scope(Memory::web);
+            BufferedPrint out(page, Memory::web, HTTP_BUFFER_SIZE);
+            WebPage::render(out, data, data.valid);
+        }
+
+        if (++n % 8 == 0) {
+            state.pauseTiming();
+            Log::drain(logs);
+            state.resumeTiming();
+        }
+    }
+    Log::drain(logs);
+    state.setBytesProcessed(client.bytes() / state.iterations());
+}
+BENCHMARK_ZERO_ALLOC(BM_SteadyStateCycle);
+
+/**
+ * Geofences: one fix against N fences through the grid index, on a track
+ * that keeps entering and leaving them. Cost should stay flat as N grows.
+ */
+template <size_t N, bool Indexed = true>
+static void BM_GeofenceEval(Bench::State& state) {
+    static size_t size;
+    static uint8_t* blob = buildFenceBlob(N, Indexed, size);
+    static GeofenceEngine engine;
+    if (!blob || !engine.load(blob, size)) return;
+    GeofenceEvent events[4];
+    uint32_t step = 0;
+    size_t transitions = 0;
+
+    for (auto _ : state) {
+        const GeofencePoint p = fenceTrackPoint(N, step++);
+        transitions += engine.update(p.latE7, p.lonE7, events, 4);
+    }
+    doNotOptimize(transitions);
+}
+BENCHMARK_ZERO_ALLOC(BM_GeofenceEval<100>);
+BENCHMARK_ZERO_ALLOC(BM_GeofenceEval<1000>);
+#if !defined(ESP_PLATFORM)
+BENCHMARK_ZERO_ALLOC(BM_GeofenceEval<5000>);  // About 300 KB, more than ESP32 DRAM
+#endif
+
+/**
+ * Same fences without the index (one cell): the linear scan the grid avoids
+ */
+template <size_t N>
+static void BM_GeofenceScan(Bench::State& state) {
+    BM_GeofenceEval<N, false>(state);
+}
+BENCHMARK_ZERO_ALLOC(BM_GeofenceScan<1000>);
+
+/**
+ * Route: one fix matched against a route of N segments, sailing along it
+ * 30 m off the line. Cost should not depend on N.
+ */
+template <size_t N>
+static void BM_RouteUpdate(Bench::State& state) {
+    static size_t size;
+    static uint8_t* blob = buildRouteBlob(N, size);
+    static RouteTracker tracker;
+    if (!blob || !tracker.load(blob, size)) return;
+    RouteEvent event;
+    uint32_t step = 0;
+    uint32_t events = 0;
+
+    for (auto _ : state) {
+        const RouteBenchPoint p = routeTrackPoint(N, step);
+        events += tracker.update(p.latE7, p.lonE7, step * 1000, event);
+        step++;
+    }
+    doNotOptimize(events);
+    doNotOptimize(tracker.status());
+}
+BENCHMARK_ZERO_ALLOC(BM_RouteUpdate<100>);
+BENCHMARK_ZERO_ALLOC(BM_RouteUpdate<1000>);
+#if !defined(ESP_PLATFORM)
+BENCHMARK_ZERO_ALLOC(BM_RouteUpdate<20000>);  // About 500 KB, more than ESP32 DRAM
+#endif
+
+/**
+ * Step pairs for the haversine case: the recorded capture, then 0.3 m to
+ * 100 km at several latitudes and bearings
+ */
+struct TripPair {
+    int32_t lat1E7, lon1E7, lat2E7, lon2E7;
+    double referenceMm;
+};
+
+static size_t buildTripPairs(TripPair* pairs, size_t max) {
+    static GPSModule gps(GPS_RX_PIN, GPS_TX_PIN, GPS_BAUD_RATE);
+    size_t n = 0;
+    auto add = [&](int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+        if (n == max) return;
+        pairs[n++] = TripPair{lat1, lon1, lat2, lon2,
+                              tripReferenceM(lat1 * 1e-7, lon1 * 1e-7, lat2 * 1e-7, lon2 * 1e-7) * 1000};
+    };
+
+    GPSData data;
+    data.clear();
+    int32_t lastLat = 0, lastLon = 0;
+    bool first = true;
+    for (size_t i = 0; i < sizeof(NMEA_CAPTURE) - 1; i++) {
+        if (!gps.encode((uint8_t)NMEA_CAPTURE[i], data) || NMEA_CAPTURE[i + 1] != '$' || !data.valid) continue;
+        const int32_t lat = (int32_t)lround(data.latitude * 1e7), lon = (int32_t)lround(data.longitude * 1e7);
+        if (!first && (lat != lastLat || lon != lastLon)) add(lastLat, lastLon, lat, lon);
+        first = false;
+        lastLat = lat;
+        lastLon = lon;
+    }
+
+    static const double latitudes[] = {0, -6.1, 45, 70, -89};
+    static const double metres[] = {0.3, 1, 6, 100, 1000, 10000, 100000};
+    static const double bearings[] = {0, 30, 90, 135, 200};
+    for (double lat : latitudes) {
+        for (double m : metres) {
+            for (double b : bearings) {
+                const double lat2 = lat + m * cos(b * M_PI / 180) / 111194.9;
+                const double lon2 = 106.8 + m * sin(b * M_PI / 180) / (111194.9 * cos(lat * M_PI / 180));
+                if (fabs(lon2 - 106.8) > 1) continue;   // Not measured, see MAX_STEP_E7
+                add((int32_t)lround(lat * 1e7), 1068000000, (int32_t)lround(lat2 * 1e7), (int32_t)lround(lon2 * 1e7));
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * Fixed-point haversine (one step distance per op) against double
+ * precision. Fails beyond 1 mm, or 1 ppm for steps over 1 km.
+ */
+static void BM_TripHaversine(Bench::State& state) {
+    static TripPair pairs[256];
+    static const size_t count = buildTripPairs(pairs, sizeof(pairs) / sizeof(pairs[0]));
+
+    double worstPpm = 0;
+    bool failed = false;
+    for (size_t i = 0; i < count; i++) {
+        const TripPair& p = pairs[i];
+        const double error = fabs(TripMath::distanceMm(p.lat1E7, p.lon1E7, p.lat2E7, p.lon2E7) - p.referenceMm);
+        if (p.referenceMm >= 1e6) {
+            worstPpm = max(worstPpm, error / p.referenceMm * 1e6);
+            failed |= error > p.referenceMm * 1e-6;
+        } else {
+            failed |= error > 1;
+        }
+    }
+    state.setCounter("max_err_ppm", worstPpm);
+    if (failed) state.fail("haversine error");
+
+    size_t i = 0;
+    uint32_t total = 0;
+    for (auto _ : state) {
+        const TripPair& p = pairs[i];
+        total += TripMath::distanceMm(p.lat1E7, p.lon1E7, p.lat2E7, p.lon2E7);
+        if (++i == count) i = 0;
+    }
+    doNotOptimize(total);
+}
+BENCHMARK_ZERO_ALLOC(BM_TripHaversine);
+
+/**
+ * Trip analytics, one fix per op, over the synthetic voyage (laps keep
+ * the clock running)
+ */
+static void BM_TripUpdate(Bench::State& state) {
+    static const TripTrack track = buildTripTrack();
+    if (!track.samples) return;
+    static TripAnalytics trip;
+    static uint32_t lap = 0;
+    static size_t i = 0;
+    TripEvent event;
+    uint32_t events = 0;
+
+    for (auto _ : state) {
+        TripSample s = track.samples[i];
+        s.timeMs += lap * (uint32_t)track.count * 1000;
+        events += trip.update(s, event);
+        if (++i == track.count) {
+            i = 0;
+            lap++;
+        }
+    }
+    doNotOptimize(events);
+    doNotOptimize(trip.status());
+}
+BENCHMARK_ZERO_ALLOC(BM_TripUpdate);
+
+/**
+ * Whole voyage per op: one trip, one stop, odometer against the reference.
+ * Fails if the trip is not found as sailed or the distance is off by
+ * more than 0.1 %.
+ */
+static void BM_TripVoyage(Bench::State& state) {
+    static const TripTrack track = buildTripTrack();
+    if (!track.samples) return;
+    TripEvent event;
+    TripSummary ended{};
+    uint32_t events = 0;
+
+    for (auto _ : state) {
+        TripAnalytics trip;
+        for (size_t i = 0; i < track.count; i++) {
+            if (trip.update(track.samples[i], event)) {
+                events++;
+                if (event.ended) ended = event.trip;
+            }
+        }
+    }
+    state.setBytesProcessed(track.count * sizeof(TripSample));
+
+    const double errorPpm = fabs(ended.distanceM - track.movingM) / track.movingM * 1e6;
+    state.setCounter("odo_err_ppm", errorPpm);
+    if (events != 2 * state.iterations() || ended.stops != TRIP_TRACK_STOPS ||
+        abs((int)ended.movingS - (int)track.movingS) > 2 || abs((int)ended.stoppedS - (int)track.stoppedS) > 2) {
+        state.fail("trip not detected as sailed");
+    } else if (errorPpm > 1000) {
+        state.fail("odometer error");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_TripVoyage);
+
+/**
+ * One epoch per op over the noisy passage (laps keep the clock running).
+ * Fails above POSITION_CYCLE_BUDGET at the CPU clock (240 MHz on host).
+ */
+static void BM_PositionFilterUpdate(Bench::State& state) {
+    static const FilterTrack track = buildFilterTrack();
+    if (!track.samples) return;
+    static PositionFilter filter;
+    static uint32_t lap = 0;
+    static size_t i = 0;
+    FilteredPosition out;
+    uint32_t accepted = 0;
+
+    for (auto _ : state) {
+        PositionMeasurement m = track.samples[i].m;
+        m.timeMs += lap * (uint32_t)track.count * 1000;
+        accepted += filter.update(m, out) == FilterStep::ACCEPTED;
+        if (++i == track.count) {
+            i = 0;
+            lap++;
+        }
+    }
+    doNotOptimize(accepted);
+    doNotOptimize(out);
+
+#if defined(ESP_PLATFORM)
+    const double mhz = ESP.getCpuFreqMHz();
+#else
+    const double mhz = 240;
+#endif
+    const double budgetNs = POSITION_CYCLE_BUDGET * 1000.0 / mhz;
+    const double nsPerOp = (double)state.elapsedNanos() / state.iterations();
+    state.setCounter("budget_pct", nsPerOp / budgetNs * 100);
+    if (nsPerOp > budgetNs) state.fail("over cycle budget");
+}
+BENCHMARK_ZERO_ALLOC(BM_PositionFilterUpdate);
+
+/**
+ * Whole passage per op, error against the true track. Fails unless the
+ * filtered RMS error (multipath fixes excluded) is under 80 % of the raw
+ * one, every multipath jump is rejected (filtered error under 10 m) and
+ * the dropout is bridged within 10 m.
+ */
+static void BM_PositionFilterTrack(Bench::State& state) {
+    static const FilterTrack track = buildFilterTrack();
+    if (!track.samples) return;
+    double rawSq = 0, filteredSq = 0, worstOutlierM = 0, worstDeadReckonedM = 0;
+    size_t clean = 0;
+    bool lost = false;
+
+    for (auto _ : state) {
+        PositionFilter filter;
+        FilteredPosition out;
+        rawSq = filteredSq = worstOutlierM = worstDeadReckonedM = 0;
+        clean = 0;
+        for (size_t i = 0; i < track.count; i++) {
+            const FilterTrackSample& s = track.samples[i];
+            filter.update(s.m, out);
+            lost |= !out.valid;
+            const double error = filterTrackErrorM(out.latE7, out.lonE7, s.trueLat, s.trueLon);
+            if (out.deadReckoned) {
+                worstDeadReckonedM = max(worstDeadReckonedM, error);
+            } else if (s.outlier) {
+                worstOutlierM = max(worstOutlierM, error);
+            } else {
+                const double raw = filterTrackErrorM(s.m.latE7, s.m.lonE7, s.trueLat, s.trueLon);
+                rawSq += raw * raw;
+                filteredSq += error * error;
+                clean++;
+            }
+        }
+    }
+    state.setBytesProcessed(track.count * sizeof(PositionMeasurement));
+
+    const double ratioPct = clean ? sqrt(filteredSq / rawSq) * 100 : 100;
+    state.setCounter("rms_vs_raw_pct", ratioPct);
+    if (lost) {
+        state.fail("fix lost");
+    } else if (ratioPct >= 80) {
+        state.fail("not smoother than raw");
+    } else if (worstOutlierM > 10) {
+        state.fail("multipath not rejected");
+    } else if (worstDeadReckonedM > 10) {
+        state.fail("dead reckoning error");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_PositionFilterTrack);
+
+/**
+ * Link failover policy on simulated links, one hour per op: probes every
+ * LINK_PROBE_MS, a report every SEND_INTERVAL_NORMAL, Ethernet 2 ms and
+ * WiFi 15 ms connect time with +-30 % jitter. Ethernet stops answering
+ * (address kept) for 10 min from 10:07, and its connect time degrades to
+ * 400 ms for 10 min from 40:07. Counter is the slower of the two times
+ * from the event to the first report on WiFi. Fails if that is longer
+ * than one report interval, or on any switch besides the four expected
+ * (flapping).
+ */
+static void BM_LinkFailover(Bench::State& state) {
+    static constexpr size_t ETH = 0, WIFI = 1;
+    static constexpr uint32_t OUTAGE_MS = 607000, RESTORE_MS = 1207000;
+    static constexpr uint32_t SLOW_MS = 2407000, FAST_MS = 3007000, HOUR_MS = 3600000;
+    static constexpr uint32_t NOT_YET = UINT32_MAX;
+    uint32_t outageSwitchMs = NOT_YET, slowSwitchMs = NOT_YET, switches = 0;
+
+    for (auto _ : state) {
+        LinkSelector<2> selector;
+        selector.setUp(ETH, true);
+        selector.setUp(WIFI, true);
+        selector.select();
+        uint32_t seed = 7;
+        auto connectUs = [&seed](uint32_t baseUs) {
+            seed = seed * 1103515245u + 12345u;
+            return baseUs * (70 + (seed >> 16) % 61) / 100;
+        };
+        auto ethUp = [](uint32_t t) { return t < OUTAGE_MS || t >= RESTORE_MS; };
+        auto ethUs = [](uint32_t t) { return t >= SLOW_MS && t < FAST_MS ? 400000u : 2000u; };
+
+        outageSwitchMs = slowSwitchMs = NOT_YET;
+        switches = 0;
+        size_t active = selector.active();
+        for (uint32_t t = 0; t < HOUR_MS; t += 1000) {
+            if (t % LINK_PROBE_MS == 0) {
+                selector.observe(ETH, ethUp(t), ethUp(t) ? connectUs(ethUs(t)) : 0);
+                selector.observe(WIFI, true, connectUs(15000));
+                selector.select();
+            }
+            if (t % SEND_INTERVAL_NORMAL == 0) {
+                if (selector.active() == ETH && !ethUp(t)) {
+                    selector.observe(ETH, false);
+                    selector.activate(selector.fallback());
+                }
+                selector.observe(selector.active(), true);
+                if (selector.active() == WIFI) {
+                    if (t >= SLOW_MS && slowSwitchMs == NOT_YET) {
+                        slowSwitchMs = t - SLOW_MS;
+                    } else if (t >= OUTAGE_MS && t < SLOW_MS && outageSwitchMs == NOT_YET) {
+                        outageSwitchMs = t - OUTAGE_MS;
+                    }
+                }
+            }
+            if (selector.active() != active) switches++;
+            active = selector.active();
+        }
+    }
+    const uint32_t worstMs = max(outageSwitchMs, slowSwitchMs);
+    state.setCounter("switch_s", worstMs / 1000.0);
+    if (switches != 4) {
+        state.fail("unexpected link switches");
+    } else if (worstMs > SEND_INTERVAL_NORMAL) {
+        state.fail("switch slower than a report interval");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_LinkFailover);
+
+/**
+ * Power policy over two simulated hours, checked every POWER_CHECK_MS
+ * (on the host the virtual clock follows): under way on ship power, at
+ * anchor, battery backup, drifting inside the hysteresis band, under way
+ * again, fix lost, ship power back. Counter is the modelled average draw
+ * at anchor on battery (mW). Fails on a supply or GPS mode other than
+ * expected at the end of a phase, on any extra transition, if cyclic
+ * tracking starts more than one check after POWER_STATIONARY_MS, or if
+ * the draw at anchor on battery is not below the draw under way.
+ */
+static void BM_PowerPolicy(Bench::State& state) {
+    struct Phase {
+        uint32_t untilMs;       // Simulated time at its end
+        bool battery;
+        bool valid;
+        float speed;            // km/h
+        bool gpsPowerSave;      // Expected at the end
+        bool lightSleep;
+    };
+    static constexpr uint32_t MIN = 60000;
+    static const Phase PHASES[] = {
+        {20 * MIN, false, true, 12.0f, false, false},   // Under way
+        {40 * MIN, false, true, 0.4f, true, false},     // At anchor
+        {60 * MIN, true, true, 0.4f, true, true},       // Battery backup
+        {70 * MIN, true, true, 2.0f, true, true},       // Drifting, inside the band
+        {80 * MIN, true, true, 6.0f, false, true},      // Under way again
+        {90 * MIN, true, false, 0.0f, false, true},     // Fix lost
+        {120 * MIN, false, true, 12.0f, false, false},  // Ship power back
+    };
+    static constexpr size_t PHASE_COUNT = sizeof(PHASES) / sizeof(PHASES[0]);
+    const char* failure = nullptr;
+    uint32_t underWayMw = 0, anchorMw = 0;
+
+#if defined(ARDUINO_NATIVE)
+    NativeClock::setVirtual(true);
+#endif
+    for (auto _ : state) {
+        PowerManager power;
+        power.begin();
+        const uint32_t start = millis();
+        uint32_t elapsed = 0, psmAtMs = 0, supplyChanges = 0, gpsChanges = 0;
+        GPSData fix;
+        fix.clear();
+
+        for (size_t i = 0; i < PHASE_COUNT && !failure; i++) {
+            const Phase& phase = PHASES[i];
+            fix.valid = phase.valid;
+            fix.speed = phase.speed;
+            while (elapsed < phase.untilMs) {
+                elapsed += POWER_CHECK_MS;
+#if defined(ARDUINO_NATIVE)
+                NativeClock::advance((uint64_t)POWER_CHECK_MS * 1000);
+#endif
+                const uint8_t changes = power.update(fix, phase.battery, start + elapsed);
+                supplyChanges += (changes & PowerManager::CHANGED_SUPPLY) != 0;
+                gpsChanges += (changes & PowerManager::CHANGED_GPS) != 0;
+                if ((changes & PowerManager::CHANGED_GPS) && power.gpsPowerSave()) psmAtMs = elapsed;
+            }
+            const EnergyReport energy = power.takeReport(start + elapsed);
+            if (i == 0) underWayMw = energy.averageMilliwatts();
+            if (i == 2) anchorMw = energy.averageMilliwatts();
+
+            if (power.onBattery() != phase.battery || power.lightSleep() != phase.lightSleep) {
+                failure = "wrong supply state";
+            } else if (power.gpsPowerSave() != phase.gpsPowerSave) {
+                failure = "wrong GPS mode";
+            }
+        }
+        if (failure) continue;
+        if (supplyChanges != 2 || gpsChanges != 2) {
+            failure = "extra transitions";
+        } else if (psmAtMs > PHASES[0].untilMs + POWER_STATIONARY_MS + POWER_CHECK_MS) {
+            failure = "cyclic tracking late";
+        }
+    }
+#if defined(ARDUINO_NATIVE)
+    NativeClock::setVirtual(false);
+#endif
+    state.setCounter("anchor_mW", anchorMw);
+    if (failure) {
+        state.fail(failure);
+    } else if (anchorMw >= underWayMw) {
+        state.fail("battery at anchor draws no less");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_PowerPolicy);
+
+/**
+ * In-memory sockets for GpsdServer: every client takes what it is sent,
+ * except stalled ones (socket buffer full for good)
+ */
+struct BenchStreamLink {
+    static constexpr size_t MAX = 40;
+    static inline uint64_t received[MAX];
+    static inline bool stalled[MAX];
+    static inline bool open[MAX];
+    static inline const char* request[MAX];
+    static inline size_t pending[2];    // Connections waiting per port (gpsd, NMEA)
+    static inline size_t nextId = 0;
+
+    struct Client {
+        int id = -1;
+        explicit operator bool() const { return id >= 0; }
+        uint8_t connected() const { return open[id]; }
+        int available() const { return request[id] ? (int)strlen(request[id]) : 0; }
+        int read() { return available() ? (uint8_t)*request[id]++ : -1; }
+        void stop() { if (id >= 0) open[id] = false; }
+    };
+    struct Server {
+        explicit Server(uint16_t port) : nmea(port == GPSD_NMEA_PORT) {}
+        void begin() {}
+        bool nmea;
+    };
+
+    static bool lock() { return true; }
+    static void unlock() {}
+    static Client accept(Server& server) {
+        if (pending[server.nmea] == 0 || nextId == MAX) return Client{};
+        pending[server.nmea]--;
+        const int id = (int)nextId++;
+        open[id] = true;
+        return Client{id};
+    }
+    static size_t send(Client& client, const uint8_t*, size_t size) {
+        if (stalled[client.id]) return 0;
+        received[client.id] += size;
+        return size;
+    }
+};
+
+/**
+ * One receiver epoch per op (RMC + GGA, then the TPV report) fanned out
+ * to 15 gpsd JSON and 16 NMEA clients, plus one stalled client. Counter
+ * is the fan-out throughput (bytes delivered to all clients per second).
+ * Fails unless every live client got the whole stream and the stalled
+ * one was dropped.
+ */
+static void BM_GpsdFanout(Bench::State& state) {
+    static constexpr size_t JSON_CLIENTS = 16, NMEA_CLIENTS = 16, CLIENTS = JSON_CLIENTS + NMEA_CLIENTS;
+    static constexpr size_t STALLED = 0;    // A JSON client that never reads
+    static GpsdFeed feed;
+    static GpsdServer<BenchStreamLink, CLIENTS> server(feed, "bench");
+    static const char* const WATCH = "?WATCH={\"enable\":true,\"json\":true};";
+    static bool connected = false;
+    if (!connected) {
+        // The gpsd port is accepted first: JSON clients get the low ids
+        BenchStreamLink::pending[0] = JSON_CLIENTS;
+        BenchStreamLink::pending[1] = NMEA_CLIENTS;
+        for (size_t i = 0; i < JSON_CLIENTS; i++) BenchStreamLink::request[i] = WATCH;
+        BenchStreamLink::stalled[STALLED] = true;
+        server.begin();
+        server.handle();
+        connected = true;
+    }
+    for (size_t i = 0; i < CLIENTS; i++) BenchStreamLink::received[i] = 0;
+    const uint32_t droppedBefore = Metrics::registry.gpsdDropped.value();
+    const uint32_t nmeaStart = feed.nmea.head(), jsonStart = feed.json.head();
+
+    GPSData fix = sampleFix();
+    const char* epoch = NMEA_CAPTURE;
+    const char* const end = NMEA_CAPTURE + sizeof(NMEA_CAPTURE) - 1;
+    for (auto _ : state) {
+        const char* next = strstr(epoch, "$GPRMC,");
+        next = next ? strstr(next + 1, "$GPRMC,") : nullptr;
+        if (!next) next = end;
+        feed.nmea.write((const uint8_t*)epoch, next - epoch);
+        fix.epoch++;
+        feed.publishFix(fix);
+        server.handle();
+        epoch = next == end ? NMEA_CAPTURE : next;
+    }
+
+    uint64_t delivered = 0;
+    bool complete = true;
+    for (size_t i = 0; i < CLIENTS; i++) {
+        if (i == STALLED) continue;
+        delivered += BenchStreamLink::received[i];
+        const uint32_t expected = i < JSON_CLIENTS ? feed.json.head() - jsonStart : feed.nmea.head() - nmeaStart;
+        complete &= BenchStreamLink::received[i] == expected;
+    }
+    state.setBytesProcessed(delivered / state.iterations());
+    state.setCounter("MB_s", delivered * 1e3 / max<uint64_t>(state.elapsedNanos(), 1));
+    if (!complete) {
+        state.fail("client missed stream bytes");
+    } else if (Metrics::registry.gpsdDropped.value() == droppedBefore && BenchStreamLink::open[STALLED]) {
+        state.fail("stalled client not dropped");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_GpsdFanout);
+
+/**
+ * Delta image in RAM: old bytes from the built image, new bytes only
+ * counted (the applier's hash checks them)
+ */
+struct BenchDeltaImage {
+    const uint8_t* oldImage;
+    uint32_t written = 0;
+
+    DeltaError open(const DeltaHeader&) {
+        written = 0;
+        return DeltaError::NONE;
+    }
+    bool readOld(uint32_t offset, uint8_t* out, size_t len) {
+        memcpy(out, oldImage + offset, len);
+        return true;
+    }
+    bool writeNew(const uint8_t*, size_t len) {
+        written += len;
+        return true;
+    }
+};
+
+/**
+ * OTA delta apply: one whole patch per op (see delta_builder.h), fed in
+ * TCP-segment pieces as the download delivers it, including the SHA-256
+ * of the new image. Counter is the new image rebuilt per second. Fails
+ * unless the rebuilt image hashes right.
+ */
+static void BM_DeltaApply(Bench::State& state) {
+    #if defined(ESP_PLATFORM)
+    static constexpr size_t IMAGE_BYTES = 64 * 1024;
+    #else
+    static constexpr size_t IMAGE_BYTES = 1024 * 1024;  // A full app slot
+    #endif
+    static constexpr size_t SEGMENT = 1460;
+    static DeltaImages images;
+    static bool built = buildDeltaImages(IMAGE_BYTES, images);
+    if (!built) return;
+    static BenchDeltaImage image{images.oldImage};
+    static DeltaApplier<BenchDeltaImage> applier(image);
+    DeltaError error = DeltaError::NONE;
+
+    for (auto _ : state) {
+        applier.reset();
+        for (size_t pos = 0; pos < images.patchSize; pos += SEGMENT) {
+            applier.write(images.patch + pos, min(SEGMENT, images.patchSize - pos));
+        }
+        error = applier.finish();
+    }
+    state.setBytesProcessed(images.newSize);
+    state.setCounter("MB_s", (double)images.newSize * state.iterations() * 1e3 /
+                                 max<uint64_t>(state.elapsedNanos(), 1));
+    if (error != DeltaError::NONE || image.written != images.newSize) state.fail(DELTA_ERROR_NAMES[(size_t)error]);
+}
+BENCHMARK_ZERO_ALLOC(BM_DeltaApply);
+
+/**
+ * Archive on the "spiffs" partition (a temporary file on the host),
+ * erased once
+ */
+static TrackArchive* benchArchive() {
+    static TrackArchive archive;
+    static bool ready = [] {
+        #if defined(ARDUINO_NATIVE)
+        static char dir[] = "/tmp/bench_flashXXXXXX";
+        if (!mkdtemp(dir)) return false;
+        nativeSetFlashDir(dir);
+        #endif
+        return archive.begin() && archive.clear();
+    }();
+    return ready ? &archive : nullptr;
+}
+
+/**
+ * Fix t of a 1 Hz passage at 12 kn with some GPS noise
+ */
+static TrackPoint archiveFix(uint32_t t) {
+    static constexpr uint32_t START = 1714528800;
+    uint32_t noise = t * 2654435761u;
+    TrackPoint p{};
+    p.time = START + t;
+    p.lat = -61000000 + (int32_t)(t * 39) + (int32_t)(noise >> 29) - 4;
+    p.lng = 1068000000 + (int32_t)(t * 39) + (int32_t)((noise >> 26) & 7) - 4;
+    p.speed = (uint16_t)(2222 + (noise >> 28) % 20);
+    p.altitude = (int16_t)(12 + (noise >> 30));
+    p.course = (uint16_t)(4500 + (noise >> 24) % 50);
+    p.satellites = 9;
+    return p;
+}
+
+static uint32_t archiveFixes = 0;   // Fixes appended so far
+
+/**
+ * Track archive ingest: one 1 Hz fix per op, page writes and sector
+ * erases included (NOR rules on the host file). Runs long enough to wrap
+ * the partition. Counter is flash bytes programmed per fix. Fails if
+ * that is not below the 20-byte TrackPoint.
+ */
+static void BM_ArchiveAppend(Bench::State& state) {
+    TrackArchive* archive = benchArchive();
+    if (!archive) return;
+    const Metrics::Registry& metrics = Metrics::registry;
+    const uint32_t bytesBefore = metrics.archiveFlashBytes.value();
+    const uint32_t fixesBefore = metrics.archiveFixes.value();
+
+    for (auto _ : state) {
+        archive->append(archiveFix(archiveFixes++));
+    }
+    const uint32_t fixes = metrics.archiveFixes.value() - fixesBefore;
+    const double bytesPerFix = (double)(metrics.archiveFlashBytes.value() - bytesBefore) / max<uint32_t>(fixes, 1);
+    state.setCounter("flash_B_fix", bytesPerFix);
+    if (fixes != state.iterations()) {
+        state.fail("fix rejected");
+    } else if (bytesPerFix >= sizeof(TrackPoint)) {
+        state.fail("records not compact");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_ArchiveAppend);
+
+/**
+ * Track archive range query: one hour (3600 fixes) at a random point of
+ * the last day, decoded page by page. ns/op is the query latency. Fails
+ * unless every fix of the hour comes back, in order.
+ */
+static void BM_ArchiveQuery(Bench::State& state) {
+    static constexpr uint32_t DAY_S = 86400, HOUR_S = 3600;
+    TrackArchive* archive = benchArchive();
+    if (!archive) return;
+    while (archiveFixes < DAY_S) archive->append(archiveFix(archiveFixes++));
+    static uint8_t page[ARCHIVE_PAGE_SIZE];
+    const uint32_t newest = archive->newestTime();
+    uint32_t seed = 99;
+    bool complete = true;
+    uint32_t fixes = 0;
+
+    for (auto _ : state) {
+        seed = seed * 1103515245u + 12345u;
+        const uint32_t from = newest - DAY_S + 1 + (seed >> 8) % (DAY_S - HOUR_S);
+        uint32_t expected = from;
+        fixes = archive->query(from, from + HOUR_S - 1, page, [&](const TrackPoint& p) {
+            complete &= p.time == expected++;
+            return true;
+        });
+        complete &= fixes == HOUR_S;
+    }
+    state.setCounter("fixes", fixes);
+    if (!complete) state.fail("fixes missing from the range");
+}
+BENCHMARK_ZERO_ALLOC(BM_ArchiveQuery);
+
+/**
+ * /chart.svg body: a full track store (TRACK_STORE_CAPACITY fixes, one
+ * speed spike) reduced to CHART_MAX_POINTS and rendered. ns/op is the
+ * request's CPU time. Fails unless the chart has every point it may and
+ * keeps the spike.
+ */
+static void BM_ChartDownsample(Bench::State& state) {
+    static TrackStore store;
+    static constexpr uint32_t SPIKE = TRACK_STORE_CAPACITY * 2 / 3;
+    if (store.size() == 0) {
+        for (uint32_t t = 0; t < TRACK_STORE_CAPACITY; t++) {
+            TrackPoint p = archiveFix(t * 30);
+            if (t == SPIKE) p.speed = 4000;
+            store.append(p, (uint16_t)(180 - t % 7));
+        }
+    }
+    CountingPrint out;
+    size_t kept = 0;
+    bool spike = false;
+
+    for (auto _ : state) {
+        out.reset();
+        ArenaScope scope(Memory::web);
+        TrackChart::Point* points = (TrackChart::Point*)Memory::web.allocate(
+            CHART_MAX_POINTS * sizeof(TrackChart::Point), alignof(TrackChart::Point));
+        kept = TrackChart::downsample(store, 0, store.size(), TrackChart::Series::SPEED, points, CHART_MAX_POINTS);
+        spike = false;
+        for (size_t i = 0; i < kept; i++) spike |= points[i].value == 40.0f;
+        BufferedPrint buffered(out, Memory::web, HTTP_BUFFER_SIZE);
+        TrackChart::render(buffered, TrackChart::Series::SPEED, points, kept);
+    }
+    state.setBytesProcessed(out.bytes());
+    state.setCounter("points", kept);
+    if (kept != CHART_MAX_POINTS) {
+        state.fail("wrong point count");
+    } else if (!spike) {
+        state.fail("spike lost");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_ChartDownsample);
+
+/**
+ * Client that digests the response body from a given byte on (FNV-1a)
+ */
+class BodyDigestClient : public NullClient {
+public:
+    void reset(size_t from = 0) {
+        NullClient::reset();
+        _from = from;
+        _matched = 0;
+        _body = 0;
+        _hash = 2166136261u;
+    }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* data, size_t size) override {
+        NullClient::write(data, size);
+        for (size_t i = 0; i < size; i++) {
+            if (_matched < 4) {
+                _matched = data[i] == "\r\n\r\n"[_matched] ? _matched + 1 : (data[i] == '\r' ? 1 : 0);
+            } else if (_body++ >= _from) {
+                _hash = (_hash ^ data[i]) * 16777619u;
+            }
+        }
+        return size;
+    }
+
+    size_t body() const { return _body; }
+    uint32_t hash() const { return _hash; }
+
+private:
+    size_t _from = 0;
+    uint8_t _matched = 0;
+    size_t _body = 0;
+    uint32_t _hash = 2166136261u;
+};
+
+/**
+ * Digest client that stores fixes while the body streams (the uploader
+ * at work) and checks the GeoJSON braces balance
+ */
+class AppendingClient : public BodyDigestClient {
+public:
+    AppendingClient(TrackStore& store, uint32_t perWrite, uint32_t nextTime)
+        : _store(store), _perWrite(perWrite), _next(nextTime) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* data, size_t size) override {
+        const size_t before = body();
+        BodyDigestClient::write(data, size);
+        for (size_t i = size - (body() - before); i < size; i++) {
+            _depth += data[i] == '{' ? 1 : data[i] == '}' ? -1 : 0;
+            _spaces += data[i] == ' ';
+        }
+        if (before > 0) {
+            for (uint32_t i = 0; i < _perWrite; i++, _next += 30) _store.append(archiveFix(_next));
+        }
+        return size;
+    }
+
+    bool balanced() const { return _depth == 0; }
+    bool padded() const { return _spaces > 1; }   // The first feature has one
+    uint32_t nextTime() const { return _next; }
+
+private:
+    TrackStore& _store;
+    const uint32_t _perWrite;
+    uint32_t _next;
+    int32_t _depth = 0;
+    size_t _spaces = 0;
+};
+
+/**
+ * GeoJSON export of a full store while perWrite fixes are stored per
+ * chunk written
+ * @return false if the body is not the counted length or not well formed
+ */
+static bool exportWhileAppending(uint32_t perWrite, bool& padded) {
+    static TrackStore store;
+    static uint32_t next = 0;
+    while (store.size() < TRACK_STORE_CAPACITY) store.append(archiveFix(next += 30));
+
+    uint32_t firstSeq = 0;
+    const size_t count = store.findSequences(0, UINT32_MAX, firstSeq);
+    const size_t total = TrackExport::ExportDocument(store, TrackExport::Format::GEOJSON,
+                                                     firstSeq, count, "GPS_BENCH").length();
+    HttpRequest request{};
+    strcpy(request.method, "GET");
+    AppendingClient client(store, perWrite, next + 30);
+    client.reset();
+    TrackExport::serve(client, request, store, TrackExport::Format::GEOJSON, "GPS_BENCH");
+    next = client.nextTime();
+    padded = client.padded();
+    return client.body() == total && client.balanced();
+}
+
+/**
+ * /export.gpx and /export.geojson over a full track store
+ * (TRACK_STORE_CAPACITY fixes), then a Range resume from the middle of
+ * the GeoJSON document. ns/op covers the three responses, all from the
+ * web arena. Counter is body megabytes per second. Fails if the resumed
+ * part differs from the same bytes of the full document, or if a
+ * download with fixes stored meanwhile is cut short or malformed: whole
+ * when the reader stays ahead of the overwrites, padded after the last
+ * whole record when it does not.
+ */
+static void BM_TrackExport(Bench::State& state) {
+    static TrackStore store;
+    if (store.size() == 0) {
+        for (uint32_t t = 0; t < TRACK_STORE_CAPACITY; t++) store.append(archiveFix(t * 30));
+    }
+    HttpRequest request{};
+    strcpy(request.method, "GET");
+    BodyDigestClient client;
+    size_t bytes = 0;
+    uint32_t expected = 0, resumed = 0;
+
+    for (auto _ : state) {
+        bytes = 0;
+        request.range[0] = '\0';
+        client.reset();
+        TrackExport::serve(client, request, store, TrackExport::Format::GPX, "GPS_BENCH");
+        bytes += client.body();
+
+        client.reset();
+        TrackExport::serve(client, request, store, TrackExport::Format::GEOJSON, "GPS_BENCH");
+        const size_t from = client.body() / 2 + 7;
+        bytes += client.body();
+
+        state.pauseTiming();
+        client.reset(from);
+        TrackExport::serve(client, request, store, TrackExport::Format::GEOJSON, "GPS_BENCH");
+        expected = client.hash();
+        snprintf(request.range, sizeof(request.range), "bytes=%u-", (unsigned)from);
+        state.resumeTiming();
+
+        client.reset();
+        TrackExport::serve(client, request, store, TrackExport::Format::GEOJSON, "GPS_BENCH");
+        resumed = client.hash();
+        bytes += client.body();
+    }
+    state.setBytesProcessed(bytes);
+    state.setCounter("MB_s", (double)bytes * state.iterations() * 1e3 /
+                                 max<uint64_t>(state.elapsedNanos(), 1));
+    bool slowPadded = false, fastPadded = false;
+    const bool slow = exportWhileAppending(1, slowPadded);
+    const bool fast = exportWhileAppending(16, fastPadded);
+    if (resumed != expected) {
+        state.fail("resume differs");
+    } else if (!slow || slowPadded) {
+        state.fail("export broken by appends");
+    } else if (!fast || !fastPadded) {
+        state.fail("export broken by overwrites");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_TrackExport);
+
+// ============================================
+// Report outbox over a lossy link
+// ============================================
+
+/**
+ * Server end of the report sequence behind a link that loses requests
+ * and responses (seeded, so every run sees the same losses). Stores a
+ * sequence once, answers with X-Ack-Seq and counts what the protocol
+ * rules out.
+ */
+class LossyReportServer {
+public:
+    static constexpr uint32_t MAX_SEQ = 2048;
+    static constexpr uint32_t LOSE_REQUEST_PCT = 15;
+    static constexpr uint32_t DROP_RESPONSE_PCT = 15;
+
+    void reset() {
+        memset(_epoch, 0, sizeof(_epoch));
+        memset(_confirmed, 0, sizeof(_confirmed));
+        _watermark = _seenAck = 0;
+        _rng = 0x9E3779B9u;
+        lossy = true;
+        duplicates = reused = resentAcked = outOfRange = 0;
+    }
+
+    HttpResponse post(const HeldReport& report, uint32_t seqBase, bool resent) {
+        if (report.seq == 0 || report.seq >= MAX_SEQ) {
+            outOfRange++;
+            return {0, false};
+        }
+        if (resent && report.seq <= _seenAck) resentAcked++;
+        _rng = _rng * 1664525u + 1013904223u;
+        const uint32_t roll = lossy ? (_rng >> 16) % 100 : 100;
+        if (roll < LOSE_REQUEST_PCT) return {0, false};
+
+        if (_epoch[report.seq] == 0) {
+            _epoch[report.seq] = report.fix.epoch;
+        } else if (_epoch[report.seq] != report.fix.epoch) {
+            reused++;           // Another report under a stored sequence
+        } else if (_confirmed[report.seq]) {
+            duplicates++;       // Sent again after its 2xx arrived
+        }
+        if (seqBase > _watermark + 1) _watermark = seqBase - 1;     // Never coming
+        while (_watermark + 1 < MAX_SEQ && _epoch[_watermark + 1]) _watermark++;
+
+        if (roll < LOSE_REQUEST_PCT + DROP_RESPONSE_PCT) return {0, false};
+        _confirmed[report.seq] = true;
+        _seenAck = _watermark;
+        HttpResponse response = {200, true};
+        response.ackSeq = _watermark;
+        return response;
+    }
+
+    uint32_t watermark() const { return _watermark; }
+
+    bool lossy = true;
+    uint32_t duplicates = 0;
+    uint32_t reused = 0;
+    uint32_t resentAcked = 0;
+    uint32_t outOfRange = 0;
+
+private:
+    uint32_t _epoch[MAX_SEQ];
+    bool _confirmed[MAX_SEQ];
+    uint32_t _watermark = 0;
+    uint32_t _seenAck = 0;
+    uint32_t _rng = 0;
+};
+
+/**
+ * A device's life from a blank NVS per op: REPORTS reports through a
+ * link that loses 15% of the requests and 15% of the responses, a
+ * reboot every REBOOT_EVERY reports, then the gaps sent on a clean
+ * link. The send loop is the uploader's: report, settle, then up to
+ * UPLOAD_RETRANSMIT_MAX gaps after a 2xx. Fails if a report reaches the
+ * server again after its 2xx, a gap at or below X-Ack-Seq is resent, a
+ * sequence is reused or does not continue within UPLOAD_SEQ_BLOCK after
+ * a reboot, or the server's watermark does not reach the last report.
+ */
+static void BM_ReportOutbox(Bench::State& state) {
+    static constexpr uint32_t REPORTS = 240;
+    static constexpr uint32_t REBOOT_EVERY = 60;
+    static LossyReportServer server;
+    static ReportOutbox outbox;
+    const HttpUpload::ReportExtras none;
+    CountingPrint logs;
+    uint32_t resent = 0, broken = 0, stuck = 0;
+
+    auto resend = [&] {
+        uint32_t after = 0;
+        for (int i = 0; i < UPLOAD_RETRANSMIT_MAX; i++) {
+            HeldReport* held = outbox.nextGap(after);
+            if (!held) return false;
+            after = held->seq;
+            const HttpResponse response = server.post(*held, outbox.base(), true);
+            resent++;
+            outbox.settle(*held, response);
+            if (!response.success) return true;
+        }
+        return true;
+    };
+
+    for (auto _ : state) {
+        Preferences prefs;
+        prefs.begin("upload");
+        prefs.clear();
+        prefs.end();
+        server.reset();
+        outbox = ReportOutbox();
+        outbox.begin();
+
+        GPSData fix = sampleFix();
+        uint32_t last = 0;
+        for (uint32_t n = 0; n < REPORTS; n++) {
+            if (n > 0 && n % REBOOT_EVERY == 0) {
+                outbox = ReportOutbox();    // RAM lost, NVS kept
+                outbox.begin();
+            }
+            fix.epoch++;
+            HeldReport& held = outbox.add(fix, none);
+            if (n % REBOOT_EVERY == 0 && n > 0 &&
+                (held.seq <= last || held.seq > last + 1 + UPLOAD_SEQ_BLOCK)) {
+                broken++;
+            }
+            last = held.seq;
+            const HttpResponse response = server.post(held, outbox.base(), false);
+            outbox.settle(held, response);
+            if (response.success) resend();
+        }
+
+        server.lossy = false;
+        while (resend()) {}
+        stuck += outbox.held() != 0 || server.watermark() != last;
+
+        state.pauseTiming();
+        Log::drain(logs);
+        state.resumeTiming();
+    }
+    state.setCounter("resent_op", (double)resent / state.iterations());
+    if (server.outOfRange) {
+        state.fail("sequence out of range");
+    } else if (server.reused) {
+        state.fail("sequence reused");
+    } else if (server.duplicates) {
+        state.fail("report sent again after its 2xx");
+    } else if (server.resentAcked) {
+        state.fail("resent at or below X-Ack-Seq");
+    } else if (broken) {
+        state.fail("sequence did not continue after a reboot");
+    } else if (stuck) {
+        state.fail("watermark did not reach the last report");
+    }
+}
+BENCHMARK(BM_ReportOutbox);
+
+#if defined(ARDUINO_NATIVE) && W5500_DRIVER_ENABLE
+
+// ============================================
+// W5500 driver on the register-level simulator
+// ============================================
+
+/**
+ * Lease an address from the simulator once (DHCP over the UDP socket)
+ */
+static bool benchW5500Up() {
+    static bool up = [] {
+        static const uint8_t MAC[6] = {0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0x47};
+        W5500Ethernet.init(W5500_CS_PIN);
+        return W5500Ethernet.begin(const_cast<uint8_t*>(MAC), 5000) == 1;
+    }();
+    return up;
+}
+
+/**
+ * One report per op through the driver: connect, POST, response, close
+ * against a loopback HTTP peer. Counter is SPI frames per report (the
+ * bus transactions the firmware pays on the board). Fails if a report
+ * did not get its 200 or the frame count regresses.
+ */
+static void BM_W5500Upload(Bench::State& state) {
+    static HttpResponder peer;
+    static bool ready = benchW5500Up() && peer.begin();
+    if (!ready) {
+        state.fail("simulator not up");
+        return;
+    }
+    static W5500Client client;
+    const GPSData data = sampleFix();
+    CountingPrint logs;
+    uint32_t failed = 0, n = 0;
+    nativeW5500ResetStats();
+
+    for (auto _ : state) {
+        const HttpResponse response = HttpUpload::post(client, IPAddress(127, 0, 0, 1), "bench", SERVER_PATH,
+                                                       peer.port(), "GPS_BENCH", data, "127.0.0.1");
+        failed += !response.success;
+        if (++n % 8 == 0) {
+            state.pauseTiming();
+            Log::drain(logs);
+            state.resumeTiming();
+        }
+    }
+    Log::drain(logs);
+    const double frames = (double)nativeW5500Stats().frames / state.iterations();
+    state.setCounter("frames_op", frames);
+    if (failed) {
+        state.fail("report not acknowledged");
+    } else if (frames > 32) {
+        state.fail("too many SPI frames per report");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_W5500Upload);
+
+/**
+ * One dashboard request per op: a host client GETs / from the web server
+ * on the simulated chip and reads the page to the end. Counter is SPI
+ * frames per page. Fails if a page came back empty or the frame count
+ * regresses.
+ */
+static void BM_W5500Dashboard(Bench::State& state) {
+    static constexpr uint16_t PORT = 18081;
+    static HttpFetcher fetcher;
+    static WebServerModule web(PORT);
+    static LatestFix fix;
+    static TrackStore track;
+    static bool ready = [] {
+        if (!benchW5500Up()) return false;
+        web.begin();
+        fix.publish(sampleFix());
+        fetcher.begin(nativeListenPort(PORT), "GET / HTTP/1.1\r\nHost: bench\r\n\r\n");
+        return true;
+    }();
+    if (!ready) {
+        state.fail("simulator not up");
+        return;
+    }
+    const WebContext ctx{fix, track, "GPS_BENCH"};
+    const Metrics::Counter& pages = Metrics::registry.webRequests[(size_t)Metrics::WebRoute::DASHBOARD];
+    uint32_t empty = 0;
+    nativeW5500ResetStats();
+
+    for (auto _ : state) {
+        const uint32_t before = pages.value();
+        fetcher.fetch();
+        while (!fetcher.sent()) {}
+        while (pages.value() == before) web.handle(ctx);
+        while (!fetcher.done()) {}
+        empty += fetcher.bytes() == 0;
+    }
+    const double frames = (double)nativeW5500Stats().frames / state.iterations();
+    state.setCounter("frames_op", frames);
+    if (empty) {
+        state.fail("page not delivered");
+    } else if (frames > 128) {
+        state.fail("too many SPI frames per page");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_W5500Dashboard);
+
+/**
+ * Network for UploadFanout on host sockets: every destination is one
+ * loopback peer
+ */
+class LoopbackNetwork {
+public:
+    class Channel {
+    public:
+        Client& client() { return _socket; }
+
+    private:
+        friend class LoopbackNetwork;
+        NativeSocketClient _socket;
+    };
+
+    explicit LoopbackNetwork(uint16_t port) : _port(port) {}
+
+    bool open(Channel& channel, const char*, uint16_t, const char*) {
+        return channel._socket.connect(IPAddress(127, 0, 0, 1), _port);
+    }
+
+private:
+    uint16_t _port;
+};
+
+/**
+ * One report cycle per op with UPLOAD_DESTINATIONS besides the primary
+ * server, every peer taking SERVER_DELAY_MS per request: the extra
+ * destinations' requests must overlap the primary exchange. Counter is
+ * the cycle time in units of the server delay (sequential uploads would
+ * be 1 + destinations). Zero-alloc once warm: the host socket keeps its
+ * buffer between connects, as the W5500 keeps its socket memory.
+ */
+static void BM_UploadFanout(Bench::State& state) {
+    static constexpr uint32_t SERVER_DELAY_MS = 20;
+    static HttpResponder primary, destination;
+    static bool ready = primary.begin(SERVER_DELAY_MS) && destination.begin(SERVER_DELAY_MS);
+    if (!ready) {
+        state.fail("peers not up");
+        return;
+    }
+    static LoopbackNetwork network(destination.port());
+    static UploadFanout<LoopbackNetwork> fanout(network);
+    static bool begun = (fanout.begin(), true);
+    (void)begun;
+
+    const GPSData data = sampleFix();
+    char payload[JSON_BUFFER_SIZE];
+    HttpUpload::buildJsonPayload(payload, sizeof(payload), "GPS_BENCH", data, "127.0.0.1");
+    static NativeSocketClient client;
+    CountingPrint logs;
+    auto cycle = [&] {
+        Memory::cycle.reset();
+        fanout.submit(payload, true, [&](char* buffer, size_t size) {
+            HttpUpload::buildPositionPayload(buffer, size, "GPS_BENCH", data);
+        });
+        const bool ok = HttpUpload::postPayload(client, IPAddress(127, 0, 0, 1), "bench", SERVER_PATH,
+                                                primary.port(), payload).success;
+        fanout.finish();
+        return ok;
+    };
+    static bool warm = cycle();     // First connects allocate the sockets
+    (void)warm;
+    Log::drain(logs);
+    Metrics::DestinationMetrics& metrics = Metrics::registry.destinations[1];
+    const uint32_t deliveredBefore = metrics.delivered.value();
+    uint32_t failed = 0;
+
+    for (auto _ : state) {
+        failed += !cycle();
+        state.pauseTiming();
+        Log::drain(logs);
+        state.resumeTiming();
+    }
+    const double cycleMs = state.elapsedNanos() / 1e6 / state.iterations();
+    state.setCounter("cycle_delays", cycleMs / SERVER_DELAY_MS);
+    if (failed || metrics.delivered.value() - deliveredBefore != state.iterations() * DESTINATION_COUNT) {
+        state.fail("report not delivered");
+    } else if (cycleMs >= SERVER_DELAY_MS * 1.5) {
+        state.fail("destinations did not overlap the primary upload");
+    }
+}
+BENCHMARK_ZERO_ALLOC(BM_UploadFanout);
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * @file bench_main.cpp
+ * @brief Benchmark runner entry point
+ *
+ * ESP32 (pio run -e bench_esp32 -t upload -t monitor): runs once at boot,
+ * prints the table and the JSON between BENCH_JSON_BEGIN / BENCH_JSON_END.
+ *
+ * Host (pio run -e bench_native):
+ *   .pio/build/bench_native/program [--filter <substr>] [--json <file>]
+ * Exit status: 1 when no case matched the filter, 2 when a case failed
+ * (a zero-allocation case allocated, with BENCH_COUNT_ALLOCS, or an
+ * accuracy case was out of bounds).
+ */
+
+#include <Arduino.h>
+#include "bench.h"
+
+#if defined(ARDUINO_NATIVE)
+
+#include <stdio.h>
+
+/**
+ * Print into a stdio FILE
+ */
+class FilePrint : public Print {
+public:
+    explicit FilePrint(FILE* file) : _file(file) {}
+    size_t write(uint8_t c) override { return fputc(c, _file) == EOF ? 0 : 1; }
+    size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, _file); }
+
+private:
+    FILE* _file;
+};
+
+int main(int argc, char** argv) {
+    const char* filter = getenv("BENCH_FILTER");
+    const char* jsonPath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+        else if (!strcmp(argv[i], "--json") && i + 1 < argc) jsonPath = argv[++i];
+    }
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    if (Bench::runAll(Serial, filter) == 0) {
+        fprintf(stderr, "[bench] no benchmark matches '%s'\n", filter ? filter : "");
+        return 1;
+    }
+
+    if (jsonPath) {
+        FILE* file = fopen(jsonPath, "w");
+        if (!file) {
+            fprintf(stderr, "[bench] cannot write %s\n", jsonPath);
+            return 1;
+        }
+        FilePrint out(file);
+        Bench::writeJson(out);
+        fclose(file);
+    } else {
+        Serial.println(F("BENCH_JSON_BEGIN"));
+        Bench::writeJson(Serial);
+        Serial.println(F("BENCH_JSON_END"));
+    }
+
+    if (Bench::failures() > 0) {
+        fprintf(stderr, "[bench] %u case(s) failed\n", (unsigned)Bench::failures());
+        return 2;
+    }
+    return 0;
+}
+
+#else
+
+#include <SPI.h>
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    // With the Ethernet library, WebPage::render queries the W5500 (SPI)
+    // for the IP address; the own driver keeps it from the lease
+    SPI.begin();
+
+    Serial.printf("\n[BENCH] %s %s @ %u MHz\n", FIRMWARE_VERSION, FIRMWARE_BUILD, ESP.getCpuFreqMHz());
+    Bench::runAll(Serial);
+    Serial.println(F("BENCH_JSON_BEGIN"));
+    Bench::writeJson(Serial);
+    Serial.println(F("BENCH_JSON_END"));
+    if (Bench::failures() > 0) {
+        Serial.printf("[BENCH] FAIL: %u case(s) failed\n", (unsigned)Bench::failures());
+    }
+}
+
+void loop() {
+    delay(1000);
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef DELTA_BUILDER_H
+#define DELTA_BUILDER_H
+
+/**
+ * @file delta_builder.h
+ * @brief Synthetic firmware images and their delta patch for the OTA benchmark
+ *
+ * The new image is the old one after a small release: DELTA_INSERT_BYTES
+ * of new code at a third of the image, so everything behind it moves,
+ * and one relocated address (4 bytes) in every DELTA_RELOC_SPACING of
+ * the moved code. The patch is laid out as tools/ota/make_delta.py
+ * writes it; the matches come from the edit script instead of a search.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../src/modules/delta_patch.h"
+
+static constexpr size_t DELTA_INSERT_BYTES = 2048;
+static constexpr size_t DELTA_RELOC_SPACING = 64;
+static constexpr size_t DELTA_ZERO_RUN_MIN = 3;
+
+struct DeltaImages {
+    uint8_t* oldImage = nullptr;
+    size_t oldSize = 0;
+    uint8_t* patch = nullptr;
+    size_t patchSize = 0;
+    size_t newSize = 0;
+};
+
+inline size_t deltaPutVarint(uint8_t* out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+/**
+ * One block: len bytes of old + diff from old[o] against new[n], then
+ * extra new bytes, then the old cursor moves by seek
+ */
+inline size_t deltaPutBlock(uint8_t* out, const uint8_t* oldImage, const uint8_t* newImage,
+                            size_t o, size_t n, size_t len, size_t extra, int32_t seek) {
+    size_t pos = deltaPutVarint(out, (uint32_t)len);
+    pos += deltaPutVarint(out + pos, (uint32_t)extra);
+    pos += deltaPutVarint(out + pos, seek >= 0 ? (uint32_t)seek << 1 : ((uint32_t)-seek << 1) - 1);
+
+    size_t i = 0;
+    while (i < len) {
+        size_t zeros = 0;
+        while (i + zeros < len && oldImage[o + i + zeros] == newImage[n + i + zeros]) zeros++;
+        i += zeros;
+        // Literals until a zero run worth a new pair
+        size_t end = i;
+        while (end < len) {
+            size_t run = 0;
+            while (run < DELTA_ZERO_RUN_MIN && end + run < len &&
+                   oldImage[o + end + run] == newImage[n + end + run]) {
+                run++;
+            }
+            if (run == DELTA_ZERO_RUN_MIN) break;
+            end += run ? run : 1;
+        }
+        pos += deltaPutVarint(out + pos, (uint32_t)zeros);
+        pos += deltaPutVarint(out + pos, (uint32_t)(end - i));
+        for (; i < end; i++) out[pos++] = (uint8_t)(newImage[n + i] - oldImage[o + i]);
+    }
+    memcpy(out + pos, newImage + n + len, extra);
+    return pos + extra;
+}
+
+/**
+ * Build both images and the patch
+ * @return false if out of memory
+ */
+inline bool buildDeltaImages(size_t oldSize, DeltaImages& images) {
+    const size_t insertAt = oldSize / 3;
+    const size_t newSize = oldSize + DELTA_INSERT_BYTES;
+    uint8_t* oldImage = (uint8_t*)malloc(oldSize);
+    uint8_t* newImage = (uint8_t*)malloc(newSize);
+    uint8_t* patch = (uint8_t*)malloc(sizeof(DeltaHeader) + newSize * 2);
+    if (!oldImage || !newImage || !patch) {
+        free(oldImage);
+        free(newImage);
+        free(patch);
+        return false;
+    }
+
+    // Code-like bytes: short repeated opcodes, random operands
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < oldSize; i++) {
+        seed = seed * 1103515245u + 12345u;
+        oldImage[i] = (i & 3) == 0 ? (uint8_t)(0x20 + (seed >> 28)) : (uint8_t)(seed >> 16);
+    }
+    memcpy(newImage, oldImage, insertAt);
+    for (size_t i = 0; i < DELTA_INSERT_BYTES; i++) {
+        seed = seed * 1103515245u + 12345u;
+        newImage[insertAt + i] = (uint8_t)(seed >> 16);
+    }
+    memcpy(newImage + insertAt + DELTA_INSERT_BYTES, oldImage + insertAt, oldSize - insertAt);
+    for (size_t i = insertAt + DELTA_INSERT_BYTES; i + 4 <= newSize; i += DELTA_RELOC_SPACING) {
+        uint32_t address;
+        memcpy(&address, newImage + i, sizeof(address));
+        address += DELTA_INSERT_BYTES;
+        memcpy(newImage + i, &address, sizeof(address));
+    }
+
+    DeltaHeader header;
+    header.magic = DeltaHeader::MAGIC;
+    header.oldSize = (uint32_t)oldSize;
+    header.newSize = (uint32_t)newSize;
+    Sha256 hash;
+    hash.begin();
+    hash.update(oldImage, oldSize);
+    hash.finish(header.oldSha256);
+    hash.begin();
+    hash.update(newImage, newSize);
+    hash.finish(header.newSha256);
+    memcpy(patch, &header, sizeof(header));
+
+    size_t pos = sizeof(header);
+    pos += deltaPutBlock(patch + pos, oldImage, newImage, 0, 0, insertAt, DELTA_INSERT_BYTES, 0);
+    pos += deltaPutBlock(patch + pos, oldImage, newImage, insertAt, insertAt + DELTA_INSERT_BYTES,
+                         oldSize - insertAt, 0, 0);
+    free(newImage);
+
+    images.oldImage = oldImage;
+    images.oldSize = oldSize;
+    images.patch = patch;
+    images.patchSize = pos;
+    images.newSize = newSize;
+    return true;
+}
+
+#endif // DELTA_BUILDER_H
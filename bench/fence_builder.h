@@ -0,0 +1,115 @@
+#ifndef FENCE_BUILDER_H
+#define FENCE_BUILDER_H
+
+/**
+ * @file fence_builder.h
+ * @brief Synthetic geofence blobs for the geofence benchmarks
+ *
+ * Hexagonal fences on a square lattice (FENCE_SPACING_E7 apart, so the
+ * density stays the same as the count grows, like fences along a coast),
+ * laid out as tools/geofence/build_fences.py would. indexed = false puts
+ * every fence into a single grid cell, i.e. a linear scan.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "../src/modules/geofence.h"
+
+static constexpr int32_t FENCE_ORIGIN_LAT_E7 = -62000000;
+static constexpr int32_t FENCE_ORIGIN_LON_E7 = 1067000000;
+static constexpr int32_t FENCE_SPACING_E7 = 100000;     // 0.01 deg, about 1.1 km
+static constexpr int32_t FENCE_RADIUS_E7 = 30000;
+static constexpr uint32_t FENCE_VERTICES = 6;
+
+inline size_t fenceLatticeSide(size_t fenceCount) {
+    size_t side = 1;
+    while (side * side < fenceCount) side++;
+    return side;
+}
+
+/**
+ * Build a blob with fenceCount fences
+ * @return malloc'd, 4-byte aligned blob (caller frees), nullptr if out of memory
+ */
+inline uint8_t* buildFenceBlob(size_t fenceCount, bool indexed, size_t& size) {
+    const size_t side = fenceLatticeSide(fenceCount);
+    const uint16_t gridSide = indexed ? (uint16_t)side : 1;
+    const size_t cells = (size_t)gridSide * gridSide;
+    const size_t maxEntries = fenceCount * 4;   // A bbox is smaller than a cell
+
+    size = sizeof(GeofenceBlobHeader) + fenceCount * sizeof(GeofenceRecord) +
+           fenceCount * FENCE_VERTICES * sizeof(GeofencePoint) +
+           (cells + 1) * sizeof(uint32_t) + maxEntries * sizeof(uint16_t);
+    size = (size + 3) & ~(size_t)3;
+    uint8_t* blob = (uint8_t*)calloc(1, size);
+    if (!blob) return nullptr;
+
+    GeofenceBlobHeader* h = reinterpret_cast<GeofenceBlobHeader*>(blob);
+    GeofenceRecord* fences = reinterpret_cast<GeofenceRecord*>(h + 1);
+    GeofencePoint* vertices = reinterpret_cast<GeofencePoint*>(fences + fenceCount);
+    uint32_t* cellStart = reinterpret_cast<uint32_t*>(vertices + fenceCount * FENCE_VERTICES);
+    uint16_t* cellFences = reinterpret_cast<uint16_t*>(cellStart + cells + 1);
+
+    h->magic = GeofenceBlobHeader::MAGIC;
+    h->version = 1;
+    h->fenceCount = (uint16_t)fenceCount;
+    h->vertexCount = (uint32_t)(fenceCount * FENCE_VERTICES);
+    h->gridLatE7 = FENCE_ORIGIN_LAT_E7 - FENCE_RADIUS_E7;
+    h->gridLonE7 = FENCE_ORIGIN_LON_E7 - FENCE_RADIUS_E7;
+    h->cellLatE7 = h->cellLonE7 = FENCE_SPACING_E7 * (uint32_t)(side / gridSide);
+    h->rows = h->cols = gridSide;
+
+    for (size_t i = 0; i < fenceCount; i++) {
+        const int32_t lat = FENCE_ORIGIN_LAT_E7 + (int32_t)(i / side) * FENCE_SPACING_E7;
+        const int32_t lon = FENCE_ORIGIN_LON_E7 + (int32_t)(i % side) * FENCE_SPACING_E7;
+        GeofenceRecord& f = fences[i];
+        f.id = (uint16_t)i;
+        f.kind = (uint8_t)(i % (size_t)GeofenceKind::COUNT);
+        f.firstVertex = (uint32_t)(i * FENCE_VERTICES);
+        f.vertexCount = FENCE_VERTICES;
+        f.min = GeofencePoint{INT32_MAX, INT32_MAX};
+        f.max = GeofencePoint{INT32_MIN, INT32_MIN};
+        for (uint32_t k = 0; k < FENCE_VERTICES; k++) {
+            const double a = k * 2 * M_PI / FENCE_VERTICES;
+            GeofencePoint& v = vertices[f.firstVertex + k];
+            v.latE7 = lat + (int32_t)lround(FENCE_RADIUS_E7 * sin(a));
+            v.lonE7 = lon + (int32_t)lround(FENCE_RADIUS_E7 * cos(a));
+            f.min = GeofencePoint{min(f.min.latE7, v.latE7), min(f.min.lonE7, v.lonE7)};
+            f.max = GeofencePoint{max(f.max.latE7, v.latE7), max(f.max.lonE7, v.lonE7)};
+        }
+    }
+
+    // Counting sort of (cell, fence) pairs: count, prefix sum, fill
+    auto forEachCell = [&](const GeofenceRecord& f, auto fn) {
+        const uint32_t r0 = (uint32_t)(f.min.latE7 - h->gridLatE7) / h->cellLatE7;
+        const uint32_t r1 = (uint32_t)(f.max.latE7 - h->gridLatE7) / h->cellLatE7;
+        const uint32_t c0 = (uint32_t)(f.min.lonE7 - h->gridLonE7) / h->cellLonE7;
+        const uint32_t c1 = (uint32_t)(f.max.lonE7 - h->gridLonE7) / h->cellLonE7;
+        for (uint32_t r = r0; r <= r1 && r < gridSide; r++) {
+            for (uint32_t c = c0; c <= c1 && c < gridSide; c++) fn(r * gridSide + c);
+        }
+    };
+    for (size_t i = 0; i < fenceCount; i++) {
+        forEachCell(fences[i], [&](uint32_t cell) { cellStart[cell + 1]++; });
+    }
+    for (size_t c = 0; c < cells; c++) cellStart[c + 1] += cellStart[c];
+    for (size_t i = 0; i < fenceCount; i++) {
+        forEachCell(fences[i], [&](uint32_t cell) { cellFences[cellStart[cell]++] = (uint16_t)i; });
+    }
+    for (size_t c = cells; c > 0; c--) cellStart[c] = cellStart[c - 1];
+    cellStart[0] = 0;
+    h->cellEntryCount = cellStart[cells];
+    return blob;
+}
+
+/**
+ * Fix that walks the lattice diagonal, about 10 fixes per fence
+ */
+inline GeofencePoint fenceTrackPoint(size_t fenceCount, uint32_t step) {
+    const uint32_t stepsPerFence = 10;
+    const uint32_t length = (uint32_t)fenceLatticeSide(fenceCount) * stepsPerFence;
+    const int32_t offset = (int32_t)(step % length) * (FENCE_SPACING_E7 / stepsPerFence);
+    return GeofencePoint{FENCE_ORIGIN_LAT_E7 + offset, FENCE_ORIGIN_LON_E7 + offset};
+}
+
+#endif // FENCE_BUILDER_H
@@ -0,0 +1,127 @@
+#ifndef FILTER_TRACK_H
+#define FILTER_TRACK_H
+
+/**
+ * @file filter_track.h
+ * @brief Noisy synthetic passage for the position filter benchmarks
+ *
+ * 1 Hz epochs: alongside under the cranes (poor HDOP, multipath jumps),
+ * casting off and accelerating, underway with a turn and a GPS dropout,
+ * then alongside again. Receiver error is white noise plus a slowly
+ * wandering bias (first-order Gauss-Markov), both scaled by HDOP; the
+ * bias is what a real receiver mostly has and no filter can remove it.
+ * Multipath fixes jump 20 to 60 m with an unchanged HDOP, as they do.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "../src/modules/position_filter.h"
+
+struct FilterTrackPhase {
+    uint32_t seconds;
+    double knots;           // Target speed, reached at FILTER_TRACK_ACCEL
+    double turnDegPerS;
+    double hdop;
+    uint32_t outlierPermille;
+};
+
+static const FilterTrackPhase FILTER_TRACK_PHASES[] = {
+    {300, 0, 0, 1.8, 60},       // Alongside, cranes overhead
+    {600, 10, 0.1, 1.0, 5},     // Casting off, then underway and turning
+    {600, 14, 0, 0.9, 0},       // Open water (dropout in the middle)
+    {300, 0, 0, 1.8, 60},       // Alongside again
+};
+static constexpr double FILTER_TRACK_ACCEL = 0.1;          // m/s^2
+static constexpr uint32_t FILTER_TRACK_DROPOUT_AT = 1200;  // Epoch index
+static constexpr uint32_t FILTER_TRACK_DROPOUT_S = 10;
+static constexpr double FILTER_TRACK_WHITE_M = 1.5;        // Per axis, per unit of HDOP
+static constexpr double FILTER_TRACK_BIAS_M = 1.0;
+static constexpr double FILTER_TRACK_BIAS_TAU_S = 60;
+static constexpr double FILTER_TRACK_SPEED_M = 0.05;       // Doppler velocity noise
+
+struct FilterTrackSample {
+    PositionMeasurement m;
+    double trueLat;
+    double trueLon;
+    bool outlier;
+};
+
+struct FilterTrack {
+    FilterTrackSample* samples;     // malloc'd, nullptr if out of memory
+    size_t count;
+};
+
+/**
+ * Horizontal distance (m) between an E7 position and a true one
+ */
+inline double filterTrackErrorM(int32_t latE7, int32_t lonE7, double lat, double lon) {
+    const double north = (latE7 * 1e-7 - lat) * 111194.9;
+    const double east = (lonE7 * 1e-7 - lon) * 111194.9 * cos(lat * M_PI / 180);
+    return sqrt(north * north + east * east);
+}
+
+inline FilterTrack buildFilterTrack() {
+    FilterTrack t{nullptr, 0};
+    size_t count = 0;
+    for (const FilterTrackPhase& p : FILTER_TRACK_PHASES) count += p.seconds;
+    t.samples = (FilterTrackSample*)malloc(count * sizeof(FilterTrackSample));
+    if (!t.samples) return t;
+
+    uint32_t seed = 4242;
+    auto uniform = [&seed]() {
+        seed = seed * 1103515245u + 12345u;
+        return ((seed >> 8) + 0.5) / 16777216.0;
+    };
+    auto gauss = [&uniform]() {
+        return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+    };
+
+    double lat = -6.1, lon = 106.8, course = 30, speed = 0;
+    double biasN = 0, biasE = 0;
+    const double decay = exp(-1 / FILTER_TRACK_BIAS_TAU_S);
+    const double drive = sqrt(1 - decay * decay);
+
+    for (const FilterTrackPhase& p : FILTER_TRACK_PHASES) {
+        const double target = p.knots * 0.514444;
+        for (uint32_t i = 0; i < p.seconds; i++) {
+            FilterTrackSample& s = t.samples[t.count];
+            speed += fmax(-FILTER_TRACK_ACCEL, fmin(FILTER_TRACK_ACCEL, target - speed));
+            if (speed > 0) course += p.turnDegPerS;
+            const double ve = speed * sin(course * M_PI / 180);
+            const double vn = speed * cos(course * M_PI / 180);
+            lat += vn / 111194.9;
+            lon += ve / (111194.9 * cos(lat * M_PI / 180));
+
+            biasN = biasN * decay + drive * FILTER_TRACK_BIAS_M * gauss();
+            biasE = biasE * decay + drive * FILTER_TRACK_BIAS_M * gauss();
+            double north = p.hdop * (biasN + FILTER_TRACK_WHITE_M * gauss());
+            double east = p.hdop * (biasE + FILTER_TRACK_WHITE_M * gauss());
+            s.outlier = uniform() * 1000 < p.outlierPermille;
+            if (s.outlier) {
+                const double jump = 20 + 40 * uniform(), bearing = 2 * M_PI * uniform();
+                north += jump * cos(bearing);
+                east += jump * sin(bearing);
+            }
+
+            const double mve = ve + FILTER_TRACK_SPEED_M * gauss();
+            const double mvn = vn + FILTER_TRACK_SPEED_M * gauss();
+            double mcourse = atan2(mve, mvn) * 180 / M_PI;
+            if (mcourse < 0) mcourse += 360;
+
+            s.trueLat = lat;
+            s.trueLon = lon;
+            s.m.latE7 = (int32_t)lround((lat + north / 111194.9) * 1e7);
+            s.m.lonE7 = (int32_t)lround((lon + east / (111194.9 * cos(lat * M_PI / 180))) * 1e7);
+            s.m.hdop = (float)p.hdop;
+            s.m.speedMps = (float)sqrt(mve * mve + mvn * mvn);
+            s.m.courseDeg = (float)mcourse;
+            s.m.timeMs = (uint32_t)t.count * 1000;
+            s.m.fresh = t.count < FILTER_TRACK_DROPOUT_AT ||
+                        t.count >= FILTER_TRACK_DROPOUT_AT + FILTER_TRACK_DROPOUT_S;
+            t.count++;
+        }
+    }
+    return t;
+}
+
+#endif // FILTER_TRACK_H
@@ -0,0 +1,153 @@
+#ifndef HTTP_PEER_H
+#define HTTP_PEER_H
+
+/**
+ * @file http_peer.h
+ * @brief Host-side HTTP peers for the W5500 driver benchmarks (host only)
+ *
+ * The firmware side runs on the register-level simulator; its far end
+ * is a plain socket thread here. HttpResponder answers every request
+ * with a 200, optionally after a fixed server delay; HttpFetcher issues
+ * one GET per fetch() against the simulated chip's web server and reads
+ * the page to the end.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+
+/**
+ * Read one request (headers and Content-Length body)
+ * @return false if the peer went away
+ */
+inline bool httpPeerReadRequest(int fd) {
+    char buf[2048];
+    size_t len = 0;
+    for (;;) {
+        const ssize_t n = ::recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n <= 0) return false;
+        len += n;
+        buf[len] = '\0';
+        const char* end = strstr(buf, "\r\n\r\n");
+        if (!end) {
+            if (len == sizeof(buf) - 1) return false;
+            continue;
+        }
+        const char* field = strcasestr(buf, "Content-Length:");
+        const size_t body = field && field < end ? (size_t)atoi(field + 15) : 0;
+        size_t have = len - (end + 4 - buf);
+        while (have < body) {
+            const ssize_t m = ::recv(fd, buf, sizeof(buf), 0);
+            if (m <= 0) return false;
+            have += m;
+        }
+        return true;
+    }
+}
+
+class HttpResponder {
+public:
+    /**
+     * Listen on an ephemeral loopback port and serve from a thread
+     * @param delayMs Time the server takes per request
+     */
+    bool begin(uint32_t delayMs = 0) {
+        _delayMs = delayMs;
+        _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (_fd < 0 || ::bind(_fd, (struct sockaddr*)&addr, len) < 0 || ::listen(_fd, 8) < 0 ||
+            getsockname(_fd, (struct sockaddr*)&addr, &len) < 0) {
+            return false;
+        }
+        _port = ntohs(addr.sin_port);
+        std::thread([this] { serve(); }).detach();
+        return true;
+    }
+
+    uint16_t port() const { return _port; }
+
+private:
+    int _fd = -1;
+    uint16_t _port = 0;
+    uint32_t _delayMs = 0;
+
+    void serve() {
+        static const char RESPONSE[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok";
+        for (;;) {
+            const int conn = ::accept(_fd, nullptr, nullptr);
+            if (conn < 0) continue;
+            if (httpPeerReadRequest(conn)) {
+                if (_delayMs) usleep(_delayMs * 1000);
+                ::send(conn, RESPONSE, sizeof(RESPONSE) - 1, MSG_NOSIGNAL);
+            }
+            ::close(conn);
+        }
+    }
+};
+
+class HttpFetcher {
+public:
+    void begin(uint16_t port, const char* request) {
+        _port = port;
+        _request = request;
+        std::thread([this] { run(); }).detach();
+    }
+
+    /**
+     * Start one GET; sent() once the request is out, done() once the
+     * response ended
+     */
+    void fetch() {
+        _sent = false;
+        _done = false;
+        _go = true;
+    }
+
+    bool sent() const { return _sent; }
+    bool done() const { return _done; }
+    size_t bytes() const { return _bytes; }
+
+private:
+    uint16_t _port = 0;
+    const char* _request = nullptr;
+    std::atomic<bool> _go{false};
+    std::atomic<bool> _sent{false};
+    std::atomic<bool> _done{false};
+    std::atomic<size_t> _bytes{0};
+
+    void run() {
+        for (;;) {
+            if (!_go.exchange(false)) {
+                usleep(50);
+                continue;
+            }
+            const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            struct sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(_port);
+            size_t total = 0;
+            if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+                ::send(fd, _request, strlen(_request), MSG_NOSIGNAL);
+                _sent = true;
+                char buf[4096];
+                ssize_t n;
+                while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0) total += n;
+            }
+            ::close(fd);
+            _bytes = total;
+            _sent = true;
+            _done = true;
+        }
+    }
+};
+
+#endif // HTTP_PEER_H
@@ -0,0 +1,56 @@
+#ifndef NMEA_CAPTURE_H
+#define NMEA_CAPTURE_H
+
+/**
+ * @file nmea_capture.h
+ * @brief 20 epochs (RMC + GGA) from tools/nmea/sample_track.nmea for the parse benchmark
+ */
+
+#include <stddef.h>
+
+static const char NMEA_CAPTURE[] =
+    "$GPRMC,020000.00,A,0605.99765,S,10648.00237,E,12.0,45.0,010524,,,A*4B\r\n"
+    "$GPGGA,020000.00,0605.99765,S,10648.00237,E,1,09,0.9,12.3,M,0.0,M,,*79\r\n"
+    "$GPRMC,020001.00,A,0605.99529,S,10648.00473,E,12.0,45.0,010524,,,A*46\r\n"
+    "$GPGGA,020001.00,0605.99529,S,10648.00473,E,1,09,0.9,12.3,M,0.0,M,,*74\r\n"
+    "$GPRMC,020002.00,A,0605.99294,S,10648.00710,E,12.0,45.0,010524,,,A*42\r\n"
+    "$GPGGA,020002.00,0605.99294,S,10648.00710,E,1,09,0.9,12.3,M,0.0,M,,*70\r\n"
+    "$GPRMC,020003.00,A,0605.99059,S,10648.00946,E,12.0,45.0,010524,,,A*4D\r\n"
+    "$GPGGA,020003.00,0605.99059,S,10648.00946,E,1,09,0.9,12.3,M,0.0,M,,*7F\r\n"
+    "$GPRMC,020004.00,A,0605.98824,S,10648.01183,E,12.0,45.0,010524,,,A*49\r\n"
+    "$GPGGA,020004.00,0605.98824,S,10648.01183,E,1,09,0.9,12.3,M,0.0,M,,*7B\r\n"
+    "$GPRMC,020005.00,A,0605.98588,S,10648.01420,E,12.0,45.0,010524,,,A*4F\r\n"
+    "$GPGGA,020005.00,0605.98588,S,10648.01420,E,1,09,0.9,12.3,M,0.0,M,,*7D\r\n"
+    "$GPRMC,020006.00,A,0605.98353,S,10648.01656,E,12.0,45.0,010524,,,A*4F\r\n"
+    "$GPGGA,020006.00,0605.98353,S,10648.01656,E,1,09,0.9,12.3,M,0.0,M,,*7D\r\n"
+    "$GPRMC,020007.00,A,0605.98118,S,10648.01893,E,12.0,45.0,010524,,,A*44\r\n"
+    "$GPGGA,020007.00,0605.98118,S,10648.01893,E,1,09,0.9,12.3,M,0.0,M,,*76\r\n"
+    "$GPRMC,020008.00,A,0605.97882,S,10648.02130,E,12.0,45.0,010524,,,A*4D\r\n"
+    "$GPGGA,020008.00,0605.97882,S,10648.02130,E,1,09,0.9,12.3,M,0.0,M,,*7F\r\n"
+    "$GPRMC,020009.00,A,0605.97647,S,10648.02366,E,12.0,45.0,010524,,,A*4A\r\n"
+    "$GPGGA,020009.00,0605.97647,S,10648.02366,E,1,09,0.9,12.3,M,0.0,M,,*78\r\n"
+    "$GPRMC,020010.00,A,0605.97412,S,10648.02603,E,12.0,45.0,010524,,,A*46\r\n"
+    "$GPGGA,020010.00,0605.97412,S,10648.02603,E,1,09,0.9,12.3,M,0.0,M,,*74\r\n"
+    "$GPRMC,020011.00,A,0605.97177,S,10648.02839,E,12.0,45.0,010524,,,A*46\r\n"
+    "$GPGGA,020011.00,0605.97177,S,10648.02839,E,1,09,0.9,12.3,M,0.0,M,,*74\r\n"
+    "$GPRMC,020012.00,A,0605.96941,S,10648.03076,E,12.0,45.0,010524,,,A*4B\r\n"
+    "$GPGGA,020012.00,0605.96941,S,10648.03076,E,1,09,0.9,12.3,M,0.0,M,,*79\r\n"
+    "$GPRMC,020013.00,A,0605.96706,S,10648.03313,E,12.0,45.0,010524,,,A*47\r\n"
+    "$GPGGA,020013.00,0605.96706,S,10648.03313,E,1,09,0.9,12.3,M,0.0,M,,*75\r\n"
+    "$GPRMC,020014.00,A,0605.96471,S,10648.03549,E,12.0,45.0,010524,,,A*4A\r\n"
+    "$GPGGA,020014.00,0605.96471,S,10648.03549,E,1,09,0.9,12.3,M,0.0,M,,*78\r\n"
+    "$GPRMC,020015.00,A,0605.96236,S,10648.03786,E,12.0,45.0,010524,,,A*4F\r\n"
+    "$GPGGA,020015.00,0605.96236,S,10648.03786,E,1,09,0.9,12.3,M,0.0,M,,*7D\r\n"
+    "$GPRMC,020016.00,A,0605.96000,S,10648.04023,E,12.0,45.0,010524,,,A*44\r\n"
+    "$GPGGA,020016.00,0605.96000,S,10648.04023,E,1,09,0.9,12.3,M,0.0,M,,*76\r\n"
+    "$GPRMC,020017.00,A,0605.95765,S,10648.04259,E,12.0,45.0,010524,,,A*4D\r\n"
+    "$GPGGA,020017.00,0605.95765,S,10648.04259,E,1,09,0.9,12.3,M,0.0,M,,*7F\r\n"
+    "$GPRMC,020018.00,A,0605.95530,S,10648.04496,E,12.0,45.0,010524,,,A*45\r\n"
+    "$GPGGA,020018.00,0605.95530,S,10648.04496,E,1,09,0.9,12.3,M,0.0,M,,*77\r\n"
+    "$GPRMC,020019.00,A,0605.95294,S,10648.04732,E,12.0,45.0,010524,,,A*40\r\n"
+    "$GPGGA,020019.00,0605.95294,S,10648.04732,E,1,09,0.9,12.3,M,0.0,M,,*72\r\n"
+    ;
+
+static constexpr size_t NMEA_CAPTURE_EPOCHS = 20;
+
+#endif // NMEA_CAPTURE_H
@@ -0,0 +1,114 @@
+#ifndef ROUTE_BUILDER_H
+#define ROUTE_BUILDER_H
+
+/**
+ * @file route_builder.h
+ * @brief Synthetic route blobs for the route benchmarks
+ *
+ * A zigzag heading east, ROUTE_LEG_E7 per segment, with a port every
+ * ROUTE_PORT_EVERY segments, laid out as tools/route/build_route.py
+ * would (grid cells one leg wide, segments listed with their corridor).
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "../src/modules/route_tracker.h"
+
+static constexpr int32_t ROUTE_ORIGIN_LAT_E7 = -62000000;
+static constexpr int32_t ROUTE_ORIGIN_LON_E7 = 1067000000;
+static constexpr int32_t ROUTE_LEG_E7 = 50000;         // About 550 m east per segment
+static constexpr int32_t ROUTE_ZIGZAG_E7 = 20000;
+static constexpr float ROUTE_BENCH_CORRIDOR_M = 200;
+static constexpr size_t ROUTE_PORT_EVERY = 50;
+
+struct RouteBenchPoint {
+    int32_t latE7;
+    int32_t lonE7;
+};
+
+inline RouteBenchPoint routeVertex(size_t i) {
+    return RouteBenchPoint{ROUTE_ORIGIN_LAT_E7 + (i % 2 ? ROUTE_ZIGZAG_E7 : 0),
+                         ROUTE_ORIGIN_LON_E7 + (int32_t)i * ROUTE_LEG_E7};
+}
+
+/**
+ * Build a blob with segmentCount segments
+ * @return malloc'd, 4-byte aligned blob (caller frees), nullptr if out of memory
+ */
+inline uint8_t* buildRouteBlob(size_t segmentCount, size_t& size) {
+    static constexpr float METRES_PER_E7 = 0.0111319f;
+    const size_t ports = (segmentCount + ROUTE_PORT_EVERY - 1) / ROUTE_PORT_EVERY + 1;
+    const uint16_t cols = (uint16_t)(segmentCount + 1);   // One leg per cell, one row
+    const size_t maxEntries = (size_t)cols * 4;
+
+    size = sizeof(RouteBlobHeader) + segmentCount * sizeof(RouteSegment) + ports * sizeof(RoutePort) +
+           (cols + 1) * sizeof(uint32_t) + maxEntries * sizeof(uint32_t);
+    uint8_t* blob = (uint8_t*)calloc(1, size);
+    if (!blob) return nullptr;
+
+    RouteBlobHeader* h = reinterpret_cast<RouteBlobHeader*>(blob);
+    RouteSegment* segments = reinterpret_cast<RouteSegment*>(h + 1);
+    RoutePort* portTable = reinterpret_cast<RoutePort*>(segments + segmentCount);
+    uint32_t* cellStart = reinterpret_cast<uint32_t*>(portTable + ports);
+    uint32_t* cellSegments = cellStart + cols + 1;
+
+    h->magic = RouteBlobHeader::MAGIC;
+    h->version = 1;
+    h->portCount = (uint16_t)ports;
+    h->segmentCount = (uint32_t)segmentCount;
+    h->corridorM = ROUTE_BENCH_CORRIDOR_M;
+    h->gridLatE7 = ROUTE_ORIGIN_LAT_E7 - ROUTE_LEG_E7;
+    h->gridLonE7 = ROUTE_ORIGIN_LON_E7 - ROUTE_LEG_E7 / 2;
+    h->cellLatE7 = 3 * ROUTE_LEG_E7;
+    h->cellLonE7 = ROUTE_LEG_E7;
+    h->rows = 1;
+    h->cols = cols;
+
+    const float kx = METRES_PER_E7 * cosf(ROUTE_ORIGIN_LAT_E7 * 1e-7f * (float)DEG_TO_RAD);
+    float distance = 0;
+    size_t port = 0;
+    for (size_t i = 0; i < segmentCount; i++) {
+        const RouteBenchPoint a = routeVertex(i), b = routeVertex(i + 1);
+        RouteSegment& s = segments[i];
+        s.latE7 = a.latE7;
+        s.lonE7 = a.lonE7;
+        s.eastM = (b.lonE7 - a.lonE7) * kx;
+        s.northM = (b.latE7 - a.latE7) * METRES_PER_E7;
+        s.lengthM = sqrtf(s.eastM * s.eastM + s.northM * s.northM);
+        s.startM = distance;
+        if (i % ROUTE_PORT_EVERY == 0) {
+            portTable[port] = RoutePort{(uint16_t)port, 0, distance};
+            port++;
+        }
+        distance += s.lengthM;
+    }
+    portTable[port] = RoutePort{(uint16_t)port, 0, distance};
+
+    // Segment i spans cells i and i + 1, its corridor reaches one more
+    // cell on either side
+    uint32_t entries = 0;
+    for (size_t c = 0; c < cols; c++) {
+        cellStart[c] = entries;
+        for (size_t i = c > 2 ? c - 2 : 0; i <= c + 1 && i < segmentCount; i++) {
+            cellSegments[entries++] = (uint32_t)i;
+        }
+    }
+    cellStart[cols] = entries;
+    h->cellEntryCount = entries;
+    return blob;
+}
+
+/**
+ * Fix that sails the route 30 m to starboard, about 10 fixes per segment
+ */
+inline RouteBenchPoint routeTrackPoint(size_t segmentCount, uint32_t step) {
+    const uint32_t stepsPerLeg = 10;
+    const uint32_t position = step % (uint32_t)(segmentCount * stepsPerLeg);
+    const RouteBenchPoint a = routeVertex(position / stepsPerLeg);
+    const RouteBenchPoint b = routeVertex(position / stepsPerLeg + 1);
+    const int32_t t = position % stepsPerLeg;
+    return RouteBenchPoint{a.latE7 + (b.latE7 - a.latE7) * t / (int32_t)stepsPerLeg - 2700,
+                         a.lonE7 + (b.lonE7 - a.lonE7) * t / (int32_t)stepsPerLeg};
+}
+
+#endif // ROUTE_BUILDER_H
@@ -0,0 +1,102 @@
+#ifndef TRIP_TRACK_H
+#define TRIP_TRACK_H
+
+/**
+ * @file trip_track.h
+ * @brief Synthetic voyage for the trip analytics benchmarks
+ *
+ * 1 Hz fixes: alongside, underway with a slow turn, at anchor, underway
+ * again, then alongside until the trip ends. Stationary fixes carry
+ * receiver-like jitter (a few metres, speed under 1 km/h), so the case
+ * checks jitter rejection as well as the odometer. The reference
+ * distance is double-precision haversine over the noise-free positions
+ * while underway.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "../src/modules/trip_analytics.h"
+
+struct TripTrackPhase {
+    uint32_t seconds;
+    double knots;           // 0 = stationary
+    double turnDegPerS;
+};
+
+static const TripTrackPhase TRIP_TRACK_PHASES[] = {
+    {60, 0, 0},             // Alongside
+    {900, 12, 0.05},        // Underway, turning slowly
+    {300, 0, 0},            // At anchor: one stop
+    {900, 15, -0.02},
+    {TRIP_END_STOP_S + 60, 0, 0},   // Alongside: ends the trip
+};
+static constexpr uint32_t TRIP_TRACK_STOPS = 1;
+
+static constexpr double TRIP_TRACK_RADIUS_M = 6371008.8;
+
+struct TripTrack {
+    TripSample* samples;    // malloc'd, nullptr if out of memory
+    size_t count;
+    double movingM;         // Reference distance underway
+    uint32_t movingS;
+    uint32_t stoppedS;      // Stops within the trip
+};
+
+/**
+ * Double-precision haversine, the reference for TripMath::distanceMm
+ */
+inline double tripReferenceM(double lat1, double lon1, double lat2, double lon2) {
+    const double dLat = (lat2 - lat1) * M_PI / 180;
+    const double dLon = (lon2 - lon1) * M_PI / 180;
+    const double a = sin(dLat / 2) * sin(dLat / 2) +
+                     cos(lat1 * M_PI / 180) * cos(lat2 * M_PI / 180) * sin(dLon / 2) * sin(dLon / 2);
+    return 2 * TRIP_TRACK_RADIUS_M * asin(sqrt(a));
+}
+
+inline TripTrack buildTripTrack() {
+    TripTrack t{nullptr, 0, 0, 0, 0};
+    size_t count = 0;
+    for (const TripTrackPhase& p : TRIP_TRACK_PHASES) count += p.seconds;
+    t.samples = (TripSample*)malloc(count * sizeof(TripSample));
+    if (!t.samples) return t;
+
+    double lat = -6.1, lon = 106.8, course = 45;
+    uint32_t noise = 12345;
+    auto jitter = [&noise](int32_t span) {
+        noise = noise * 1103515245u + 12345u;
+        return (int32_t)((noise >> 8) % (uint32_t)(2 * span + 1)) - span;
+    };
+
+    for (size_t phase = 0; phase < sizeof(TRIP_TRACK_PHASES) / sizeof(TRIP_TRACK_PHASES[0]); phase++) {
+        const TripTrackPhase& p = TRIP_TRACK_PHASES[phase];
+        const bool last = phase + 1 == sizeof(TRIP_TRACK_PHASES) / sizeof(TRIP_TRACK_PHASES[0]);
+        if (p.knots > 0) t.movingS += p.seconds;
+        else if (phase > 0 && !last) t.stoppedS += p.seconds;
+
+        for (uint32_t i = 0; i < p.seconds; i++) {
+            TripSample& s = t.samples[t.count];
+            if (p.knots > 0) {
+                const double metres = p.knots * 0.514444;
+                const double lat0 = lat, lon0 = lon;
+                course += p.turnDegPerS;
+                lat += metres * cos(course * M_PI / 180) / 111194.9;
+                lon += metres * sin(course * M_PI / 180) / (111194.9 * cos(lat * M_PI / 180));
+                t.movingM += tripReferenceM(lat0, lon0, lat, lon);
+                s.latE7 = (int32_t)lround(lat * 1e7);
+                s.lonE7 = (int32_t)lround(lon * 1e7);
+                s.speedCms = (uint32_t)lround(metres * 100);
+            } else {
+                // About 3 m of jitter, under 0.5 km/h
+                s.latE7 = (int32_t)lround(lat * 1e7) + jitter(270);
+                s.lonE7 = (int32_t)lround(lon * 1e7) + jitter(270);
+                s.speedCms = (uint32_t)(jitter(7) + 7);
+            }
+            s.timeMs = (uint32_t)t.count * 1000;
+            s.epoch = 1714528800 + (uint32_t)t.count;
+            t.count++;
+        }
+    }
+    return t;
+}
+
+#endif // TRIP_TRACK_H
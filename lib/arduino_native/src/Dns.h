@@ -0,0 +1,20 @@
+#ifndef NATIVE_DNS_H
+#define NATIVE_DNS_H
+
+/**
+ * @file Dns.h
+ * @brief Ethernet library DNSClient backed by the host resolver
+ */
+
+#include "IPAddress.h"
+
+class DNSClient {
+public:
+    void begin(const IPAddress& server) { _server = server; }
+    int getHostByName(const char* host, IPAddress& result, uint16_t timeout = 5000);
+
+private:
+    IPAddress _server;
+};
+
+#endif // NATIVE_DNS_H
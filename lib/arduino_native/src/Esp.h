@@ -0,0 +1,32 @@
+#ifndef NATIVE_ESP_H
+#define NATIVE_ESP_H
+
+/**
+ * @file Esp.h
+ * @brief ESP system API on the host
+ *
+ * Heap figures are modelled on a 320 KB ESP32 heap minus the bytes the
+ * host allocator reports in use, so trends stay meaningful.
+ */
+
+#include <stdint.h>
+
+class EspClass {
+public:
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint8_t getChipRevision() { return 3; }
+    uint32_t getCpuFreqMHz();
+    uint64_t getEfuseMac();
+    uint32_t getCycleCount();
+    void restart();
+
+private:
+    uint32_t _minFreeHeap = UINT32_MAX;
+};
+
+extern EspClass ESP;
+
+#endif // NATIVE_ESP_H
@@ -0,0 +1,63 @@
+#ifndef NATIVE_ETHERNET_H
+#define NATIVE_ETHERNET_H
+
+/**
+ * @file Ethernet.h
+ * @brief Arduino Ethernet (W5500) API on host sockets
+ *
+ * DHCP always "succeeds" with the loopback address.
+ */
+
+#include <Arduino.h>
+#include "native_socket.h"
+#include "Dns.h"
+
+enum EthernetHardwareStatus { EthernetNoHardware, EthernetW5100, EthernetW5200, EthernetW5500 };
+enum EthernetLinkStatus { Unknown, LinkON, LinkOFF };
+
+class EthernetClass {
+public:
+    void init(uint8_t csPin) { _csPin = csPin; }
+    int begin(uint8_t* mac, unsigned long timeout = 60000, unsigned long responseTimeout = 4000);
+    int maintain() { return 0; }
+    IPAddress localIP() { return _ip; }
+    IPAddress dnsServerIP() { return IPAddress(127, 0, 0, 53); }
+    void MACAddress(uint8_t* mac) { memcpy(mac, _mac, 6); }
+    EthernetLinkStatus linkStatus() { return _linkUp ? LinkON : LinkOFF; }
+    EthernetHardwareStatus hardwareStatus() { return EthernetW5500; }
+
+    /**
+     * Simulate cable unplug / replug
+     */
+    void setLink(bool up) { _linkUp = up; _ip = up ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+
+    NativePath path;    // Simulated connect latency and outages
+
+private:
+    uint8_t _csPin = 0;
+    uint8_t _mac[6] = {0};
+    bool _linkUp = true;
+    IPAddress _ip;
+};
+
+extern EthernetClass Ethernet;
+
+class EthernetClient : public NativeSocketClient {
+public:
+    using NativeSocketClient::NativeSocketClient;
+    EthernetClient() {}
+    EthernetClient(const NativeSocketClient& other) : NativeSocketClient(other) {}
+
+protected:
+    const NativePath* simulatedPath() const override { return &Ethernet.path; }
+};
+
+class EthernetServer : public NativeSocketServer {
+public:
+    explicit EthernetServer(uint16_t port) : NativeSocketServer(port) {}
+    EthernetClient available() { return EthernetClient(accept()); }
+    EthernetClient accept() { return EthernetClient(NativeSocketServer::accept()); }
+    void begin(uint16_t port = 0) override { NativeSocketServer::begin(port); }
+};
+
+#endif // NATIVE_ETHERNET_H
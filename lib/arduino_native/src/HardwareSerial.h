@@ -0,0 +1,108 @@
+#ifndef NATIVE_HARDWARE_SERIAL_H
+#define NATIVE_HARDWARE_SERIAL_H
+
+/**
+ * @file HardwareSerial.h
+ * @brief Host UARTs
+ *
+ * UART0 is the console (stdout / non-blocking stdin). Any other UART is
+ * a fake receiver that replays an NMEA capture file against millis(),
+ * so it behaves like a real GPS under both the real and the virtual
+ * clock. Like a receiver, each navigation epoch (sentences sharing one
+ * UTC time field) is released at its own time offset and then clocked
+ * out at the configured baud rate. Captures without NMEA time fields
+ * are simply streamed at the baud rate. State is per UART number, so
+ * every HardwareSerial(2) sees the same replay.
+ */
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include "Stream.h"
+
+#define SERIAL_8N1 0x800001c
+
+class HardwareSerial : public Stream {
+public:
+    explicit HardwareSerial(int uartNum) : _uartNum(uartNum) {}
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1,
+               int8_t rxPin = -1, int8_t txPin = -1,
+               bool invert = false, unsigned long timeoutMs = 20000UL);
+    void end();
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+
+    /**
+     * Called from a watcher thread when data arrives: for the replay
+     * UARTs at the end of each epoch's burst (or every 120 bytes of a raw
+     * stream, the FIFO threshold), for the console when stdin has input
+     */
+    void onReceive(std::function<void(void)> callback, bool onlyOnTimeout = false);
+
+    operator bool() const { return true; }
+
+    /**
+     * Replay source for this UART (capture file of raw NMEA/UBX bytes)
+     * @param path File to replay
+     * @param baudOverride Pace at this rate instead of begin() baud (0 = use begin())
+     * @param loop Restart from the beginning at end of file
+     */
+    bool setReplayFile(const char* path, uint32_t baudOverride = 0, bool loop = true);
+
+    /**
+     * Replay from memory instead of a file
+     */
+    void setReplayData(const uint8_t* data, size_t size, uint32_t baudOverride = 0, bool loop = true);
+
+    /**
+     * Bytes the firmware wrote to this UART (e.g. UBX configuration)
+     */
+    const std::vector<uint8_t>& txLog() const { return port().txLog; }
+
+    /**
+     * Callback registered with onReceive(), if any
+     */
+    const std::function<void(void)>& receiveCallback() const;
+
+private:
+    // Per-UART hardware state, shared by all objects on the same port
+    struct Port {
+        unsigned long baud = 0;
+        uint32_t baudOverride = 0;
+        bool loop = true;
+        uint64_t startMicros = 0;
+        uint64_t consumed = 0;
+        std::vector<uint8_t> replay;
+        std::vector<size_t> epochByte;      // First byte of each epoch
+        std::vector<uint64_t> epochMicros;  // Release time of each epoch
+        uint64_t periodMicros = 0;          // Replay length (0 = raw stream)
+        std::vector<uint8_t> txLog;
+        std::function<void(void)> onReceive;
+        bool watching = false;
+        int peeked = -1;
+    };
+    static constexpr int PORT_COUNT = 3;
+
+    const int _uartNum;
+
+    Port& port() const;
+    uint64_t bytesDue() const;
+    uint64_t nextBurstEnd(uint64_t afterMicros) const;
+    void watchReplay();
+    void watchConsole();
+    static void indexEpochs(Port& p);
+    int replayByte(bool consume);
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+
+#endif // NATIVE_HARDWARE_SERIAL_H
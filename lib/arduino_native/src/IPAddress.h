@@ -0,0 +1,53 @@
+#ifndef NATIVE_IPADDRESS_H
+#define NATIVE_IPADDRESS_H
+
+/**
+ * @file IPAddress.h
+ * @brief IPv4 address value type
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "WString.h"
+
+class IPAddress {
+public:
+    IPAddress() : IPAddress(0, 0, 0, 0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        _bytes[0] = a; _bytes[1] = b; _bytes[2] = c; _bytes[3] = d;
+    }
+    IPAddress(uint32_t address) {   // Network byte order, as on ESP32
+        _bytes[0] = address & 0xFF;
+        _bytes[1] = (address >> 8) & 0xFF;
+        _bytes[2] = (address >> 16) & 0xFF;
+        _bytes[3] = (address >> 24) & 0xFF;
+    }
+
+    operator uint32_t() const {
+        return (uint32_t)_bytes[0] | ((uint32_t)_bytes[1] << 8) |
+               ((uint32_t)_bytes[2] << 16) | ((uint32_t)_bytes[3] << 24);
+    }
+    bool operator==(const IPAddress& other) const { return (uint32_t)*this == (uint32_t)other; }
+    bool operator!=(const IPAddress& other) const { return !(*this == other); }
+    uint8_t operator[](int index) const { return _bytes[index]; }
+    uint8_t& operator[](int index) { return _bytes[index]; }
+
+    String toString() const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+        return String(buf);
+    }
+
+    bool fromString(const char* address) {
+        unsigned a, b, c, d;
+        if (sscanf(address, "%u.%u.%u.%u", &a, &b, &c, &d) != 4) return false;
+        if (a > 255 || b > 255 || c > 255 || d > 255) return false;
+        *this = IPAddress(a, b, c, d);
+        return true;
+    }
+
+private:
+    uint8_t _bytes[4];
+};
+
+#endif // NATIVE_IPADDRESS_H
@@ -0,0 +1,119 @@
+/**
+ * @file Preferences.cpp
+ * @brief Host NVS: one map shared by all Preferences handles
+ *
+ * File format: repeated [u16 key length][key][u32 value length][value].
+ */
+
+#include "Preferences.h"
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace {
+std::mutex g_mutex;
+std::map<std::string, std::vector<uint8_t>> g_entries;
+std::string g_path;
+
+void saveLocked() {
+    if (g_path.empty()) return;
+    const std::string tmp = g_path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) return;
+    for (const auto& e : g_entries) {
+        const uint16_t keyLen = (uint16_t)e.first.size();
+        const uint32_t valueLen = (uint32_t)e.second.size();
+        fwrite(&keyLen, sizeof(keyLen), 1, f);
+        fwrite(e.first.data(), 1, keyLen, f);
+        fwrite(&valueLen, sizeof(valueLen), 1, f);
+        fwrite(e.second.data(), 1, valueLen, f);
+    }
+    fclose(f);
+    rename(tmp.c_str(), g_path.c_str());
+}
+} // namespace
+
+bool nativeSetNvsFile(const char* path) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_path = path;
+    g_entries.clear();
+
+    FILE* f = fopen(path, "rb");
+    if (!f) return true;  // Created on the first write
+    uint16_t keyLen;
+    while (fread(&keyLen, sizeof(keyLen), 1, f) == 1) {
+        std::string key(keyLen, '\0');
+        uint32_t valueLen;
+        if (fread(&key[0], 1, keyLen, f) != keyLen || fread(&valueLen, sizeof(valueLen), 1, f) != 1) break;
+        std::vector<uint8_t> value(valueLen);
+        if (fread(value.data(), 1, valueLen, f) != valueLen) break;
+        g_entries[key] = std::move(value);
+    }
+    fclose(f);
+    return true;
+}
+
+bool Preferences::begin(const char* name, bool readOnly, const char*) {
+    // NVS namespaces are limited to 15 characters
+    if (!name || strlen(name) > 15) return false;
+    _namespace = name;
+    _readOnly = readOnly;
+    _open = true;
+    return true;
+}
+
+void Preferences::end() {
+    _open = false;
+}
+
+bool Preferences::clear() {
+    if (!_open || _readOnly) return false;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const std::string prefix = _namespace + '/';
+    for (auto it = g_entries.begin(); it != g_entries.end();) {
+        it = it->first.compare(0, prefix.size(), prefix) == 0 ? g_entries.erase(it) : std::next(it);
+    }
+    saveLocked();
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!_open || _readOnly) return false;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_entries.erase(fullKey(key)) == 0) return false;
+    saveLocked();
+    return true;
+}
+
+bool Preferences::isKey(const char* key) {
+    if (!_open) return false;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_entries.count(fullKey(key)) != 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+    if (!_open || _readOnly || !key || strlen(key) > 15) return 0;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    g_entries[fullKey(key)].assign(bytes, bytes + len);
+    saveLocked();
+    return len;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+    if (!_open) return 0;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto it = g_entries.find(fullKey(key));
+    if (it == g_entries.end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    if (!_open) return 0;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto it = g_entries.find(fullKey(key));
+    return it == g_entries.end() ? 0 : it->second.size();
+}
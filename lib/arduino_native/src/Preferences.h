@@ -0,0 +1,49 @@
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+/**
+ * @file Preferences.h
+ * @brief NVS key/value store on the host
+ *
+ * Entries live in memory and, if a backing file is set (--nvs or
+ * NATIVE_NVS_FILE), are rewritten to it after every change so state
+ * survives a restart of the program, like flash across a reboot.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * Load and persist NVS entries in this file (call before setup())
+ */
+bool nativeSetNvsFile(const char* path);
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+    void end();
+
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putBytes(const char* key, const void* value, size_t len);
+    size_t getBytes(const char* key, void* buf, size_t maxLen);
+    size_t getBytesLength(const char* key);
+
+    size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) {
+        uint32_t value = defaultValue;
+        return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+    }
+
+private:
+    std::string _namespace;
+    bool _open = false;
+    bool _readOnly = false;
+
+    std::string fullKey(const char* key) const { return _namespace + '/' + key; }
+};
+
+#endif // NATIVE_PREFERENCES_H
@@ -0,0 +1,107 @@
+#ifndef NATIVE_PRINT_H
+#define NATIVE_PRINT_H
+
+/**
+ * @file Print.h
+ * @brief Arduino Print base class
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "WString.h"
+
+class __FlashStringHelper;
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            if (!write(*buffer++)) break;
+            n++;
+        }
+        return n;
+    }
+    size_t write(const char* str) {
+        return str ? write((const uint8_t*)str, strlen(str)) : 0;
+    }
+    size_t write(const char* buffer, size_t size) {
+        return write((const uint8_t*)buffer, size);
+    }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        const int len = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        if (len < 0) return 0;
+        if ((size_t)len < sizeof(buf)) return write((const uint8_t*)buf, len);
+
+        char* big = new char[len + 1];
+        va_start(args, format);
+        vsnprintf(big, len + 1, format, args);
+        va_end(args);
+        const size_t n = write((const uint8_t*)big, len);
+        delete[] big;
+        return n;
+    }
+
+    size_t print(const __FlashStringHelper* s) { return write(reinterpret_cast<const char*>(s)); }
+    size_t print(const String& s) { return write(s.c_str(), s.length()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC_BASE) { return printNumber(n, base); }
+    size_t print(int n, int base = DEC_BASE) { return printSigned(n, base); }
+    size_t print(unsigned int n, int base = DEC_BASE) { return printNumber(n, base); }
+    size_t print(long n, int base = DEC_BASE) { return printSigned(n, base); }
+    size_t print(unsigned long n, int base = DEC_BASE) { return printNumber(n, base); }
+    size_t print(long long n, int base = DEC_BASE) { return printSigned(n, base); }
+    size_t print(unsigned long long n, int base = DEC_BASE) { return printNumber(n, base); }
+    size_t print(double n, int digits = 2) {
+        char buf[48];
+        const int len = snprintf(buf, sizeof(buf), "%.*f", digits, n);
+        return write((const uint8_t*)buf, len);
+    }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& value) { const size_t n = print(value); return n + println(); }
+    template <typename T>
+    size_t println(const T& value, int format) { const size_t n = print(value, format); return n + println(); }
+    size_t println(const char* s) { const size_t n = print(s); return n + println(); }
+    size_t println(const __FlashStringHelper* s) { const size_t n = print(s); return n + println(); }
+
+private:
+    static constexpr int DEC_BASE = 10;
+
+    size_t printSigned(long long n, int base) {
+        if (base == 10 && n < 0) {
+            return print('-') + printNumber(0ULL - (unsigned long long)n, base);
+        }
+        return printNumber((unsigned long long)n, base);
+    }
+
+    size_t printNumber(unsigned long long n, int base) {
+        char buf[65];
+        char* p = &buf[sizeof(buf) - 1];
+        *p = '\0';
+        if (base < 2) base = 10;
+        do {
+            const int d = (int)(n % base);
+            *--p = (char)(d < 10 ? '0' + d : 'A' + d - 10);
+            n /= base;
+        } while (n);
+        return write(p);
+    }
+};
+
+#endif // NATIVE_PRINT_H
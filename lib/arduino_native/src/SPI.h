@@ -0,0 +1,35 @@
+#ifndef NATIVE_SPI_H
+#define NATIVE_SPI_H
+
+/**
+ * @file SPI.h
+ * @brief SPI bus placeholder (no SPI devices on the host)
+ */
+
+#include <stdint.h>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+class SPISettings {
+public:
+    SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0)
+        : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+    uint32_t clock;
+    uint8_t bitOrder;
+    uint8_t dataMode;
+};
+
+class SPIClass {
+public:
+    void begin(int8_t = -1, int8_t = -1, int8_t = -1, int8_t = -1) {}
+    void end() {}
+    void beginTransaction(SPISettings) {}
+    void endTransaction() {}
+    uint8_t transfer(uint8_t) { return 0; }
+    void transferBytes(const uint8_t*, uint8_t*, uint32_t) {}
+};
+
+extern SPIClass SPI;
+
+#endif // NATIVE_SPI_H
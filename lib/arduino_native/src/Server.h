@@ -0,0 +1,16 @@
+#ifndef NATIVE_SERVER_H
+#define NATIVE_SERVER_H
+
+/**
+ * @file Server.h
+ * @brief Arduino Server interface (ESP32 flavour: begin takes a port)
+ */
+
+#include "Print.h"
+
+class Server : public Print {
+public:
+    virtual void begin(uint16_t port = 0) = 0;
+};
+
+#endif // NATIVE_SERVER_H
@@ -0,0 +1,62 @@
+#ifndef NATIVE_STREAM_H
+#define NATIVE_STREAM_H
+
+/**
+ * @file Stream.h
+ * @brief Arduino Stream base class
+ */
+
+#include "Print.h"
+
+unsigned long millis();
+void yield();
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeoutMs) { _timeout = timeoutMs; }
+    unsigned long getTimeout() const { return _timeout; }
+
+    size_t readBytes(char* buffer, size_t length) {
+        size_t count = 0;
+        while (count < length) {
+            const int c = timedRead();
+            if (c < 0) break;
+            *buffer++ = (char)c;
+            count++;
+        }
+        return count;
+    }
+    size_t readBytes(uint8_t* buffer, size_t length) {
+        return readBytes((char*)buffer, length);
+    }
+
+    size_t readBytesUntil(char terminator, char* buffer, size_t length) {
+        size_t index = 0;
+        while (index < length) {
+            const int c = timedRead();
+            if (c < 0 || c == terminator) break;
+            *buffer++ = (char)c;
+            index++;
+        }
+        return index;
+    }
+
+protected:
+    unsigned long _timeout = 1000;
+
+    int timedRead() {
+        const unsigned long start = millis();
+        do {
+            const int c = read();
+            if (c >= 0) return c;
+            yield();
+        } while (millis() - start < _timeout);
+        return -1;
+    }
+};
+
+#endif // NATIVE_STREAM_H
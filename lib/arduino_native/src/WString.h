@@ -0,0 +1,84 @@
+#ifndef NATIVE_WSTRING_H
+#define NATIVE_WSTRING_H
+
+/**
+ * @file WString.h
+ * @brief Arduino String on top of std::string
+ */
+
+#include <stdint.h>
+#include <string>
+
+class __FlashStringHelper;
+
+class String {
+public:
+    String(const char* s = "") : _s(s ? s : "") {}
+    String(const __FlashStringHelper* s) : _s(reinterpret_cast<const char*>(s)) {}
+    String(const std::string& s) : _s(s) {}
+    explicit String(char c) : _s(1, c) {}
+    explicit String(unsigned char value, unsigned char base = 10) : _s(toBase(value, base)) {}
+    explicit String(int value, unsigned char base = 10) : _s(toBase(value, base)) {}
+    explicit String(unsigned int value, unsigned char base = 10) : _s(toBase(value, base)) {}
+    explicit String(long value, unsigned char base = 10) : _s(toBase(value, base)) {}
+    explicit String(unsigned long value, unsigned char base = 10) : _s(toBase(value, base)) {}
+    explicit String(long long value, unsigned char base = 10) : _s(toBase(value, base)) {}
+    explicit String(unsigned long long value, unsigned char base = 10) : _s(toBase(value, base)) {}
+    explicit String(float value, unsigned int decimals = 2) : _s(toFixed(value, decimals)) {}
+    explicit String(double value, unsigned int decimals = 2) : _s(toFixed(value, decimals)) {}
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return _s.length(); }
+    bool reserve(unsigned int size) { _s.reserve(size); return true; }
+    bool concat(const String& s) { _s += s._s; return true; }
+    bool concat(const char* s) { _s += s; return true; }
+    bool concat(char c) { _s += c; return true; }
+    long toInt() const { return atol(_s.c_str()); }
+    float toFloat() const { return atof(_s.c_str()); }
+    int indexOf(char c, unsigned int from = 0) const {
+        const size_t pos = _s.find(c, from);
+        return pos == std::string::npos ? -1 : (int)pos;
+    }
+    String substring(unsigned int from, unsigned int to = ~0u) const {
+        if (from > _s.size()) return String();
+        return String(_s.substr(from, to == ~0u ? std::string::npos : to - from));
+    }
+    bool startsWith(const String& prefix) const { return _s.rfind(prefix._s, 0) == 0; }
+    char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : '\0'; }
+
+    String& operator+=(const String& s) { _s += s._s; return *this; }
+    String& operator+=(const char* s) { _s += s; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+
+    friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+    friend String operator+(const String& a, const char* b) { return String(a._s + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b._s); }
+    friend bool operator==(const String& a, const String& b) { return a._s == b._s; }
+    friend bool operator==(const String& a, const char* b) { return a._s == b; }
+    friend bool operator!=(const String& a, const String& b) { return a._s != b._s; }
+
+private:
+    std::string _s;
+
+    template <typename T>
+    static std::string toBase(T value, unsigned char base) {
+        if (base == 10) return std::to_string(value);
+        const bool negative = value < 0;
+        unsigned long long v = negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+        std::string out;
+        do {
+            const int d = (int)(v % base);
+            out.insert(out.begin(), (char)(d < 10 ? '0' + d : 'A' + d - 10));
+            v /= base;
+        } while (v);
+        return negative ? "-" + out : out;
+    }
+
+    static std::string toFixed(double value, unsigned int decimals) {
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%.*f", (int)decimals, value);
+        return buf;
+    }
+};
+
+#endif // NATIVE_WSTRING_H
@@ -0,0 +1,71 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+/**
+ * @file WiFi.h
+ * @brief ESP32 WiFi API on host sockets
+ *
+ * Association is instant; the station gets the loopback address.
+ */
+
+#include <Arduino.h>
+#include "native_socket.h"
+
+typedef enum { WIFI_OFF = 0, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t m) { _mode = m; return true; }
+    wl_status_t begin(const char* ssid, const char* password = nullptr);
+    bool disconnect(bool = false) { _status = WL_DISCONNECTED; return true; }
+    wl_status_t status() { return _status; }
+    IPAddress localIP() { return _status == WL_CONNECTED ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+    int32_t RSSI() { return _rssi; }
+    String SSID() { return String(_ssid); }
+    uint8_t* macAddress(uint8_t* mac);
+    int hostByName(const char* host, IPAddress& result) { return nativeResolve(host, result) ? 1 : 0; }
+    bool setSleep(bool) { return true; }
+
+    /**
+     * Simulated radio conditions
+     */
+    void setRSSI(int32_t rssi) { _rssi = rssi; }
+    void setStatus(wl_status_t status) { _status = status; }
+
+    NativePath path;    // Simulated connect latency and outages
+
+private:
+    wifi_mode_t _mode = WIFI_OFF;
+    wl_status_t _status = WL_DISCONNECTED;
+    int32_t _rssi = -55;
+    char _ssid[33] = {0};
+};
+
+extern WiFiClass WiFi;
+
+class WiFiClient : public NativeSocketClient {
+public:
+    using NativeSocketClient::NativeSocketClient;
+    WiFiClient() {}
+    WiFiClient(const NativeSocketClient& other) : NativeSocketClient(other) {}
+
+protected:
+    const NativePath* simulatedPath() const override { return &WiFi.path; }
+};
+
+class WiFiServer : public NativeSocketServer {
+public:
+    explicit WiFiServer(uint16_t port) : NativeSocketServer(port) {}
+    WiFiClient available() { return WiFiClient(accept()); }
+};
+
+#endif // NATIVE_WIFI_H
@@ -0,0 +1,412 @@
+/**
+ * @file arduino_native.cpp
+ * @brief Core Arduino/ESP32 functions for the host build
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <esp_task_wdt.h>
+#include <malloc.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+// ============================================
+// Time
+// ============================================
+unsigned long millis() {
+    return (unsigned long)(NativeClock::nowMicros() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)NativeClock::nowMicros();
+}
+
+void delay(uint32_t ms) {
+    NativeClock::sleepMicros((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    NativeClock::sleepMicros(us);
+}
+
+void yield() {
+    // Busy-wait loops must make progress under the virtual clock
+    if (NativeClock::isVirtual()) {
+        NativeClock::sleepMicros(1000);
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+// ============================================
+// GPIO (levels written by the firmware or set with --pin)
+// ============================================
+static uint8_t g_pinState[64];
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (pin < sizeof(g_pinState)) g_pinState[pin] = val;
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < sizeof(g_pinState) ? g_pinState[pin] : LOW;
+}
+
+// ============================================
+// CPU frequency (recorded only; the host runs at full speed)
+// ============================================
+static std::atomic<uint32_t> g_cpuMhz{240};
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+    if (mhz != 240 && mhz != 160 && mhz != 80 && mhz != 40 && mhz != 20 && mhz != 10) return false;
+    g_cpuMhz.store(mhz);
+    return true;
+}
+
+uint32_t getCpuFrequencyMhz() {
+    return g_cpuMhz.load();
+}
+
+// ============================================
+// Random
+// ============================================
+static std::mt19937 g_rng(12345);
+
+long random(long maxValue) {
+    return maxValue <= 0 ? 0 : (long)(g_rng() % (unsigned long)maxValue);
+}
+
+long random(long minValue, long maxValue) {
+    return maxValue <= minValue ? minValue : minValue + random(maxValue - minValue);
+}
+
+void randomSeed(unsigned long seed) {
+    g_rng.seed(seed);
+}
+
+// ============================================
+// ESP
+// ============================================
+EspClass ESP;
+
+static constexpr uint32_t NATIVE_HEAP_SIZE = 327680;
+
+uint32_t EspClass::getHeapSize() {
+    return NATIVE_HEAP_SIZE;
+}
+
+uint32_t EspClass::getFreeHeap() {
+    const struct mallinfo2 info = mallinfo2();
+    const uint32_t used = (uint32_t)min<size_t>(info.uordblks, NATIVE_HEAP_SIZE);
+    const uint32_t freeHeap = NATIVE_HEAP_SIZE - used;
+    if (freeHeap < _minFreeHeap) _minFreeHeap = freeHeap;
+    return freeHeap;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    getFreeHeap();
+    return _minFreeHeap;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return getFreeHeap();
+}
+
+uint32_t EspClass::getCpuFreqMHz() {
+    return getCpuFrequencyMhz();
+}
+
+uint64_t EspClass::getEfuseMac() {
+    const char* mac = getenv("NATIVE_EFUSE_MAC");
+    return mac ? strtoull(mac, nullptr, 16) : 0x0000C3B2A1ULL;
+}
+
+uint32_t EspClass::getCycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#else
+    return (uint32_t)(NativeClock::nowMicros() * 240);
+#endif
+}
+
+// Like a reset: no destructors (the caller may be a task thread that
+// static teardown would join)
+void EspClass::restart() {
+    fflush(stdout);
+    _exit(0);
+}
+
+// ============================================
+// Watchdog (no-op)
+// ============================================
+esp_err_t esp_task_wdt_init(uint32_t, bool) { return ESP_OK; }
+esp_err_t esp_task_wdt_add(TaskHandle_t) { return ESP_OK; }
+esp_err_t esp_task_wdt_delete(TaskHandle_t) { return ESP_OK; }
+esp_err_t esp_task_wdt_reset() { return ESP_OK; }
+
+// ============================================
+// SPI
+// ============================================
+SPIClass SPI;
+
+// ============================================
+// HardwareSerial
+// ============================================
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+
+HardwareSerial::Port& HardwareSerial::port() const {
+    static Port ports[PORT_COUNT];
+    return ports[(_uartNum >= 0 && _uartNum < PORT_COUNT) ? _uartNum : 0];
+}
+
+const std::function<void(void)>& HardwareSerial::receiveCallback() const {
+    return port().onReceive;
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t, int8_t, int8_t, bool, unsigned long) {
+    Port& p = port();
+    p.baud = baud;
+    p.startMicros = NativeClock::nowMicros();
+    p.consumed = 0;
+    p.peeked = -1;
+}
+
+void HardwareSerial::end() {
+    port().baud = 0;
+}
+
+bool HardwareSerial::setReplayFile(const char* path, uint32_t baudOverride, bool loop) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    std::vector<uint8_t> data;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    setReplayData(data.data(), data.size(), baudOverride, loop);
+    return true;
+}
+
+void HardwareSerial::setReplayData(const uint8_t* data, size_t size, uint32_t baudOverride, bool loop) {
+    Port& p = port();
+    p.replay.assign(data, data + size);
+    p.baudOverride = baudOverride;
+    p.loop = loop;
+    p.startMicros = NativeClock::nowMicros();
+    p.consumed = 0;
+    indexEpochs(p);
+}
+
+/**
+ * Split the capture into epochs by the UTC field of $..RMC/$..GGA
+ */
+void HardwareSerial::indexEpochs(Port& p) {
+    p.epochByte.clear();
+    p.epochMicros.clear();
+    p.periodMicros = 0;
+
+    double firstTime = -1;
+    double lastTime = -1;
+    double prevOffset = 0;
+    for (size_t i = 0; i + 7 < p.replay.size(); i++) {
+        if (p.replay[i] != '$') continue;
+        const char* s = (const char*)&p.replay[i];
+        if (strncmp(s + 3, "RMC,", 4) != 0 && strncmp(s + 3, "GGA,", 4) != 0) continue;
+
+        const double hms = atof(s + 7);
+        const double t = (int)(hms / 10000) * 3600 + ((int)(hms / 100) % 100) * 60 + fmod(hms, 100.0);
+        if (t == lastTime) continue;
+
+        if (firstTime < 0) firstTime = t;
+        double offset = t - firstTime;
+        if (offset < prevOffset) offset += 86400;   // Midnight rollover
+        prevOffset = offset;
+        lastTime = t;
+
+        p.epochByte.push_back(p.epochByte.empty() ? 0 : i);
+        p.epochMicros.push_back((uint64_t)(offset * 1e6));
+    }
+
+    if (p.epochByte.size() < 2) {
+        p.epochByte.clear();
+        p.epochMicros.clear();
+        return;
+    }
+    const uint64_t lastGap = p.epochMicros.back() - p.epochMicros[p.epochMicros.size() - 2];
+    p.periodMicros = p.epochMicros.back() + lastGap;
+}
+
+uint64_t HardwareSerial::bytesDue() const {
+    const Port& p = port();
+    const uint32_t baud = p.baudOverride ? p.baudOverride : p.baud;
+    if (baud == 0) return 0;
+    const uint64_t elapsed = NativeClock::nowMicros() - p.startMicros;
+
+    if (p.periodMicros == 0) {
+        // Raw stream, 8N1: 10 bit times per byte
+        const uint64_t due = elapsed * baud / 10 / 1000000ULL;
+        if (!p.loop && due > p.replay.size()) return p.replay.size();
+        return due;
+    }
+
+    const uint64_t lap = elapsed / p.periodMicros;
+    if (!p.loop && lap > 0) return p.replay.size();
+    const uint64_t t = elapsed % p.periodMicros;
+
+    // Last epoch released at or before t
+    const size_t k = std::upper_bound(p.epochMicros.begin(), p.epochMicros.end(), t)
+                     - p.epochMicros.begin() - 1;
+    const size_t epochEnd = k + 1 < p.epochByte.size() ? p.epochByte[k + 1] : p.replay.size();
+    const uint64_t clocked = (t - p.epochMicros[k]) * baud / 10 / 1000000ULL;
+    const uint64_t within = min<uint64_t>(clocked, epochEnd - p.epochByte[k]);
+    return lap * p.replay.size() + p.epochByte[k] + within;
+}
+
+int HardwareSerial::replayByte(bool consume) {
+    Port& p = port();
+    if (p.replay.empty() || p.consumed >= bytesDue()) return -1;
+    const int c = p.replay[p.consumed % p.replay.size()];
+    if (consume) p.consumed++;
+    return c;
+}
+
+/**
+ * End of the first receive burst that completes after afterMicros
+ */
+uint64_t HardwareSerial::nextBurstEnd(uint64_t afterMicros) const {
+    const Port& p = port();
+    const uint32_t baud = p.baudOverride ? p.baudOverride : p.baud;
+    if (baud == 0 || p.replay.empty()) return afterMicros + 100000;
+    const uint64_t byteMicros = 10 * 1000000ULL / baud;
+    const uint64_t elapsed = afterMicros - p.startMicros;
+
+    if (p.periodMicros == 0) {
+        const uint64_t chunk = 120 * byteMicros;
+        return p.startMicros + (elapsed / chunk + 1) * chunk;
+    }
+
+    const uint64_t lap = elapsed / p.periodMicros;
+    if (!p.loop && lap > 0) return afterMicros + 1000000;
+    const uint64_t t = elapsed % p.periodMicros;
+    for (size_t k = 0; k < p.epochByte.size(); k++) {
+        const size_t end = k + 1 < p.epochByte.size() ? p.epochByte[k + 1] : p.replay.size();
+        const uint64_t burstEnd = p.epochMicros[k] + (end - p.epochByte[k]) * byteMicros;
+        if (burstEnd > t) return p.startMicros + lap * p.periodMicros + burstEnd;
+    }
+    const size_t firstEnd = p.epochByte.size() > 1 ? p.epochByte[1] : p.replay.size();
+    return p.startMicros + (lap + 1) * p.periodMicros + p.epochMicros[0] + firstEnd * byteMicros;
+}
+
+void HardwareSerial::onReceive(std::function<void(void)> callback, bool) {
+    Port& p = port();
+    p.onReceive = callback;
+    if (!callback || p.watching) return;
+    p.watching = true;
+    if (_uartNum == 0) {
+        std::thread([this] { watchConsole(); }).detach();
+    } else {
+        NativeClock::attachThread();  // Sleeps on the (virtual) clock like a task
+        std::thread([this] { watchReplay(); }).detach();
+    }
+}
+
+void HardwareSerial::watchReplay() {
+    const Port& p = port();
+    for (;;) {
+        const uint64_t now = NativeClock::nowMicros();
+        NativeClock::sleepMicros(nextBurstEnd(now) - now);
+        if (p.onReceive) p.onReceive();
+    }
+}
+
+// Real-time input: runs off the clock, like an interrupt source
+void HardwareSerial::watchConsole() {
+    const Port& p = port();
+    int notified = 0;
+    for (;;) {
+        struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        int pending = 0;
+        if (ioctl(STDIN_FILENO, FIONREAD, &pending) != 0 || pending == 0) {
+            if (pfd.revents & (POLLHUP | POLLIN)) return;  // EOF: nothing will arrive
+            continue;
+        }
+        if (pending != notified && p.onReceive) p.onReceive();
+        notified = pending;
+        usleep(10000);
+    }
+}
+
+// Console input; closed (EOF) stdin reads as "no data" forever
+static int consoleRead() {
+    static bool closed = false;
+    if (closed) return -1;
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    if (poll(&pfd, 1, 0) <= 0) return -1;
+    uint8_t c;
+    if (::read(STDIN_FILENO, &c, 1) == 1) return c;
+    closed = true;
+    return -1;
+}
+
+int HardwareSerial::available() {
+    Port& p = port();
+    if (_uartNum == 0) {
+        if (p.peeked < 0) p.peeked = consoleRead();
+        return p.peeked >= 0 ? 1 : 0;
+    }
+    if (p.replay.empty()) return 0;
+    const uint64_t due = bytesDue();
+    // Model the UART FIFO + driver buffer: unread older bytes are lost
+    if (due - p.consumed > 1024) p.consumed = due - 1024;
+    return (int)(due - p.consumed);
+}
+
+int HardwareSerial::read() {
+    Port& p = port();
+    if (p.peeked >= 0) {
+        const int c = p.peeked;
+        p.peeked = -1;
+        return c;
+    }
+    if (_uartNum == 0) {
+        return consoleRead();
+    }
+    return replayByte(true);
+}
+
+int HardwareSerial::peek() {
+    Port& p = port();
+    if (_uartNum == 0) {
+        if (p.peeked < 0) p.peeked = consoleRead();
+        return p.peeked;
+    }
+    return replayByte(false);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    if (_uartNum == 0) {
+        return fwrite(buffer, 1, size, stdout);
+    }
+    Port& p = port();
+    p.txLog.insert(p.txLog.end(), buffer, buffer + size);
+    return size;
+}
+
+void HardwareSerial::flush() {
+    if (_uartNum == 0) fflush(stdout);
+}
@@ -0,0 +1,78 @@
+#ifndef NATIVE_DRIVER_SPI_MASTER_H
+#define NATIVE_DRIVER_SPI_MASTER_H
+
+/**
+ * @file driver/spi_master.h
+ * @brief ESP-IDF SPI master API on the host: the one device is the
+ *        W5500 simulator (w5500_sim.h), which gets every transaction as
+ *        a frame (command phase = address, address phase = control byte)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../esp_err.h"
+
+#ifndef portMAX_DELAY
+#define portMAX_DELAY 0xFFFFFFFFu
+#endif
+
+typedef enum { SPI1_HOST = 0, SPI2_HOST = 1, SPI3_HOST = 2 } spi_host_device_t;
+typedef enum { SPI_DMA_DISABLED = 0, SPI_DMA_CH1 = 1, SPI_DMA_CH2 = 2, SPI_DMA_CH_AUTO = 3 } spi_dma_chan_t;
+
+#define SPI_TRANS_USE_RXDATA    (1 << 2)
+#define SPI_TRANS_USE_TXDATA    (1 << 3)
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+    uint32_t flags;
+    int intr_flags;
+} spi_bus_config_t;
+
+typedef struct {
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+    uint8_t mode;
+    uint16_t duty_cycle_pos;
+    uint16_t cs_ena_pretrans;
+    uint8_t cs_ena_posttrans;
+    int clock_speed_hz;
+    int input_delay_ns;
+    int spics_io_num;
+    uint32_t flags;
+    int queue_size;
+} spi_device_interface_config_t;
+
+typedef struct {
+    uint32_t flags;
+    uint16_t cmd;
+    uint64_t addr;
+    size_t length;      // Bits
+    size_t rxlength;    // Bits
+    void* user;
+    union {
+        const void* tx_buffer;
+        uint8_t tx_data[4];
+    };
+    union {
+        void* rx_buffer;
+        uint8_t rx_data[4];
+    };
+} spi_transaction_t;
+
+typedef struct spi_device_t* spi_device_handle_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t* bus, spi_dma_chan_t dma);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* config,
+                             spi_device_handle_t* handle);
+esp_err_t spi_device_acquire_bus(spi_device_handle_t handle, uint32_t wait);
+void spi_device_release_bus(spi_device_handle_t handle);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t* transaction);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t* transaction);
+
+#endif // NATIVE_DRIVER_SPI_MASTER_H
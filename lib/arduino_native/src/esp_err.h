@@ -0,0 +1,19 @@
+#ifndef NATIVE_ESP_ERR_H
+#define NATIVE_ESP_ERR_H
+
+/**
+ * @file esp_err.h
+ * @brief ESP-IDF error codes used by the shims
+ */
+
+typedef int esp_err_t;
+
+#define ESP_OK                      0
+#define ESP_FAIL                    -1
+#define ESP_ERR_INVALID_ARG         0x102
+#define ESP_ERR_INVALID_STATE       0x103
+#define ESP_ERR_INVALID_SIZE        0x104
+#define ESP_ERR_NOT_FOUND           0x105
+#define ESP_ERR_OTA_VALIDATE_FAILED 0x1503
+
+#endif // NATIVE_ESP_ERR_H
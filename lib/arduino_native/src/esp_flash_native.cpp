@@ -0,0 +1,292 @@
+/**
+ * @file esp_flash_native.cpp
+ * @brief File-backed flash partitions: OTA slots with the bootloader's
+ *        rollback decision, and the data partition
+ *
+ * otadata format (text): "<boot slot> <state of ota_0> <state of ota_1>".
+ * The data partition file is created erased, at full size, and keeps
+ * NOR semantics: a write only clears bits, an erase sets a sector back
+ * to 0xFF.
+ */
+
+#include "esp_ota_ops.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <mutex>
+#include <string>
+
+namespace {
+constexpr int SLOTS = 2;
+
+std::mutex g_mutex;
+std::string g_dir;
+const esp_partition_t g_slots[SLOTS] = {
+    {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, NATIVE_OTA_SLOT_SIZE, "app0", false},
+    {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x10000 + NATIVE_OTA_SLOT_SIZE, NATIVE_OTA_SLOT_SIZE, "app1", false},
+};
+const esp_partition_t g_data = {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS,
+                                 0x10000 + 2 * NATIVE_OTA_SLOT_SIZE, NATIVE_DATA_PARTITION_SIZE, "spiffs", false};
+FILE* g_dataFile = nullptr;
+int g_running = -1;     // No flash directory: no partitions
+int g_boot = 0;
+esp_ota_img_states_t g_state[SLOTS] = {ESP_OTA_IMG_UNDEFINED, ESP_OTA_IMG_UNDEFINED};
+
+FILE* g_image = nullptr;    // Open update, handle 1
+int g_imageSlot = -1;
+size_t g_imageBytes = 0;
+
+std::string slotPath(int slot) {
+    return g_dir + "/ota_" + std::to_string(slot) + ".bin";
+}
+
+int slotOf(const esp_partition_t* partition) {
+    for (int i = 0; i < SLOTS; i++) {
+        if (partition == &g_slots[i]) return i;
+    }
+    return -1;
+}
+
+bool hasImage(int slot) {
+    return access(slotPath(slot).c_str(), R_OK) == 0;
+}
+
+bool bootable(int slot) {
+    return hasImage(slot) && g_state[slot] != ESP_OTA_IMG_INVALID && g_state[slot] != ESP_OTA_IMG_ABORTED;
+}
+
+// Opened on first use, created erased
+FILE* dataFileLocked() {
+    if (g_dataFile || g_dir.empty()) return g_dataFile;
+    const std::string path = g_dir + "/" + g_data.label + ".bin";
+    g_dataFile = fopen(path.c_str(), "r+b");
+    if (g_dataFile) return g_dataFile;
+    g_dataFile = fopen(path.c_str(), "w+b");
+    if (!g_dataFile) return nullptr;
+    uint8_t erased[SPI_FLASH_SEC_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (uint32_t offset = 0; offset < g_data.size; offset += sizeof(erased)) {
+        fwrite(erased, 1, sizeof(erased), g_dataFile);
+    }
+    fflush(g_dataFile);
+    return g_dataFile;
+}
+
+void saveLocked() {
+    const std::string path = g_dir + "/otadata";
+    const std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) return;
+    fprintf(f, "%d %u %u\n", g_boot, (unsigned)g_state[0], (unsigned)g_state[1]);
+    fclose(f);
+    rename(tmp.c_str(), path.c_str());
+}
+} // namespace
+
+bool nativeSetFlashDir(const char* dir) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_dataFile) fclose(g_dataFile);
+    g_dataFile = nullptr;
+    g_dir = dir;
+    g_running = -1;
+
+    FILE* f = fopen((g_dir + "/otadata").c_str(), "r");
+    if (f) {
+        unsigned s0, s1;
+        if (fscanf(f, "%d %u %u", &g_boot, &s0, &s1) == 3 && g_boot >= 0 && g_boot < SLOTS) {
+            g_state[0] = (esp_ota_img_states_t)s0;
+            g_state[1] = (esp_ota_img_states_t)s1;
+        } else {
+            g_boot = 0;
+        }
+        fclose(f);
+    }
+
+    // The bootloader's choice
+    int slot = g_boot;
+    if (g_state[slot] == ESP_OTA_IMG_PENDING_VERIFY) {
+        fprintf(stderr, "[native] ota_%d was never confirmed, rolling back\n", slot);
+        g_state[slot] = ESP_OTA_IMG_ABORTED;
+    } else if (g_state[slot] == ESP_OTA_IMG_NEW) {
+        g_state[slot] = ESP_OTA_IMG_PENDING_VERIFY;
+    }
+    if (!bootable(slot)) slot = 1 - slot;
+    if (!bootable(slot)) {
+        g_running = -1;
+        return false;
+    }
+    g_running = g_boot = slot;
+    fprintf(stderr, "[native] booting ota_%d\n", slot);
+    saveLocked();
+    return true;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_dir.empty()) return nullptr;
+    const esp_partition_t* all[] = {&g_slots[0], &g_slots[1], &g_data};
+    for (const esp_partition_t* partition : all) {
+        if (partition->type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && partition->subtype != subtype) continue;
+        if (label && strcmp(partition->label, label) != 0) continue;
+        return partition;
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (!dst) return ESP_ERR_INVALID_ARG;
+    if (src_offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    if (partition == &g_data) {
+        FILE* f = dataFileLocked();
+        if (!f || fseek(f, (long)src_offset, SEEK_SET) != 0 || fread(dst, 1, size, f) != size) return ESP_FAIL;
+        return ESP_OK;
+    }
+    const int slot = slotOf(partition);
+    if (slot < 0) return ESP_ERR_INVALID_ARG;
+
+    memset(dst, 0xFF, size);
+    FILE* f = fopen(slotPath(slot).c_str(), "rb");
+    if (!f) return ESP_OK;  // Erased
+    if (fseek(f, (long)src_offset, SEEK_SET) == 0) fread(dst, 1, size, f);
+    fclose(f);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (partition != &g_data || !src) return ESP_ERR_INVALID_ARG;  // App slots go through esp_ota_write
+    if (dst_offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    FILE* f = dataFileLocked();
+    if (!f) return ESP_FAIL;
+
+    // Programming only clears bits
+    uint8_t chunk[256];
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    for (size_t done = 0; done < size;) {
+        const size_t n = size - done < sizeof(chunk) ? size - done : sizeof(chunk);
+        if (fseek(f, (long)(dst_offset + done), SEEK_SET) != 0 || fread(chunk, 1, n, f) != n) return ESP_FAIL;
+        for (size_t i = 0; i < n; i++) chunk[i] &= in[done + i];
+        if (fseek(f, (long)(dst_offset + done), SEEK_SET) != 0 || fwrite(chunk, 1, n, f) != n) return ESP_FAIL;
+        done += n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (partition != &g_data) return ESP_ERR_INVALID_ARG;
+    if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE) return ESP_ERR_INVALID_SIZE;
+    if (offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    FILE* f = dataFileLocked();
+    if (!f || fseek(f, (long)offset, SEEK_SET) != 0) return ESP_FAIL;
+    uint8_t erased[SPI_FLASH_SEC_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (size_t done = 0; done < size; done += sizeof(erased)) {
+        if (fwrite(erased, 1, sizeof(erased), f) != sizeof(erased)) return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+const esp_partition_t* esp_ota_get_running_partition(void) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_running < 0 ? nullptr : &g_slots[g_running];
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_running < 0) return nullptr;
+    const int from = start_from ? slotOf(start_from) : g_running;
+    return from < 0 ? nullptr : &g_slots[1 - from];
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const int slot = slotOf(partition);
+    if (slot < 0 || !out_handle) return ESP_ERR_INVALID_ARG;
+    if (slot == g_running) return ESP_ERR_INVALID_ARG;
+    if (g_image) return ESP_ERR_INVALID_STATE;
+    if (image_size > partition->size) return ESP_ERR_INVALID_SIZE;
+
+    // Erase: the slot is empty until the first write
+    g_image = fopen(slotPath(slot).c_str(), "wb");
+    if (!g_image) return ESP_FAIL;
+    g_imageSlot = slot;
+    g_imageBytes = 0;
+    g_state[slot] = ESP_OTA_IMG_UNDEFINED;
+    saveLocked();
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (handle != 1 || !g_image) return ESP_ERR_INVALID_ARG;
+    if (g_imageBytes + size > g_slots[g_imageSlot].size) return ESP_ERR_INVALID_SIZE;
+    if (fwrite(data, 1, size, g_image) != size) return ESP_FAIL;
+    g_imageBytes += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (handle != 1 || !g_image) return ESP_ERR_INVALID_ARG;
+    const bool ok = fclose(g_image) == 0;
+    g_image = nullptr;
+    // Any bytes pass for an image here; the real check parses the header
+    return ok && g_imageBytes ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (handle != 1 || !g_image) return ESP_ERR_INVALID_ARG;
+    fclose(g_image);
+    g_image = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const int slot = slotOf(partition);
+    if (slot < 0 || !hasImage(slot)) return ESP_ERR_INVALID_ARG;
+    g_boot = slot;
+    if (slot != g_running) g_state[slot] = ESP_OTA_IMG_NEW;
+    saveLocked();
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* ota_state) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const int slot = slotOf(partition);
+    if (slot < 0 || !ota_state) return ESP_ERR_INVALID_ARG;
+    if (g_state[slot] == ESP_OTA_IMG_UNDEFINED) return ESP_ERR_NOT_FOUND;
+    *ota_state = g_state[slot];
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_running < 0) return ESP_ERR_NOT_FOUND;
+    g_state[g_running] = ESP_OTA_IMG_VALID;
+    saveLocked();
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void) {
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_running < 0) return ESP_ERR_NOT_FOUND;
+        const int other = 1 - g_running;
+        if (!hasImage(other) || g_state[other] == ESP_OTA_IMG_INVALID || g_state[other] == ESP_OTA_IMG_ABORTED) {
+            return ESP_FAIL;    // Nothing to roll back to
+        }
+        g_state[g_running] = ESP_OTA_IMG_INVALID;
+        g_boot = other;
+        saveLocked();
+    }
+    fflush(stdout);
+    _exit(0);
+}
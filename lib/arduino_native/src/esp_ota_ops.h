@@ -0,0 +1,52 @@
+#ifndef NATIVE_ESP_OTA_OPS_H
+#define NATIVE_ESP_OTA_OPS_H
+
+/**
+ * @file esp_ota_ops.h
+ * @brief OTA slots on the host, backed by files
+ *
+ * With --flash <dir> (NATIVE_FLASH_DIR) the slots are <dir>/ota_0.bin
+ * and <dir>/ota_1.bin and <dir>/otadata keeps the boot slot and the
+ * image states. The program stands in for whatever image the running
+ * slot holds, and nativeSetFlashDir() plays the bootloader with app
+ * rollback: a NEW image boots as PENDING_VERIFY, and one still
+ * PENDING_VERIFY at the next boot (never confirmed) is ABORTED in favour
+ * of the other slot. Restarts end the program; run it again to boot.
+ * Without a flash directory there is no running partition.
+ */
+
+#include "esp_partition.h"
+
+#ifndef NATIVE_OTA_SLOT_SIZE
+#define NATIVE_OTA_SLOT_SIZE 0x140000   // app0/app1 of the default partition table
+#endif
+
+typedef uint32_t esp_ota_handle_t;
+
+typedef enum {
+    ESP_OTA_IMG_NEW = 0x0U,
+    ESP_OTA_IMG_PENDING_VERIFY = 0x1U,
+    ESP_OTA_IMG_VALID = 0x2U,
+    ESP_OTA_IMG_INVALID = 0x3U,
+    ESP_OTA_IMG_ABORTED = 0x4U,
+    ESP_OTA_IMG_UNDEFINED = 0xFFFFFFFFU
+} esp_ota_img_states_t;
+
+/**
+ * Use this directory as flash and boot from it (call before setup())
+ * @return false if neither slot holds an image
+ */
+bool nativeSetFlashDir(const char* dir);
+
+const esp_partition_t* esp_ota_get_running_partition(void);
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from);
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* ota_state);
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void);
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void);
+
+#endif // NATIVE_ESP_OTA_OPS_H
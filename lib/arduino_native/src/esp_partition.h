@@ -0,0 +1,65 @@
+#ifndef NATIVE_ESP_PARTITION_H
+#define NATIVE_ESP_PARTITION_H
+
+/**
+ * @file esp_partition.h
+ * @brief Flash partitions on the host, one file each in the --flash
+ *        directory: the two OTA app slots (see esp_ota_ops.h) and the
+ *        "spiffs" data partition of the default table (spiffs.bin)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_APP_OTA_0 = 0x10,
+    ESP_PARTITION_SUBTYPE_APP_OTA_1 = 0x11,
+    ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+    ESP_PARTITION_SUBTYPE_ANY = 0xff
+} esp_partition_subtype_t;
+
+#ifndef SPI_FLASH_SEC_SIZE
+#define SPI_FLASH_SEC_SIZE 4096
+#endif
+#ifndef NATIVE_DATA_PARTITION_SIZE
+#define NATIVE_DATA_PARTITION_SIZE 0x160000     // spiffs of the default partition table
+#endif
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+/**
+ * @param label nullptr matches any
+ * @return nullptr without a flash directory
+ */
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label);
+
+/**
+ * Bytes past the end of a slot's file read as erased flash (0xFF)
+ */
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size);
+
+/**
+ * Data partition only; clears bits like NOR flash programming
+ */
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size);
+
+/**
+ * Data partition only; whole sectors
+ */
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
+
+#endif // NATIVE_ESP_PARTITION_H
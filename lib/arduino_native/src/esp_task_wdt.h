@@ -0,0 +1,19 @@
+#ifndef NATIVE_ESP_TASK_WDT_H
+#define NATIVE_ESP_TASK_WDT_H
+
+/**
+ * @file esp_task_wdt.h
+ * @brief Task watchdog stubs (the host has no watchdog)
+ */
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef void* TaskHandle_t;
+
+esp_err_t esp_task_wdt_init(uint32_t timeoutSec, bool panic);
+esp_err_t esp_task_wdt_add(TaskHandle_t handle);
+esp_err_t esp_task_wdt_delete(TaskHandle_t handle);
+esp_err_t esp_task_wdt_reset();
+
+#endif // NATIVE_ESP_TASK_WDT_H
@@ -0,0 +1,90 @@
+#include "native_clock.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace {
+std::atomic<bool> g_virtual{false};
+std::atomic<uint64_t> g_virtualMicros{0};
+const auto g_start = std::chrono::steady_clock::now();
+
+// Virtual-time scheduling: the clock jumps to the earliest wakeup once
+// every attached thread is asleep
+std::mutex g_mutex;
+std::condition_variable g_wake;
+std::multiset<uint64_t> g_wakeups;
+int g_attached = 1;  // the main thread
+int g_sleeping = 0;
+
+// Release every sleeper whose wakeup has passed (caller holds g_mutex)
+void wakeDue() {
+    while (!g_wakeups.empty() && *g_wakeups.begin() <= g_virtualMicros) {
+        g_wakeups.erase(g_wakeups.begin());
+        g_sleeping--;
+    }
+    g_wake.notify_all();
+}
+
+void advanceIfIdle() {
+    if (g_sleeping < g_attached || g_wakeups.empty()) return;
+    const uint64_t next = *g_wakeups.begin();
+    if (next > g_virtualMicros) g_virtualMicros = next;
+    wakeDue();
+}
+}
+
+namespace NativeClock {
+
+void setVirtual(bool enabled) {
+    if (enabled && !g_virtual) g_virtualMicros = nowMicros();
+    g_virtual = enabled;
+}
+
+bool isVirtual() {
+    return g_virtual;
+}
+
+uint64_t nowMicros() {
+    if (g_virtual) return g_virtualMicros;
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - g_start).count();
+}
+
+void advance(uint64_t micros) {
+    if (!g_virtual) return;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_virtualMicros += micros;
+    wakeDue();
+}
+
+void sleepMicros(uint64_t micros) {
+    if (!g_virtual) {
+        if (micros > 0) std::this_thread::sleep_for(std::chrono::microseconds(micros));
+        return;
+    }
+
+    if (micros == 0) return;
+
+    std::unique_lock<std::mutex> lock(g_mutex);
+    const uint64_t target = g_virtualMicros + micros;
+    g_wakeups.insert(target);
+    g_sleeping++;
+    advanceIfIdle();
+    g_wake.wait(lock, [target] { return g_virtualMicros >= target; });
+}
+
+void attachThread() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_attached++;
+}
+
+void detachThread() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_attached--;
+    advanceIfIdle();
+}
+
+} // namespace NativeClock
@@ -0,0 +1,48 @@
+#ifndef NATIVE_CLOCK_H
+#define NATIVE_CLOCK_H
+
+/**
+ * @file native_clock.h
+ * @brief Host clock backing millis()/micros()/delay()
+ *
+ * Real mode follows the monotonic clock. Virtual mode only moves when
+ * the firmware sleeps (delay/yield) or a harness calls advance(), so
+ * timeouts and send intervals run instantly and deterministically.
+ *
+ * With several threads, virtual time moves to the earliest pending
+ * wakeup once every attached thread is sleeping. Threads blocked on
+ * anything else (sockets, mutexes) hold the clock still.
+ */
+
+#include <stdint.h>
+
+namespace NativeClock {
+
+void setVirtual(bool enabled);
+bool isVirtual();
+
+/**
+ * Microseconds since start
+ */
+uint64_t nowMicros();
+
+/**
+ * Advance virtual time (no-op in real mode)
+ */
+void advance(uint64_t micros);
+
+/**
+ * Sleep: advances virtual time, or really sleeps in real mode
+ */
+void sleepMicros(uint64_t micros);
+
+/**
+ * Register/unregister a thread that sleeps on virtual time; the main
+ * thread is attached from the start
+ */
+void attachThread();
+void detachThread();
+
+} // namespace NativeClock
+
+#endif // NATIVE_CLOCK_H
@@ -0,0 +1,80 @@
+/**
+ * @file native_main.cpp
+ * @brief Host entry point: runs setup()/loop() like the Arduino core
+ *
+ * Options (also settable via environment variables):
+ *   --nmea <file>       NMEA capture replayed on Serial2 (NATIVE_NMEA_FILE)
+ *   --uart-baud <baud>  Replay pacing override (NATIVE_UART_BAUD)
+ *   --virtual-clock     Run under the virtual clock (NATIVE_VIRTUAL_CLOCK=1)
+ *   --duration <sec>    Stop after this much (virtual or real) time
+ *   --pin <n>=<level>   Initial input level, e.g. a power-sense line
+ *   --nvs <file>        Persist Preferences (NVS) in this file (NATIVE_NVS_FILE)
+ *   --flash <dir>       OTA slots, otadata and data partition in this directory
+ *                       (NATIVE_FLASH_DIR)
+ *   --eth-latency <ms>  Extra connect latency on Ethernet (same for --wifi-latency)
+ *   --eth-down <s>:<n>  Ethernet unreachable n seconds from s, address kept
+ *                       (same for --wifi-down)
+ *
+ * Harnesses that provide their own main() build with NATIVE_NO_MAIN.
+ */
+
+#ifndef NATIVE_NO_MAIN
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <esp_ota_ops.h>
+
+static void parseOutage(const char* arg, NativePath& path) {
+    unsigned start = 0, seconds = 0;
+    if (sscanf(arg, "%u:%u", &start, &seconds) != 2) return;
+    path.downFromMs = start * 1000;
+    path.downUntilMs = (start + seconds) * 1000;
+}
+
+int main(int argc, char** argv) {
+    const char* nmeaFile = getenv("NATIVE_NMEA_FILE");
+    uint32_t uartBaud = getenv("NATIVE_UART_BAUD") ? atoi(getenv("NATIVE_UART_BAUD")) : 0;
+    bool virtualClock = getenv("NATIVE_VIRTUAL_CLOCK") && atoi(getenv("NATIVE_VIRTUAL_CLOCK"));
+    const char* nvsFile = getenv("NATIVE_NVS_FILE");
+    const char* flashDir = getenv("NATIVE_FLASH_DIR");
+    uint32_t durationSec = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--nmea") && i + 1 < argc) nmeaFile = argv[++i];
+        else if (!strcmp(argv[i], "--uart-baud") && i + 1 < argc) uartBaud = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--virtual-clock")) virtualClock = true;
+        else if (!strcmp(argv[i], "--duration") && i + 1 < argc) durationSec = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--nvs") && i + 1 < argc) nvsFile = argv[++i];
+        else if (!strcmp(argv[i], "--flash") && i + 1 < argc) flashDir = argv[++i];
+        else if (!strcmp(argv[i], "--eth-latency") && i + 1 < argc) Ethernet.path.latencyMs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--wifi-latency") && i + 1 < argc) WiFi.path.latencyMs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--eth-down") && i + 1 < argc) parseOutage(argv[++i], Ethernet.path);
+        else if (!strcmp(argv[i], "--wifi-down") && i + 1 < argc) parseOutage(argv[++i], WiFi.path);
+        else if (!strcmp(argv[i], "--pin") && i + 1 < argc) {
+            unsigned pin = 0, level = 0;
+            if (sscanf(argv[++i], "%u=%u", &pin, &level) == 2) digitalWrite(pin, level ? HIGH : LOW);
+        }
+    }
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    NativeClock::setVirtual(virtualClock);
+    if (nmeaFile && !Serial2.setReplayFile(nmeaFile, uartBaud)) {
+        fprintf(stderr, "[native] cannot open NMEA file %s\n", nmeaFile);
+        return 1;
+    }
+
+    if (nvsFile) nativeSetNvsFile(nvsFile);
+    if (flashDir && !nativeSetFlashDir(flashDir)) {
+        fprintf(stderr, "[native] no app image in %s (ota_0.bin or ota_1.bin), OTA off\n", flashDir);
+    }
+
+    setup();
+    while (durationSec == 0 || millis() < durationSec * 1000UL) {
+        loop();
+    }
+    return 0;
+}
+
+#endif // NATIVE_NO_MAIN
@@ -0,0 +1,336 @@
+/**
+ * @file native_socket.cpp
+ * @brief POSIX socket backing for Client/Server, Ethernet and WiFi shims
+ */
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <WiFi.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ============================================
+// Helpers
+// ============================================
+bool nativeResolve(const char* host, IPAddress& result) {
+    if (result.fromString(host)) return true;
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* info = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &info) != 0 || !info) return false;
+
+    const struct sockaddr_in* addr = (const struct sockaddr_in*)info->ai_addr;
+    result = IPAddress((uint32_t)addr->sin_addr.s_addr);
+    freeaddrinfo(info);
+    return true;
+}
+
+uint16_t nativeListenPort(uint16_t port) {
+    if (port >= 1024 || geteuid() == 0) return port;
+    const char* offset = getenv("NATIVE_PORT_OFFSET");
+    return port + (offset ? atoi(offset) : 8000);
+}
+
+static void setNonBlocking(int fd, bool enabled) {
+    const int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+}
+
+// ============================================
+// NativeSocketClient
+// ============================================
+NativeSocketClient::State::~State() {
+    if (fd >= 0) ::close(fd);
+}
+
+NativeSocketClient::NativeSocketClient(int fd) : _state(std::make_shared<State>()) {
+    _state->fd = fd;
+    setNonBlocking(fd, true);
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+int NativeSocketClient::connect(const char* host, uint16_t port) {
+    IPAddress ip;
+    if (!nativeResolve(host, ip)) return 0;
+    return connect(ip, port);
+}
+
+int NativeSocketClient::connect(IPAddress ip, uint16_t port) {
+    stop();
+
+    if (const NativePath* path = simulatedPath()) {
+        if (!path->reachable(millis())) {
+            delay(_connectTimeoutMs);   // SYN never answered
+            return 0;
+        }
+        delay(path->latencyMs);
+    }
+
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = (uint32_t)ip;
+
+    setNonBlocking(fd, true);
+    int rc = ::connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+    if (rc < 0 && errno == EINPROGRESS) {
+        // Wait in small slices so the virtual clock keeps moving
+        const unsigned long start = millis();
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        while ((rc = poll(&pfd, 1, 1)) == 0 && millis() - start < _connectTimeoutMs) {
+            yield();
+        }
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (rc > 0) getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        rc = (rc > 0 && err == 0) ? 0 : -1;
+    }
+    if (rc < 0) {
+        ::close(fd);
+        return 0;
+    }
+
+    if (!_state) _state = std::make_shared<State>();
+    _state->fd = fd;
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return 1;
+}
+
+bool NativeSocketClient::fill() {
+    if (!_state || _state->fd < 0) return false;
+    if (_state->rxPos < _state->rxLen) return true;
+    if (_state->peerClosed) return false;
+
+    const ssize_t n = ::recv(_state->fd, _state->rx, sizeof(_state->rx), MSG_DONTWAIT);
+    if (n > 0) {
+        _state->rxLen = n;
+        _state->rxPos = 0;
+        return true;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        _state->peerClosed = true;
+    }
+    return false;
+}
+
+size_t NativeSocketClient::write(const uint8_t* buffer, size_t size) {
+    if (!_state || _state->fd < 0) return 0;
+    size_t sent = 0;
+    while (sent < size) {
+        const ssize_t n = ::send(_state->fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd = {_state->fd, POLLOUT, 0};
+            poll(&pfd, 1, 10);
+        } else {
+            break;
+        }
+    }
+    return sent;
+}
+
+int NativeSocketClient::available() {
+    if (!fill()) return 0;
+    return (int)(_state->rxLen - _state->rxPos);
+}
+
+int NativeSocketClient::availableForWrite() {
+    if (!_state || _state->fd < 0) return 0;
+    // Unsent/unacknowledged bytes against the W5500's default 2 KB of
+    // TX memory per socket, so slow readers back up as on the board
+    static constexpr int TX_BUFFER = 2048;
+    int queued = 0;
+    if (ioctl(_state->fd, SIOCOUTQ, &queued) < 0) return 0;
+    return queued < TX_BUFFER ? TX_BUFFER - queued : 0;
+}
+
+int NativeSocketClient::read() {
+    if (!fill()) return -1;
+    return _state->rx[_state->rxPos++];
+}
+
+int NativeSocketClient::read(uint8_t* buffer, size_t size) {
+    if (!fill()) return -1;
+    const size_t n = min(size, _state->rxLen - _state->rxPos);
+    memcpy(buffer, _state->rx + _state->rxPos, n);
+    _state->rxPos += n;
+    return (int)n;
+}
+
+int NativeSocketClient::peek() {
+    if (!fill()) return -1;
+    return _state->rx[_state->rxPos];
+}
+
+void NativeSocketClient::stop() {
+    if (_state && _state->fd >= 0) {
+        // The W5500 gives a disconnect a second and then drops the socket;
+        // a FIN stuck behind unread data would never get there, so reset
+        int queued = 0;
+        if (ioctl(_state->fd, SIOCOUTQ, &queued) == 0 && queued > 0) {
+            const linger abort = {1, 0};
+            setsockopt(_state->fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+        }
+        ::close(_state->fd);
+        _state->fd = -1;
+    }
+    if (_state && _state.use_count() == 1) {
+        // Not shared with a copy: kept for the next connect, which then
+        // allocates nothing (as a hardware socket)
+        _state->rxLen = _state->rxPos = 0;
+        _state->peerClosed = false;
+    } else {
+        _state.reset();
+    }
+}
+
+uint8_t NativeSocketClient::connected() {
+    if (!_state || _state->fd < 0) return 0;
+    fill();
+    return (_state->rxPos < _state->rxLen || !_state->peerClosed) ? 1 : 0;
+}
+
+// ============================================
+// Connection-pending watcher
+// ============================================
+namespace {
+// Leaked on purpose: the detached watcher may outlive static destructors
+std::mutex& listenMutex() { static auto* m = new std::mutex; return *m; }
+std::vector<int>& listenFds() { static auto* v = new std::vector<int>; return *v; }
+std::atomic<void (*)()> g_pendingCallback{nullptr};
+
+void watchListeners() {
+    for (;;) {
+        std::vector<struct pollfd> fds;
+        {
+            std::lock_guard<std::mutex> lock(listenMutex());
+            for (int fd : listenFds()) fds.push_back({fd, POLLIN, 0});
+        }
+        if (fds.empty() || poll(fds.data(), fds.size(), 50) <= 0) {
+            if (fds.empty()) usleep(50000);
+            continue;
+        }
+        if (auto callback = g_pendingCallback.load()) callback();
+
+        // Like an interrupt line: stay quiet until the firmware accepted
+        // (or 100 ms passed), then report again
+        for (int i = 0; i < 100 && poll(fds.data(), fds.size(), 0) > 0; i++) {
+            usleep(1000);
+        }
+    }
+}
+
+void watchListen(int fd, bool add) {
+    std::lock_guard<std::mutex> lock(listenMutex());
+    std::vector<int>& fds = listenFds();
+    if (add) fds.push_back(fd);
+    else fds.erase(std::remove(fds.begin(), fds.end(), fd), fds.end());
+}
+}
+
+void nativeOnConnectionPending(void (*callback)()) {
+    static std::once_flag started;
+    g_pendingCallback = callback;
+    std::call_once(started, [] { std::thread(watchListeners).detach(); });
+}
+
+// ============================================
+// NativeSocketServer
+// ============================================
+NativeSocketServer::~NativeSocketServer() {
+    if (_fd >= 0) {
+        watchListen(_fd, false);
+        ::close(_fd);
+    }
+}
+
+void NativeSocketServer::begin(uint16_t port) {
+    if (port) _port = port;
+    if (_fd >= 0) {
+        watchListen(_fd, false);
+        ::close(_fd);
+    }
+
+    _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (_fd < 0) return;
+    const int one = 1;
+    setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // The Ethernet and WiFi servers share a port, like two interfaces
+    setsockopt(_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(nativeListenPort(_port));
+    if (::bind(_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(_fd, 16) < 0) {
+        fprintf(stderr, "[native] cannot listen on port %u: %s\n",
+                nativeListenPort(_port), strerror(errno));
+        ::close(_fd);
+        _fd = -1;
+        return;
+    }
+    setNonBlocking(_fd, true);
+    watchListen(_fd, true);
+
+    socklen_t len = sizeof(addr);
+    getsockname(_fd, (struct sockaddr*)&addr, &len);
+    _boundPort = ntohs(addr.sin_port);
+}
+
+NativeSocketClient NativeSocketServer::accept() {
+    if (_fd < 0) return NativeSocketClient();
+    const int fd = ::accept(_fd, nullptr, nullptr);
+    if (fd < 0) return NativeSocketClient();
+    return NativeSocketClient(fd);
+}
+
+// ============================================
+// Ethernet / WiFi / DNS
+// ============================================
+EthernetClass Ethernet;
+WiFiClass WiFi;
+
+int EthernetClass::begin(uint8_t* mac, unsigned long, unsigned long) {
+    memcpy(_mac, mac, 6);
+    if (!_linkUp) return 0;
+    _ip = IPAddress(127, 0, 0, 1);
+    return 1;
+}
+
+int DNSClient::getHostByName(const char* host, IPAddress& result, uint16_t) {
+    return nativeResolve(host, result) ? 1 : 0;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char*) {
+    strncpy(_ssid, ssid ? ssid : "", sizeof(_ssid) - 1);
+    _status = WL_CONNECTED;
+    return _status;
+}
+
+uint8_t* WiFiClass::macAddress(uint8_t* mac) {
+    const uint8_t fixed[6] = {0x24, 0x0A, 0xC4, 0xA1, 0xB2, 0xC3};
+    memcpy(mac, fixed, 6);
+    return mac;
+}
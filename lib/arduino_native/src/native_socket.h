@@ -0,0 +1,108 @@
+#ifndef NATIVE_SOCKET_H
+#define NATIVE_SOCKET_H
+
+/**
+ * @file native_socket.h
+ * @brief Client/Server implementations backed by host TCP sockets
+ *
+ * EthernetClient/WiFiClient and their servers all map onto these, so
+ * the firmware talks to real localhost services on a dev box.
+ * Listening ports below 1024 are shifted by NATIVE_PORT_OFFSET (default
+ * 8000) unless running as root, e.g. the web server on 80 -> 8080.
+ */
+
+#include <memory>
+#include "Client.h"
+#include "Server.h"
+
+/**
+ * Simulated path behind one interface: extra connect latency and an
+ * outage window in which the address stays but connects time out, like
+ * a dead switch or uplink
+ */
+struct NativePath {
+    uint32_t latencyMs = 0;
+    uint32_t downFromMs = 0;
+    uint32_t downUntilMs = 0;   // Equal to downFromMs: never down
+
+    bool reachable(uint32_t nowMs) const { return nowMs < downFromMs || nowMs >= downUntilMs; }
+};
+
+class NativeSocketClient : public Client {
+public:
+    NativeSocketClient() {}
+    explicit NativeSocketClient(int fd);
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int availableForWrite() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return _state && _state->fd >= 0; }
+
+    void setConnectionTimeout(uint32_t timeoutMs) { _connectTimeoutMs = timeoutMs; }
+    int fd() const { return _state ? _state->fd : -1; }
+
+protected:
+    virtual const NativePath* simulatedPath() const { return nullptr; }
+
+private:
+    // Shared between copies, like a hardware socket index
+    struct State {
+        int fd = -1;
+        uint8_t rx[1460];
+        size_t rxLen = 0;
+        size_t rxPos = 0;
+        bool peerClosed = false;
+        ~State();
+    };
+    std::shared_ptr<State> _state;
+    uint32_t _connectTimeoutMs = 5000;
+
+    bool fill();
+};
+
+class NativeSocketServer : public Server {
+public:
+    explicit NativeSocketServer(uint16_t port) : _port(port) {}
+    ~NativeSocketServer();
+
+    void begin(uint16_t port = 0) override;
+    NativeSocketClient accept();
+    NativeSocketClient available() { return accept(); }
+    size_t write(uint8_t) override { return 0; }
+    using Print::write;
+
+    uint16_t boundPort() const { return _boundPort; }
+
+private:
+    uint16_t _port;
+    uint16_t _boundPort = 0;
+    int _fd = -1;
+};
+
+/**
+ * Call callback (from a watcher thread) whenever a listening socket has
+ * a connection waiting to be accepted; stands in for the W5500 INTn line
+ */
+void nativeOnConnectionPending(void (*callback)());
+
+/**
+ * Resolve hostname to IPv4
+ */
+bool nativeResolve(const char* host, IPAddress& result);
+
+/**
+ * Effective host port for a firmware listening port
+ */
+uint16_t nativeListenPort(uint16_t port);
+
+#endif // NATIVE_SOCKET_H
@@ -0,0 +1,641 @@
+/**
+ * @file w5500_sim.cpp
+ * @brief Register-level W5500 simulator and the SPI master shim in front of it
+ */
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <driver/spi_master.h>
+#include <w5500_sim.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Common registers
+constexpr uint16_t MR = 0x00, SIR = 0x17, SIMR = 0x18, RTR = 0x19, RCR = 0x1B;
+constexpr uint16_t PHYCFGR = 0x2E, VERSIONR = 0x39;
+
+// Socket registers
+constexpr uint16_t Sn_MR = 0x00, Sn_CR = 0x01, Sn_IR = 0x02, Sn_SR = 0x03, Sn_PORT = 0x04;
+constexpr uint16_t Sn_DIPR = 0x0C, Sn_DPORT = 0x10, Sn_RXBUF_SIZE = 0x1E, Sn_TXBUF_SIZE = 0x1F;
+constexpr uint16_t Sn_TX_FSR = 0x20, Sn_TX_RD = 0x22, Sn_TX_WR = 0x24, Sn_RX_RSR = 0x26;
+constexpr uint16_t Sn_RX_RD = 0x28, Sn_RX_WR = 0x2A, Sn_IMR = 0x2C;
+
+constexpr uint8_t IR_CON = 0x01, IR_DISCON = 0x02, IR_RECV = 0x04, IR_TIMEOUT = 0x08, IR_SENDOK = 0x10;
+
+constexpr uint8_t SR_CLOSED = 0x00, SR_INIT = 0x13, SR_LISTEN = 0x14, SR_SYNSENT = 0x15;
+constexpr uint8_t SR_ESTABLISHED = 0x17, SR_FIN_WAIT = 0x18, SR_CLOSE_WAIT = 0x1C, SR_UDP = 0x22;
+
+constexpr uint8_t CR_OPEN = 0x01, CR_LISTEN = 0x02, CR_CONNECT = 0x04, CR_DISCON = 0x08;
+constexpr uint8_t CR_CLOSE = 0x10, CR_SEND = 0x20, CR_RECV = 0x40;
+
+constexpr int SOCKETS = 8;
+constexpr size_t MEMORY = 16384;    // Per direction, shared by the sockets
+
+struct Socket {
+    uint8_t reg[0x30] = {};
+    uint8_t tx[MEMORY];
+    uint8_t rx[MEMORY];
+    int fd = -1;
+    uint16_t sendEnd = 0;       // Sn_TX_WR at the last SEND
+    uint16_t rxWr = 0;
+    uint16_t rxCommitted = 0;   // Sn_RX_RD at the last RECV
+    uint32_t connectAtMs = 0;   // After the simulated path latency
+    uint32_t timeoutAtMs = 0;
+    bool unreachable = false;   // SYN goes nowhere: TIMEOUT
+
+    uint16_t get16(uint16_t a) const { return (uint16_t)(reg[a] << 8 | reg[a + 1]); }
+    void set16(uint16_t a, uint16_t v) { reg[a] = (uint8_t)(v >> 8); reg[a + 1] = (uint8_t)v; }
+    size_t txSize() const { return reg[Sn_TXBUF_SIZE] * 1024u; }
+    size_t rxSize() const { return reg[Sn_RXBUF_SIZE] * 1024u; }
+    uint8_t status() const { return reg[Sn_SR]; }
+};
+
+struct Chip {
+    uint8_t common[0x40] = {};
+    Socket sockets[SOCKETS];
+    std::map<uint16_t, int> listeners;  // Host listener per port, kept open
+    bool low = false;                   // INTn asserted
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    bool reset = false;
+};
+
+// Leaked on purpose: the detached watcher may outlive static destructors
+std::mutex& chipMutex() { static auto* m = new std::mutex; return *m; }
+Chip& chip() { static auto* c = new Chip; return *c; }
+std::atomic<void (*)()> g_isr{nullptr};
+
+void setNonBlocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK); }
+
+void noDelay(int fd) {
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+void closeHost(Socket& k) {
+    if (k.fd >= 0) ::close(k.fd);
+    k.fd = -1;
+}
+
+void drop(Socket& k, uint8_t events) {
+    closeHost(k);
+    k.reg[Sn_SR] = SR_CLOSED;
+    k.reg[Sn_IR] |= events;
+}
+
+void resetChip(Chip& c) {
+    for (Socket& k : c.sockets) {
+        closeHost(k);
+        memset(k.reg, 0, sizeof(k.reg));
+        k.reg[Sn_RXBUF_SIZE] = 2;
+        k.reg[Sn_TXBUF_SIZE] = 2;
+        k.reg[Sn_IMR] = 0xFF;
+        k.set16(Sn_TX_FSR, 2048);
+        k.sendEnd = k.rxWr = k.rxCommitted = 0;
+    }
+    memset(c.common, 0, sizeof(c.common));
+    c.common[RTR] = 0x07;   // 200 ms
+    c.common[RTR + 1] = 0xD0;
+    c.common[RCR] = 8;
+    c.common[VERSIONR] = 0x04;
+    c.reset = true;
+}
+
+// Retransmissions before TIMEOUT (RTR in 100 us, RCR + 1 tries)
+uint32_t retryMs(const Chip& c) {
+    const uint32_t rtr = (uint32_t)(c.common[RTR] << 8 | c.common[RTR + 1]);
+    return rtr * (c.common[RCR] + 1u) / 10;
+}
+
+int listener(Chip& c, uint16_t port) {
+    auto it = c.listeners.find(port);
+    if (it != c.listeners.end()) return it->second;
+
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));    // Shared with a WiFi server
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(nativeListenPort(port));
+    if (::bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 16) < 0) {
+        fprintf(stderr, "[w5500] cannot listen on port %u: %s\n", nativeListenPort(port), strerror(errno));
+        ::close(fd);
+        return -1;
+    }
+    setNonBlocking(fd);
+    c.listeners[port] = fd;
+    return fd;
+}
+
+// ============================================
+// UDP services: DHCP and DNS
+// ============================================
+void deliver(Socket& k, const uint8_t from[4], uint16_t fromPort, const uint8_t* data, size_t len) {
+    const size_t size = k.rxSize();
+    if (!size || size - (uint16_t)(k.rxWr - k.rxCommitted) < len + 8) return;     // Dropped, as on the chip
+    const uint8_t header[8] = {from[0], from[1], from[2], from[3], (uint8_t)(fromPort >> 8), (uint8_t)fromPort,
+                               (uint8_t)(len >> 8), (uint8_t)len};
+    for (size_t i = 0; i < 8; i++) k.rx[(uint16_t)(k.rxWr + i) & (size - 1)] = header[i];
+    k.rxWr += 8;
+    for (size_t i = 0; i < len; i++) k.rx[(uint16_t)(k.rxWr + i) & (size - 1)] = data[i];
+    k.rxWr += len;
+    k.reg[Sn_IR] |= IR_RECV;
+}
+
+void answerDhcp(Socket& k, const uint8_t* q, size_t len) {
+    if (len < 240 || q[0] != 1) return;
+    uint8_t type = 0;
+    for (size_t pos = 240; pos + 2 <= len && q[pos] != 255;) {
+        if (q[pos] == 0) { pos++; continue; }
+        if (q[pos] == 53) type = q[pos + 2];
+        pos += 2 + q[pos + 1];
+    }
+    const uint8_t reply = type == 1 ? 2 : type == 3 ? 5 : 0;     // DISCOVER -> OFFER, REQUEST -> ACK
+    if (!reply) return;
+
+    uint8_t r[300] = {};
+    r[0] = 2;
+    r[1] = 1;
+    r[2] = 6;
+    memcpy(r + 4, q + 4, 4);    // xid
+    memcpy(r + 10, q + 10, 2);  // flags
+    const uint8_t lease[4] = {127, 0, 0, 1};
+    memcpy(r + 16, lease, 4);   // yiaddr
+    memcpy(r + 20, lease, 4);   // siaddr
+    memcpy(r + 28, q + 28, 16); // chaddr
+    r[236] = 99; r[237] = 130; r[238] = 83; r[239] = 99;
+    const uint8_t options[] = {
+        53, 1, reply,
+        54, 4, 127, 0, 0, 1,
+        51, 4, 0, 0, 0x0E, 0x10,    // 3600 s
+        1, 4, 255, 0, 0, 0,
+        3, 4, 127, 0, 0, 1,
+        6, 4, 127, 0, 0, 53,
+        255
+    };
+    memcpy(r + 240, options, sizeof(options));
+    deliver(k, lease, 67, r, 240 + sizeof(options));
+}
+
+void answerDns(Socket& k, const uint8_t server[4], const uint8_t* q, size_t len) {
+    if (len < 12) return;
+    std::string name;
+    size_t pos = 12;
+    while (pos < len && q[pos]) {
+        const size_t label = q[pos];
+        if (pos + 1 + label > len) return;
+        if (!name.empty()) name += '.';
+        name.append((const char*)q + pos + 1, label);
+        pos += 1 + label;
+    }
+    pos += 5;   // Root, type, class
+    if (pos > len) return;
+
+    IPAddress ip;
+    const bool found = nativeResolve(name.c_str(), ip);
+    uint8_t r[600];
+    if (pos + 16 > sizeof(r)) return;
+    memcpy(r, q, pos);
+    r[2] = 0x81;
+    r[3] = found ? 0x80 : 0x83;     // NXDOMAIN
+    r[6] = 0;
+    r[7] = found ? 1 : 0;
+    r[8] = r[9] = r[10] = r[11] = 0;
+    if (found) {
+        const uint8_t answer[16] = {0xC0, 0x0C, 0, 1, 0, 1, 0, 0, 0, 60, 0, 4, ip[0], ip[1], ip[2], ip[3]};
+        memcpy(r + pos, answer, sizeof(answer));
+        pos += sizeof(answer);
+    }
+    deliver(k, server, 53, r, pos);
+}
+
+void sendDatagram(Socket& k) {
+    const size_t size = k.txSize();
+    const uint16_t start = k.get16(Sn_TX_RD), end = k.get16(Sn_TX_WR);
+    const size_t len = (uint16_t)(end - start);
+    k.set16(Sn_TX_RD, end);
+    k.sendEnd = end;
+    k.reg[Sn_IR] |= IR_SENDOK;
+    if (!size || len > size || len > 600) return;
+
+    uint8_t data[600];
+    for (size_t i = 0; i < len; i++) data[i] = k.tx[(uint16_t)(start + i) & (size - 1)];
+    if (Ethernet.linkStatus() != LinkON || !Ethernet.path.reachable(millis())) return;
+    const uint16_t port = k.get16(Sn_DPORT);
+    if (port == 67) answerDhcp(k, data, len);
+    else if (port == 53) answerDns(k, k.reg + Sn_DIPR, data, len);
+}
+
+// ============================================
+// TCP
+// ============================================
+void startConnect(Chip& c, Socket& k) {
+    const uint32_t now = millis();
+    k.reg[Sn_SR] = SR_SYNSENT;
+    k.unreachable = Ethernet.linkStatus() != LinkON || !Ethernet.path.reachable(now);
+    k.connectAtMs = now + Ethernet.path.latencyMs;
+    k.timeoutAtMs = now + retryMs(c);
+}
+
+void pumpConnect(Socket& k) {
+    const uint32_t now = millis();
+    if (k.unreachable || (k.fd < 0 && (int32_t)(now - k.connectAtMs) < 0)) {
+        if ((int32_t)(now - k.timeoutAtMs) >= 0) drop(k, IR_TIMEOUT);
+        return;
+    }
+    if (k.fd < 0) {
+        k.fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (k.fd < 0) {
+            drop(k, IR_TIMEOUT);
+            return;
+        }
+        setNonBlocking(k.fd);
+        noDelay(k.fd);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        memcpy(&addr.sin_addr.s_addr, k.reg + Sn_DIPR, 4);
+        addr.sin_port = htons(k.get16(Sn_DPORT));
+        if (::connect(k.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+            drop(k, IR_TIMEOUT);
+            return;
+        }
+        k.timeoutAtMs = now + 5000;
+    }
+    struct pollfd pfd = {k.fd, POLLOUT, 0};
+    if (poll(&pfd, 1, 0) > 0) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(k.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err) drop(k, IR_TIMEOUT);   // Refused: RST
+        else {
+            k.reg[Sn_SR] = SR_ESTABLISHED;
+            k.reg[Sn_IR] |= IR_CON;
+        }
+    } else if ((int32_t)(now - k.timeoutAtMs) >= 0) {
+        drop(k, IR_TIMEOUT);
+    }
+}
+
+void pumpAccept(Chip& c, Socket& k) {
+    const int fd = listener(c, k.get16(Sn_PORT));
+    if (fd < 0) return;
+    const int conn = ::accept(fd, nullptr, nullptr);
+    if (conn < 0) return;
+    setNonBlocking(conn);
+    noDelay(conn);
+    k.fd = conn;
+    k.reg[Sn_SR] = SR_ESTABLISHED;
+    k.reg[Sn_IR] |= IR_CON;
+}
+
+// Sent data leaves the TX buffer only as fast as the peer takes it, so
+// a slow reader backs the socket up as on the chip
+void pumpSend(Socket& k) {
+    const size_t size = k.txSize();
+    uint16_t rd = k.get16(Sn_TX_RD);
+    if (rd == k.sendEnd || !size) return;
+    int queued = 0;
+    if (ioctl(k.fd, SIOCOUTQ, &queued) < 0 || (size_t)queued >= size) return;
+    while (rd != k.sendEnd) {
+        const size_t at = rd & (size - 1);
+        const size_t n = std::min((size_t)(uint16_t)(k.sendEnd - rd), size - at);
+        const ssize_t sent = ::send(k.fd, k.tx + at, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent <= 0) {
+            if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) drop(k, IR_DISCON);
+            break;
+        }
+        rd += sent;
+    }
+    k.set16(Sn_TX_RD, rd);
+    if (rd == k.sendEnd) k.reg[Sn_IR] |= IR_SENDOK;
+}
+
+void pumpReceive(Socket& k) {
+    const size_t size = k.rxSize();
+    if (!size) return;
+    const size_t space = size - (uint16_t)(k.rxWr - k.rxCommitted);
+    if (space == 0) return;
+    const size_t at = k.rxWr & (size - 1);
+    const ssize_t n = ::recv(k.fd, k.rx + at, std::min(space, size - at), MSG_DONTWAIT);
+    if (n > 0) {
+        k.rxWr += n;
+        k.reg[Sn_IR] |= IR_RECV;
+    } else if (n == 0) {
+        if (k.status() == SR_FIN_WAIT) drop(k, IR_DISCON);
+        else {
+            k.reg[Sn_SR] = SR_CLOSE_WAIT;
+            k.reg[Sn_IR] |= IR_DISCON;
+        }
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        drop(k, IR_DISCON | IR_TIMEOUT);
+    }
+}
+
+void pump(Chip& c) {
+    for (Socket& k : c.sockets) {
+        switch (k.status()) {
+            case SR_SYNSENT:
+                pumpConnect(k);
+                break;
+            case SR_LISTEN:
+                pumpAccept(c, k);
+                break;
+            case SR_ESTABLISHED:
+            case SR_FIN_WAIT:
+                pumpSend(k);
+                if (k.fd >= 0) pumpReceive(k);
+                break;
+            case SR_CLOSE_WAIT:
+                pumpSend(k);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// ============================================
+// Registers
+// ============================================
+void command(Chip& c, int s, uint8_t cmd) {
+    Socket& k = c.sockets[s];
+    switch (cmd) {
+        case CR_OPEN: {
+            closeHost(k);
+            unsigned tx = 0, rx = 0;
+            for (const Socket& other : c.sockets) {
+                tx += other.reg[Sn_TXBUF_SIZE];
+                rx += other.reg[Sn_RXBUF_SIZE];
+            }
+            const uint8_t protocol = k.reg[Sn_MR] & 0x0F;
+            if (tx > 16 || rx > 16) {
+                fprintf(stderr, "[w5500] socket %d: buffers total %u KB TX, %u KB RX (16 KB each)\n", s, tx, rx);
+                k.reg[Sn_SR] = SR_CLOSED;
+            } else {
+                k.reg[Sn_SR] = protocol == 1 ? SR_INIT : protocol == 2 ? SR_UDP : SR_CLOSED;
+            }
+            k.set16(Sn_TX_RD, k.get16(Sn_TX_WR));
+            k.sendEnd = k.get16(Sn_TX_WR);
+            k.rxWr = k.rxCommitted = k.get16(Sn_RX_RD);
+            break;
+        }
+        case CR_LISTEN:
+            if (k.status() == SR_INIT) {
+                k.reg[Sn_SR] = SR_LISTEN;
+                listener(c, k.get16(Sn_PORT));
+            }
+            break;
+        case CR_CONNECT:
+            if (k.status() == SR_INIT) startConnect(c, k);
+            break;
+        case CR_DISCON:
+            if (k.status() == SR_ESTABLISHED && k.fd >= 0) {
+                pumpSend(k);
+                shutdown(k.fd, SHUT_WR);
+                k.reg[Sn_SR] = SR_FIN_WAIT;
+            } else if (k.status() == SR_CLOSE_WAIT) {
+                pumpSend(k);
+                drop(k, IR_DISCON);
+            } else {
+                drop(k, 0);
+            }
+            break;
+        case CR_CLOSE:
+            drop(k, 0);
+            break;
+        case CR_SEND:
+            if (k.status() == SR_UDP) sendDatagram(k);
+            else if (k.status() == SR_ESTABLISHED || k.status() == SR_CLOSE_WAIT) {
+                k.sendEnd = k.get16(Sn_TX_WR);
+                pumpSend(k);
+            }
+            break;
+        case CR_RECV:
+            k.rxCommitted = k.get16(Sn_RX_RD);
+            break;
+        default:
+            break;
+    }
+}
+
+uint8_t readCommon(Chip& c, uint16_t a) {
+    if (a == SIR) {
+        uint8_t sir = 0;
+        for (int s = 0; s < SOCKETS; s++) {
+            if (c.sockets[s].reg[Sn_IR] & c.sockets[s].reg[Sn_IMR]) sir |= 1u << s;
+        }
+        return sir;
+    }
+    if (a == PHYCFGR) return (uint8_t)(0xB8 | 0x06 | (Ethernet.linkStatus() == LinkON ? 0x01 : 0));
+    return a < sizeof(c.common) ? c.common[a] : 0;
+}
+
+void writeCommon(Chip& c, uint16_t a, uint8_t v) {
+    if (a == MR && (v & 0x80)) {
+        resetChip(c);
+        return;
+    }
+    if (a == SIR || a == VERSIONR || a >= sizeof(c.common)) return;
+    c.common[a] = v;
+}
+
+uint8_t readSocket(Socket& k, uint16_t a) {
+    if (a >= sizeof(k.reg)) return 0;
+    uint16_t value;
+    switch (a & ~1) {
+        case Sn_TX_FSR: value = (uint16_t)(k.txSize() - (uint16_t)(k.sendEnd - k.get16(Sn_TX_RD))); break;
+        case Sn_RX_RSR: value = (uint16_t)(k.rxWr - k.rxCommitted); break;
+        case Sn_RX_WR: value = k.rxWr; break;
+        default: return k.reg[a];
+    }
+    return (a & 1) ? (uint8_t)value : (uint8_t)(value >> 8);
+}
+
+void writeSocket(Chip& c, int s, uint16_t a, uint8_t v) {
+    Socket& k = c.sockets[s];
+    switch (a) {
+        case Sn_CR: command(c, s, v); break;
+        case Sn_IR: k.reg[Sn_IR] &= ~v; break;
+        case Sn_SR:
+        case Sn_TX_FSR: case Sn_TX_FSR + 1:
+        case Sn_TX_RD: case Sn_TX_RD + 1:
+        case Sn_RX_RSR: case Sn_RX_RSR + 1:
+        case Sn_RX_WR: case Sn_RX_WR + 1:
+            break;  // Read-only
+        default:
+            if (a < sizeof(k.reg)) k.reg[a] = v;
+            break;
+    }
+}
+
+// INTn goes low while any unmasked socket event is pending
+bool updateLine(Chip& c) {
+    bool low = false;
+    for (int s = 0; s < SOCKETS; s++) {
+        const Socket& k = c.sockets[s];
+        if ((c.common[SIMR] & (1u << s)) && (k.reg[Sn_IR] & k.reg[Sn_IMR])) low = true;
+    }
+    const bool edge = low && !c.low;
+    c.low = low;
+    return edge;
+}
+
+void raise(bool edge) {
+    if (!edge) return;
+    if (auto isr = g_isr.load()) isr();
+}
+
+// Moves host data between frames, so events (and INTn) arrive while the
+// firmware waits for them
+void watch() {
+    for (;;) {
+        struct pollfd fds[SOCKETS];     // Fixed: no heap traffic under the alloc counter
+        nfds_t count = 0;
+        {
+            std::lock_guard<std::mutex> lock(chipMutex());
+            Chip& c = chip();
+            for (const Socket& k : c.sockets) {
+                if (k.status() == SR_LISTEN) {
+                    auto it = c.listeners.find(k.get16(Sn_PORT));
+                    if (it != c.listeners.end()) fds[count++] = {it->second, POLLIN, 0};
+                } else if (k.fd >= 0) {
+                    fds[count++] = {k.fd, (short)(POLLIN | (k.status() == SR_SYNSENT ? POLLOUT : 0)), 0};
+                }
+            }
+        }
+        if (count == 0) usleep(2000);
+        else poll(fds, count, 2);
+
+        bool edge;
+        {
+            std::lock_guard<std::mutex> lock(chipMutex());
+            pump(chip());
+            edge = updateLine(chip());
+        }
+        raise(edge);
+    }
+}
+
+} // namespace
+
+// ============================================
+// Simulator entry points
+// ============================================
+void nativeW5500Frame(uint16_t address, uint8_t control, const uint8_t* tx, uint8_t* rx, size_t len) {
+    bool edge;
+    {
+        std::lock_guard<std::mutex> lock(chipMutex());
+        Chip& c = chip();
+        if (!c.reset) resetChip(c);
+        c.frames++;
+        c.bytes += 3 + len;
+        pump(c);
+
+        const uint8_t block = control >> 3;
+        const bool write = control & 0x04;
+        const int s = block ? (block - 1) / 4 : -1;
+        const int kind = block ? (block - 1) % 4 : -1;  // Registers, TX or RX memory
+        for (size_t i = 0; i < len; i++) {
+            const uint16_t a = (uint16_t)(address + i);
+            if (block == 0) {
+                if (write) writeCommon(c, a, tx[i]);
+                else rx[i] = readCommon(c, a);
+            } else if (s < SOCKETS && kind == 0) {
+                if (write) writeSocket(c, s, a, tx[i]);
+                else rx[i] = readSocket(c.sockets[s], a);
+            } else if (s < SOCKETS && kind == 1) {
+                Socket& k = c.sockets[s];
+                if (write && k.txSize()) k.tx[a & (k.txSize() - 1)] = tx[i];
+                else if (!write) rx[i] = k.txSize() ? k.tx[a & (k.txSize() - 1)] : 0;
+            } else if (s < SOCKETS && kind == 2) {
+                Socket& k = c.sockets[s];
+                if (write && k.rxSize()) k.rx[a & (k.rxSize() - 1)] = tx[i];
+                else if (!write) rx[i] = k.rxSize() ? k.rx[a & (k.rxSize() - 1)] : 0;
+            } else if (!write) {
+                rx[i] = 0;
+            }
+        }
+        edge = updateLine(c);
+    }
+    raise(edge);
+}
+
+void nativeW5500OnInterrupt(void (*isr)()) {
+    static std::once_flag started;
+    g_isr = isr;
+    std::call_once(started, [] { std::thread(watch).detach(); });
+}
+
+NativeW5500Stats nativeW5500Stats() {
+    std::lock_guard<std::mutex> lock(chipMutex());
+    return NativeW5500Stats{chip().frames, chip().bytes};
+}
+
+void nativeW5500ResetStats() {
+    std::lock_guard<std::mutex> lock(chipMutex());
+    chip().frames = 0;
+    chip().bytes = 0;
+}
+
+// ============================================
+// driver/spi_master.h
+// ============================================
+struct spi_device_t {
+    int clockHz;
+};
+
+namespace {
+bool g_busReady = false;
+spi_device_t g_device;
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t, const spi_bus_config_t*, spi_dma_chan_t) {
+    if (g_busReady) return ESP_ERR_INVALID_STATE;
+    g_busReady = true;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t, const spi_device_interface_config_t* config,
+                             spi_device_handle_t* handle) {
+    if (!g_busReady) return ESP_ERR_INVALID_STATE;
+    if (config->command_bits != 16 || config->address_bits != 8) return ESP_ERR_INVALID_ARG;    // W5500 framing
+    g_device.clockHz = config->clock_speed_hz;
+    *handle = &g_device;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_acquire_bus(spi_device_handle_t, uint32_t) { return ESP_OK; }
+void spi_device_release_bus(spi_device_handle_t) {}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t* t) {
+    if (!handle || t->length % 8) return ESP_ERR_INVALID_ARG;
+    const size_t len = t->length / 8;
+    const uint8_t* tx = (t->flags & SPI_TRANS_USE_TXDATA) ? t->tx_data : (const uint8_t*)t->tx_buffer;
+    uint8_t* rx = (t->flags & SPI_TRANS_USE_RXDATA) ? t->rx_data : (uint8_t*)t->rx_buffer;
+    const bool write = t->addr & 0x04;
+    if ((write && !tx) || (!write && !rx)) return ESP_ERR_INVALID_ARG;
+    nativeW5500Frame(t->cmd, (uint8_t)t->addr, tx, rx, len);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t* t) {
+    return spi_device_polling_transmit(handle, t);
+}
@@ -0,0 +1,43 @@
+#ifndef NATIVE_W5500_SIM_H
+#define NATIVE_W5500_SIM_H
+
+/**
+ * @file w5500_sim.h
+ * @brief Register-level W5500 on the host, behind driver/spi_master.h
+ *
+ * Common and socket registers, per-socket TX/RX memory as sized in
+ * Sn_TXBUF_SIZE/Sn_RXBUF_SIZE and the socket commands, with host
+ * sockets underneath: CONNECT opens a TCP connection (through
+ * Ethernet.path latency and outages), LISTEN takes connections from a
+ * host listener on nativeListenPort(port), SEND/RECV move bytes between
+ * the buffers and the host. UDP answers DHCP (port 67, a loopback
+ * lease) and DNS (port 53, the host resolver) itself.
+ *
+ * INTn follows SIR and SIMR; a watcher thread moves host data while the
+ * firmware is not clocking frames and calls the interrupt handler on
+ * every falling edge.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * One SPI frame (chip select low to high)
+ * @param control Block select << 3 | write << 2 (variable length mode)
+ */
+void nativeW5500Frame(uint16_t address, uint8_t control, const uint8_t* tx, uint8_t* rx, size_t len);
+
+/**
+ * Call isr on INTn falling edges
+ */
+void nativeW5500OnInterrupt(void (*isr)());
+
+struct NativeW5500Stats {
+    uint64_t frames;
+    uint64_t bytes;     // Header and data
+};
+
+NativeW5500Stats nativeW5500Stats();
+void nativeW5500ResetStats();
+
+#endif // NATIVE_W5500_SIM_H
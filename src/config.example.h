@@ -28,7 +28,35 @@
 // ============================================
 #define SERVER_HOST         "pelni-webhook-send.shoel-dev.workers.dev"
 #define SERVER_PATH         "/"
-#define SERVER_PORT         80
+#define SERVER_PORT         443     // 80 with SERVER_TLS_ENABLE false
+
+// HTTPS (mbedTLS over Ethernet or WiFi, session resumption between reports)
+#define SERVER_TLS_ENABLE   true
+// Base64 SHA-256 of the server's (or its CA's) public key, required with TLS:
+//   openssl s_client -connect HOST:443 -servername HOST </dev/null | openssl x509 -pubkey -noout |
+//   openssl pkey -pubin -outform der | openssl dgst -sha256 -binary | base64
+#define TLS_PIN_SHA256          ""
+#define TLS_PIN_SHA256_BACKUP   ""      // Next key, so the server can rotate
+#define TLS_ALLOW_UNPINNED      false   // true: no pin = encrypted but server not authenticated
+#define TLS_HANDSHAKE_TIMEOUT_MS 10000
+
+// Reports carry a sequence number; the server's X-Ack-Seq settles them
+#define UPLOAD_OUTBOX_CAPACITY  16      // Reports held until acknowledged
+#define UPLOAD_RETRANSMIT_MAX   4       // Unanswered reports sent again per cycle
+#define UPLOAD_SEQ_BLOCK        64      // Sequence numbers reserved per NVS write
+
+// More report destinations besides SERVER_HOST, e.g. a regulator's endpoint
+// (modules/upload_fanout.h): each fix is serialized once per format and sent
+// to all of them at once. HTTPS as SERVER_TLS_ENABLE; on Ethernet every
+// destination needs its own socket (W5500_FANOUT_SOCKETS).
+#define UPLOAD_FANOUT_ENABLE    false
+// {name, host, path, port, TLS pin ("" only with TLS_ALLOW_UNPINNED), FULL or POSITION, least ms between reports}
+#define UPLOAD_DESTINATIONS     { \
+    {"regulator", "vms.example.go.id", "/api/v1/positions", 443, "", ReportFormat::POSITION, 60000}, \
+}
+#define UPLOAD_FANOUT_BACKLOG   4       // Reports kept per destination while it fails (RAM: JSON_BUFFER_SIZE each)
+#define UPLOAD_FANOUT_RETRY_MS  10000   // First retry after a failure, doubled up to the maximum
+#define UPLOAD_FANOUT_RETRY_MAX_MS 300000
 
 // ============================================
 // Timing Configuration (milliseconds)
@@ -38,6 +66,7 @@
 #define GPS_READ_TIMEOUT        2000        // GPS read timeout
 #define HTTP_TIMEOUT            10000       // HTTP request timeout
 #define WATCHDOG_TIMEOUT        60          // Watchdog timeout in seconds
+#define BOOT_REPORT_MAX_WAIT_MS 60000       // First report waits this long for a fix
 
 // ============================================
 // GPS Module (NEO-M8N) Configuration
@@ -46,15 +75,74 @@
 #define GPS_TX_PIN          17      // ESP32 TX -> GPS RX
 #define GPS_BAUD_RATE       9600
 
+// Warm start: last fix kept in NVS and sent as UBX-MGA-INI at boot
+#define GPS_SAVE_INTERVAL_MS    300000  // Check whether to save the fix
+#define GPS_SAVE_MIN_MOVE_M     200     // Save only after moving this far
+#define GPS_AIDING_POS_ACC_M    5000    // Uncertainty sent with the saved position
+
+// ============================================
+// Position Filter (Kalman, between the parser and every consumer)
+// ============================================
+#define POSITION_FILTER_ENABLE  true    // Smooth fixes, reject multipath jumps, bridge dropouts
+#define POSITION_UERE_M         3.0     // Position error per unit of HDOP (1 sigma)
+#define POSITION_SPEED_SIGMA_MPS 0.2    // Doppler velocity error per unit of HDOP
+#define POSITION_ACCEL_MPS2     0.5     // Manoeuvring acceleration (process noise)
+#define POSITION_GATE           13.8    // Chi-square gate for a position (2 dof, 99.9 %)
+#define POSITION_MAX_REJECTS    5       // Consecutive rejects that restart at the new position
+#define POSITION_DR_MS          15000   // Dead reckoning limit, then the fix is reported lost
+
+// ============================================
+// Geofencing (port, anchorage, restricted zones)
+// ============================================
+// Fences come from src/geofence_data.h (tools/geofence/build_fences.py)
+#define GEOFENCE_ENABLE         true    // Evaluate every fix, report transitions at once
+#define GEOFENCE_CONFIRM_FIXES  3       // Consecutive fixes to confirm enter/exit
+#define GEOFENCE_EXIT_MARGIN_M  30      // Distance outside a fence before it counts as left
+#define GEOFENCE_MAX_ACTIVE     16      // Fences tracked at once (inside or entering)
+
+// ============================================
+// Planned Route (corridor check, ETA to next port)
+// ============================================
+// Route and corridor width come from src/route_data.h (tools/route/build_route.py)
+#define ROUTE_ENABLE            true    // Report corridor breaches at once, ETA in every report
+#define ROUTE_CONFIRM_FIXES     3       // Consecutive fixes to confirm breach/return
+#define ROUTE_RETURN_MARGIN_M   20      // Back inside only this far within the corridor
+#define ROUTE_SPEED_TAU_S       120     // Smoothing of the speed used for the ETA
+
+// ============================================
+// Trip Analytics (odometer, stops, speed statistics)
+// ============================================
+#define TRIP_ENABLE             true    // Every fix; trip summary in reports, start/end reported at once
+#define TRIP_STOP_KMH           1.0     // Slower than this ...
+#define TRIP_STOP_CONFIRM_S     120     // ... for this long is a stop
+#define TRIP_MOVE_KMH           3.0     // Faster than this ...
+#define TRIP_MOVE_CONFIRM_S     10      // ... for this long is moving again
+#define TRIP_END_STOP_S         900     // A stop this long ends the trip
+#define TRIP_MAX_SPEED_KMH      150     // Steps implying more are GPS outliers
+#define TRIP_ODOMETER_SAVE_M    1000    // Odometer NVS write granularity
+
 // ============================================
 // W5500 Ethernet Module Configuration
 // ============================================
 #define W5500_CS_PIN        5       // Chip Select
 #define W5500_RST_PIN       4       // Reset
-// SPI Pins (using ESP32 default VSPI)
-// MISO = GPIO 19
-// MOSI = GPIO 23
-// SCK  = GPIO 18
+#define W5500_INT_PIN       -1      // INTn (e.g. 34) wakes the web task; -1 = poll
+#define W5500_DRIVER_ENABLE true    // Own driver (modules/w5500.h); false = Arduino Ethernet library
+#define W5500_SPI_HZ        20000000 // SPI clock (80 MHz / n; the W5500 is rated for 33 MHz)
+// SPI Pins (ESP32 default VSPI)
+#define W5500_MISO_PIN      19
+#define W5500_MOSI_PIN      23
+#define W5500_SCK_PIN       18
+// Socket buffers in KB (0/1/2/4/8/16), 16 KB per direction in total
+#define W5500_UPLOAD_TX_KB  2       // Reports and OTA fetches
+#define W5500_UPLOAD_RX_KB  4       // Patch downloads
+#define W5500_WEB_TX_KB     4       // Per web socket (2), pages and exports
+#define W5500_WEB_RX_KB     2
+#define W5500_STREAM_TX_KB  1       // Per GPS stream socket (clients + listeners)
+#define W5500_STREAM_RX_KB  1
+#define W5500_FANOUT_SOCKETS 0      // One per UPLOAD_DESTINATIONS entry (lower GPSD_MAX_CLIENTS to free them)
+#define W5500_FANOUT_TX_KB  1
+#define W5500_FANOUT_RX_KB  1
 
 // ============================================
 // Status LED Configuration (Optional)
@@ -68,6 +156,15 @@
 #define DEBUG_SERIAL        true    // Enable serial debug output
 #define DEBUG_BAUD_RATE     115200
 
+// Deferred logging (messages in modules/log_messages.h)
+#define LOG_LEVEL           3       // 0=off 1=error 2=warn 3=info 4=debug (compile-time)
+#define LOG_QUEUE_RECORDS   64      // Ring slots, power of two (LOG_RECORD_SIZE bytes each)
+#define LOG_RECORD_SIZE     64      // Bytes per record incl. 12-byte header; longer strings are truncated
+
+// Tracing spans (GET /trace or serial command 't' -> Chrome trace JSON)
+#define TRACE_ENABLE        false   // false = spans compile away entirely
+#define TRACE_BUFFER_EVENTS 256     // Ring size per CPU core (16 bytes/event)
+
 // ============================================
 // Network Configuration
 // ============================================
@@ -77,8 +174,11 @@
 // ============================================
 // Memory Optimization
 // ============================================
-#define JSON_BUFFER_SIZE    384     // JSON document size
-#define HTTP_BUFFER_SIZE    512     // HTTP response buffer
+#define JSON_BUFFER_SIZE    768     // JSON document size
+#define HTTP_BUFFER_SIZE    512     // Web response chunk (coalesced writes)
+#define HTTP_HEADER_SIZE    192     // Upload request headers
+#define CYCLE_ARENA_SIZE    1280    // Static arena for one upload cycle
+#define WEB_ARENA_SIZE      1536    // Static arena for one web request
 
 // ============================================
 // Retry Configuration
@@ -87,11 +187,64 @@
 #define RETRY_DELAY_MS      5000    // Delay between retries
 
 // ============================================
-// Connection Mode (WiFi or Ethernet)
+// Task Configuration (FreeRTOS; core 0 also runs WiFi/lwIP)
+// ============================================
+#define GPS_TASK_CORE       1
+#define GPS_TASK_PRIORITY   3       // Highest: the UART buffer must not overflow
+#define GPS_TASK_STACK      3072
+#define GPS_FIX_MAX_AGE_MS  3000    // Older fixes are reported as no fix
+#define UPLOAD_TASK_CORE    0
+#define UPLOAD_TASK_PRIORITY 1
+#define UPLOAD_TASK_STACK   8192    // Room for the mbedTLS handshake
+#define WEB_TASK_CORE       1
+#define WEB_TASK_PRIORITY   2
+#define WEB_TASK_STACK      6144
+#define WEB_POLL_MS         10      // Accept poll without W5500_INT_PIN (and bus-busy retry)
+
+// ============================================
+// Event Loop Configuration
+// ============================================
+#define TIMER_TICK_MS       10      // Timer wheel resolution
+#define WDT_FEED_MS         1000    // Watchdog feed period (idle tasks wake this often)
+#define NETWORK_MAINTAIN_MS 1000    // DHCP lease / link check period
+
+// ============================================
+// Power Management (see modules/power_manager.h)
+// ============================================
+#define POWER_SENSE_PIN         -1      // Ship-power sense input (e.g. 27); -1 = always ship power
+#define POWER_SENSE_SHIP_LEVEL  HIGH    // Level while ship power is present
+#define POWER_CHECK_MS          1000    // Supply / motion check period
+#define POWER_CPU_MHZ           240     // CPU limit on ship power
+#define POWER_CPU_MHZ_BATTERY   80      // CPU limit on battery (light sleep allowed)
+#define POWER_CPU_MHZ_MIN       80      // DFS floor; keep 80 so APB (UART/SPI) stays fixed
+#define POWER_STATIONARY_KMH    1.0     // Slower than this ...
+#define POWER_STATIONARY_MS     120000  // ... for this long -> GPS cyclic tracking
+#define POWER_MOVING_KMH        3.0     // Back to continuous tracking
+#define POWER_GPS_PSM_PERIOD_MS 10000   // Fix period in cyclic tracking
+#define POWER_UART_AWAKE_MS     100     // Stay awake after GPS UART data
+#define POWER_WEB_POLL_MS       250     // W5500 poll while light sleep is allowed
+// Energy model for the per-report log (mA at POWER_SUPPLY_MV)
+#define POWER_SUPPLY_MV         3300
+#define POWER_MA_CPU_240        50
+#define POWER_MA_CPU_80         22
+#define POWER_MA_LIGHT_SLEEP    1
+#define POWER_MA_GPS            25      // NEO-M8N continuous tracking
+#define POWER_MA_GPS_PSM        8       // NEO-M8N cyclic tracking (average)
+#define POWER_MA_NETWORK        130     // W5500 (or WiFi modem)
+
 // ============================================
-#define WIFI_ENABLE         false   // true = WiFi, false = Ethernet (W5500)
+// Connection Mode (WiFi, Ethernet, or both)
+// ============================================
+#define LINK_DUAL_ENABLE    true    // Ethernet and WiFi at once, uploads on the best link
+#define WIFI_ENABLE         false   // Single link: true = WiFi, false = Ethernet (W5500)
 #define WIFI_SSID           "your-wifi-ssid"
 #define WIFI_PASSWORD       "your-wifi-password"
+// Link selection (LINK_DUAL_ENABLE, see modules/link_selector.h)
+#define LINK_PROBE_MS           15000   // TCP connect probe per link; keep under SEND_INTERVAL_NORMAL
+#define LINK_FAILURE_PENALTY_MS 2000    // Score added per recent failure
+#define LINK_HYSTERESIS_PCT     25      // Move only to a link scoring this much better
+#define LINK_RETRY_MS           30000   // Bring-up retry for a link that is down
+#define LINK_DHCP_TIMEOUT_MS    10000
 
 // ============================================
 // Web Server Configuration
@@ -99,8 +252,51 @@
 #define WEBSERVER_ENABLE    true    // Enable built-in web server
 #define WEBSERVER_PORT      80      // Web server port
 
+// Track history for /export.gpx and /export.geojson
+// Query: ?from=<epoch>&to=<epoch>, supports HTTP Range resume
+#define TRACK_STORE_CAPACITY    1440    // Stored fixes (22 bytes each, with free heap)
+#define TRACK_EXPORT_CHUNK_SIZE 512     // Export write chunk (bytes)
+
+// Trend charts from the same history (/chart.svg, on the dashboard)
+// Query: ?series=speed|altitude|satellites|heap&points=<n>&from=<epoch>&to=<epoch>
+#define CHART_DEFAULT_WINDOW_S  3600    // Window without from/to
+#define CHART_MAX_POINTS        120     // Points per chart (8 bytes each in the web arena)
+
+// Every fix in a flash partition, circular (see modules/track_archive.h)
+// Served as /archive.gpx and /archive.geojson?from=<epoch>&to=<epoch>
+// The "spiffs" partition of the default table (1.4 MB) holds about
+// 2 days at 1 Hz (~8.5 bytes per fix); a custom partition table gives it weeks.
+#define ARCHIVE_ENABLE          true
+#define ARCHIVE_PARTITION       "spiffs"    // Data partition label
+#define ARCHIVE_PAGE_SIZE       512     // Fixes buffered in RAM per flash write; lost on a reset
+#define ARCHIVE_MAX_SECTORS     1024    // Time index in RAM, 4 bytes per 4 KB sector
+#define ARCHIVE_DEFAULT_WINDOW_S 3600   // Range served without from=
+
+// GPS stream over TCP for bridge software / loggers (served by the web task)
+#define GPSD_ENABLE             true    // Needs WEBSERVER_ENABLE
+#define GPSD_PORT               2947    // gpsd protocol (?WATCH, TPV or NMEA)
+#define GPSD_NMEA_PORT          10110   // Raw NMEA from connect; 0 = off
+#define GPSD_MAX_CLIENTS        2       // Per link; the W5500 has 8 sockets, about 2 are spare
+#define GPSD_NMEA_RING_BYTES    4096    // Shared NMEA backlog, power of two (~4 s at 9600 baud)
+#define GPSD_JSON_RING_BYTES    2048    // Shared TPV backlog, power of two
+#define GPSD_MAX_LAG_PCT        75      // Clients further behind (share of the ring) are dropped
+
 // Default Location (used when GPS has no fix)
 #define DEFAULT_LAT         0.0
 #define DEFAULT_LNG         0.0
 
+// ============================================
+// Firmware Updates (delta OTA, see modules/ota_update.h)
+// ============================================
+// Patches come from SERVER_HOST, over HTTPS with the pin (required):
+//   GET OTA_PATH?device=<id>&version=<FIRMWARE_VERSION>
+// Build them with tools/ota/make_delta.py old.bin new.bin -o patch.bin
+#define OTA_ENABLE              true
+#define OTA_PATH                "/firmware/patch"
+#define OTA_CHECK_INTERVAL_MS   21600000UL  // 6 hours
+#define OTA_FIRST_CHECK_MS      60000       // After boot
+#define OTA_HEALTH_TIMEOUT_MS   300000      // New image rolls back without a report in this much link time
+#define DELTA_READ_CHUNK        256         // Old image read-back buffer
+#define DELTA_WRITE_CHUNK       1024        // New image flash write buffer
+
 #endif // CONFIG_H
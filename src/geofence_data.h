@@ -0,0 +1,32 @@
+// Generated by tools/geofence/build_fences.py from example_fences.geojson; do not edit
+#ifndef GEOFENCE_DATA_H
+#define GEOFENCE_DATA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+alignas(4) static const uint8_t GEOFENCE_BLOB[] = {
+    0x47, 0x46, 0x4e, 0x31, 0x01, 0x00, 0x04, 0x00, 0x11, 0x00, 0x00, 0x00, 0xb0, 0x9a, 0xb4, 0xfb,
+    0x68, 0x28, 0xa8, 0x3f, 0x5a, 0xa2, 0xc4, 0x00, 0x5a, 0xa2, 0xc4, 0x00, 0x01, 0x00, 0x05, 0x00,
+    0x04, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00,
+    0xb0, 0x0f, 0x5d, 0xfc, 0x68, 0x28, 0xa8, 0x3f, 0x68, 0x98, 0x5d, 0xfc, 0x30, 0xd8, 0xa8, 0x3f,
+    0x02, 0x00, 0x01, 0x00, 0x05, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x10, 0xfa, 0x5d, 0xfc,
+    0x50, 0x26, 0xa9, 0x3f, 0x30, 0x48, 0x5e, 0xfc, 0x70, 0x74, 0xa9, 0x3f, 0x03, 0x00, 0x02, 0x00,
+    0x09, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x60, 0xbd, 0x5e, 0xfc, 0xa0, 0xe9, 0xa9, 0x3f,
+    0x90, 0x32, 0x5f, 0xfc, 0x58, 0x72, 0xaa, 0x3f, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00,
+    0x04, 0x00, 0x00, 0x00, 0xb0, 0x9a, 0xb4, 0xfb, 0x00, 0xb5, 0x2f, 0x43, 0x50, 0x21, 0xb6, 0xfb,
+    0x40, 0xc2, 0x32, 0x43, 0xb0, 0x0f, 0x5d, 0xfc, 0x68, 0x28, 0xa8, 0x3f, 0xb0, 0x0f, 0x5d, 0xfc,
+    0xa8, 0xc4, 0xa8, 0x3f, 0xd0, 0x5d, 0x5d, 0xfc, 0x30, 0xd8, 0xa8, 0x3f, 0x68, 0x98, 0x5d, 0xfc,
+    0x98, 0x9d, 0xa8, 0x3f, 0xe0, 0x84, 0x5d, 0xfc, 0x68, 0x28, 0xa8, 0x3f, 0x10, 0xfa, 0x5d, 0xfc,
+    0x50, 0x26, 0xa9, 0x3f, 0x10, 0xfa, 0x5d, 0xfc, 0x70, 0x74, 0xa9, 0x3f, 0x30, 0x48, 0x5e, 0xfc,
+    0x70, 0x74, 0xa9, 0x3f, 0x30, 0x48, 0x5e, 0xfc, 0x50, 0x26, 0xa9, 0x3f, 0x60, 0xbd, 0x5e, 0xfc,
+    0xa0, 0xe9, 0xa9, 0x3f, 0x60, 0xbd, 0x5e, 0xfc, 0x58, 0x72, 0xaa, 0x3f, 0x90, 0x32, 0x5f, 0xfc,
+    0x58, 0x72, 0xaa, 0x3f, 0x90, 0x32, 0x5f, 0xfc, 0xa0, 0xe9, 0xa9, 0x3f, 0xb0, 0x9a, 0xb4, 0xfb,
+    0x00, 0xb5, 0x2f, 0x43, 0xb0, 0x9a, 0xb4, 0xfb, 0x40, 0xc2, 0x32, 0x43, 0x50, 0x21, 0xb6, 0xfb,
+    0x40, 0xc2, 0x32, 0x43, 0x50, 0x21, 0xb6, 0xfb, 0x00, 0xb5, 0x2f, 0x43, 0x00, 0x00, 0x00, 0x00,
+    0x03, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0x00,
+};
+static const size_t GEOFENCE_BLOB_SIZE = sizeof(GEOFENCE_BLOB);
+
+#endif // GEOFENCE_DATA_H
@@ -5,6 +5,21 @@
  *
  * Features:
  * - Modular architecture
+ * - FreeRTOS tasks: GPS ingestion, uploader, web server
+ * - Event loops: timer wheel + task notifications, no polling delays
+ * - Power management: DFS, light sleep on battery, GPS power save
+ * - Parallel GPS/network bring-up, warm GPS start from the fix saved in NVS
+ * - Kalman position filter: multipath rejection, dead reckoning through dropouts
+ * - On-device geofencing with immediate transition reports
+ * - Planned-route corridor check and ETA to the next port
+ * - Trip analytics: odometer, stops, speed statistics per trip
+ * - HTTPS uploads: TLS session resumption, public key pinning
+ * - Ethernet and WiFi at once, uploads on the best-scoring link
+ * - Sequence-numbered reports, resent until the server acknowledges them
+ * - Extra report destinations served at once, each fix serialized once
+ * - GPS stream over TCP: gpsd protocol (TPV, NMEA) and raw NMEA, many clients
+ * - Delta firmware updates into the inactive slot, rollback without a report
+ * - Full-rate track archive on flash with a time index (/archive.gpx)
  * - Minimal RAM usage (stack-based allocations)
  * - Watchdog timer for reliability
  * - Status LED indication
@@ -15,23 +30,76 @@
 #include <Arduino.h>
 #include <esp_task_wdt.h>
 #include "config.h"
+#include "modules/arena.h"
+#include "modules/event_loop.h"
+#include "modules/gps_aiding.h"
 #include "modules/gps_module.h"
+#include "modules/logger.h"
+#include "modules/metrics.h"
+#include "modules/power_manager.h"
+#include "modules/report_outbox.h"
+#include "modules/rtos.h"
+#include "modules/trace.h"
+#include "modules/track_store.h"
 
-#if WIFI_ENABLE
+#if POSITION_FILTER_ENABLE
+#include "modules/position_filter.h"
+#endif
+
+#if GEOFENCE_ENABLE
+#include "geofence_data.h"
+#include "modules/geofence.h"
+#endif
+
+#if ROUTE_ENABLE
+#include "route_data.h"
+#include "modules/route_tracker.h"
+#include "modules/seqlock.h"
+#endif
+
+#if TRIP_ENABLE
+#include "modules/seqlock.h"
+#include "modules/trip_analytics.h"
+#endif
+
+#if LINK_DUAL_ENABLE
+#include <WiFi.h>
+#include "modules/dual_network_module.h"
+#if WEBSERVER_ENABLE
+#include "modules/dual_webserver_module.h"
+#endif
+#elif WIFI_ENABLE
 #include <WiFi.h>
 #include "modules/wifi_module.h"
 #if WEBSERVER_ENABLE
 #include "modules/wifi_webserver_module.h"
 #endif
 #else
-#include <SPI.h>
-#include <Ethernet.h>
 #include "modules/network_module.h"
 #if WEBSERVER_ENABLE
 #include "modules/webserver_module.h"
 #endif
 #endif
 
+#if OTA_ENABLE
+#include "modules/ota_update.h"
+#endif
+
+#if UPLOAD_FANOUT_ENABLE
+#include "modules/upload_fanout.h"
+#endif
+
+#if ARCHIVE_ENABLE
+#include "modules/track_archive.h"
+#endif
+
+#if GPSD_ENABLE
+#if !WEBSERVER_ENABLE
+#error "GPSD_ENABLE is served by the web task: set WEBSERVER_ENABLE"
+#endif
+#include "modules/gpsd_module.h"
+#endif
+
 // ============================================
 // Application State
 // ============================================
@@ -43,99 +111,188 @@ enum class AppState : uint8_t {
     ERROR_FATAL
 };
 
+/**
+ * Event bits posted to the task event loops
+ */
+enum AppEvent : uint32_t {
+    EVENT_FIX_ACQUIRED = 1u << 0,   // gps -> upload
+    EVENT_CONSOLE      = 1u << 1,   // Serial input -> upload
+    EVENT_UART         = 1u << 2,   // GPS UART -> gps
+    EVENT_SOCKET       = 1u << 3,   // W5500 INTn -> web
+    EVENT_POWER        = 1u << 4,   // upload -> gps, web
+    EVENT_LINK_UP      = 1u << 5,   // upload -> web
+    EVENT_GEOFENCE     = 1u << 6,   // gps -> upload
+    EVENT_ROUTE        = 1u << 7,   // gps -> upload
+    EVENT_TRIP         = 1u << 8,   // gps -> upload
+    EVENT_STREAM       = 1u << 9    // gps -> web
+};
+
 // ============================================
 // Application Class - Single Instance
 // ============================================
 class GPSTrackerApp {
 public:
+    /**
+     * Bring up the GPS and start the tasks; the network comes up in the
+     * uploader task while the GPS task already acquires
+     */
     void setup() {
+        _self = this;
         initSerial();
         initDeviceId();
         initWatchdog();
         initStatusLED();
-
-        _state = AppState::NETWORK_CONNECTING;
-
-        if (!initNetwork()) {
-            _state = AppState::ERROR_NETWORK;
-            printBanner();  // Show banner even if network fails
-            log("ERROR: Network initialization failed!");
-            return;
-        }
-
-        printBanner();
+        initPower();
+        initGeofence();
+        initRoute();
+        initTrip();
+        initOta();
+        initArchive();
+        initOutbox();
 
         if (!initGPS()) {
-            log("WARNING: GPS initialization issue");
+            LOG(APP_GPS_ISSUE);
         }
+        markBoot(Metrics::BootPhase::GPS_READY);
 
-        _state = AppState::RUNNING;
+        _state = AppState::NETWORK_CONNECTING;
         _lastSendTime = 0;
         _currentInterval = SEND_INTERVAL_NORMAL;
 
-        log("System initialized successfully");
+        startTasks();
+        markBoot(Metrics::BootPhase::TASKS_STARTED);
+
+        LOG(APP_READY);
         logMemoryStatus();
     }
 
+    /**
+     * Everything runs in the task event loops
+     */
     void loop() {
-        // Feed watchdog
-        esp_task_wdt_reset();
-
-        // Maintain network connection
-        _network.maintain();
-
-        // Check network status
-        if (!_network.isConnected()) {
-            handleNetworkError();
-            return;
-        }
-
-        // Handle web server clients
-        #if WEBSERVER_ENABLE
-        _webServer.handle(_lastGPSData, _lastGPSValid);
-        #endif
-
-        // Check if it's time to send data
-        const uint32_t now = millis();
-        if (now - _lastSendTime >= _currentInterval) {
-            processAndSend();
-            _lastSendTime = now;
-        }
-
-        // Small delay to prevent tight loop
-        delay(100);
+        Rtos::endLoopTask();
     }
 
 private:
     // Modules (stack allocated)
     GPSModule _gps{GPS_RX_PIN, GPS_TX_PIN, GPS_BAUD_RATE};
 
-    #if WIFI_ENABLE
+    #if LINK_DUAL_ENABLE
+    DualNetworkModule _network{W5500_CS_PIN, W5500_RST_PIN};
+    #elif WIFI_ENABLE
     WiFiNetworkModule _network;
     #else
     NetworkModule _network{W5500_CS_PIN, W5500_RST_PIN};
     #endif
 
     #if WEBSERVER_ENABLE
-    #if WIFI_ENABLE
+    #if LINK_DUAL_ENABLE
+    DualWebServerModule _webServer{WEBSERVER_PORT};
+    #elif WIFI_ENABLE
     WiFiWebServerModule _webServer{WEBSERVER_PORT};
     #else
     WebServerModule _webServer{WEBSERVER_PORT};
     #endif
-    GPSData _lastGPSData;
-    bool _lastGPSValid = false;
+    TrackStore _track;  // History for /export.gpx, /export.geojson and /chart.svg
+    #endif
+    #if GPSD_ENABLE
+    GpsdFeed _gpsdFeed;     // GPS task -> web
+    GpsdModule _gpsd{_gpsdFeed};
+    #endif
+
+    PowerManager _power;
+    GpsAiding _aiding;
+    ReportOutbox _outbox;       // Uploader only (after setup)
+    #if UPLOAD_FANOUT_ENABLE
+    UploadFanout<decltype(_network)> _fanout{_network};    // Uploader only (after setup)
+    #endif
+    #if OTA_ENABLE
+    OtaUpdater _ota;            // Uploader only (after setup)
+    #endif
+    #if ARCHIVE_ENABLE
+    TrackArchive _archive;      // GPS task appends, web task queries
+    #endif
+
+    #if POSITION_FILTER_ENABLE
+    PositionFilter _filter;     // GPS task only
+    FilteredPosition _filtered{0, 0, false, false};
+    uint32_t _filterLocationMs = 0;
+    #endif
+    #if GEOFENCE_ENABLE
+    GeofenceEngine _geofence;   // GPS task only
+    #endif
+    #if ROUTE_ENABLE
+    RouteTracker _route;        // GPS task only
+    #endif
+    #if TRIP_ENABLE
+    TripAnalytics _trip;        // GPS task only
+    OdometerStore _odometer;    // Uploader only (after setup)
     #endif
 
+    // Task communication
+    LatestFix _latestFix;   // GPS task -> uploader, web
+    #if GEOFENCE_ENABLE
+    Rtos::Queue<GeofenceEvent, GEOFENCE_EVENT_QUEUE> _fenceEvents;  // GPS task -> uploader
+    #endif
+    #if ROUTE_ENABLE
+    SeqLock<RouteStatus> _routeStatus;                              // GPS task -> uploader
+    Rtos::Queue<RouteEvent, ROUTE_EVENT_QUEUE> _routeEvents;        // GPS task -> uploader
+    #endif
+    #if TRIP_ENABLE
+    SeqLock<TripStatus> _tripStatus;                                // GPS task -> uploader, web
+    Rtos::Queue<TripEvent, TRIP_EVENT_QUEUE> _tripEvents;           // GPS task -> uploader
+    #endif
+
+    // Event loops, one per task
+    EventLoop _gpsLoop{Metrics::LoopTask::GPS};
+    EventLoop _appLoop{Metrics::LoopTask::UPLOAD, &Metrics::registry.loopIteration};
+    #if WEBSERVER_ENABLE
+    EventLoop _webLoop{Metrics::LoopTask::WEB};
+    #endif
+
+    // Upload task timers
+    Timer _sendTimer{Timer::member<GPSTrackerApp, &GPSTrackerApp::onSendTimer>(), this};
+    Timer _maintainTimer{Timer::member<GPSTrackerApp, &GPSTrackerApp::onMaintainTimer>(), this};
+    Timer _retryTimer{Timer::member<GPSTrackerApp, &GPSTrackerApp::onRetryTimer>(), this};
+    Timer _ledTimer{Timer::member<GPSTrackerApp, &GPSTrackerApp::onLedTimer>(), this};
+    Timer _powerTimer{Timer::member<GPSTrackerApp, &GPSTrackerApp::onPowerTimer>(), this};
+    Timer _fixSaveTimer{Timer::member<GPSTrackerApp, &GPSTrackerApp::onFixSaveTimer>(), this};
+    #if LINK_DUAL_ENABLE
+    Timer _probeTimer{Timer::member<GPSTrackerApp, &GPSTrackerApp::onProbeTimer>(), this};
+    #endif
+    #if OTA_ENABLE
+    Timer _otaTimer{Timer::member<GPSTrackerApp, &GPSTrackerApp::onOtaTimer>(), this};
+    Timer _otaHealthTimer{[](void* self) { static_cast<GPSTrackerApp*>(self)->_ota.rollback(); }, this};
+    uint32_t _otaHealthLeftMs = OTA_HEALTH_TIMEOUT_MS;  // Link time a new image has left to report
+    uint32_t _otaHealthSinceMs = 0;
+    #endif
+
+    // GPS task timer
+    Timer _uartIdleTimer{[](void* self) { static_cast<GPSTrackerApp*>(self)->_power.holdAwake(false); }, this};
+
+    // Web task timer
+    #if WEBSERVER_ENABLE
+    Timer _webPollTimer{Timer::member<GPSTrackerApp, &GPSTrackerApp::serveWeb>(), this};
+    bool _webInterrupt = false;
+    #endif
+
+    static inline GPSTrackerApp* _self = nullptr;  // For ISRs
+
     // State variables
     AppState _state = AppState::INIT;
     uint32_t _lastSendTime = 0;
     uint32_t _currentInterval = SEND_INTERVAL_NORMAL;
     uint8_t _networkRetryCount = 0;
+    bool _appLoopRunning = false;
+
+    // LED pattern
+    uint8_t _ledToggles = 0;
+    uint16_t _ledPeriodMs = 0;
 
     // Device ID (prefix + chip ID)
     char _deviceId[24];
 
-    #if !WIFI_ENABLE
+    #if LINK_DUAL_ENABLE || !WIFI_ENABLE
     const uint8_t _mac[6] = MAC_ADDR;
     #endif
 
@@ -146,9 +303,7 @@ private:
     void initSerial() {
         #if DEBUG_SERIAL
         Serial.begin(DEBUG_BAUD_RATE);
-        while (!Serial && millis() < 3000) {
-            delay(10);
-        }
+        Log::begin();  // Drain task writes log records to Serial once it is up
         #endif
     }
 
@@ -165,21 +320,21 @@ private:
             _network.getLocalIP(ipBuffer, sizeof(ipBuffer));
         }
 
-        log("\n========================================");
-        log("  ESP32 GPS Tracker v" FIRMWARE_VERSION);
-        log("  Build: " FIRMWARE_BUILD);
-        log("  Device: " + String(_deviceId));
-        log("  IP: " + String(ipBuffer));
+        LOG(APP_RULE);
+        LOG(APP_BANNER_TITLE, FIRMWARE_VERSION);
+        LOG(APP_BANNER_BUILD, FIRMWARE_BUILD);
+        LOG(APP_BANNER_DEVICE, _deviceId);
+        LOG(APP_BANNER_IP, ipBuffer);
         #if WEBSERVER_ENABLE
-        log("  Web: http://" + String(ipBuffer) + ":" + String(WEBSERVER_PORT));
+        LOG(APP_BANNER_WEB, ipBuffer, WEBSERVER_PORT);
         #endif
-        log("========================================\n");
+        LOG(APP_RULE);
     }
 
     void initWatchdog() {
         esp_task_wdt_init(WATCHDOG_TIMEOUT, true);
         esp_task_wdt_add(NULL);
-        log("Watchdog initialized (" + String(WATCHDOG_TIMEOUT) + "s timeout)");
+        LOG(APP_WATCHDOG, WATCHDOG_TIMEOUT);
     }
 
     void initStatusLED() {
@@ -189,99 +344,740 @@ private:
         #endif
     }
 
-    bool initNetwork() {
-        #if WIFI_ENABLE
-        log("Connecting to WiFi...");
-        log("  SSID: " WIFI_SSID);
+    void initPower() {
+        _power.begin();
+        logPowerSupply();
+    }
+
+    void initGeofence() {
+        #if GEOFENCE_ENABLE
+        if (_geofence.load(GEOFENCE_BLOB, GEOFENCE_BLOB_SIZE)) {
+            Metrics::registry.geofencesLoaded.set(_geofence.fenceCount());
+            LOG(APP_GEOFENCE_LOADED, (unsigned)_geofence.fenceCount());
+        } else {
+            LOG(APP_GEOFENCE_INVALID);
+        }
+        #endif
+    }
+
+    void initRoute() {
+        #if ROUTE_ENABLE
+        if (_route.load(ROUTE_BLOB, ROUTE_BLOB_SIZE)) {
+            const RouteBlobHeader* h = reinterpret_cast<const RouteBlobHeader*>(ROUTE_BLOB);
+            LOG(APP_ROUTE_LOADED, (unsigned)h->segmentCount, _route.lengthM(), _route.corridorM());
+        } else {
+            LOG(APP_ROUTE_INVALID);
+        }
+        #endif
+    }
+
+    void initTrip() {
+        #if TRIP_ENABLE
+        if (_odometer.begin()) {
+            _trip.restore(_odometer.odometerM(), _odometer.tripCount());
+            LOG(APP_TRIP_RESTORED, _odometer.odometerM(), _odometer.tripCount());
+        }
+        Metrics::registry.tripOdometerM.set(_trip.odometerM());
+        #endif
+    }
+
+    void initOta() {
+        #if OTA_ENABLE
+        _ota.begin();
+        #endif
+    }
+
+    void initArchive() {
+        #if ARCHIVE_ENABLE
+        _archive.begin();
+        #endif
+    }
+
+    void initOutbox() {
+        _outbox.begin();
+        #if UPLOAD_FANOUT_ENABLE
+        _fanout.begin();
+        #endif
+    }
+
+    /**
+     * One connection attempt (uploader task); restarts the web server,
+     * since a W5500 reset drops its listening socket
+     */
+    bool connectNetwork() {
+        #if LINK_DUAL_ENABLE
+        if (!_network.begin(_mac, WIFI_SSID, WIFI_PASSWORD)) return false;
+        #elif WIFI_ENABLE
+        if (!_network.begin(WIFI_SSID, WIFI_PASSWORD)) return false;
         #else
-        log("Initializing Ethernet...");
+        if (!_network.begin(_mac)) return false;
+        #endif
+
+        #if WEBSERVER_ENABLE
+        _webServer.begin();
+        #if GPSD_ENABLE
+        _gpsd.begin();
+        #endif
+        _webLoop.post(EVENT_LINK_UP);
+        #endif
+        return true;
+    }
+
+    bool initGPS() {
+        LOG(APP_GPS_INIT);
+        LOG(APP_GPS_PINS, GPS_RX_PIN, GPS_TX_PIN, GPS_BAUD_RATE);
+
+        if (_aiding.begin()) {
+            LOG(APP_GPS_AIDING, _aiding.savedLatitude(), _aiding.savedLongitude(),
+                _aiding.clock() ? "kept" : "unknown");
+        }
+
+        if (_gps.begin()) {
+            LOG(APP_GPS_READY);
+            return true;
+        }
+        return false;
+    }
+
+    // ========================================
+    // Tasks
+    // ========================================
+
+    void startTasks() {
+        struct TaskSpec {
+            Rtos::TaskFn fn;
+            const char* name;
+            uint32_t stack;
+            uint8_t priority;
+            uint8_t core;
+        };
+        static const TaskSpec specs[] = {
+            {gpsTask, "gps", GPS_TASK_STACK, GPS_TASK_PRIORITY, GPS_TASK_CORE},
+            {uploadTask, "upload", UPLOAD_TASK_STACK, UPLOAD_TASK_PRIORITY, UPLOAD_TASK_CORE},
+            #if WEBSERVER_ENABLE
+            {webTask, "web", WEB_TASK_STACK, WEB_TASK_PRIORITY, WEB_TASK_CORE},
+            #endif
+        };
+        for (const TaskSpec& t : specs) {
+            if (!Rtos::startTask(t.fn, t.name, t.stack, t.priority, t.core, this)) {
+                LOG(APP_TASK_FAILED, t.name);
+            }
+        }
+    }
+
+    static void gpsTask(void* arg) { static_cast<GPSTrackerApp*>(arg)->runGps(); }
+    static void uploadTask(void* arg) { static_cast<GPSTrackerApp*>(arg)->runUploader(); }
+    #if WEBSERVER_ENABLE
+    static void webTask(void* arg) { static_cast<GPSTrackerApp*>(arg)->runWeb(); }
+    #endif
+
+    /**
+     * GPS ingestion: parse whatever the UART delivered, publish the fix
+     */
+    void runGps() {
+        _gpsLoop.begin();
+        _gps.onReceive([this] { _gpsLoop.post(EVENT_UART); });
+        #if GPSD_ENABLE
+        _gps.setTap(&_gpsdFeed.nmea);
         #endif
 
-        for (uint8_t retry = 0; retry < MAX_NETWORK_RETRIES; retry++) {
-            if (retry > 0) {
-                log("Retry " + String(retry) + "/" + String(MAX_NETWORK_RETRIES));
-                delay(RETRY_DELAY_MS);
+        GPSData data;
+        data.clear();
+        bool hadFix = false;
+        bool powerSave = false;
+        bool aidingSent = false;
+        uint32_t fixEpoch = 0;
+
+        while (Rtos::running()) {
+            const uint32_t events = _gpsLoop.wait();
+            TRACE_TICK();
+
+            if ((events & EVENT_POWER) && _power.gpsPowerSave() != powerSave) {
+                powerSave = _power.gpsPowerSave();
+                _gps.setPowerSave(powerSave, POWER_GPS_PSM_PERIOD_MS);
+                _latestFix.setMaxAge(GPS_FIX_MAX_AGE_MS + (powerSave ? POWER_GPS_PSM_PERIOD_MS : 0));
+                LOG(APP_GPS_POWER_MODE, powerSave ? "cyclic" : "continuous");
+            }
+            if (events & EVENT_UART) {
+                // Stay out of light sleep until the burst is over
+                _power.holdAwake(true);
+                _gpsLoop.timers().schedule(_uartIdleTimer, POWER_UART_AWAKE_MS);
             }
 
-            #if WIFI_ENABLE
-            if (_network.begin(WIFI_SSID, WIFI_PASSWORD)) {
-            #else
-            if (_network.begin(_mac)) {
+            if (_gps.poll(data) == 0) continue;
+            if (!aidingSent) {
+                // The receiver talks, so it is up and listening
+                _aiding.push(_gps);
+                aidingSent = true;
+            }
+            // RMC and GGA both update the fix: filter and check once per epoch
+            const bool newEpoch = data.valid && (data.epoch != fixEpoch || data.epoch == 0);
+            if (newEpoch) fixEpoch = data.epoch;
+            GPSData fix = data;
+            #if POSITION_FILTER_ENABLE
+            filterPosition(fix, newEpoch);
+            #endif
+
+            _latestFix.publish(fix);
+            #if GPSD_ENABLE
+            if (newEpoch || (hadFix && !data.valid)) _gpsdFeed.publishFix(fix);
+            if (_gpsdFeed.watched()) _webLoop.post(EVENT_STREAM);
             #endif
-                #if WEBSERVER_ENABLE
-                _webServer.begin();
+            if (data.valid && !hadFix) {
+                _aiding.syncClock(data);
+                markBoot(Metrics::BootPhase::FIRST_FIX);
+                _appLoop.post(EVENT_FIX_ACQUIRED);
+            }
+            hadFix = data.valid;
+
+            if (newEpoch && fix.valid) {
+                #if ARCHIVE_ENABLE
+                _archive.append(TrackPoint::fromGPSData(fix));
+                #endif
+                #if GEOFENCE_ENABLE
+                checkGeofences(fix);
+                #endif
+                #if ROUTE_ENABLE
+                checkRoute(fix);
+                #endif
+                #if TRIP_ENABLE
+                checkTrip(fix);
                 #endif
+            }
+        }
+    }
 
-                blinkLED(3, 100);
-                return true;
+    #if POSITION_FILTER_ENABLE
+    /**
+     * Replace the raw position with the filter's estimate; the filter
+     * steps once per epoch, publishes in between carry that estimate
+     */
+    void filterPosition(GPSData& fix, bool newEpoch) {
+        if (newEpoch) {
+            TRACE_SPAN("filter");
+            Metrics::Registry& metrics = Metrics::registry;
+            const uint32_t start = micros();
+
+            const PositionMeasurement m{(int32_t)lround(fix.latitude * 1e7), (int32_t)lround(fix.longitude * 1e7),
+                                        fix.hdop, (float)(fix.speed / 3.6), (float)fix.course,
+                                        (uint32_t)millis(), fix.locationMs != _filterLocationMs};
+            _filterLocationMs = fix.locationMs;
+            const bool wasValid = _filtered.valid;
+            const FilterStep step = _filter.update(m, _filtered);
+            metrics.filterEvalMicros.inc(micros() - start);
+            switch (step) {
+                case FilterStep::REJECTED: metrics.filterRejected.inc(); break;
+                case FilterStep::PREDICTED: metrics.filterPredicted.inc(); break;
+                case FilterStep::RESET: metrics.filterResets.inc(); break;
+                case FilterStep::LOST: if (wasValid) LOG(APP_FILTER_LOST, POSITION_DR_MS / 1000); break;
+                default: break;
             }
         }
 
-        return false;
+        if (!_filtered.valid) {
+            fix.valid = false;
+            return;
+        }
+        fix.latitude = _filtered.latE7 * 1e-7;
+        fix.longitude = _filtered.lonE7 * 1e-7;
+        fix.deadReckoned = _filtered.deadReckoned;
     }
+    #endif
 
-    bool initGPS() {
-        log("Initializing GPS...");
-        log("  RX=" + String(GPS_RX_PIN) + ", TX=" + String(GPS_TX_PIN) +
-            ", Baud=" + String(GPS_BAUD_RATE));
+    #if GEOFENCE_ENABLE
+    void checkGeofences(const GPSData& fix) {
+        TRACE_SPAN("geofence");
+        Metrics::Registry& metrics = Metrics::registry;
+        const uint32_t start = micros();
 
-        if (_gps.begin()) {
-            log("GPS module initialized");
-            return true;
+        GeofenceEvent events[4];
+        const size_t count = _geofence.update((int32_t)lround(fix.latitude * 1e7),
+                                              (int32_t)lround(fix.longitude * 1e7),
+                                              events, sizeof(events) / sizeof(events[0]));
+        metrics.geofenceEvalMicros.inc(micros() - start);
+        metrics.geofenceEvaluations.inc();
+        if (count == 0) return;
+
+        metrics.geofencesInside.set(_geofence.insideCount());
+        for (size_t i = 0; i < count; i++) {
+            (events[i].entered ? metrics.geofenceEnter : metrics.geofenceExit).inc();
+            if (!_fenceEvents.send(events[i])) metrics.geofenceDropped.inc();
         }
-        return false;
+        _appLoop.post(EVENT_GEOFENCE);
     }
+    #endif
+
+    #if ROUTE_ENABLE
+    void checkRoute(const GPSData& fix) {
+        if (!_route.loaded()) return;
+        TRACE_SPAN("route");
+        Metrics::Registry& metrics = Metrics::registry;
+        const uint32_t start = micros();
+
+        RouteEvent event;
+        const bool transition = _route.update((int32_t)lround(fix.latitude * 1e7),
+                                              (int32_t)lround(fix.longitude * 1e7), millis(), event);
+        const RouteStatus& status = _route.status();
+        _routeStatus.write(status);
+        metrics.routeEvalMicros.inc(micros() - start);
+        if (status.onRoute) {
+            metrics.routeCrossTrackM.set((uint32_t)fabsf(status.crossTrackM));
+            metrics.routeProgressM.set((uint32_t)status.progressM);
+        }
+        metrics.routeEtaSeconds.set(status.etaSeconds);
+        if (!transition) return;
+
+        if (event.breach) metrics.routeBreaches.inc();
+        _routeEvents.send(event);
+        _appLoop.post(EVENT_ROUTE);
+    }
+    #endif
+
+    #if TRIP_ENABLE
+    void checkTrip(const GPSData& fix) {
+        TRACE_SPAN("trip");
+        Metrics::Registry& metrics = Metrics::registry;
+        const uint32_t start = micros();
+
+        const TripSample sample{(int32_t)lround(fix.latitude * 1e7), (int32_t)lround(fix.longitude * 1e7),
+                                (uint32_t)lround(fix.speed * 1000 / 36), (uint32_t)millis(), fix.epoch};
+        const uint32_t rejected = _trip.rejected();
+        TripEvent event;
+        const bool transition = _trip.update(sample, event);
+        const TripStatus status = _trip.status();
+        _tripStatus.write(status);
+        metrics.tripEvalMicros.inc(micros() - start);
+        metrics.tripFixesRejected.inc(_trip.rejected() - rejected);
+        metrics.tripOdometerM.set(status.odometerM);
+        metrics.tripMoving.set(status.motion == Motion::MOVING);
+        if (!transition) return;
+
+        if (event.ended) metrics.tripsCompleted.inc();
+        _tripEvents.send(event);
+        _appLoop.post(EVENT_TRIP);
+    }
+    #endif
+
+    /**
+     * Uploader: sends, link upkeep, retries, LED and console, all as
+     * timers and events
+     */
+    void runUploader() {
+        _appLoop.begin();
+        _appLoopRunning = true;
+        TimerWheel& timers = _appLoop.timers();
+
+        #if LINK_DUAL_ENABLE || WIFI_ENABLE
+        LOG(APP_WIFI_CONNECTING);
+        LOG(APP_WIFI_SSID, WIFI_SSID);
+        #endif
+        #if LINK_DUAL_ENABLE || !WIFI_ENABLE
+        LOG(APP_ETH_INIT);
+        #endif
+        timers.schedule(_retryTimer, 0);  // First connection attempt
+        timers.schedule(_maintainTimer, NETWORK_MAINTAIN_MS, NETWORK_MAINTAIN_MS);
+        timers.schedule(_powerTimer, POWER_CHECK_MS, POWER_CHECK_MS);
+        timers.schedule(_fixSaveTimer, GPS_SAVE_INTERVAL_MS, GPS_SAVE_INTERVAL_MS);
+        #if LINK_DUAL_ENABLE
+        timers.schedule(_probeTimer, LINK_PROBE_MS, LINK_PROBE_MS);
+        #endif
+        #if OTA_ENABLE
+        if (_ota.ready()) timers.schedule(_otaTimer, OTA_FIRST_CHECK_MS, OTA_CHECK_INTERVAL_MS);
+        #endif
+
+        #if DEBUG_SERIAL
+        Serial.onReceive([this] { _appLoop.post(EVENT_CONSOLE); });
+        #endif
+
+        while (Rtos::running()) {
+            const uint32_t events = _appLoop.wait();
+            TRACE_TICK();
+
+            if (events & EVENT_CONSOLE) handleSerialCommands();
+            if (events & EVENT_FIX_ACQUIRED) onFixAcquired();
+            #if GEOFENCE_ENABLE
+            if (events & EVENT_GEOFENCE) onGeofenceEvents();
+            #endif
+            #if ROUTE_ENABLE
+            if (events & EVENT_ROUTE) onRouteEvents();
+            #endif
+            #if TRIP_ENABLE
+            if (events & EVENT_TRIP) onTripEvents();
+            #endif
+        }
+    }
+
+    void scheduleSend() {
+        if (_lastSendTime == 0) {
+            // First report as soon as there is a fix, without one after
+            // BOOT_REPORT_MAX_WAIT_MS
+            GPSData fix;
+            _latestFix.read(fix);
+            const uint32_t now = millis();
+            const uint32_t wait = fix.valid || now >= BOOT_REPORT_MAX_WAIT_MS ? 0 : BOOT_REPORT_MAX_WAIT_MS - now;
+            _appLoop.timers().schedule(_sendTimer, wait);
+            return;
+        }
+        const uint32_t elapsed = millis() - _lastSendTime;
+        _appLoop.timers().schedule(_sendTimer, elapsed >= _currentInterval ? 0 : _currentInterval - elapsed);
+    }
+
+    void onSendTimer() {
+        if (!_network.isConnected()) {
+            handleNetworkError();
+            return;
+        }
+        processAndSend();
+        _lastSendTime = millis();
+        scheduleSend();
+    }
+
+    // A fix during the slow no-fix interval (or before the first report):
+    // report now
+    void onFixAcquired() {
+        GPSData fix;
+        _latestFix.read(fix);
+        if (_aiding.save(fix)) LOG(APP_FIX_SAVED);
+
+        if (!_sendTimer.active()) return;
+        if (_lastSendTime != 0 && _currentInterval == SEND_INTERVAL_NORMAL) return;
+        _currentInterval = SEND_INTERVAL_NORMAL;
+        scheduleSend();
+    }
+
+    /**
+     * Out-of-band report of one event; the periodic report restarts from
+     * it. Without a link the event is held in the outbox and goes out
+     * with the gaps after the next report that gets through.
+     */
+    void reportEvent(const HttpUpload::ReportExtras& extras) {
+        if (_state == AppState::RUNNING && _network.isConnected()) {
+            processAndSend(extras);
+            _lastSendTime = millis();
+            return;
+        }
+        GPSData fix;
+        _latestFix.read(fix);
+        LOG(APP_EVENT_HELD, _outbox.add(fix, extras).seq);
+    }
+
+    #if GEOFENCE_ENABLE
+    /**
+     * One out-of-band report per transition
+     */
+    void onGeofenceEvents() {
+        GeofenceEvent event;
+        while (_fenceEvents.receive(event, 0)) {
+            LOG(APP_GEOFENCE_EVENT, event.fenceId, geofenceKindName(event.kind),
+                event.entered ? "enter" : "exit", event.latE7 * 1e-7, event.lonE7 * 1e-7);
+            HttpUpload::ReportExtras extras;
+            extras.geofence = &event;
+            reportEvent(extras);
+        }
+        if (_state == AppState::RUNNING) scheduleSend();
+    }
+    #endif
+
+    #if ROUTE_ENABLE
+    void onRouteEvents() {
+        RouteEvent event;
+        while (_routeEvents.receive(event, 0)) {
+            LOG(APP_ROUTE_EVENT, event.breach ? "left" : "back in", event.crossTrackM);
+            HttpUpload::ReportExtras extras;
+            extras.routeEvent = &event;
+            reportEvent(extras);
+        }
+        if (_state == AppState::RUNNING) scheduleSend();
+    }
+    #endif
+
+    #if TRIP_ENABLE
+    void onTripEvents() {
+        TripEvent event;
+        while (_tripEvents.receive(event, 0)) {
+            if (event.ended) {
+                LOG(APP_TRIP_END, event.trip.id, event.trip.distanceM, event.trip.movingS, event.trip.stops);
+            } else {
+                LOG(APP_TRIP_START, event.trip.id);
+            }
+            saveOdometer(event.ended);
+            HttpUpload::ReportExtras extras;
+            extras.tripEvent = &event;
+            reportEvent(extras);
+        }
+        if (_state == AppState::RUNNING) scheduleSend();
+    }
+    #endif
+
+    /**
+     * Odometer and trip count to NVS (rate-limited unless forced)
+     */
+    void saveOdometer(bool force = false) {
+        #if TRIP_ENABLE
+        TripStatus status;
+        if (_tripStatus.read(status) == 0) return;
+        if (_odometer.save(status.odometerM, status.trips, force)) LOG(APP_ODOMETER_SAVED);
+        #endif
+    }
+
+    void onFixSaveTimer() {
+        GPSData fix;
+        _latestFix.read(fix);
+        if (_aiding.save(fix)) LOG(APP_FIX_SAVED);
+        saveOdometer();
+    }
+
+    void onMaintainTimer() {
+        if (_state != AppState::RUNNING) return;  // The retry timer owns the link
+        #if LINK_DUAL_ENABLE && WEBSERVER_ENABLE
+        if (_network.maintain()) {
+            _webServer.restartEthernet();
+            #if GPSD_ENABLE
+            _gpsd.restartEthernet();
+            #endif
+        }
+        #else
+        _network.maintain();
+        #endif
+        if (!_network.isConnected()) {
+            handleNetworkError();
+        }
+    }
+
+    #if LINK_DUAL_ENABLE
+    // Keeps both links scored so uploads move within a report interval
+    void onProbeTimer() {
+        if (_state != AppState::RUNNING) return;
+        _network.probe(SERVER_HOST, SERVER_PORT);
+    }
+    #endif
+
+    #if OTA_ENABLE
+    // A new image is judged on link time only: the health clock runs while
+    // the link is up, keeps what is left across outages, and gives each
+    // reconnect at least one report interval
+    void resumeOtaHealth() {
+        if (!_ota.pendingVerify() || _otaHealthTimer.active()) return;
+        _otaHealthSinceMs = millis();
+        _appLoop.timers().schedule(_otaHealthTimer, max<uint32_t>(_otaHealthLeftMs, SEND_INTERVAL_NORMAL));
+    }
+
+    void pauseOtaHealth() {
+        if (!_otaHealthTimer.active()) return;
+        _appLoop.timers().cancel(_otaHealthTimer);
+        _otaHealthLeftMs -= min<uint32_t>(_otaHealthLeftMs, millis() - _otaHealthSinceMs);
+    }
+
+    // Not while this image is on probation: the first report decides
+    void onOtaTimer() {
+        if (_state != AppState::RUNNING || !_network.isConnected() || _ota.pendingVerify()) return;
+        Memory::cycle.reset();
+        if (!_ota.update(_network, _deviceId)) return;
+
+        // Keep what the next boot needs, then start the new image
+        GPSData fix;
+        _latestFix.read(fix);
+        _aiding.save(fix, true);
+        saveOdometer(true);
+        #if ARCHIVE_ENABLE
+        _archive.flush();
+        #endif
+        LOG(APP_RESTART);
+        Log::flush();
+        ESP.restart();
+    }
+    #endif
+
+    void onPowerTimer() {
+        GPSData fix;
+        _latestFix.read(fix);
+        const uint8_t changes = _power.update(fix, millis());
+
+        if (changes & PowerManager::CHANGED_SUPPLY) {
+            logPowerSupply();
+            // Ship power is gone: keep the position for the next boot
+            if (_power.onBattery() && _aiding.save(fix, true)) LOG(APP_FIX_SAVED);
+            if (_power.onBattery()) saveOdometer(true);
+            #if ARCHIVE_ENABLE
+            if (_power.onBattery()) _archive.flush();
+            #endif
+            #if WEBSERVER_ENABLE
+            _webLoop.post(EVENT_POWER);
+            #endif
+        }
+        if (changes & PowerManager::CHANGED_GPS) _gpsLoop.post(EVENT_POWER);
+    }
+
+    #if WEBSERVER_ENABLE
+    void runWeb() {
+        _webLoop.begin();
+        _webInterrupt = _webServer.attachInterrupt(onSocketInterrupt);
+
+        while (Rtos::running()) {
+            const uint32_t events = _webLoop.wait();
+            TRACE_TICK();
+
+            // Serve only once the uploader brought the link up
+            if ((events & EVENT_LINK_UP) || ((events & EVENT_POWER) && _webPollTimer.active())) {
+                _webLoop.timers().schedule(_webPollTimer, 0, webPollMs());
+            }
+            if ((events & EVENT_SOCKET) && _webPollTimer.active()) serveWeb();
+            #if GPSD_ENABLE
+            if ((events & EVENT_STREAM) && _webPollTimer.active() && !_gpsd.handle()) {
+                _webLoop.timers().schedule(_webPollTimer, WEB_POLL_MS, webPollMs());
+            }
+            #endif
+        }
+    }
+
+    // With an interrupt line the poll is only a safety net, unless light
+    // sleep can swallow the edge
+    uint32_t webPollMs() const {
+        if (_power.lightSleep()) return POWER_WEB_POLL_MS;
+        return _webInterrupt ? WDT_FEED_MS : WEB_POLL_MS;
+    }
+
+    void serveWeb() {
+        #if TRIP_ENABLE
+        WebContext context{_latestFix, _track, _deviceId, &_tripStatus};
+        #else
+        WebContext context{_latestFix, _track, _deviceId};
+        #endif
+        #if ARCHIVE_ENABLE
+        if (_archive.ready()) context.archive = &_archive;
+        #endif
+        bool done = _webServer.handle(context);
+        #if GPSD_ENABLE
+        done &= _gpsd.handle();
+        #endif
+        if (done) return;
+        // Bus busy: retry soon, no new interrupt edge may follow
+        _webLoop.timers().schedule(_webPollTimer, WEB_POLL_MS, webPollMs());
+    }
+
+    static void IRAM_ATTR onSocketInterrupt() {
+        _self->_webLoop.postFromISR(EVENT_SOCKET);
+    }
+    #endif
 
     // ========================================
     // Main Processing
     // ========================================
 
-    void processAndSend() {
-        log("\n--- Processing Cycle ---");
+    void processAndSend(const HttpUpload::ReportExtras& extras = {}) {
+        TRACE_SPAN("processAndSend");
+        Memory::cycle.reset();  // Per-cycle buffers start empty
+        LOG(APP_CYCLE);
 
-        // Read GPS data
+        // Latest fix from the GPS task
         GPSData gpsData;
-        const bool hasValidFix = _gps.read(gpsData, GPS_READ_TIMEOUT);
+        _latestFix.read(gpsData);
+        const bool hasValidFix = gpsData.valid;
 
         // Log GPS status
         logGPSStatus(gpsData, hasValidFix);
 
-        // Store last GPS data for web server
+        // Store track history for the web server
         #if WEBSERVER_ENABLE
-        _lastGPSData = gpsData;
-        _lastGPSValid = hasValidFix;
+        if (hasValidFix) {
+            _track.append(TrackPoint::fromGPSData(gpsData), min<uint32_t>(ESP.getFreeHeap() / 1024, UINT16_MAX));
+        }
         #endif
 
-        // Send data to server
+        // Route position, ETA and trip figures ride along with every report
+        HttpUpload::ReportExtras report = extras;
+        #if ROUTE_ENABLE
+        RouteStatus route;
+        if (hasValidFix && _routeStatus.read(route) != 0) report.route = &route;
+        #endif
+        #if TRIP_ENABLE
+        TripStatus trip;
+        if (_tripStatus.read(trip) != 0) report.trip = &trip;
+        #endif
+
+        // Send data to server; held until the server acknowledges it
+        HeldReport& held = _outbox.add(gpsData, report);
+        report.seq = held.seq;
+        report.seqBase = _outbox.base();
         setLED(true);
-        const HttpResponse response = _network.sendGPSData(
-            SERVER_HOST, SERVER_PATH, SERVER_PORT,
-            _deviceId, gpsData
-        );
+        HttpResponse response = {0, false};
+        {
+            // Serialized once; the extra destinations share the bytes
+            ArenaScope scope(Memory::cycle);
+            char localIP[16];
+            _network.getLocalIP(localIP, sizeof(localIP));
+            const char* payload = HttpUpload::buildJsonPayload(Memory::cycle, _deviceId, gpsData, localIP, report);
+            if (payload) {
+                #if UPLOAD_FANOUT_ENABLE
+                _fanout.submit(payload, HttpUpload::eventName(report) != nullptr, [&](char* buffer, size_t size) {
+                    HttpUpload::buildPositionPayload(buffer, size, _deviceId, gpsData, report);
+                });
+                const uint32_t start = micros();
+                response = _network.sendReport(SERVER_HOST, SERVER_PATH, SERVER_PORT, payload);
+                _fanout.recordPrimary(response, micros() - start);
+                #else
+                response = _network.sendReport(SERVER_HOST, SERVER_PATH, SERVER_PORT, payload);
+                #endif
+            }
+        }
+        _outbox.settle(held, response);
+        if (response.success) resendHeld();  // The link works: fill the gaps
+        #if UPLOAD_FANOUT_ENABLE
+        _fanout.finish();   // Answers from the extra destinations
+        #endif
         setLED(false);
 
         // Process response
         if (response.success) {
-            log("Data sent successfully (HTTP " + String(response.statusCode) + ")");
+            LOG(APP_SEND_OK, response.statusCode);
+            markBoot(Metrics::BootPhase::FIRST_REPORT);
+            #if OTA_ENABLE
+            if (_ota.pendingVerify()) {
+                _ota.confirm();
+                _appLoop.timers().cancel(_otaHealthTimer);
+            }
+            #endif
             _currentInterval = hasValidFix ? SEND_INTERVAL_NORMAL : SEND_INTERVAL_NO_FIX;
             _networkRetryCount = 0;
         } else {
-            log("Failed to send data (HTTP " + String(response.statusCode) + ")");
+            LOG(APP_SEND_FAILED, response.statusCode);
             _networkRetryCount++;
         }
 
+        const EnergyReport energy = _power.takeReport(millis());
+        LOG(APP_ENERGY, energy.millijoules, energy.periodMs / 1000, energy.averageMilliwatts());
+
         logMemoryStatus();
     }
 
+    /**
+     * Send reports that got no 2xx again, oldest first, a few per cycle
+     */
+    void resendHeld() {
+        uint32_t after = 0;
+        for (int i = 0; i < UPLOAD_RETRANSMIT_MAX; i++) {
+            HeldReport* held = _outbox.nextGap(after);
+            if (!held) return;
+            after = held->seq;
+
+            HttpUpload::ReportExtras extras = held->extras();
+            extras.seqBase = _outbox.base();
+            const HttpResponse response = _network.sendGPSData(
+                SERVER_HOST, SERVER_PATH, SERVER_PORT,
+                _deviceId, held->fix, extras
+            );
+            Metrics::registry.uploadResent.inc();
+            LOG(UPLOAD_RESENT, after, response.statusCode);
+            _outbox.settle(*held, response);
+            if (!response.success) return;
+        }
+    }
+
     void logGPSStatus(const GPSData& data, bool hasValidFix) {
         if (hasValidFix) {
-            log("GPS Fix: Valid");
-            log("  Lat: " + String(data.latitude, 6));
-            log("  Lng: " + String(data.longitude, 6));
-            log("  Satellites: " + String(data.satellites));
-            log("  Speed: " + String(data.speed, 1) + " km/h");
+            LOG(APP_FIX_VALID, data.latitude, data.longitude, data.satellites, data.speed);
         } else {
-            log("GPS Fix: No valid fix (satellites: " + String(data.satellites) + ")");
+            LOG(APP_FIX_NONE, data.satellites);
         }
     }
 
@@ -290,39 +1086,88 @@ private:
     // ========================================
 
     void handleNetworkError() {
-        log("Network disconnected! Attempting reconnection...");
+        LOG(APP_NETWORK_LOST);
         _state = AppState::ERROR_NETWORK;
+        _appLoop.timers().cancel(_sendTimer);
+        #if OTA_ENABLE
+        pauseOtaHealth();
+        #endif
 
+        // Reconnect once the error pattern has played
         blinkLED(5, 200);
+        _appLoop.timers().schedule(_retryTimer, 5 * 2 * 200);
+    }
 
-        #if WIFI_ENABLE
-        if (_network.begin(WIFI_SSID, WIFI_PASSWORD)) {
-        #else
-        if (_network.begin(_mac)) {
-        #endif
+    void onRetryTimer() {
+        const bool booting = _state == AppState::NETWORK_CONNECTING;
+        if (connectNetwork()) {
             _state = AppState::RUNNING;
-            log("Reconnected successfully");
             _networkRetryCount = 0;
+            if (booting) {
+                markBoot(Metrics::BootPhase::NETWORK_UP);
+                printBanner();
+                blinkLED(3, 100);
+            } else {
+                LOG(APP_RECONNECTED);
+            }
+            #if OTA_ENABLE
+            resumeOtaHealth();
+            #endif
+            scheduleSend();
+            return;
+        }
+
+        if (booting && ++_networkRetryCount < MAX_NETWORK_RETRIES) {
+            LOG(APP_NETWORK_RETRY, _networkRetryCount, MAX_NETWORK_RETRIES);
+        } else if (booting) {
+            printBanner();  // Show banner even if network fails
+            LOG(APP_NETWORK_FAILED);  // Keep retrying
+            _state = AppState::ERROR_NETWORK;
+            blinkLED(5, 200);
         } else {
-            log("Reconnection failed");
-            delay(RETRY_DELAY_MS);
+            LOG(APP_RECONNECT_FAILED);
+            blinkLED(5, 200);
         }
+        _appLoop.timers().schedule(_retryTimer, RETRY_DELAY_MS);
     }
 
     // ========================================
-    // Utility Methods
+    // Serial Commands
     // ========================================
 
-    void log(const String& message) {
+    void handleSerialCommands() {
         #if DEBUG_SERIAL
-        Serial.println("[" + String(millis() / 1000) + "s] " + message);
+        while (Serial.available() > 0) {
+            const char cmd = Serial.read();
+            #if TRACE_ENABLE
+            if (cmd == 't') {
+                Trace::writeChromeTrace(Serial);  // Chrome trace_event JSON
+            }
+            #endif
+            (void)cmd;
+        }
         #endif
     }
 
+    // ========================================
+    // Utility Methods
+    // ========================================
+
+    void markBoot(Metrics::BootPhase phase) {
+        if (Metrics::registry.markBoot(phase)) {
+            LOG(APP_BOOT_PHASE, Metrics::BOOT_PHASE_NAMES[(size_t)phase],
+                Metrics::registry.bootPhaseMs[(size_t)phase].value());
+        }
+    }
+
+    void logPowerSupply() {
+        LOG(APP_POWER_SUPPLY, _power.onBattery() ? "battery" : "ship power",
+            _power.cpuMhz(), _power.lightSleep() ? "on" : "off");
+    }
+
     void logMemoryStatus() {
-        #if DEBUG_SERIAL
-        log("Free heap: " + String(ESP.getFreeHeap()) + " bytes");
-        #endif
+        LOG(APP_FREE_HEAP, ESP.getFreeHeap(), ESP.getMinFreeHeap(),
+            ESP.getMaxAllocHeap(), Metrics::heapFragmentation());
     }
 
     void setLED(bool state) {
@@ -331,18 +1176,31 @@ private:
         #endif
     }
 
-    void blinkLED(uint8_t times, uint16_t delayMs) {
+    /**
+     * Blink without blocking: the upload loop's LED timer plays it
+     */
+    void blinkLED(uint8_t times, uint16_t periodMs) {
         #if LED_ENABLE
-        for (uint8_t i = 0; i < times; i++) {
-            setLED(true);
-            delay(delayMs);
-            setLED(false);
-            delay(delayMs);
-        }
+        _ledToggles = times * 2;
+        _ledPeriodMs = periodMs;
+        if (_appLoopRunning) _appLoop.timers().schedule(_ledTimer, 0, periodMs);
         #endif
     }
+
+    void onLedTimer() {
+        if (_ledToggles > 0) {
+            _ledToggles--;
+            setLED(_ledToggles % 2 == 1);
+        }
+        if (_ledToggles == 0) _appLoop.timers().cancel(_ledTimer);
+    }
 };
 
+#if OTA_ENABLE && !defined(ARDUINO_NATIVE)
+// The core would confirm a new image at boot; OtaUpdater waits for a report
+extern "C" bool verifyRollbackLater() { return true; }
+#endif
+
 // ============================================
 // Single Application Instance
 // ============================================
@@ -0,0 +1,112 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/**
+ * @file arena.h
+ * @brief Static bump arenas for per-cycle buffers
+ *
+ * Payload, header, response and page-chunk buffers are carved out of
+ * fixed static storage instead of the heap or a deep stack, and the
+ * whole arena is released at once at the start of each cycle (upload)
+ * or request (web). Nothing is freed individually and no destructors
+ * run, so only plain buffers belong here.
+ *
+ * An arena is owned by one task; it is not thread safe.
+ */
+
+#include <Arduino.h>
+#include "../config.h"
+
+#ifndef CYCLE_ARENA_SIZE
+#define CYCLE_ARENA_SIZE    1280
+#endif
+#ifndef WEB_ARENA_SIZE
+#define WEB_ARENA_SIZE      1536
+#endif
+#ifndef HTTP_HEADER_SIZE
+#define HTTP_HEADER_SIZE    192
+#endif
+
+class Arena {
+public:
+    Arena(uint8_t* storage, size_t capacity, const char* name)
+        : _storage(storage), _capacity(capacity), _name(name) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @return aligned block or nullptr when the arena is exhausted
+     */
+    void* allocate(size_t size, size_t align = alignof(uint64_t)) {
+        const size_t start = (_used + align - 1) & ~(align - 1);
+        if (start + size > _capacity) {
+            _exhausted++;
+            return nullptr;
+        }
+        _used = start + size;
+        if (_used > _highWater) _highWater = _used;
+        return _storage + start;
+    }
+
+    char* allocChars(size_t size) { return (char*)allocate(size, 1); }
+
+    size_t mark() const { return _used; }
+    void rewind(size_t mark) { if (mark < _used) _used = mark; }
+    void reset() { _used = 0; }
+
+    const char* name() const { return _name; }
+    size_t used() const { return _used; }
+    size_t capacity() const { return _capacity; }
+    size_t highWater() const { return _highWater; }
+    uint32_t exhausted() const { return _exhausted; }
+
+private:
+    uint8_t* const _storage;
+    const size_t _capacity;
+    const char* const _name;
+    size_t _used = 0;
+    size_t _highWater = 0;
+    uint32_t _exhausted = 0;
+};
+
+template <size_t N>
+class StaticArena : public Arena {
+public:
+    explicit StaticArena(const char* name) : Arena(_buffer, N, name) {}
+
+private:
+    alignas(8) uint8_t _buffer[N];
+};
+
+/**
+ * Rewinds the arena to its state at construction
+ */
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena& arena) : _arena(arena), _mark(arena.mark()) {}
+    ~ArenaScope() { _arena.rewind(_mark); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    Arena& _arena;
+    const size_t _mark;
+};
+
+namespace Memory {
+
+// Upload cycle: payload + request headers + status line
+static_assert(CYCLE_ARENA_SIZE >= JSON_BUFFER_SIZE + HTTP_HEADER_SIZE + 64 + 16,
+              "CYCLE_ARENA_SIZE too small for one upload");
+inline StaticArena<CYCLE_ARENA_SIZE> cycle{"cycle"};
+
+// Web request: response chunk buffer + export chunk
+static_assert(WEB_ARENA_SIZE >= HTTP_BUFFER_SIZE + TRACK_EXPORT_CHUNK_SIZE,
+              "WEB_ARENA_SIZE too small for one request");
+inline StaticArena<WEB_ARENA_SIZE> web{"web"};
+
+} // namespace Memory
+
+#endif // ARENA_H
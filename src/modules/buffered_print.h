@@ -0,0 +1,62 @@
+#ifndef BUFFERED_PRINT_H
+#define BUFFERED_PRINT_H
+
+/**
+ * @file buffered_print.h
+ * @brief Coalesces small prints into chunk-sized writes
+ *
+ * Page rendering issues hundreds of short print() calls; on the W5500
+ * each one is a separate SPI socket write. Wrapping the client in a
+ * BufferedPrint turns them into HTTP_BUFFER_SIZE writes.
+ */
+
+#include <Arduino.h>
+#include "arena.h"
+
+class BufferedPrint : public Print {
+public:
+    /**
+     * @param arena Source of the chunk buffer; falls back to unbuffered
+     *              writes if it is exhausted
+     */
+    BufferedPrint(Print& out, Arena& arena, size_t size)
+        : _out(out), _buffer((uint8_t*)arena.allocate(size, 1)), _size(_buffer ? size : 0) {}
+
+    ~BufferedPrint() { flush(); }
+
+    BufferedPrint(const BufferedPrint&) = delete;
+    BufferedPrint& operator=(const BufferedPrint&) = delete;
+
+    size_t write(uint8_t c) override {
+        if (_used == _size) {
+            flush();
+            if (_size == 0) return _out.write(c);
+        }
+        _buffer[_used++] = c;
+        return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        if (size > _size - _used) {
+            flush();
+            if (size >= _size) return _out.write(data, size);
+        }
+        memcpy(_buffer + _used, data, size);
+        _used += size;
+        return size;
+    }
+
+    void flush() override {
+        if (_used == 0) return;
+        _out.write(_buffer, _used);
+        _used = 0;
+    }
+
+private:
+    Print& _out;
+    uint8_t* const _buffer;
+    const size_t _size;
+    size_t _used = 0;
+};
+
+#endif // BUFFERED_PRINT_H
@@ -0,0 +1,379 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+/**
+ * @file delta_patch.h
+ * @brief Streaming binary delta (bsdiff-style) applier with bounded RAM
+ *
+ * A patch rebuilds the new image from the old one, as produced by
+ * tools/ota/make_delta.py. After the header it is a list of blocks:
+ *
+ *   varint copyLen   bytes taken from the old image at the old cursor,
+ *                    each plus a diff byte (mod 256)
+ *   varint extraLen  bytes that are new
+ *   zigzag varint    old cursor move after the block
+ *   diff             copyLen bytes as (varint zeros, varint count,
+ *                    count diff bytes) pairs: code that only moved has
+ *                    diff runs of zero with a few changed addresses
+ *   extra            extraLen literal bytes
+ *
+ * Patch bytes arrive through Print, as the download delivers them; the
+ * applier keeps one chunk of the old image and one of the new image
+ * (DELTA_READ_CHUNK + DELTA_WRITE_CHUNK bytes) plus a SHA-256 context,
+ * however large the images are.
+ *
+ * Image provides the partitions:
+ *   DeltaError open(const DeltaHeader&);       // Before the first write
+ *   bool readOld(uint32_t offset, uint8_t* out, size_t len);
+ *   bool writeNew(const uint8_t* data, size_t len);  // Sequential
+ */
+
+#include <Arduino.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/version.h>
+#include "../config.h"
+
+#ifndef DELTA_READ_CHUNK
+#define DELTA_READ_CHUNK    256
+#endif
+#ifndef DELTA_WRITE_CHUNK
+#define DELTA_WRITE_CHUNK   1024
+#endif
+
+/**
+ * Patch header, little-endian
+ */
+struct __attribute__((packed)) DeltaHeader {
+    static constexpr uint32_t MAGIC = 0x31544C44;   // "DLT1"
+
+    uint32_t magic;
+    uint32_t oldSize;
+    uint32_t newSize;
+    uint8_t oldSha256[32];      // The image the patch was made against
+    uint8_t newSha256[32];      // What it produces
+};
+
+enum class DeltaError : uint8_t {
+    NONE = 0,
+    BAD_HEADER,         // Not a patch, or a newer format
+    CURRENT,            // The patch produces the running image
+    WRONG_BASE,         // Made against another image
+    ROLLED_BACK,        // Produces the image that failed its health check
+    NO_SPACE,           // New image larger than the slot
+    CORRUPT,            // Control data out of range
+    TRUNCATED,          // Ended before the new image was complete
+    READ_FAILED,
+    WRITE_FAILED,
+    HASH_MISMATCH,
+    COUNT
+};
+
+inline constexpr const char* DELTA_ERROR_NAMES[] = {
+    "ok", "bad header", "already running", "wrong base image", "rolled back before", "no space", "corrupt",
+    "truncated", "read failed", "write failed", "hash mismatch"
+};
+
+/**
+ * SHA-256 over mbedTLS 2.x and 3.x
+ */
+class Sha256 {
+public:
+    Sha256() { mbedtls_sha256_init(&_ctx); }
+    ~Sha256() { mbedtls_sha256_free(&_ctx); }
+    Sha256(const Sha256&) = delete;
+    Sha256& operator=(const Sha256&) = delete;
+
+    void begin() {
+        #if MBEDTLS_VERSION_MAJOR >= 3
+        mbedtls_sha256_starts(&_ctx, 0);
+        #else
+        mbedtls_sha256_starts_ret(&_ctx, 0);
+        #endif
+    }
+
+    void update(const uint8_t* data, size_t len) {
+        #if MBEDTLS_VERSION_MAJOR >= 3
+        mbedtls_sha256_update(&_ctx, data, len);
+        #else
+        mbedtls_sha256_update_ret(&_ctx, data, len);
+        #endif
+    }
+
+    void finish(uint8_t out[32]) {
+        #if MBEDTLS_VERSION_MAJOR >= 3
+        mbedtls_sha256_finish(&_ctx, out);
+        #else
+        mbedtls_sha256_finish_ret(&_ctx, out);
+        #endif
+    }
+
+private:
+    mbedtls_sha256_context _ctx;
+};
+
+template <typename Image>
+class DeltaApplier : public Print {
+public:
+    explicit DeltaApplier(Image& image) : _image(image) {}
+
+    /**
+     * Ready for the next patch
+     */
+    void reset() {
+        _headerLen = 0;
+        _state = State::HEADER;
+        _error = DeltaError::NONE;
+        _varint = 0;
+        _shift = 0;
+        _copyLeft = _extraLeft = _runLeft = 0;
+        _oldPos = _newPos = 0;
+        _oldStart = _oldLen = 0;
+        _outLen = 0;
+    }
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+
+    /**
+     * Feed patch bytes
+     * @return size, or 0 once the patch failed (see error())
+     */
+    size_t write(const uint8_t* data, size_t size) override {
+        const uint8_t* const end = data + size;
+        while (data < end && _state != State::FAILED) {
+            switch (_state) {
+                case State::HEADER: {
+                    const size_t n = min((size_t)(end - data), sizeof(DeltaHeader) - _headerLen);
+                    memcpy(reinterpret_cast<uint8_t*>(&_header) + _headerLen, data, n);
+                    _headerLen += n;
+                    data += n;
+                    if (_headerLen == sizeof(DeltaHeader)) start();
+                    break;
+                }
+                case State::COPY_LEN:
+                case State::EXTRA_LEN:
+                case State::SEEK:
+                case State::ZEROS:
+                case State::COUNT:
+                    if (varint(*data++)) control();
+                    break;
+                case State::DIFF: {
+                    const size_t n = min((size_t)(end - data), (size_t)_runLeft);
+                    for (size_t i = 0; i < n && _state != State::FAILED; i++) {
+                        uint8_t old;
+                        if (!oldByte(old)) break;
+                        put((uint8_t)(old + data[i]));
+                    }
+                    data += n;
+                    _runLeft -= n;
+                    _copyLeft -= n;
+                    if (_runLeft == 0) nextPair();
+                    break;
+                }
+                case State::EXTRA: {
+                    const size_t n = min((size_t)(end - data), (size_t)_extraLeft);
+                    for (size_t i = 0; i < n && _state != State::FAILED; i++) put(data[i]);
+                    data += n;
+                    _extraLeft -= n;
+                    if (_extraLeft == 0) endBlock();
+                    break;
+                }
+                case State::DONE:
+                    fail(DeltaError::CORRUPT);     // Bytes past the end
+                    break;
+                case State::FAILED:
+                    break;
+            }
+        }
+        return _state == State::FAILED ? 0 : size;
+    }
+
+    /**
+     * After the last patch byte: flush and check the new image
+     */
+    DeltaError finish() {
+        if (_state == State::FAILED) return _error;
+        if (_state != State::DONE) return fail(DeltaError::TRUNCATED);
+        if (!flushOut()) return _error;
+        uint8_t digest[32];
+        _hash.finish(digest);
+        if (memcmp(digest, _header.newSha256, sizeof(digest)) != 0) return fail(DeltaError::HASH_MISMATCH);
+        return DeltaError::NONE;
+    }
+
+    const DeltaHeader& header() const { return _header; }
+    DeltaError error() const { return _error; }
+    uint32_t written() const { return _newPos; }    // New image bytes produced
+
+private:
+    enum class State : uint8_t { HEADER, COPY_LEN, EXTRA_LEN, SEEK, ZEROS, COUNT, DIFF, EXTRA, DONE, FAILED };
+
+    Image& _image;
+    Sha256 _hash;
+    DeltaHeader _header{};
+    size_t _headerLen = 0;
+    State _state = State::HEADER;
+    DeltaError _error = DeltaError::NONE;
+
+    uint32_t _varint = 0;
+    uint8_t _shift = 0;
+    uint32_t _copyLeft = 0, _extraLeft = 0, _runLeft = 0;
+    int64_t _seek = 0;
+    uint32_t _oldPos = 0, _newPos = 0;
+
+    uint8_t _old[DELTA_READ_CHUNK];
+    uint32_t _oldStart = 0, _oldLen = 0;   // Old image bytes in _old
+    uint8_t _out[DELTA_WRITE_CHUNK];
+    size_t _outLen = 0;
+
+    DeltaError fail(DeltaError error) {
+        _state = State::FAILED;
+        _error = error;
+        return error;
+    }
+
+    void start() {
+        if (_header.magic != DeltaHeader::MAGIC) {
+            fail(DeltaError::BAD_HEADER);
+            return;
+        }
+        const DeltaError error = _image.open(_header);
+        if (error != DeltaError::NONE) {
+            fail(error);
+            return;
+        }
+        _hash.begin();
+        _state = _header.newSize ? State::COPY_LEN : State::DONE;
+    }
+
+    // Little-endian base-128; true once the value is complete
+    bool varint(uint8_t b) {
+        if (_shift > 28) {
+            fail(DeltaError::CORRUPT);
+            return false;
+        }
+        _varint |= (uint32_t)(b & 0x7F) << _shift;
+        _shift += 7;
+        return (b & 0x80) == 0;
+    }
+
+    void control() {
+        const uint32_t value = _varint;
+        _varint = 0;
+        _shift = 0;
+        switch (_state) {
+            case State::COPY_LEN:
+                _copyLeft = value;
+                _state = State::EXTRA_LEN;
+                break;
+            case State::EXTRA_LEN:
+                _extraLeft = value;
+                if ((uint64_t)_newPos + _copyLeft + _extraLeft > _header.newSize ||
+                    (uint64_t)_oldPos + _copyLeft > _header.oldSize) {
+                    fail(DeltaError::CORRUPT);
+                    return;
+                }
+                _state = State::SEEK;
+                break;
+            case State::SEEK:
+                _seek = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+                if (_copyLeft) _state = State::ZEROS;
+                else startExtra();
+                break;
+            case State::ZEROS:
+                if (value > _copyLeft) {
+                    fail(DeltaError::CORRUPT);
+                    return;
+                }
+                copyOld(value);
+                _copyLeft -= value;
+                _state = State::COUNT;
+                break;
+            case State::COUNT:
+                if (value > _copyLeft) {
+                    fail(DeltaError::CORRUPT);
+                    return;
+                }
+                _runLeft = value;
+                if (_runLeft) _state = State::DIFF;
+                else nextPair();
+                break;
+            default:
+                break;
+        }
+    }
+
+    void nextPair() {
+        if (_state == State::FAILED) return;
+        if (_copyLeft) _state = State::ZEROS;
+        else startExtra();
+    }
+
+    void startExtra() {
+        if (_extraLeft) _state = State::EXTRA;
+        else endBlock();
+    }
+
+    void endBlock() {
+        if (_state == State::FAILED) return;
+        const int64_t pos = (int64_t)_oldPos + _seek;
+        if (pos < 0 || pos > (int64_t)_header.oldSize) {
+            fail(DeltaError::CORRUPT);
+            return;
+        }
+        _oldPos = (uint32_t)pos;
+        _state = _newPos == _header.newSize ? State::DONE : State::COPY_LEN;
+    }
+
+    // Old bytes unchanged (a zero run of the diff)
+    void copyOld(uint32_t len) {
+        while (len && _state != State::FAILED) {
+            if (!fillOld()) return;
+            const size_t n = min((size_t)len, min((size_t)(_oldStart + _oldLen - _oldPos),
+                                                 sizeof(_out) - _outLen));
+            memcpy(_out + _outLen, _old + (_oldPos - _oldStart), n);
+            _outLen += n;
+            _oldPos += n;
+            _newPos += n;
+            len -= n;
+            if (_outLen == sizeof(_out)) flushOut();
+        }
+    }
+
+    bool oldByte(uint8_t& out) {
+        if (!fillOld()) return false;
+        out = _old[_oldPos++ - _oldStart];
+        return true;
+    }
+
+    // _old holds _oldPos afterwards
+    bool fillOld() {
+        if (_oldPos >= _oldStart && _oldPos < _oldStart + _oldLen) return true;
+        const uint32_t len = min((uint32_t)sizeof(_old), _header.oldSize - _oldPos);
+        if (!_image.readOld(_oldPos, _old, len)) {
+            fail(DeltaError::READ_FAILED);
+            return false;
+        }
+        _oldStart = _oldPos;
+        _oldLen = len;
+        return true;
+    }
+
+    void put(uint8_t b) {
+        _out[_outLen++] = b;
+        _newPos++;
+        if (_outLen == sizeof(_out)) flushOut();
+    }
+
+    bool flushOut() {
+        if (_outLen == 0) return true;
+        _hash.update(_out, _outLen);
+        if (!_image.writeNew(_out, _outLen)) {
+            fail(DeltaError::WRITE_FAILED);
+            return false;
+        }
+        _outLen = 0;
+        return true;
+    }
+};
+
+#endif // DELTA_PATCH_H
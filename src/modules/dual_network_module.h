@@ -0,0 +1,293 @@
+#ifndef DUAL_NETWORK_MODULE_H
+#define DUAL_NETWORK_MODULE_H
+
+/**
+ * @file dual_network_module.h
+ * @brief Ethernet (W5500) and WiFi at once, uploads on the best link
+ *
+ * Same interface as NetworkModule / WiFiNetworkModule. Both links are
+ * brought up and kept up on their own (a link that is down is retried
+ * every LINK_RETRY_MS, Ethernet only while the PHY sees a link);
+ * LinkSelector scores them from probe connect times and failures. A report that gets no answer on the active link
+ * is sent again on the next best one straight away, so a dead LAN
+ * switch costs one connect timeout rather than a report interval.
+ *
+ * The W5500 has its own TCP/IP stack and WiFi runs on lwIP, so each
+ * module's client always leaves through its own link.
+ */
+
+#include <Arduino.h>
+#include "link_selector.h"
+#include "logger.h"
+#include "metrics.h"
+#include "network_module.h"
+#include "wifi_module.h"
+
+#ifndef LINK_RETRY_MS
+#define LINK_RETRY_MS               30000
+#endif
+#ifndef LINK_DHCP_TIMEOUT_MS
+#define LINK_DHCP_TIMEOUT_MS        10000
+#endif
+
+class DualNetworkModule {
+public:
+    static constexpr size_t ETHERNET = (size_t)Metrics::NetLink::ETHERNET;
+    static constexpr size_t WIFI = (size_t)Metrics::NetLink::WIFI;
+
+    DualNetworkModule(uint8_t csPin, uint8_t rstPin) : _ethernet(csPin, rstPin) {}
+
+    /**
+     * Bring up both links: WiFi associates in the background while
+     * Ethernet runs DHCP
+     * @return true if either link is up
+     */
+    bool begin(const uint8_t* mac, const char* ssid, const char* password) {
+        _mac = mac;
+        _ssid = ssid;
+        _password = password;
+
+        const uint32_t start = millis();
+        _wifi.begin(ssid, password, 0);
+        _ethernet.begin(mac, LINK_DHCP_TIMEOUT_MS);
+        while (!_ethernet.isConnected() && !_wifi.isConnected() && millis() - start < LINK_DHCP_TIMEOUT_MS) {
+            delay(100);
+        }
+        _retryMs[ETHERNET] = _retryMs[WIFI] = millis();
+        update();
+        return isConnected();
+    }
+
+    /**
+     * Link upkeep; retries a link that is down
+     * @return true if Ethernet came back (a W5500 reset drops the web
+     *         server's listening socket)
+     */
+    bool maintain() {
+        const uint32_t now = millis();
+        bool ethernetRestarted = false;
+        if (_ethernet.getStatus() == NetworkStatus::CONNECTED) {
+            _ethernet.maintain();
+        } else if (now - _retryMs[ETHERNET] >= LINK_RETRY_MS) {
+            _retryMs[ETHERNET] = now;
+            // No cable or switch: a chip reset and DHCP wait would gain nothing
+            if (_ethernet.linkUp()) ethernetRestarted = _ethernet.begin(_mac, LINK_DHCP_TIMEOUT_MS);
+        }
+
+        _wifi.maintain();
+        if (!_wifi.isConnected() && now - _retryMs[WIFI] >= LINK_RETRY_MS) {
+            _retryMs[WIFI] = now;
+            _wifi.begin(_ssid, _password, 0);
+        }
+        update();
+        return ethernetRestarted;
+    }
+
+    /**
+     * Either link up
+     */
+    bool isConnected() const {
+        return _selector.up(ETHERNET) || _selector.up(WIFI);
+    }
+
+    /**
+     * Address on the active link
+     */
+    void getLocalIP(char* buffer, size_t bufferSize) const {
+        if (_selector.active() == WIFI) {
+            _wifi.getLocalIP(buffer, bufferSize);
+        } else {
+            _ethernet.getLocalIP(buffer, bufferSize);
+        }
+    }
+
+    /**
+     * Send on the active link; a report that gets no answer at all is
+     * sent again on the next best link (its sequence number lets the
+     * server drop the copy if the first one did arrive)
+     */
+    HttpResponse sendGPSData(const char* host, const char* path, uint16_t port,
+                             const char* deviceId, const GPSData& gpsData,
+                             const HttpUpload::ReportExtras& extras = {}) {
+        char ipBuffer[16];
+        getLocalIP(ipBuffer, sizeof(ipBuffer));
+
+        ArenaScope scope(Memory::cycle);
+        const char* payload = HttpUpload::buildJsonPayload(Memory::cycle, deviceId, gpsData, ipBuffer, extras);
+        if (!payload) return HttpResponse{0, false};
+        return sendReport(host, path, port, payload);
+    }
+
+    /**
+     * POST a report already serialized, with the same failover (the
+     * other link sends the same bytes)
+     */
+    HttpResponse sendReport(const char* host, const char* path, uint16_t port, const char* payload) {
+        const size_t link = _selector.active();
+        if (link == Selector::NONE) {
+            LOG(HTTP_NO_LINK, "Ethernet/WiFi");
+            return HttpResponse{0, false};
+        }
+
+        HttpResponse response = send(link, host, path, port, payload);
+        if (response.statusCode != 0) return response;
+
+        const size_t next = _selector.fallback();
+        if (next == Selector::NONE) return response;
+        _selector.activate(next);
+        switched(link);
+        return send(next, host, path, port, payload);
+    }
+
+    /**
+     * Connection to one extra report destination on whichever link was
+     * active when it was opened
+     */
+    class Channel {
+    public:
+        Client& client() { return _link == WIFI ? _wifi.client() : _ethernet.client(); }
+
+    private:
+        friend class DualNetworkModule;
+        NetworkModule::Channel _ethernet;
+        WiFiNetworkModule::Channel _wifi;
+        size_t _link = ETHERNET;
+    };
+
+    /**
+     * Connect a channel on the active link (a destination that fails
+     * does not count against the link: it may just be that server)
+     */
+    bool open(Channel& channel, const char* host, uint16_t port, const char* pin) {
+        const size_t link = _selector.active();
+        if (link == Selector::NONE) return false;
+        channel._link = link;
+        return link == WIFI ? _wifi.open(channel._wifi, host, port, pin)
+                            : _ethernet.open(channel._ethernet, host, port, pin);
+    }
+
+    /**
+     * Stream the body of a GET into body on the active link (no retry on
+     * the other: the next check tries again)
+     */
+    HttpDownload::Result fetch(const char* host, const char* path, uint16_t port, Print& body) {
+        const size_t link = _selector.active();
+        if (link == Selector::NONE) {
+            LOG(HTTP_NO_LINK, "Ethernet/WiFi");
+            return HttpDownload::Result{0, 0, false};
+        }
+        return link == WIFI ? _wifi.fetch(host, path, port, body) : _ethernet.fetch(host, path, port, body);
+    }
+
+    /**
+     * Time a connect to the server on every link that is up and
+     * re-evaluate (every LINK_PROBE_MS)
+     */
+    void probe(const char* host, uint16_t port) {
+        for (size_t link = 0; link < LINKS; link++) {
+            if (!_selector.up(link)) continue;
+            uint32_t connectUs = 0;
+            const uint32_t startMs = millis();
+            const bool ok = link == WIFI ? _wifi.probe(host, port, connectUs)
+                                         : _ethernet.probe(host, port, connectUs);
+            record(link, ok, startMs, ok ? connectUs : 0);
+            LOG(LINK_PROBE, name(link), ok ? connectUs : 0, _selector.failures(link));
+        }
+        reselect();
+    }
+
+private:
+    static constexpr size_t LINKS = (size_t)Metrics::NetLink::COUNT;
+    using Selector = LinkSelector<LINKS>;
+
+    NetworkModule _ethernet;
+    WiFiNetworkModule _wifi;
+    Selector _selector;
+    const uint8_t* _mac = nullptr;
+    const char* _ssid = "";
+    const char* _password = "";
+    uint32_t _retryMs[LINKS] = {};
+    uint32_t _failingSinceMs = 0;   // First failure on the active link since it last worked, 0 = none
+    size_t _failingLink = Selector::NONE;
+
+    static const char* name(size_t link) {
+        return link < LINKS ? Metrics::NET_LINK_NAMES[link] : "none";
+    }
+
+    HttpResponse send(size_t link, const char* host, const char* path, uint16_t port, const char* payload) {
+        const uint32_t startMs = millis();
+        const HttpResponse response = link == WIFI
+            ? _wifi.sendReport(host, path, port, payload)
+            : _ethernet.sendReport(host, path, port, payload);
+        // Any status line means the link works, whatever the server said
+        const bool answered = response.statusCode != 0;
+        if (answered && _failingSinceMs != 0 && link != _failingLink) {
+            const uint32_t elapsed = millis() - _failingSinceMs;
+            _failingSinceMs = 0;
+            Metrics::registry.linkFailoverMs.set(elapsed);
+            LOG(LINK_FAILOVER, name(link), elapsed);
+        }
+        record(link, answered, startMs);
+        return response;
+    }
+
+    /**
+     * @param startMs When the failed attempt began (the outage is at least that old)
+     */
+    void record(size_t link, bool ok, uint32_t startMs, uint32_t connectUs = 0) {
+        Metrics::Registry& metrics = Metrics::registry;
+        if (!ok) {
+            metrics.linkFailures[link].inc();
+            markFailing(link, startMs);
+        } else if (link == _failingLink) {
+            _failingSinceMs = 0;    // Recovered in place
+        }
+        _selector.observe(link, ok, connectUs);
+        metrics.linkConnectUs[link].set(_selector.srttUs(link));
+    }
+
+    // Start of an outage on the active link, for the failover time
+    void markFailing(size_t link, uint32_t sinceMs) {
+        if (link != _selector.active() || _failingSinceMs != 0) return;
+        _failingSinceMs = sinceMs | 1;
+        _failingLink = link;
+    }
+
+    void update() {
+        setUp(ETHERNET, _ethernet.isConnected());
+        setUp(WIFI, _wifi.isConnected());
+        reselect();
+    }
+
+    void setUp(size_t link, bool up) {
+        if (up == _selector.up(link)) return;
+        _selector.setUp(link, up);
+        Metrics::registry.linkUp[link].set(up);
+        if (up) {
+            LOG(LINK_UP, name(link));
+        } else {
+            LOG(LINK_DOWN, name(link));
+            markFailing(link, millis());
+        }
+    }
+
+    void reselect() {
+        const size_t previous = _selector.active();
+        if (_selector.select()) switched(previous);
+    }
+
+    void switched(size_t previous) {
+        const size_t active = _selector.active();
+        Metrics::registry.linkActive.set(active + 1);
+        if (previous == Selector::NONE) {
+            LOG(LINK_SWITCH, name(previous), name(active), "first link");
+            return;
+        }
+        Metrics::registry.linkSwitches.inc();
+        const char* reason = !_selector.up(previous) ? "down"
+                           : _selector.failures(previous) ? "failures" : "faster";
+        LOG(LINK_SWITCH, name(previous), name(active), reason);
+    }
+};
+
+#endif // DUAL_NETWORK_MODULE_H
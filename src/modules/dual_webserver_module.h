@@ -0,0 +1,54 @@
+#ifndef DUAL_WEBSERVER_MODULE_H
+#define DUAL_WEBSERVER_MODULE_H
+
+/**
+ * @file dual_webserver_module.h
+ * @brief Web server listening on both Ethernet and WiFi
+ *
+ * Whichever link is up serves the dashboard, so it follows the uploads
+ * without a restart.
+ */
+
+#include "webserver_module.h"
+#include "wifi_webserver_module.h"
+
+class DualWebServerModule {
+public:
+    DualWebServerModule(uint16_t port) : _ethernet(port), _wifi(port) {}
+
+    void begin() {
+        _ethernet.begin();
+        _wifi.begin();
+    }
+
+    /**
+     * Listen again after a W5500 reset
+     */
+    void restartEthernet() {
+        _ethernet.begin();
+    }
+
+    /**
+     * The W5500 line still wakes the task, but WiFi has no interrupt
+     * source: returns false so the web task keeps polling
+     */
+    bool attachInterrupt(void (*isr)()) {
+        _ethernet.attachInterrupt(isr);
+        return false;
+    }
+
+    /**
+     * Serve every pending connection on both links
+     * @return false if the W5500 bus was busy; try again shortly
+     */
+    bool handle(const WebContext& ctx) {
+        _wifi.handle(ctx);
+        return _ethernet.handle(ctx);
+    }
+
+private:
+    WebServerModule _ethernet;
+    WiFiWebServerModule _wifi;
+};
+
+#endif // DUAL_WEBSERVER_MODULE_H
@@ -0,0 +1,154 @@
+#ifndef ETHERNET_BUS_H
+#define ETHERNET_BUS_H
+
+/**
+ * @file ethernet_bus.h
+ * @brief Serializes W5500 access between the uploader and web tasks
+ *
+ * The Ethernet library is not thread safe: every call is a sequence of
+ * SPI register transactions on one shared chip. The uploader wraps its
+ * client in LockedClient so the lock is held per call (the web task can
+ * run while it waits for a response); the web server holds it for a
+ * whole request. WiFi (lwIP sockets) needs none of this.
+ *
+ * Socket events (connect, data, disconnect) can wake the web task
+ * through the W5500 INTn line (W5500_INT_PIN); on the host the library
+ * shim signals pending connections instead, and the driver's simulator
+ * drives INTn itself.
+ *
+ * With W5500_DRIVER_ENABLE the chip runs on the driver in w5500.h and
+ * EthernetClient, EthernetServer and DNSClient name its classes;
+ * otherwise they are the Arduino Ethernet library's. Either way the
+ * interface itself is EthernetBus::ethernet.
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+#include "../config.h"
+#include "rtos.h"
+
+#ifndef W5500_INT_PIN
+#define W5500_INT_PIN   -1
+#endif
+
+#if W5500_DRIVER_ENABLE
+#include "w5500_ethernet.h"
+
+using EthernetClient = W5500Client;
+using EthernetServer = W5500Server;
+using DNSClient = W5500Dns;
+#else
+#include <SPI.h>
+#include <Ethernet.h>
+#include <Dns.h>
+#if defined(ARDUINO_NATIVE)
+#include <native_socket.h>
+#elif W5500_INT_PIN >= 0
+#include <utility/w5100.h>
+#endif
+#endif
+
+namespace EthernetBus {
+
+inline Rtos::Mutex mutex;
+
+#if W5500_DRIVER_ENABLE
+inline W5500EthernetClass& ethernet = W5500Ethernet;
+#else
+inline EthernetClass& ethernet = Ethernet;
+#endif
+
+#if !W5500_DRIVER_ENABLE && !defined(ARDUINO_NATIVE) && W5500_INT_PIN >= 0
+// W5500 registers: socket interrupt mask (common), per-socket mask/flags
+constexpr uint16_t REG_SIMR = 0x0018;
+constexpr uint16_t REG_SN_IMR = 0x002C;
+constexpr uint8_t SN_IR_EVENTS = 0x07;  // CON | DISCON | RECV
+
+inline void (*isrHandler)() = nullptr;
+#endif
+
+/**
+ * Unmask socket events on the chip (again after every chip reset);
+ * caller holds the mutex
+ */
+inline void enableInterrupts() {
+    #if W5500_DRIVER_ENABLE
+    // W5500Class::begin() unmasks them
+    #elif !defined(ARDUINO_NATIVE) && W5500_INT_PIN >= 0
+    if (!isrHandler) return;
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+    W5100.write(REG_SIMR, (uint8_t)0xFF);
+    for (uint8_t s = 0; s < MAX_SOCK_NUM; s++) {
+        W5100.writeSn(s, REG_SN_IMR, SN_IR_EVENTS);
+    }
+    SPI.endTransaction();
+    #endif
+}
+
+/**
+ * Call isr on socket events
+ * @return false without an interrupt line (the caller must poll)
+ */
+inline bool attachInterrupt(void (*isr)()) {
+    #if W5500_DRIVER_ENABLE
+    Rtos::LockGuard guard(mutex);
+    return W5500.attachInterrupt(isr);
+    #elif defined(ARDUINO_NATIVE)
+    nativeOnConnectionPending(isr);
+    return true;
+    #elif W5500_INT_PIN >= 0
+    Rtos::LockGuard guard(mutex);
+    isrHandler = isr;
+    enableInterrupts();
+    pinMode(W5500_INT_PIN, INPUT_PULLUP);
+    ::attachInterrupt(digitalPinToInterrupt(W5500_INT_PIN), isr, FALLING);
+    return true;
+    #else
+    (void)isr;
+    return false;
+    #endif
+}
+
+/**
+ * Acknowledge socket events so INTn releases and the next one gives a
+ * new edge; caller holds the mutex
+ */
+inline void clearInterrupts() {
+    #if W5500_DRIVER_ENABLE
+    W5500.serviceInterrupts();
+    #elif !defined(ARDUINO_NATIVE) && W5500_INT_PIN >= 0
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+    for (uint8_t s = 0; s < MAX_SOCK_NUM; s++) {
+        W5100.writeSnIR(s, SN_IR_EVENTS);
+    }
+    SPI.endTransaction();
+    #endif
+}
+
+} // namespace EthernetBus
+
+/**
+ * Client decorator that takes EthernetBus::mutex around every call
+ */
+class LockedClient : public Client {
+public:
+    explicit LockedClient(Client& client) : _client(client) {}
+
+    int connect(IPAddress ip, uint16_t port) override { Rtos::LockGuard g(EthernetBus::mutex); return _client.connect(ip, port); }
+    int connect(const char* host, uint16_t port) override { Rtos::LockGuard g(EthernetBus::mutex); return _client.connect(host, port); }
+    size_t write(uint8_t c) override { Rtos::LockGuard g(EthernetBus::mutex); return _client.write(c); }
+    size_t write(const uint8_t* buf, size_t size) override { Rtos::LockGuard g(EthernetBus::mutex); return _client.write(buf, size); }
+    int available() override { Rtos::LockGuard g(EthernetBus::mutex); return _client.available(); }
+    int read() override { Rtos::LockGuard g(EthernetBus::mutex); return _client.read(); }
+    int read(uint8_t* buf, size_t size) override { Rtos::LockGuard g(EthernetBus::mutex); return _client.read(buf, size); }
+    int peek() override { Rtos::LockGuard g(EthernetBus::mutex); return _client.peek(); }
+    void flush() override { Rtos::LockGuard g(EthernetBus::mutex); _client.flush(); }
+    void stop() override { Rtos::LockGuard g(EthernetBus::mutex); _client.stop(); }
+    uint8_t connected() override { Rtos::LockGuard g(EthernetBus::mutex); return _client.connected(); }
+    operator bool() override { Rtos::LockGuard g(EthernetBus::mutex); return (bool)_client; }
+
+private:
+    Client& _client;
+};
+
+#endif // ETHERNET_BUS_H
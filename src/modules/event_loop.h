@@ -0,0 +1,81 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+/**
+ * @file event_loop.h
+ * @brief Per-task event loop: timer wheel plus notification bits
+ *
+ * A task sleeps in wait() until its next timer is due or another task,
+ * a driver callback or an ISR posts event bits, instead of polling on a
+ * fixed delay. begin() registers the task with the task watchdog and
+ * feeds it from a periodic timer, so an idle task wakes only every
+ * WDT_FEED_MS.
+ */
+
+#include <Arduino.h>
+#include <esp_task_wdt.h>
+#include "../config.h"
+#include "metrics.h"
+#include "rtos.h"
+#include "timer_wheel.h"
+
+#ifndef WDT_FEED_MS
+#define WDT_FEED_MS     1000
+#endif
+
+class EventLoop {
+public:
+    /**
+     * @param busy Optional histogram of the time spent per wakeup
+     */
+    explicit EventLoop(Metrics::LoopTask task, Metrics::LoopHistogram* busy = nullptr)
+        : _wakeups(Metrics::registry.loopWakeups[(size_t)task]), _busy(busy) {}
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * Call from the owning task before anything else
+     */
+    void begin() {
+        _notifier.bind();
+        _timers.rebase(millis());
+        esp_task_wdt_add(NULL);
+        _timers.schedule(_feed, 0, WDT_FEED_MS);
+        _busySince = micros();
+    }
+
+    /**
+     * Wake the loop with event bits (any task or driver callback)
+     */
+    void post(uint32_t events) { _notifier.notify(events); }
+
+    void IRAM_ATTR postFromISR(uint32_t events) { _notifier.notifyFromISR(events); }
+
+    TimerWheel& timers() { return _timers; }
+
+    /**
+     * Sleep until a timer is due or events arrive, then run due timers
+     * @return event bits posted meanwhile
+     */
+    uint32_t wait() {
+        const uint32_t busyUs = micros() - _busySince;
+        if (_busy) _busy->observe(busyUs);
+        Metrics::registry.loopBusyMicros.inc(busyUs);
+        const uint32_t events = _notifier.wait(_timers.nextDueMs(millis()));
+        _busySince = micros();
+        _wakeups.inc();
+        _timers.advance(millis());
+        return events;
+    }
+
+private:
+    Rtos::Notifier _notifier;
+    TimerWheel _timers;
+    Timer _feed{[](void*) { esp_task_wdt_reset(); }, nullptr};
+    Metrics::Counter& _wakeups;
+    Metrics::LoopHistogram* const _busy;
+    uint32_t _busySince = 0;
+};
+
+#endif // EVENT_LOOP_H
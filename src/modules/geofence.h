@@ -0,0 +1,312 @@
+#ifndef GEOFENCE_H
+#define GEOFENCE_H
+
+/**
+ * @file geofence.h
+ * @brief Polygon geofences from a flash blob, with a uniform-grid index
+ *
+ * Coordinates are fixed point, 1e-7 degree (E7, as in UBX). A fix is
+ * looked up in one grid cell, the cell's fences are filtered by bounding
+ * box and tested by crossing number in 64-bit integer math, so the cost
+ * depends on the fences near the vessel, not on how many are loaded.
+ * Only fences the vessel is in, or about to enter, hold state
+ * (GEOFENCE_MAX_ACTIVE slots).
+ *
+ * Hysteresis: entering takes GEOFENCE_CONFIRM_FIXES consecutive fixes
+ * inside; leaving takes as many fixes at least GEOFENCE_EXIT_MARGIN_M
+ * outside the polygon, so GPS jitter on the boundary raises no events.
+ *
+ * Blob layout (little endian, 4-byte aligned; built by
+ * tools/geofence/build_fences.py):
+ *   GeofenceBlobHeader
+ *   GeofenceRecord[fenceCount]
+ *   GeofencePoint[vertexCount]            polygon rings, not closed
+ *   uint32_t cellStart[rows * cols + 1]    offsets into cellFences
+ *   uint16_t cellFences[cellEntryCount]    fences whose bbox meets the cell
+ * Polygons must span less than 90 degrees.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include "../config.h"
+
+#ifndef GEOFENCE_MAX_ACTIVE
+#define GEOFENCE_MAX_ACTIVE     16
+#endif
+#ifndef GEOFENCE_CONFIRM_FIXES
+#define GEOFENCE_CONFIRM_FIXES  3
+#endif
+#ifndef GEOFENCE_EXIT_MARGIN_M
+#define GEOFENCE_EXIT_MARGIN_M  30
+#endif
+#ifndef GEOFENCE_EVENT_QUEUE
+#define GEOFENCE_EVENT_QUEUE    8
+#endif
+
+enum class GeofenceKind : uint8_t {
+    PORT = 0,
+    ANCHORAGE,
+    RESTRICTED,
+    COUNT
+};
+
+inline const char* geofenceKindName(GeofenceKind kind) {
+    static const char* const names[] = {"port", "anchorage", "restricted"};
+    return kind < GeofenceKind::COUNT ? names[(size_t)kind] : "unknown";
+}
+
+struct GeofencePoint {
+    int32_t latE7;
+    int32_t lonE7;
+};
+
+struct GeofenceBlobHeader {
+    static constexpr uint32_t MAGIC = 0x314E4647;  // "GFN1"
+    uint32_t magic;
+    uint16_t version;
+    uint16_t fenceCount;
+    uint32_t vertexCount;
+    int32_t gridLatE7;      // South-west corner
+    int32_t gridLonE7;
+    uint32_t cellLatE7;     // Cell size
+    uint32_t cellLonE7;
+    uint16_t rows;
+    uint16_t cols;
+    uint32_t cellEntryCount;
+};
+
+struct GeofenceRecord {
+    uint16_t id;
+    uint8_t kind;           // GeofenceKind
+    uint8_t reserved;
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    GeofencePoint min;      // Bounding box
+    GeofencePoint max;
+};
+
+static_assert(sizeof(GeofenceBlobHeader) == 36, "blob header layout");
+static_assert(sizeof(GeofenceRecord) == 28, "blob record layout");
+
+/**
+ * Confirmed enter/exit transition
+ */
+struct GeofenceEvent {
+    uint16_t fenceId;
+    GeofenceKind kind;
+    bool entered;
+    int32_t latE7;
+    int32_t lonE7;
+};
+
+class GeofenceEngine {
+public:
+    /**
+     * Use a blob in place (it must stay mapped, e.g. a const array)
+     * @return false if the blob is malformed; the engine is then empty
+     */
+    bool load(const uint8_t* blob, size_t size) {
+        _header = nullptr;
+        _slotCount = 0;
+        if (!blob || ((uintptr_t)blob & 3) || size < sizeof(GeofenceBlobHeader)) return false;
+
+        const GeofenceBlobHeader* h = reinterpret_cast<const GeofenceBlobHeader*>(blob);
+        if (h->magic != GeofenceBlobHeader::MAGIC || h->version != 1) return false;
+
+        const size_t cells = (size_t)h->rows * h->cols;
+        size_t offset = sizeof(GeofenceBlobHeader);
+        const size_t fencesAt = offset;
+        offset += (size_t)h->fenceCount * sizeof(GeofenceRecord);
+        const size_t verticesAt = offset;
+        offset += (size_t)h->vertexCount * sizeof(GeofencePoint);
+        const size_t cellStartAt = offset;
+        offset += (cells + 1) * sizeof(uint32_t);
+        const size_t cellFencesAt = offset;
+        offset += (size_t)h->cellEntryCount * sizeof(uint16_t);
+        if (offset > size || cells == 0 || h->cellLatE7 == 0 || h->cellLonE7 == 0) return false;
+
+        _fences = reinterpret_cast<const GeofenceRecord*>(blob + fencesAt);
+        _vertices = reinterpret_cast<const GeofencePoint*>(blob + verticesAt);
+        _cellStart = reinterpret_cast<const uint32_t*>(blob + cellStartAt);
+        _cellFences = reinterpret_cast<const uint16_t*>(blob + cellFencesAt);
+
+        // Bounds checks here keep update() free of them
+        if (_cellStart[cells] != h->cellEntryCount) return false;
+        for (size_t i = 0; i < cells; i++) {
+            if (_cellStart[i] > _cellStart[i + 1]) return false;
+        }
+        for (uint32_t i = 0; i < h->cellEntryCount; i++) {
+            if (_cellFences[i] >= h->fenceCount) return false;
+        }
+        for (uint16_t i = 0; i < h->fenceCount; i++) {
+            const GeofenceRecord& f = _fences[i];
+            if (f.vertexCount < 3 || f.firstVertex + f.vertexCount > h->vertexCount) return false;
+        }
+
+        _header = h;
+        return true;
+    }
+
+    size_t fenceCount() const { return _header ? _header->fenceCount : 0; }
+
+    /**
+     * Fences currently confirmed inside
+     */
+    size_t insideCount() const {
+        size_t n = 0;
+        for (size_t i = 0; i < _slotCount; i++) n += _slots[i].inside;
+        return n;
+    }
+
+    /**
+     * Evaluate one fix
+     * @param events Receives confirmed transitions
+     * @return number of events written (at most maxEvents)
+     */
+    size_t update(int32_t latE7, int32_t lonE7, GeofenceEvent* events, size_t maxEvents) {
+        if (!_header) return 0;
+        const GeofencePoint p{latE7, lonE7};
+
+        for (size_t i = 0; i < _slotCount; i++) _slots[i].tested = false;
+
+        // Candidates: fences whose bounding box meets this cell
+        uint32_t cell;
+        if (cellOf(p, cell)) {
+            for (uint32_t i = _cellStart[cell]; i < _cellStart[cell + 1]; i++) {
+                const uint16_t fence = _cellFences[i];
+                const bool inside = contains(_fences[fence], p);
+                Slot* slot = find(fence);
+                if (!slot && inside) slot = claim(fence);
+                if (!slot) continue;
+                slot->tested = true;
+                slot->hit = inside;
+            }
+        }
+
+        // Tracked fences outside this cell's list do not contain the fix
+        size_t written = 0;
+        for (size_t i = 0; i < _slotCount;) {
+            Slot& s = _slots[i];
+            if (!s.tested) s.hit = false;
+
+            bool release = false;
+            bool transition = false;
+            if (!s.inside) {
+                if (!s.hit) {
+                    release = true;
+                } else if (++s.count >= GEOFENCE_CONFIRM_FIXES) {
+                    s.inside = true;
+                    s.count = 0;
+                    transition = true;
+                }
+            } else if (s.hit || distanceM(_fences[s.fence], p) < GEOFENCE_EXIT_MARGIN_M) {
+                s.count = 0;
+            } else if (++s.count >= GEOFENCE_CONFIRM_FIXES) {
+                transition = true;
+                release = true;
+            }
+
+            if (transition && written < maxEvents) {
+                const GeofenceRecord& f = _fences[s.fence];
+                events[written++] = GeofenceEvent{f.id, (GeofenceKind)f.kind, !release, latE7, lonE7};
+            }
+            if (release) {
+                s = _slots[--_slotCount];
+            } else {
+                i++;
+            }
+        }
+        return written;
+    }
+
+private:
+    struct Slot {
+        uint16_t fence;
+        uint8_t count;      // Consecutive fixes towards the other state
+        bool inside;        // Confirmed inside
+        bool tested;        // Evaluated for this fix
+        bool hit;           // Fix inside the polygon
+    };
+
+    const GeofenceBlobHeader* _header = nullptr;
+    const GeofenceRecord* _fences = nullptr;
+    const GeofencePoint* _vertices = nullptr;
+    const uint32_t* _cellStart = nullptr;
+    const uint16_t* _cellFences = nullptr;
+    Slot _slots[GEOFENCE_MAX_ACTIVE];
+    size_t _slotCount = 0;
+
+    bool cellOf(const GeofencePoint& p, uint32_t& cell) const {
+        const int64_t dLat = (int64_t)p.latE7 - _header->gridLatE7;
+        const int64_t dLon = (int64_t)p.lonE7 - _header->gridLonE7;
+        if (dLat < 0 || dLon < 0) return false;
+        const uint64_t row = (uint64_t)dLat / _header->cellLatE7;
+        const uint64_t col = (uint64_t)dLon / _header->cellLonE7;
+        if (row >= _header->rows || col >= _header->cols) return false;
+        cell = (uint32_t)(row * _header->cols + col);
+        return true;
+    }
+
+    Slot* find(uint16_t fence) {
+        for (size_t i = 0; i < _slotCount; i++) {
+            if (_slots[i].fence == fence) return &_slots[i];
+        }
+        return nullptr;
+    }
+
+    // Full: the fence is picked up on a later fix once a slot frees
+    Slot* claim(uint16_t fence) {
+        if (_slotCount == GEOFENCE_MAX_ACTIVE) return nullptr;
+        Slot& s = _slots[_slotCount++];
+        s = Slot{fence, 0, false, false, false};
+        return &s;
+    }
+
+    /**
+     * Crossing number; x = longitude, y = latitude
+     */
+    bool contains(const GeofenceRecord& f, const GeofencePoint& p) const {
+        if (p.latE7 < f.min.latE7 || p.latE7 > f.max.latE7 ||
+            p.lonE7 < f.min.lonE7 || p.lonE7 > f.max.lonE7) {
+            return false;
+        }
+
+        const GeofencePoint* v = _vertices + f.firstVertex;
+        bool inside = false;
+        for (uint32_t i = 0, j = f.vertexCount - 1; i < f.vertexCount; j = i++) {
+            const GeofencePoint& a = v[j];
+            const GeofencePoint& b = v[i];
+            if ((a.latE7 > p.latE7) == (b.latE7 > p.latE7)) continue;
+            // Which side of edge a->b is p on (sign flips with direction)
+            const int64_t cross = (int64_t)(b.lonE7 - a.lonE7) * (p.latE7 - a.latE7) -
+                                  (int64_t)(p.lonE7 - a.lonE7) * (b.latE7 - a.latE7);
+            if ((cross > 0) == (b.latE7 > a.latE7)) inside = !inside;
+        }
+        return inside;
+    }
+
+    /**
+     * Metres from p to the polygon boundary (local flat-earth frame;
+     * only run for fences the vessel is leaving)
+     */
+    float distanceM(const GeofenceRecord& f, const GeofencePoint& p) const {
+        static constexpr float METRES_PER_E7 = 0.0111319f;
+        const float kx = METRES_PER_E7 * cosf(p.latE7 * 1e-7f * (float)DEG_TO_RAD);
+        const GeofencePoint* v = _vertices + f.firstVertex;
+
+        float best = INFINITY;
+        for (uint32_t i = 0, j = f.vertexCount - 1; i < f.vertexCount; j = i++) {
+            const float ax = (v[j].lonE7 - p.lonE7) * kx, ay = (v[j].latE7 - p.latE7) * METRES_PER_E7;
+            const float bx = (v[i].lonE7 - p.lonE7) * kx, by = (v[i].latE7 - p.latE7) * METRES_PER_E7;
+            const float ex = bx - ax, ey = by - ay;
+            const float len2 = ex * ex + ey * ey;
+            float t = len2 > 0 ? -(ax * ex + ay * ey) / len2 : 0;
+            t = t < 0 ? 0 : (t > 1 ? 1 : t);
+            const float dx = ax + t * ex, dy = ay + t * ey;
+            best = min(best, dx * dx + dy * dy);
+        }
+        return sqrtf(best);
+    }
+};
+
+#endif // GEOFENCE_H
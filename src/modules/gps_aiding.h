@@ -0,0 +1,162 @@
+#ifndef GPS_AIDING_H
+#define GPS_AIDING_H
+
+/**
+ * @file gps_aiding.h
+ * @brief Last fix in NVS, replayed to the receiver for a warm start
+ *
+ * Unless its backup supply kept them, the NEO-M8N boots without
+ * position, time or ephemeris and needs minutes for a cold start. The
+ * last good position is kept in NVS and sent as UBX-MGA-INI-POS_LLH as
+ * soon as the receiver talks; the system time follows as
+ * UBX-MGA-INI-TIME_UTC when it survived the reset (ESP32 keeps it across
+ * software and watchdog resets, not power cycles). Ephemeris (MGA-DBD
+ * dumps, several KB) does not fit the default NVS partition and is left
+ * to the receiver's backup RAM.
+ *
+ * Writes are rate-limited by GPS_SAVE_MIN_MOVE_M to spare flash;
+ * save(fix, true) is for imminent power loss.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <math.h>
+#include "../config.h"
+#include "gps_module.h"
+
+#if defined(ESP_PLATFORM)
+#include <sys/time.h>
+#endif
+
+#ifndef GPS_SAVE_INTERVAL_MS
+#define GPS_SAVE_INTERVAL_MS    300000
+#endif
+#ifndef GPS_SAVE_MIN_MOVE_M
+#define GPS_SAVE_MIN_MOVE_M     200
+#endif
+#ifndef GPS_AIDING_POS_ACC_M
+#define GPS_AIDING_POS_ACC_M    5000
+#endif
+
+class GpsAiding {
+public:
+    /**
+     * Load the saved fix (setup(), before the GPS task starts)
+     * @return true if one was found
+     */
+    bool begin() {
+        Preferences prefs;
+        if (!prefs.begin(NVS_NAMESPACE, true)) return false;
+        Record r;
+        _hasSaved = prefs.getBytes(NVS_KEY, &r, sizeof(r)) == sizeof(r) && r.version == Record::VERSION;
+        prefs.end();
+        if (_hasSaved) _saved = r;
+        return _hasSaved;
+    }
+
+    /**
+     * Send position and, if known, time to the receiver (GPS task,
+     * once the receiver is up)
+     * @return false if there was nothing to send
+     */
+    bool push(GPSModule& gps) {
+        if (!_hasSaved) return false;
+        gps.sendPositionAiding(_saved.latitude, _saved.longitude, _saved.altitude, GPS_AIDING_POS_ACC_M);
+        const uint32_t now = clock();
+        if (now) gps.sendTimeAiding(now, 2);
+        return true;
+    }
+
+    bool hasSaved() const { return _hasSaved; }
+    double savedLatitude() const { return _saved.latitude; }
+    double savedLongitude() const { return _saved.longitude; }
+    uint32_t savedEpoch() const { return _saved.epoch; }
+
+    /**
+     * Persist a fix if it moved GPS_SAVE_MIN_MOVE_M from the saved one
+     * (upload task; NVS writes stall flash access for milliseconds)
+     * @param force Write even if it has not moved
+     * @return true if written
+     */
+    bool save(const GPSData& fix, bool force = false) {
+        if (!fix.valid) return false;
+        if (!force && _hasSaved &&
+            distanceM(_saved.latitude, _saved.longitude, fix.latitude, fix.longitude) < GPS_SAVE_MIN_MOVE_M) {
+            return false;
+        }
+
+        Record r;
+        r.version = Record::VERSION;
+        r.latitude = fix.latitude;
+        r.longitude = fix.longitude;
+        r.altitude = (float)fix.altitude;
+        r.epoch = fix.epoch;
+
+        Preferences prefs;
+        if (!prefs.begin(NVS_NAMESPACE)) return false;
+        const bool ok = prefs.putBytes(NVS_KEY, &r, sizeof(r)) == sizeof(r);
+        prefs.end();
+        if (ok) {
+            _saved = r;
+            _hasSaved = true;
+        }
+        return ok;
+    }
+
+    /**
+     * Set the system clock from a fix (GPS task, once per boot)
+     */
+    void syncClock(const GPSData& fix) {
+        if (_clockSynced || !fix.valid || fix.epoch == 0) return;
+        #if defined(ESP_PLATFORM)
+        const struct timeval tv = {(time_t)fix.epoch, 0};
+        settimeofday(&tv, nullptr);
+        #else
+        _hostClockOffset = fix.epoch - millis() / 1000;
+        #endif
+        _clockSynced = true;
+    }
+
+    /**
+     * UTC seconds, or 0 if the clock was never set since power-on
+     */
+    uint32_t clock() const {
+        #if defined(ESP_PLATFORM)
+        const time_t now = time(nullptr);
+        return now > MIN_VALID_EPOCH ? (uint32_t)now : 0;
+        #else
+        // A host process start is a power cycle
+        return _hostClockOffset ? _hostClockOffset + millis() / 1000 : 0;
+        #endif
+    }
+
+private:
+    static constexpr const char* NVS_NAMESPACE = "gps";
+    static constexpr const char* NVS_KEY = "fix";
+    static constexpr uint32_t MIN_VALID_EPOCH = 1700000000;  // 2023-11-14
+
+    struct Record {
+        static constexpr uint8_t VERSION = 1;
+        uint8_t version;
+        double latitude;
+        double longitude;
+        float altitude;
+        uint32_t epoch;
+    };
+
+    Record _saved = {};
+    bool _hasSaved = false;
+    bool _clockSynced = false;
+    #if !defined(ESP_PLATFORM)
+    uint32_t _hostClockOffset = 0;
+    #endif
+
+    // Equirectangular approximation, good to <1% at these distances
+    static double distanceM(double lat1, double lon1, double lat2, double lon2) {
+        const double x = radians(lon2 - lon1) * cos(radians((lat1 + lat2) / 2));
+        const double y = radians(lat2 - lat1);
+        return sqrt(x * x + y * y) * 6371000.0;
+    }
+};
+
+#endif // GPS_AIDING_H
@@ -3,6 +3,10 @@
 
 #include <Arduino.h>
 #include <TinyGPSPlus.h>
+#include "../config.h"
+#include "metrics.h"
+#include "seqlock.h"
+#include "trace.h"
 
 /**
  * GPS Data Structure - Stack allocated, no heap usage
@@ -14,7 +18,11 @@ struct GPSData {
     double altitude;
     double course;
     uint8_t satellites;
+    float hdop;         // 0 if unknown
     bool valid;
+    bool deadReckoned;  // Position predicted through a dropout (position filter)
+    uint32_t locationMs;    // millis() of the last position from the receiver
+    uint32_t epoch;     // Unix time (seconds), 0 if date/time unknown
     char datetime[24];  // Fixed buffer instead of String
 
     void clear() {
@@ -24,11 +32,59 @@ struct GPSData {
         altitude = 0.0;
         course = 0.0;
         satellites = 0;
+        hdop = 0.0f;
         valid = false;
+        deadReckoned = false;
+        locationMs = 0;
+        epoch = 0;
         datetime[0] = '\0';
     }
 };
 
+/**
+ * Convert a UTC calendar date/time to Unix epoch seconds (no timegm on ESP32)
+ */
+inline uint32_t gpsMakeEpoch(uint16_t year, uint8_t month, uint8_t day,
+                             uint8_t hour, uint8_t minute, uint8_t second) {
+    // Days from civil (Howard Hinnant), valid for years >= 1970
+    const int32_t y = (int32_t)year - (month <= 2 ? 1 : 0);
+    const int32_t era = y / 400;
+    const uint32_t yoe = (uint32_t)(y - era * 400);
+    const uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    const int32_t days = era * 146097 + (int32_t)doe - 719468;
+    return (uint32_t)days * 86400UL + hour * 3600UL + minute * 60UL + second;
+}
+
+struct GpsDateTime {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+};
+
+/**
+ * Unix epoch seconds back to UTC calendar date/time (inverse of gpsMakeEpoch)
+ */
+inline GpsDateTime gpsBreakEpoch(uint32_t epoch) {
+    // Civil from days (Howard Hinnant)
+    const uint32_t z = epoch / 86400 + 719468;
+    const uint32_t secs = epoch % 86400;
+    const uint32_t era = z / 146097;
+    const uint32_t doe = z - era * 146097;
+    const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const uint32_t mp = (5 * doy + 2) / 153;
+    const uint8_t month = mp < 10 ? mp + 3 : mp - 9;
+    return GpsDateTime{
+        (uint16_t)(yoe + era * 400 + (month <= 2 ? 1 : 0)), month,
+        (uint8_t)(doy - (153 * mp + 2) / 5 + 1),
+        (uint8_t)(secs / 3600), (uint8_t)(secs / 60 % 60), (uint8_t)(secs % 60)
+    };
+}
+
 /**
  * GPS Module Class - Encapsulates all GPS functionality
  */
@@ -39,10 +95,25 @@ public:
 
     bool begin() {
         _serial.begin(_baudRate, SERIAL_8N1, _rxPin, _txPin);
-        delay(100);
         return true;
     }
 
+    /**
+     * Callback when the UART has received data (from the UART driver
+     * task, not an ISR)
+     */
+    void onReceive(std::function<void(void)> callback) {
+        _serial.onReceive(callback);
+    }
+
+    /**
+     * Copy every UART byte poll() reads to tap (e.g. the gpsd stream);
+     * nullptr = none
+     */
+    void setTap(Print* tap) {
+        _tap = tap;
+    }
+
     /**
      * Read GPS data with timeout
      * @param data Reference to GPSData struct to fill
@@ -52,19 +123,133 @@ public:
     bool read(GPSData& data, uint32_t timeoutMs = 1000) {
         data.clear();
 
+        uint32_t bytesRead = 0;
         const uint32_t startTime = millis();
         while (millis() - startTime < timeoutMs) {
             while (_serial.available() > 0) {
-                if (_gps.encode(_serial.read())) {
-                    parseData(data);
-                }
+                bytesRead++;
+                encode(_serial.read(), data);
             }
             yield(); // Allow ESP32 background tasks
         }
 
+        updateMetrics(bytesRead);
         return data.valid;
     }
 
+    /**
+     * Parse whatever the UART has buffered, without waiting
+     * (continuous ingestion from the GPS task; data is not cleared)
+     * @return number of completed NMEA sentences
+     */
+    uint32_t poll(GPSData& data) {
+        TRACE_SPAN("GPSModule::poll");
+        const uint32_t start = micros();
+        uint32_t bytesRead = 0;
+        uint32_t sentences = 0;
+        uint8_t chunk[64];
+        size_t chunkLen = 0;
+        while (_serial.available() > 0) {
+            const uint8_t c = _serial.read();
+            bytesRead++;
+            if (encode(c, data)) sentences++;
+            if (!_tap) continue;
+            chunk[chunkLen++] = c;
+            if (chunkLen == sizeof(chunk)) {
+                _tap->write(chunk, chunkLen);
+                chunkLen = 0;
+            }
+        }
+        if (chunkLen) _tap->write(chunk, chunkLen);
+        if (bytesRead) {
+            // Bursts only: a wakeup that found nothing is no read
+            Metrics::registry.gpsRead.observe(micros() - start);
+            updateMetrics(bytesRead);
+        }
+        return sentences;
+    }
+
+    /**
+     * Feed one byte of NMEA into the parser
+     * @return true if a sentence completed and data was updated
+     */
+    bool encode(uint8_t c, GPSData& data) {
+        if (!_gps.encode(c)) return false;
+        parseData(data);
+        return true;
+    }
+
+    /**
+     * Send a UBX frame (class, id, payload; checksum appended)
+     */
+    void sendUbx(uint8_t cls, uint8_t id, const uint8_t* payload, uint16_t length) {
+        const uint8_t header[6] = {0xB5, 0x62, cls, id, (uint8_t)(length & 0xFF), (uint8_t)(length >> 8)};
+        uint8_t ckA = 0, ckB = 0;
+        for (size_t i = 2; i < sizeof(header); i++) { ckA += header[i]; ckB += ckA; }
+        for (uint16_t i = 0; i < length; i++) { ckA += payload[i]; ckB += ckA; }
+
+        _serial.write(header, sizeof(header));
+        if (length) _serial.write(payload, length);
+        _serial.write(ckA);
+        _serial.write(ckB);
+    }
+
+    /**
+     * Switch between continuous tracking and cyclic tracking power save
+     * (UBX-CFG-PM2 + UBX-CFG-RXM, RAM only; reverts on receiver reset)
+     * @param updatePeriodMs Fix period while in power save
+     */
+    void setPowerSave(bool enable, uint32_t updatePeriodMs) {
+        _serial.write(0xFF);  // Wakes the receiver if it is between fixes
+
+        if (enable) {
+            uint8_t pm2[44] = {};
+            pm2[0] = 0x01;                                   // version
+            putLE32(&pm2[4], UBX_PM2_MODE_CYCLIC | UBX_PM2_UPDATE_EPH);
+            putLE32(&pm2[8], updatePeriodMs);                // updatePeriod
+            putLE32(&pm2[12], max<uint32_t>(updatePeriodMs, 10000));  // searchPeriod
+            sendUbx(UBX_CLASS_CFG, UBX_CFG_PM2, pm2, sizeof(pm2));
+        }
+
+        const uint8_t rxm[2] = {0x08, (uint8_t)(enable ? 1 : 0)};  // reserved, lpMode
+        sendUbx(UBX_CLASS_CFG, UBX_CFG_RXM, rxm, sizeof(rxm));
+    }
+
+    /**
+     * Approximate position for a warm start (UBX-MGA-INI-POS_LLH)
+     * @param accuracyM 1-sigma uncertainty
+     */
+    void sendPositionAiding(double latitude, double longitude, double altitudeM, uint32_t accuracyM) {
+        uint8_t ini[20] = {};
+        ini[0] = UBX_MGA_INI_POS_LLH;                    // type (version 0)
+        putLE32(&ini[4], (uint32_t)(int32_t)lround(latitude * 1e7));
+        putLE32(&ini[8], (uint32_t)(int32_t)lround(longitude * 1e7));
+        putLE32(&ini[12], (uint32_t)(int32_t)lround(altitudeM * 100));
+        putLE32(&ini[16], min<uint32_t>(accuracyM, 40000000) * 100);  // cm
+        sendUbx(UBX_CLASS_MGA, UBX_MGA_INI, ini, sizeof(ini));
+    }
+
+    /**
+     * Current UTC time, applied on receipt (UBX-MGA-INI-TIME_UTC)
+     */
+    void sendTimeAiding(uint32_t epoch, uint16_t accuracyS) {
+        const GpsDateTime t = gpsBreakEpoch(epoch);
+        uint8_t ini[24] = {};
+        ini[0] = UBX_MGA_INI_TIME_UTC;                   // type (version 0)
+        ini[2] = 0;                                      // ref: none
+        ini[3] = 0x80;                                   // leapSecs: unknown (-128)
+        ini[4] = t.year & 0xFF;
+        ini[5] = t.year >> 8;
+        ini[6] = t.month;
+        ini[7] = t.day;
+        ini[8] = t.hour;
+        ini[9] = t.minute;
+        ini[10] = t.second;
+        ini[16] = accuracyS & 0xFF;                      // tAccS
+        ini[17] = accuracyS >> 8;
+        sendUbx(UBX_CLASS_MGA, UBX_MGA_INI, ini, sizeof(ini));
+    }
+
     /**
      * Get number of characters processed
      */
@@ -80,18 +265,50 @@ public:
     }
 
 private:
+    static constexpr uint8_t UBX_CLASS_CFG = 0x06;
+    static constexpr uint8_t UBX_CFG_RXM = 0x11;
+    static constexpr uint8_t UBX_CFG_PM2 = 0x3B;
+    static constexpr uint8_t UBX_CLASS_MGA = 0x13;
+    static constexpr uint8_t UBX_MGA_INI = 0x40;
+    static constexpr uint8_t UBX_MGA_INI_POS_LLH = 0x01;
+    static constexpr uint8_t UBX_MGA_INI_TIME_UTC = 0x10;
+    static constexpr uint32_t UBX_PM2_UPDATE_EPH = 1u << 12;
+    static constexpr uint32_t UBX_PM2_MODE_CYCLIC = 1u << 17;
+
     const uint8_t _rxPin;
     const uint8_t _txPin;
     const uint32_t _baudRate;
     HardwareSerial _serial;
     TinyGPSPlus _gps;
+    Print* _tap = nullptr;
+    uint32_t _lastPassed = 0;
+    uint32_t _lastFailed = 0;
+
+    static void putLE32(uint8_t* p, uint32_t v) {
+        p[0] = v & 0xFF;
+        p[1] = (v >> 8) & 0xFF;
+        p[2] = (v >> 16) & 0xFF;
+        p[3] = v >> 24;
+    }
+
+    void updateMetrics(uint32_t bytesRead) {
+        Metrics::Registry& metrics = Metrics::registry;
+        const uint32_t passed = _gps.passedChecksum();
+        const uint32_t failed = _gps.failedChecksum();
+        metrics.uartBytes.inc(bytesRead);
+        metrics.nmeaSentences.inc(passed - _lastPassed);
+        metrics.checksumFailures.inc(failed - _lastFailed);
+        _lastPassed = passed;
+        _lastFailed = failed;
+    }
 
     void parseData(GPSData& data) {
         // Location
-        if (_gps.location.isValid()) {
-            data.valid = true;
+        data.valid = _gps.location.isValid();
+        if (data.valid) {
             data.latitude = _gps.location.lat();
             data.longitude = _gps.location.lng();
+            data.locationMs = millis() - _gps.location.age();
         }
 
         // Speed (km/h)
@@ -105,6 +322,7 @@ private:
 
         // Satellites
         data.satellites = _gps.satellites.isValid() ? _gps.satellites.value() : 0;
+        data.hdop = _gps.hdop.isValid() ? (float)_gps.hdop.hdop() : 0.0f;
 
         // DateTime - use fixed buffer
         if (_gps.date.isValid() && _gps.time.isValid()) {
@@ -112,10 +330,58 @@ private:
                      "%04d-%02d-%02dT%02d:%02d:%02dZ",
                      _gps.date.year(), _gps.date.month(), _gps.date.day(),
                      _gps.time.hour(), _gps.time.minute(), _gps.time.second());
+            data.epoch = gpsMakeEpoch(_gps.date.year(), _gps.date.month(), _gps.date.day(),
+                                      _gps.time.hour(), _gps.time.minute(), _gps.time.second());
         } else {
             strncpy(data.datetime, "N/A", sizeof(data.datetime));
         }
     }
 };
 
+#ifndef GPS_FIX_MAX_AGE_MS
+#define GPS_FIX_MAX_AGE_MS  3000
+#endif
+
+/**
+ * Latest fix published by the GPS task (seqlock, readers never block it)
+ */
+class LatestFix {
+public:
+    void publish(const GPSData& data) {
+        _snapshot.write(Snapshot{data, (uint32_t)millis()});
+    }
+
+    /**
+     * Age limit for read(data); longer while the receiver reports only
+     * every few seconds (power save)
+     */
+    void setMaxAge(uint32_t maxAgeMs) { _maxAgeMs.store(maxAgeMs, std::memory_order_relaxed); }
+
+    bool read(GPSData& data) const { return read(data, _maxAgeMs.load(std::memory_order_relaxed)); }
+
+    /**
+     * Copy the latest fix; valid only if it is younger than maxAgeMs
+     * @return false if nothing was published yet
+     */
+    bool read(GPSData& data, uint32_t maxAgeMs) const {
+        Snapshot s;
+        if (_snapshot.read(s) == 0) {
+            data.clear();
+            return false;
+        }
+        data = s.data;
+        if (millis() - s.updatedMs > maxAgeMs) data.valid = false;
+        return true;
+    }
+
+private:
+    struct Snapshot {
+        GPSData data;
+        uint32_t updatedMs;
+    };
+
+    SeqLock<Snapshot> _snapshot;
+    std::atomic<uint32_t> _maxAgeMs{GPS_FIX_MAX_AGE_MS};
+};
+
 #endif // GPS_MODULE_H
@@ -0,0 +1,116 @@
+#ifndef GPSD_MODULE_H
+#define GPSD_MODULE_H
+
+/**
+ * @file gpsd_module.h
+ * @brief GPS stream servers on the tracker's links (see gpsd_server.h)
+ *
+ * Ethernet clients are limited by the W5500's free TX buffer, WiFi ones
+ * by a non-blocking lwIP send, so no client ever blocks the web task.
+ */
+
+#include <Arduino.h>
+#include "../config.h"
+#include "gpsd_server.h"
+
+#if LINK_DUAL_ENABLE || !WIFI_ENABLE
+#include "ethernet_bus.h"
+#include "webserver_module.h"
+
+#if W5500_DRIVER_ENABLE
+// Sockets of their own, so stream clients never hold up the web server
+struct EthernetStreamServer : W5500Server {
+    explicit EthernetStreamServer(uint16_t port) : W5500Server(port, W5500Pool::STREAM) {}
+};
+#else
+using EthernetStreamServer = ESP32EthernetServer;
+#endif
+
+struct EthernetStreamLink {
+    using Server = EthernetStreamServer;
+    using Client = EthernetClient;
+
+    // Bounded wait like the web server: the uploader may hold the bus
+    static bool lock() { return EthernetBus::mutex.tryLock(WEB_POLL_MS); }
+    static void unlock() { EthernetBus::mutex.unlock(); }
+    static Client accept(Server& server) { return server.accept(); }
+
+    static size_t send(Client& client, const uint8_t* data, size_t size) {
+        const int room = client.availableForWrite();
+        return room > 0 ? client.write(data, min(size, (size_t)room)) : 0;
+    }
+};
+#endif
+
+#if LINK_DUAL_ENABLE || WIFI_ENABLE
+#include <WiFi.h>
+#include <sys/socket.h>
+
+struct WiFiStreamLink {
+    using Server = WiFiServer;
+    using Client = WiFiClient;
+
+    static bool lock() { return true; }
+    static void unlock() {}
+    static Client accept(Server& server) { return server.available(); }
+
+    static size_t send(Client& client, const uint8_t* data, size_t size) {
+        const ssize_t n = ::send(client.fd(), data, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+        return n > 0 ? (size_t)n : 0;
+    }
+};
+#endif
+
+class GpsdModule {
+public:
+    explicit GpsdModule(GpsdFeed& feed)
+        #if LINK_DUAL_ENABLE
+        : _ethernet(feed, "ethernet"), _wifi(feed, "wifi") {}
+        #elif WIFI_ENABLE
+        : _wifi(feed, "wifi") {}
+        #else
+        : _ethernet(feed, "ethernet") {}
+        #endif
+
+    void begin() {
+        #if LINK_DUAL_ENABLE || !WIFI_ENABLE
+        _ethernet.begin();
+        #endif
+        #if LINK_DUAL_ENABLE || WIFI_ENABLE
+        _wifi.begin();
+        #endif
+    }
+
+    /**
+     * Listen again after a W5500 reset
+     */
+    void restartEthernet() {
+        #if LINK_DUAL_ENABLE || !WIFI_ENABLE
+        _ethernet.begin();
+        #endif
+    }
+
+    /**
+     * @return false if the W5500 bus was busy; try again shortly
+     */
+    bool handle() {
+        bool done = true;
+        #if LINK_DUAL_ENABLE || WIFI_ENABLE
+        done &= _wifi.handle();
+        #endif
+        #if LINK_DUAL_ENABLE || !WIFI_ENABLE
+        done &= _ethernet.handle();
+        #endif
+        return done;
+    }
+
+private:
+    #if LINK_DUAL_ENABLE || !WIFI_ENABLE
+    GpsdServer<EthernetStreamLink> _ethernet;
+    #endif
+    #if LINK_DUAL_ENABLE || WIFI_ENABLE
+    GpsdServer<WiFiStreamLink> _wifi;
+    #endif
+};
+
+#endif // GPSD_MODULE_H
@@ -0,0 +1,305 @@
+#ifndef GPSD_SERVER_H
+#define GPSD_SERVER_H
+
+/**
+ * @file gpsd_server.h
+ * @brief GPS stream over TCP for bridge software and data loggers
+ *
+ * Replaces splitting the receiver's serial line:
+ * - GPSD_PORT speaks the gpsd protocol subset clients use: VERSION on
+ *   connect, ?WATCH={"enable":true,"json":true} for TPV reports,
+ *   "nmea":true (or "raw":1) for the sentences instead, ?DEVICES and
+ *   ?VERSION.
+ * - GPSD_NMEA_PORT streams the UART sentences as soon as a client
+ *   connects (NMEA 0183 over TCP); 0 = off.
+ *
+ * The GPS task writes each stream once into a StreamRing (GpsdFeed) and
+ * every client is a cursor into it, served from the web task with
+ * non-blocking writes. A client whose socket buffer is full falls
+ * behind; one more than GPSD_MAX_LAG_PCT of the ring behind is
+ * disconnected, so a slow reader never holds up the GPS task or the
+ * other clients.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include "../config.h"
+#include "gps_module.h"
+#include "logger.h"
+#include "metrics.h"
+#include "stream_ring.h"
+
+#ifndef GPSD_PORT
+#define GPSD_PORT               2947
+#endif
+#ifndef GPSD_NMEA_PORT
+#define GPSD_NMEA_PORT          10110
+#endif
+#ifndef GPSD_MAX_CLIENTS
+#define GPSD_MAX_CLIENTS        3
+#endif
+#ifndef GPSD_NMEA_RING_BYTES
+#define GPSD_NMEA_RING_BYTES    4096
+#endif
+#ifndef GPSD_JSON_RING_BYTES
+#define GPSD_JSON_RING_BYTES    2048
+#endif
+#ifndef GPSD_MAX_LAG_PCT
+#define GPSD_MAX_LAG_PCT        75
+#endif
+#ifndef GPSD_DEVICE_PATH
+#define GPSD_DEVICE_PATH        "/dev/ttyS2"    // Device name reported to clients
+#endif
+
+/**
+ * The two streams, written by the GPS task
+ */
+class GpsdFeed {
+public:
+    StreamRing<GPSD_NMEA_RING_BYTES> nmea;  // UART bytes (GPSModule tap)
+    StreamRing<GPSD_JSON_RING_BYTES> json;  // TPV reports
+
+    /**
+     * One TPV report per epoch, and one when the fix is lost
+     */
+    void publishFix(const GPSData& fix) {
+        char line[256];
+        const size_t len = formatTpv(line, sizeof(line), fix);
+        if (len) json.write((const uint8_t*)line, len);
+    }
+
+    /**
+     * Anyone connected? The GPS task wakes the web task only then
+     */
+    bool watched() const { return _clients.load(std::memory_order_relaxed) != 0; }
+
+    void addClient() { Metrics::registry.gpsdClients.set(_clients.fetch_add(1, std::memory_order_relaxed) + 1); }
+    void removeClient() { Metrics::registry.gpsdClients.set(_clients.fetch_sub(1, std::memory_order_relaxed) - 1); }
+
+    static size_t formatTpv(char* out, size_t size, const GPSData& fix) {
+        char time[48] = "";     // Room for any uint16_t year
+        if (fix.epoch) {
+            const GpsDateTime t = gpsBreakEpoch(fix.epoch);
+            snprintf(time, sizeof(time), ",\"time\":\"%04u-%02u-%02uT%02u:%02u:%02u.000Z\"",
+                     t.year, t.month, t.day, t.hour, t.minute, t.second);
+        }
+        int len;
+        if (!fix.valid) {
+            len = snprintf(out, size, "{\"class\":\"TPV\",\"device\":\"" GPSD_DEVICE_PATH "\",\"mode\":1%s}\r\n", time);
+        } else {
+            len = snprintf(out, size,
+                "{\"class\":\"TPV\",\"device\":\"" GPSD_DEVICE_PATH "\",\"mode\":%u%s%s,\"lat\":%.7f,\"lon\":%.7f,"
+                "\"altMSL\":%.1f,\"track\":%.1f,\"speed\":%.2f}\r\n",
+                fix.satellites >= 4 ? 3 : 2, fix.deadReckoned ? ",\"status\":6" : "", time,
+                fix.latitude, fix.longitude, fix.altitude, fix.course, fix.speed / 3.6);
+        }
+        return len > 0 && (size_t)len < size ? (size_t)len : 0;
+    }
+
+private:
+    std::atomic<uint32_t> _clients{0};
+};
+
+/**
+ * Stream server on one link. Link provides the socket types and how to
+ * use them without blocking:
+ *   using Server, Client; static bool lock(); static void unlock();
+ *   static Client accept(Server&); static size_t send(Client&, const uint8_t*, size_t);
+ */
+template <typename Link, size_t MAX_CLIENTS = GPSD_MAX_CLIENTS>
+class GpsdServer {
+public:
+    explicit GpsdServer(GpsdFeed& feed, const char* name = "")
+        : _feed(feed), _name(name), _gpsd(GPSD_PORT), _raw(GPSD_NMEA_PORT ? GPSD_NMEA_PORT : GPSD_PORT) {}
+
+    void begin() {
+        if (!Link::lock()) return;
+        _gpsd.begin();
+        if (GPSD_NMEA_PORT) _raw.begin();
+        Link::unlock();
+    }
+
+    /**
+     * Accept, answer requests and send what each client is missing
+     * @return false if the link was busy; try again shortly
+     */
+    bool handle() {
+        if (!Link::lock()) return false;
+        acceptFrom(_gpsd, Mode::COMMAND);
+        if (GPSD_NMEA_PORT) acceptFrom(_raw, Mode::NMEA);
+
+        for (Slot& s : _slots) {
+            if (s.mode == Mode::FREE) continue;
+            if (!s.client.connected()) {
+                close(s);
+                continue;
+            }
+            readRequests(s);
+            if (s.mode == Mode::NMEA) pump(s, _feed.nmea);
+            else if (s.mode == Mode::JSON) pump(s, _feed.json);
+        }
+        Link::unlock();
+        return true;
+    }
+
+    size_t clients() const { return _count; }
+
+private:
+    enum class Mode : uint8_t { FREE, COMMAND, JSON, NMEA };
+
+    struct Slot {
+        typename Link::Client client;
+        Mode mode = Mode::FREE;
+        bool midLine = false;   // Stream stopped inside a line: replies wait
+        uint32_t cursor = 0;
+        uint8_t requestLen = 0;
+        char request[96];
+    };
+
+    GpsdFeed& _feed;
+    const char* _name;
+    typename Link::Server _gpsd;
+    typename Link::Server _raw;
+    Slot _slots[MAX_CLIENTS];
+    size_t _count = 0;
+
+    void acceptFrom(typename Link::Server& server, Mode mode) {
+        for (;;) {
+            typename Link::Client client = Link::accept(server);
+            if (!client) return;
+
+            Slot* slot = nullptr;
+            for (Slot& s : _slots) {
+                if (s.mode == Mode::FREE) { slot = &s; break; }
+            }
+            if (!slot) {
+                Metrics::registry.gpsdRefused.inc();
+                LOG(GPSD_REFUSED, _name, (unsigned)_count);
+                client.stop();
+                continue;
+            }
+
+            slot->client = client;
+            slot->mode = mode;
+            slot->midLine = false;
+            slot->requestLen = 0;
+            slot->cursor = (mode == Mode::NMEA ? _feed.nmea.head() : _feed.json.head());
+            _count++;
+            _feed.addClient();
+            LOG(GPSD_CLIENT, mode == Mode::NMEA ? "NMEA" : "gpsd", _name, (unsigned)_count, (unsigned)MAX_CLIENTS);
+            if (mode == Mode::COMMAND) reply(*slot, versionReply());
+        }
+    }
+
+    void close(Slot& s) {
+        s.client.stop();
+        s.mode = Mode::FREE;
+        _count--;
+        _feed.removeClient();
+    }
+
+    /**
+     * Send from the client's cursor until it is up to date or its socket
+     * buffer is full
+     */
+    template <size_t N>
+    void pump(Slot& s, const StreamRing<N>& ring) {
+        const uint32_t head = ring.head();
+        if (head - s.cursor > N * GPSD_MAX_LAG_PCT / 100) {
+            drop(s, head - s.cursor);
+            return;
+        }
+        while (s.cursor != head) {
+            const uint8_t* data;
+            const size_t n = ring.peek(s.cursor, head, data);
+            const size_t sent = Link::send(s.client, data, n);
+            if (!ring.intact(s.cursor)) {
+                drop(s, N);    // Overwritten while it was being sent
+                return;
+            }
+            if (sent == 0) break;
+            s.cursor += (uint32_t)sent;
+            s.midLine = data[sent - 1] != '\n';
+            Metrics::registry.gpsdSentBytes.inc(sent);
+            if (sent < n) break;
+        }
+    }
+
+    void drop(Slot& s, uint32_t lagBytes) {
+        Metrics::registry.gpsdDropped.inc();
+        LOG(GPSD_DROPPED, _name, (unsigned)lagBytes);
+        close(s);
+    }
+
+    /**
+     * Requests end with ';' or a newline; NMEA clients' input is discarded
+     */
+    void readRequests(Slot& s) {
+        if (s.midLine) return;
+        while (s.client.available() > 0 && s.mode != Mode::FREE && !s.midLine) {
+            const int c = s.client.read();
+            if (c < 0) break;
+            if (s.mode == Mode::NMEA) continue;
+            if (c == ';' || c == '\n' || c == '\r') {
+                s.request[s.requestLen] = '\0';
+                if (s.requestLen) handleRequest(s);
+                s.requestLen = 0;
+            } else if (s.requestLen < sizeof(s.request) - 1) {
+                s.request[s.requestLen++] = (char)c;
+            }
+        }
+    }
+
+    void handleRequest(Slot& s) {
+        const char* r = s.request;
+        if (strncmp(r, "?WATCH", 6) == 0) {
+            if (r[6] == '=') watch(s, r + 7);
+            char line[160];
+            snprintf(line, sizeof(line),
+                     "{\"class\":\"WATCH\",\"enable\":%s,\"json\":%s,\"nmea\":%s,\"raw\":0,"
+                     "\"scaled\":false,\"timing\":false,\"split24\":false,\"pps\":false}\r\n",
+                     s.mode == Mode::COMMAND ? "false" : "true",
+                     s.mode == Mode::JSON ? "true" : "false", s.mode == Mode::NMEA ? "true" : "false");
+            reply(s, line);
+        } else if (strcmp(r, "?VERSION") == 0) {
+            reply(s, versionReply());
+        } else if (strcmp(r, "?DEVICES") == 0) {
+            reply(s, devicesReply());
+        } else {
+            char line[160];
+            snprintf(line, sizeof(line), "{\"class\":\"ERROR\",\"message\":\"Unrecognized request '%.40s'\"}\r\n", r);
+            reply(s, line);
+        }
+    }
+
+    void watch(Slot& s, const char* json) {
+        StaticJsonDocument<192> doc;
+        if (deserializeJson(doc, json) != DeserializationError::Ok) return;
+        const bool enable = doc["enable"] | true;
+        const bool nmea = (doc["nmea"] | false) || (doc["raw"] | 0) > 0;
+        const Mode mode = !enable ? Mode::COMMAND : nmea ? Mode::NMEA : Mode::JSON;
+        if (mode == s.mode) return;
+
+        // New data only, like gpsd
+        if (mode != Mode::COMMAND) reply(s, devicesReply());
+        s.mode = mode;
+        s.cursor = mode == Mode::NMEA ? _feed.nmea.head() : _feed.json.head();
+    }
+
+    static const char* versionReply() {
+        return "{\"class\":\"VERSION\",\"release\":\"" FIRMWARE_VERSION "\",\"rev\":\"esp32-gps-tracker\","
+               "\"proto_major\":3,\"proto_minor\":14}\r\n";
+    }
+
+    static const char* devicesReply() {
+        return "{\"class\":\"DEVICES\",\"devices\":[{\"class\":\"DEVICE\",\"path\":\"" GPSD_DEVICE_PATH "\","
+               "\"driver\":\"NMEA0183\",\"flags\":1,\"native\":0}]}\r\n";
+    }
+
+    void reply(Slot& s, const char* line) {
+        Link::send(s.client, (const uint8_t*)line, strlen(line));
+    }
+};
+
+#endif // GPSD_SERVER_H
@@ -0,0 +1,150 @@
+#ifndef HTTP_DOWNLOAD_H
+#define HTTP_DOWNLOAD_H
+
+/**
+ * @file http_download.h
+ * @brief Streaming HTTP GET shared by the network modules (OTA patches)
+ *
+ * The body goes to a Print chunk by chunk as it arrives, so a download
+ * of any size needs one HTTP_DOWNLOAD_CHUNK buffer. The sink can stop
+ * the transfer by accepting less than it was given. Needs a
+ * Content-Length or a body that ends with the connection; chunked
+ * responses are refused.
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+#include <esp_task_wdt.h>
+#include "arena.h"
+#include "logger.h"
+#include "trace.h"
+
+#ifndef HTTP_DOWNLOAD_CHUNK
+#define HTTP_DOWNLOAD_CHUNK     512
+#endif
+#ifndef HTTP_DOWNLOAD_IDLE_MS
+#define HTTP_DOWNLOAD_IDLE_MS   10000   // No data for this long ends the transfer
+#endif
+
+namespace HttpDownload {
+
+struct Result {
+    int16_t statusCode;     // 0 = no response
+    uint32_t bytes;         // Body bytes the sink took
+    bool complete;          // Whole body delivered and taken
+};
+
+/**
+ * One line of the response head, without the line end
+ * @return false on timeout or a line longer than size
+ */
+inline bool readLine(Client& client, char* line, size_t size, uint32_t timeoutMs) {
+    size_t len = 0;
+    uint32_t lastData = millis();
+    for (;;) {
+        if (client.available() <= 0) {
+            if (!client.connected() || millis() - lastData > timeoutMs) return false;
+            yield();
+            continue;
+        }
+        const int c = client.read();
+        if (c < 0) continue;
+        lastData = millis();
+        if (c == '\n') break;
+        if (len + 1 >= size) return false;
+        line[len++] = (char)c;
+    }
+    if (len && line[len - 1] == '\r') len--;
+    line[len] = '\0';
+    return true;
+}
+
+/**
+ * GET on an already-resolved address; the body of a 200 goes to body
+ * @param arena The calling task's per-cycle arena
+ */
+inline Result get(Client& client, IPAddress ip, const char* host, const char* path, uint16_t port,
+                  Print& body, Arena& arena = Memory::cycle) {
+    TRACE_SPAN("httpGet");
+    Result result = {0, 0, false};
+    ArenaScope scope(arena);
+    char* buffer = arena.allocChars(HTTP_DOWNLOAD_CHUNK);
+    if (!buffer) {
+        LOG(HTTP_NO_BUFFER, arena.name());
+        return result;
+    }
+
+    if (!client.connect(ip, port)) {
+        LOG(HTTP_CONNECT_FAILED);
+        client.stop();
+        return result;
+    }
+    const int len = snprintf(buffer, HTTP_DOWNLOAD_CHUNK,
+                             "GET %s HTTP/1.1\r\n"
+                             "Host: %s\r\n"
+                             "Connection: close\r\n"
+                             "\r\n",
+                             path, host);
+    if (len <= 0 || len >= HTTP_DOWNLOAD_CHUNK) {
+        client.stop();
+        return result;
+    }
+    client.write((const uint8_t*)buffer, len);
+
+    // Status line and the headers that matter
+    if (!readLine(client, buffer, HTTP_DOWNLOAD_CHUNK, HTTP_DOWNLOAD_IDLE_MS)) {
+        LOG(HTTP_NO_RESPONSE);
+        client.stop();
+        return result;
+    }
+    const char* code = strchr(buffer, ' ');
+    result.statusCode = code ? (int16_t)atoi(code + 1) : 0;
+    int64_t contentLength = -1;
+    bool chunked = false;
+    while (readLine(client, buffer, HTTP_DOWNLOAD_CHUNK, HTTP_DOWNLOAD_IDLE_MS) && buffer[0]) {
+        if (strncasecmp(buffer, "Content-Length:", 15) == 0) contentLength = strtoll(buffer + 15, nullptr, 10);
+        else if (strncasecmp(buffer, "Transfer-Encoding:", 18) == 0) {
+            const char* value = buffer + 18;
+            while (*value == ' ') value++;
+            chunked = strncasecmp(value, "chunked", 7) == 0;
+        }
+    }
+    if (result.statusCode != 200 || chunked) {
+        client.stop();
+        return result;
+    }
+
+    uint32_t lastData = millis();
+    while (contentLength < 0 || result.bytes < contentLength) {
+        const int available = client.available();
+        if (available <= 0) {
+            if (!client.connected()) {
+                result.complete = contentLength < 0;    // Body ends with the connection
+                break;
+            }
+            if (millis() - lastData > HTTP_DOWNLOAD_IDLE_MS) {
+                LOG(HTTP_NO_RESPONSE);
+                break;
+            }
+            yield();
+            continue;
+        }
+        size_t want = min((size_t)available, (size_t)HTTP_DOWNLOAD_CHUNK);
+        if (contentLength >= 0) want = min(want, (size_t)(contentLength - result.bytes));
+        const int n = client.read((uint8_t*)buffer, want);
+        if (n <= 0) continue;
+        lastData = millis();
+        const size_t taken = body.write((const uint8_t*)buffer, n);
+        result.bytes += taken;
+        if (taken < (size_t)n) break;   // The sink has had enough
+        esp_task_wdt_reset();           // Long transfers run inside one event
+    }
+    if (contentLength >= 0 && result.bytes == contentLength) result.complete = true;
+
+    client.stop();
+    return result;
+}
+
+} // namespace HttpDownload
+
+#endif // HTTP_DOWNLOAD_H
@@ -0,0 +1,146 @@
+#ifndef HTTP_REQUEST_H
+#define HTTP_REQUEST_H
+
+/**
+ * @file http_request.h
+ * @brief Minimal HTTP request parser for the built-in web server
+ *
+ * Reads the request line and the few headers we care about into fixed
+ * buffers. Everything else is discarded as it streams in.
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+
+struct HttpRequest {
+    char method[8];
+    char path[48];
+    char query[96];
+    char range[48];     // "Range" header value
+    char ifRange[40];   // "If-Range" header value
+
+    /**
+     * Read request line and headers from client
+     * @param client Connected client
+     * @param timeoutMs Time allowed for the complete header block
+     * @return true if a complete request header was received
+     */
+    bool read(Client& client, uint32_t timeoutMs = 2000) {
+        method[0] = path[0] = query[0] = range[0] = ifRange[0] = '\0';
+
+        char line[128];
+        bool firstLine = true;
+        const uint32_t startTime = millis();
+
+        while (client.connected() && millis() - startTime < timeoutMs) {
+            if (!readLine(client, line, sizeof(line), startTime, timeoutMs)) {
+                return false;
+            }
+            if (line[0] == '\0') {
+                return !firstLine;  // Blank line ends the header block
+            }
+            if (firstLine) {
+                if (!parseRequestLine(line)) return false;
+                firstLine = false;
+            } else {
+                parseHeader(line);
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Copy value of a query parameter into out
+     * @return true if the parameter is present
+     */
+    bool param(const char* name, char* out, size_t outSize) const {
+        const size_t nameLen = strlen(name);
+        const char* p = query;
+        while (*p) {
+            const char* end = strchr(p, '&');
+            if (!end) end = p + strlen(p);
+            if ((size_t)(end - p) > nameLen && strncmp(p, name, nameLen) == 0 && p[nameLen] == '=') {
+                const char* value = p + nameLen + 1;
+                const size_t len = min((size_t)(end - value), outSize - 1);
+                memcpy(out, value, len);
+                out[len] = '\0';
+                return true;
+            }
+            p = *end ? end + 1 : end;
+        }
+        return false;
+    }
+
+    /**
+     * Numeric query parameter with default
+     */
+    uint32_t paramUInt(const char* name, uint32_t defaultValue) const {
+        char value[16];
+        if (!param(name, value, sizeof(value)) || value[0] == '\0') return defaultValue;
+        return strtoul(value, nullptr, 10);
+    }
+
+    bool isPath(const char* p) const {
+        return strcmp(path, p) == 0;
+    }
+
+private:
+    static bool readLine(Client& client, char* line, size_t lineSize,
+                         uint32_t startTime, uint32_t timeoutMs) {
+        size_t len = 0;
+        while (millis() - startTime < timeoutMs) {
+            if (!client.available()) {
+                if (!client.connected()) return false;
+                yield();
+                continue;
+            }
+            const char c = client.read();
+            if (c == '\n') {
+                line[len] = '\0';
+                return true;
+            }
+            if (c != '\r' && len < lineSize - 1) {
+                line[len++] = c;  // Overlong lines are truncated
+            }
+        }
+        return false;
+    }
+
+    bool parseRequestLine(char* line) {
+        char* target = strchr(line, ' ');
+        if (!target) return false;
+        *target++ = '\0';
+        char* version = strchr(target, ' ');
+        if (version) *version = '\0';
+
+        strncpy(method, line, sizeof(method) - 1);
+        method[sizeof(method) - 1] = '\0';
+
+        char* q = strchr(target, '?');
+        if (q) {
+            *q++ = '\0';
+            strncpy(query, q, sizeof(query) - 1);
+            query[sizeof(query) - 1] = '\0';
+        }
+        strncpy(path, target, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+        return true;
+    }
+
+    void parseHeader(const char* line) {
+        copyHeader(line, "Range:", range, sizeof(range));
+        copyHeader(line, "If-Range:", ifRange, sizeof(ifRange));
+    }
+
+    static void copyHeader(const char* line, const char* name, char* out, size_t outSize) {
+        const size_t nameLen = strlen(name);
+        if (strncasecmp(line, name, nameLen) != 0) return;
+        const char* value = line + nameLen;
+        while (*value == ' ') value++;
+        const size_t len = strnlen(value, outSize - 1);
+        memcpy(out, value, len);
+        out[len] = '\0';
+    }
+};
+
+#endif // HTTP_REQUEST_H
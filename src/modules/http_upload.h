@@ -0,0 +1,335 @@
+#ifndef HTTP_UPLOAD_H
+#define HTTP_UPLOAD_H
+
+/**
+ * @file http_upload.h
+ * @brief Webhook upload shared by the Ethernet and WiFi network modules
+ *
+ * Everything here works on a plain Client, so both transports share one
+ * payload format and one request/response path.
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+#include <ArduinoJson.h>
+#include "arena.h"
+#include "geofence.h"
+#include "gps_module.h"
+#include "logger.h"
+#include "metrics.h"
+#include "route_tracker.h"
+#include "trace.h"
+#include "trip_analytics.h"
+
+/**
+ * HTTP Response Structure
+ */
+struct HttpResponse {
+    static constexpr uint32_t NO_ACK = 0xFFFFFFFF;
+
+    int16_t statusCode;
+    bool success;
+    uint32_t ackSeq = NO_ACK;   // X-Ack-Seq: server has every report up to this sequence
+};
+
+namespace HttpUpload {
+
+/**
+ * Optional report content beyond the periodic position
+ */
+struct ReportExtras {
+    const GeofenceEvent* geofence = nullptr;    // Out-of-band transition report
+    const RouteEvent* routeEvent = nullptr;     // Out-of-band corridor report
+    const RouteStatus* route = nullptr;         // Cross-track, progress, ETA
+    const TripEvent* tripEvent = nullptr;       // Out-of-band trip start/end report
+    const TripStatus* trip = nullptr;           // Odometer, motion, trip so far
+    uint32_t seq = 0;                           // Report sequence number, 0 = none
+    uint32_t seqBase = 0;                       // Oldest sequence the device still holds
+};
+
+/**
+ * Trip summary fields (speeds in km/h, one decimal)
+ */
+inline void addTripSummary(JsonDocument& doc, const TripSummary& trip) {
+    doc["trip_id"] = trip.id;
+    if (trip.startEpoch) doc["trip_start"] = trip.startEpoch;
+    if (trip.endEpoch) doc["trip_end"] = trip.endEpoch;
+    doc["trip_m"] = trip.distanceM;
+    doc["trip_moving_sec"] = trip.movingS;
+    doc["trip_stopped_sec"] = trip.stoppedS;
+    doc["trip_stops"] = trip.stops;
+    doc["speed_max_kmh"] = lroundf(trip.maxSpeedCms * 0.36f) / 10.0;
+    doc["speed_avg_kmh"] = lroundf(trip.avgSpeedCms * 0.36f) / 10.0;
+    doc["speed_sd_kmh"] = lroundf(trip.speedSdCms * 0.36f) / 10.0;
+}
+
+/**
+ * Name of the out-of-band event a report carries, nullptr for none
+ */
+inline const char* eventName(const ReportExtras& extras) {
+    if (extras.geofence) return extras.geofence->entered ? "geofence_enter" : "geofence_exit";
+    if (extras.routeEvent) return extras.routeEvent->breach ? "corridor_breach" : "corridor_return";
+    if (extras.tripEvent) return extras.tripEvent->ended ? "trip_end" : "trip_start";
+    return nullptr;
+}
+
+/**
+ * Build JSON payload into buffer (no heap allocation)
+ */
+inline void buildJsonPayload(char* buffer, size_t bufferSize, const char* deviceId,
+                             const GPSData& gpsData, const char* localIP,
+                             const ReportExtras& extras = {}) {
+    TRACE_SPAN("buildJsonPayload");
+    StaticJsonDocument<JSON_BUFFER_SIZE> doc;
+
+    doc["device_id"] = deviceId;
+    if (extras.seq) {
+        doc["seq"] = extras.seq;
+        doc["seq_base"] = extras.seqBase;
+    }
+
+    if (gpsData.valid) {
+        doc["status"] = "online";
+        doc["latitude"] = gpsData.latitude;
+        doc["longitude"] = gpsData.longitude;
+        doc["speed"] = gpsData.speed;
+        doc["altitude"] = gpsData.altitude;
+        doc["course"] = gpsData.course;
+        doc["satellites"] = gpsData.satellites;
+        if (gpsData.hdop > 0) doc["hdop"] = lroundf(gpsData.hdop * 10) / 10.0;
+        if (gpsData.deadReckoned) doc["dead_reckoned"] = true;
+        doc["timestamp"] = gpsData.datetime;
+    } else {
+        doc["status"] = "no_fix";
+        doc["satellites"] = gpsData.satellites;
+    }
+
+    if (const char* event = eventName(extras)) doc["event"] = event;
+    if (extras.geofence) {
+        doc["fence_id"] = extras.geofence->fenceId;
+        doc["fence_kind"] = geofenceKindName(extras.geofence->kind);
+    }
+    if (extras.route && extras.route->onRoute) {
+        doc["cross_track_m"] = lroundf(extras.route->crossTrackM);
+        doc["route_progress_m"] = lroundf(extras.route->progressM);
+        doc["in_corridor"] = extras.route->inCorridor;
+        if (extras.route->remainingM > 0) doc["next_port_id"] = extras.route->nextPortId;
+        if (extras.route->etaSeconds) doc["eta_sec"] = extras.route->etaSeconds;
+    }
+    if (extras.trip) {
+        doc["odometer_m"] = extras.trip->odometerM;
+        doc["motion"] = motionName(extras.trip->motion);
+        doc["dwell_sec"] = extras.trip->dwellS;
+    }
+    if (extras.tripEvent) {
+        addTripSummary(doc, extras.tripEvent->trip);
+    } else if (extras.trip && extras.trip->inTrip) {
+        addTripSummary(doc, extras.trip->trip);
+    }
+
+    // Add system info
+    doc["ip"] = localIP;
+    doc["uptime_sec"] = millis() / 1000;
+    doc["free_heap"] = ESP.getFreeHeap();
+
+    serializeJson(doc, buffer, bufferSize);
+}
+
+/**
+ * Build the JSON payload in the arena
+ * @return nullptr if the arena is exhausted
+ */
+inline char* buildJsonPayload(Arena& arena, const char* deviceId, const GPSData& gpsData,
+                              const char* localIP, const ReportExtras& extras = {}) {
+    char* buffer = arena.allocChars(JSON_BUFFER_SIZE);
+    if (!buffer) {
+        LOG(HTTP_NO_BUFFER, arena.name());
+        return nullptr;
+    }
+    buildJsonPayload(buffer, JSON_BUFFER_SIZE, deviceId, gpsData, localIP, extras);
+    return buffer;
+}
+
+/**
+ * Compact position report: fix, sequence and event name only, for
+ * destinations that want no device or trip detail
+ */
+inline void buildPositionPayload(char* buffer, size_t bufferSize, const char* deviceId,
+                                 const GPSData& gpsData, const ReportExtras& extras = {}) {
+    TRACE_SPAN("buildPositionPayload");
+    StaticJsonDocument<256> doc;
+
+    doc["device_id"] = deviceId;
+    if (extras.seq) doc["seq"] = extras.seq;
+    if (gpsData.valid) {
+        doc["latitude"] = gpsData.latitude;
+        doc["longitude"] = gpsData.longitude;
+        doc["speed"] = gpsData.speed;
+        doc["course"] = gpsData.course;
+        doc["timestamp"] = gpsData.datetime;
+    } else {
+        doc["status"] = "no_fix";
+    }
+    if (const char* event = eventName(extras)) doc["event"] = event;
+
+    serializeJson(doc, buffer, bufferSize);
+}
+
+/**
+ * Send HTTP POST request (headers and body as two writes)
+ * @param arena The uploading task's per-cycle arena
+ * @return false if the header buffer could not be allocated
+ */
+inline bool sendHttpPost(Client& client, const char* host, const char* path, const char* payload,
+                         Arena& arena = Memory::cycle) {
+    TRACE_SPAN("sendHttpPost");
+    ArenaScope scope(arena);
+    char* headers = arena.allocChars(HTTP_HEADER_SIZE);
+    if (!headers) return false;
+
+    const size_t payloadLen = strlen(payload);
+    const int len = snprintf(headers, HTTP_HEADER_SIZE,
+                             "POST %s HTTP/1.1\r\n"
+                             "Host: %s\r\n"
+                             "Content-Type: application/json\r\n"
+                             "Connection: close\r\n"
+                             "Content-Length: %u\r\n"
+                             "\r\n",
+                             path, host, (unsigned)payloadLen);
+    if (len <= 0 || len >= HTTP_HEADER_SIZE) return false;
+
+    client.write((const uint8_t*)headers, len);
+    client.write((const uint8_t*)payload, payloadLen);
+    return true;
+}
+
+/**
+ * Read HTTP response with timeout
+ */
+inline HttpResponse readHttpResponse(Client& client, uint32_t timeout = 5000, Arena& arena = Memory::cycle) {
+    TRACE_SPAN("readHttpResponse");
+    HttpResponse response = {0, false};
+    const uint32_t startTime = millis();
+
+    LOG(HTTP_WAITING);
+
+    // Wait for response
+    while (client.available() == 0) {
+        if (millis() - startTime > timeout) {
+            LOG(HTTP_NO_RESPONSE);
+            return response;
+        }
+        yield();
+    }
+
+    // Read status line
+    ArenaScope scope(arena);
+    char* statusLine = arena.allocChars(64);
+    if (statusLine && client.available()) {
+        size_t len = client.readBytesUntil('\n', statusLine, 63);
+        statusLine[len] = '\0';
+
+        LOG(HTTP_STATUS_LINE, statusLine);
+
+        // Parse status code from "HTTP/1.1 200 OK"
+        char* codeStart = strchr(statusLine, ' ');
+        if (codeStart) {
+            response.statusCode = atoi(codeStart + 1);
+            response.success = (response.statusCode >= 200 && response.statusCode < 300);
+        }
+    }
+
+    // Headers: only the acknowledgement watermark is of interest
+    if (statusLine) {
+        for (;;) {
+            const size_t len = client.readBytesUntil('\n', statusLine, 63);
+            if (len == 0 || (len == 1 && statusLine[0] == '\r')) break;
+            statusLine[len] = '\0';
+            if (strncasecmp(statusLine, "X-Ack-Seq:", 10) == 0) {
+                response.ackSeq = strtoul(statusLine + 10, nullptr, 10);
+            }
+            // Skip the rest of a long line
+            bool more = len == 63;
+            while (more) more = client.readBytesUntil('\n', statusLine, 63) == 63;
+        }
+    }
+
+    // Drain remaining response
+    while (client.available()) {
+        client.read();
+    }
+
+    return response;
+}
+
+/**
+ * Full upload of a serialized report on an already-resolved address,
+ * with per-phase metrics (the caller times DNS, which is transport
+ * specific)
+ * @param arena Per-cycle buffers; one per uploading task
+ */
+inline HttpResponse postPayload(Client& client, IPAddress ip, const char* host, const char* path,
+                                uint16_t port, const char* payload, Arena& arena = Memory::cycle) {
+    HttpResponse response = {0, false};
+    Metrics::Registry& metrics = Metrics::registry;
+
+    bool connected;
+    {
+        TRACE_SPAN("connect");
+        Metrics::ScopedTimer<Metrics::LatencyHistogram> timer(metrics.httpConnect);
+        connected = client.connect(ip, port);
+    }
+    if (!connected) {
+        LOG(HTTP_CONNECT_FAILED);
+        client.stop();
+        metrics.recordHttpStatus(0);
+        return response;
+    }
+
+    LOG(HTTP_SENDING);
+    LOG(HTTP_PAYLOAD, payload);
+
+    bool sent;
+    {
+        Metrics::ScopedTimer<Metrics::LatencyHistogram> timer(metrics.httpSend);
+        sent = sendHttpPost(client, host, path, payload, arena);
+    }
+    if (!sent) {
+        LOG(HTTP_NO_BUFFER, arena.name());
+        client.stop();
+        metrics.recordHttpStatus(0);
+        return response;
+    }
+    {
+        Metrics::ScopedTimer<Metrics::LatencyHistogram> timer(metrics.httpResponse);
+        response = readHttpResponse(client, 5000, arena);
+    }
+    metrics.recordHttpStatus(response.statusCode);
+
+    LOG(HTTP_RESPONSE, response.statusCode, response.success);
+
+    // Cleanup
+    client.stop();
+
+    return response;
+}
+
+/**
+ * Build the report in the arena and upload it (see postPayload)
+ */
+inline HttpResponse post(Client& client, IPAddress ip, const char* host, const char* path,
+                         uint16_t port, const char* deviceId, const GPSData& gpsData,
+                         const char* localIP, const ReportExtras& extras = {},
+                         Arena& arena = Memory::cycle) {
+    ArenaScope scope(arena);
+    const char* payload = buildJsonPayload(arena, deviceId, gpsData, localIP, extras);
+    if (!payload) {
+        Metrics::registry.recordHttpStatus(0);
+        return HttpResponse{0, false};
+    }
+    return postPayload(client, ip, host, path, port, payload, arena);
+}
+
+} // namespace HttpUpload
+
+#endif // HTTP_UPLOAD_H
@@ -0,0 +1,129 @@
+#ifndef LINK_SELECTOR_H
+#define LINK_SELECTOR_H
+
+/**
+ * @file link_selector.h
+ * @brief Scores network links and picks the one that carries uploads
+ *
+ * Each link's score is its smoothed TCP connect time to the server
+ * (probed every LINK_PROBE_MS, the same way on every link so TLS or
+ * server time does not bias it) plus LINK_FAILURE_PENALTY_MS per recent
+ * failure. Failures come from probes and uploads; each success halves
+ * the count, so a link that failed once recovers after a few good
+ * probes. A link that is down scores worst.
+ *
+ * The active link changes when it goes down, or when another link
+ * scores LINK_HYSTERESIS_PCT better, so two similar links do not flap.
+ * Ties go to the lower index (the preferred link).
+ *
+ * Pure bookkeeping, no I/O: DualNetworkModule feeds it, the bench drives
+ * it with simulated links.
+ */
+
+#include <Arduino.h>
+#include "../config.h"
+
+#ifndef LINK_PROBE_MS
+#define LINK_PROBE_MS               15000
+#endif
+#ifndef LINK_FAILURE_PENALTY_MS
+#define LINK_FAILURE_PENALTY_MS     2000
+#endif
+#ifndef LINK_HYSTERESIS_PCT
+#define LINK_HYSTERESIS_PCT         25
+#endif
+
+template <size_t N>
+class LinkSelector {
+public:
+    static constexpr size_t NONE = N;
+    static constexpr uint32_t DOWN = UINT32_MAX;
+
+    void setUp(size_t link, bool up) { _links[link].up = up; }
+    bool up(size_t link) const { return _links[link].up; }
+
+    /**
+     * Record a probe or upload
+     * @param connectUs Probe connect time; 0 = no latency sample
+     */
+    void observe(size_t link, bool ok, uint32_t connectUs = 0) {
+        Health& h = _links[link];
+        if (!ok) {
+            if (h.failures < MAX_FAILURES) h.failures++;
+            return;
+        }
+        h.failures /= 2;
+        if (connectUs == 0) return;
+        // Smoothed like TCP's SRTT, gain 1/4
+        h.srttUs = h.srttUs ? h.srttUs + ((int32_t)connectUs - (int32_t)h.srttUs) / 4 : connectUs;
+    }
+
+    /**
+     * Lower is better; DOWN for a link without an address
+     */
+    uint32_t score(size_t link) const {
+        const Health& h = _links[link];
+        if (!h.up) return DOWN;
+        const uint32_t base = h.srttUs ? h.srttUs : UNKNOWN_US;
+        return base + h.failures * (uint32_t)LINK_FAILURE_PENALTY_MS * 1000;
+    }
+
+    uint32_t srttUs(size_t link) const { return _links[link].srttUs; }
+    uint8_t failures(size_t link) const { return _links[link].failures; }
+
+    /**
+     * Re-evaluate the active link
+     * @return true if it changed
+     */
+    bool select() {
+        const size_t best = bestExcept(NONE);
+        if (best == NONE || best == _active) return false;
+        if (_active != NONE && _links[_active].up &&
+            (uint64_t)score(best) * 100 > (uint64_t)score(_active) * (100 - LINK_HYSTERESIS_PCT)) {
+            return false;
+        }
+        _active = best;
+        return true;
+    }
+
+    /**
+     * Make a link active now (an upload just succeeded on it)
+     */
+    void activate(size_t link) { _active = link; }
+
+    size_t active() const { return _active; }
+
+    /**
+     * Best link other than the active one, NONE if all others are down
+     */
+    size_t fallback() const { return bestExcept(_active); }
+
+private:
+    static constexpr uint32_t UNKNOWN_US = 1000000;    // Up, never probed
+    static constexpr uint8_t MAX_FAILURES = 8;
+
+    struct Health {
+        uint32_t srttUs = 0;
+        uint8_t failures = 0;
+        bool up = false;
+    };
+
+    Health _links[N];
+    size_t _active = NONE;
+
+    size_t bestExcept(size_t skip) const {
+        size_t best = NONE;
+        uint32_t bestScore = DOWN;
+        for (size_t i = 0; i < N; i++) {
+            if (i == skip) continue;
+            const uint32_t s = score(i);
+            if (s < bestScore) {
+                best = i;
+                bestScore = s;
+            }
+        }
+        return best;
+    }
+};
+
+#endif // LINK_SELECTOR_H
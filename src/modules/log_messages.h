@@ -0,0 +1,117 @@
+#ifndef LOG_MESSAGES_H
+#define LOG_MESSAGES_H
+
+/**
+ * @file log_messages.h
+ * @brief Log message catalog: ID, level and printf-style format
+ *
+ * Records carry only the ID and the binary arguments; the format string
+ * stays in flash and is looked up by the drain task. Add new messages at
+ * the end of their group. Supported conversions: d i u x X c f e g s.
+ */
+
+#define LOG_MESSAGES(X) \
+    /* Application */ \
+    X(APP_RULE,              INFO,  "========================================") \
+    X(APP_BANNER_TITLE,      INFO,  "  ESP32 GPS Tracker v%s") \
+    X(APP_BANNER_BUILD,      INFO,  "  Build: %s") \
+    X(APP_BANNER_DEVICE,     INFO,  "  Device: %s") \
+    X(APP_BANNER_IP,         INFO,  "  IP: %s") \
+    X(APP_BANNER_WEB,        INFO,  "  Web: http://%s:%u") \
+    X(APP_NETWORK_FAILED,    ERROR, "ERROR: Network initialization failed!") \
+    X(APP_GPS_ISSUE,         WARN,  "WARNING: GPS initialization issue") \
+    X(APP_READY,             INFO,  "System initialized successfully") \
+    X(APP_WATCHDOG,          INFO,  "Watchdog initialized (%us timeout)") \
+    X(APP_WIFI_CONNECTING,   INFO,  "Connecting to WiFi...") \
+    X(APP_WIFI_SSID,         INFO,  "  SSID: %s") \
+    X(APP_ETH_INIT,          INFO,  "Initializing Ethernet...") \
+    X(APP_NETWORK_RETRY,     WARN,  "Retry %u/%u") \
+    X(APP_GPS_INIT,          INFO,  "Initializing GPS...") \
+    X(APP_GPS_PINS,          INFO,  "  RX=%u, TX=%u, Baud=%u") \
+    X(APP_GPS_READY,         INFO,  "GPS module initialized") \
+    X(APP_CYCLE,             DEBUG, "--- Processing Cycle ---") \
+    X(APP_FIX_VALID,         INFO,  "GPS Fix: Valid (%.6f, %.6f) sats=%u speed=%.1f km/h") \
+    X(APP_FIX_NONE,          INFO,  "GPS Fix: No valid fix (satellites: %u)") \
+    X(APP_SEND_OK,           INFO,  "Data sent successfully (HTTP %d)") \
+    X(APP_SEND_FAILED,       WARN,  "Failed to send data (HTTP %d)") \
+    X(APP_NETWORK_LOST,      WARN,  "Network disconnected! Attempting reconnection...") \
+    X(APP_RECONNECTED,       INFO,  "Reconnected successfully") \
+    X(APP_RECONNECT_FAILED,  WARN,  "Reconnection failed") \
+    X(APP_TASK_FAILED,       ERROR, "ERROR: Cannot start task '%s'") \
+    X(APP_FREE_HEAP,         DEBUG, "Heap: free %u, min %u, largest block %u (%u%% fragmented)") \
+    X(APP_POWER_SUPPLY,      INFO,  "Power: %s, CPU max %u MHz, light sleep %s") \
+    X(APP_GPS_POWER_MODE,    INFO,  "GPS: %s tracking") \
+    X(APP_ENERGY,            INFO,  "Energy: %u mJ over %u s (avg %u mW)") \
+    X(APP_BOOT_PHASE,        INFO,  "Boot: %s at %u ms") \
+    X(APP_GPS_AIDING,        INFO,  "GPS aiding: last fix %.5f, %.5f, time %s") \
+    X(APP_FIX_SAVED,         DEBUG, "Last fix saved to NVS") \
+    X(APP_FILTER_LOST,       WARN,  "Position: no fix for %u s, reported as lost") \
+    X(APP_GEOFENCE_LOADED,   INFO,  "Geofences: %u loaded") \
+    X(APP_GEOFENCE_INVALID,  ERROR, "Geofences: blob rejected, alerts disabled") \
+    X(APP_GEOFENCE_EVENT,    INFO,  "Geofence %u (%s): %s at %.6f, %.6f") \
+    X(APP_ROUTE_LOADED,      INFO,  "Route: %u segments, %.0f m, corridor %.0f m") \
+    X(APP_ROUTE_INVALID,     ERROR, "Route: blob rejected, corridor check disabled") \
+    X(APP_ROUTE_EVENT,       INFO,  "Route: %s corridor, cross-track %.0f m") \
+    X(APP_TRIP_RESTORED,     INFO,  "Trip: odometer %u m, %u trips") \
+    X(APP_TRIP_START,        INFO,  "Trip %u: started") \
+    X(APP_TRIP_END,          INFO,  "Trip %u: ended, %u m in %u s moving, %u stops") \
+    X(APP_ODOMETER_SAVED,    DEBUG, "Trip: odometer saved") \
+    X(APP_EVENT_HELD,        INFO,  "No link: event held as report %u") \
+    X(APP_RESTART,           INFO,  "Restarting into the new firmware") \
+    /* Upload (network modules, HttpUpload) */ \
+    X(HTTP_NO_LINK,          WARN,  "[HTTP] %s not connected") \
+    X(HTTP_CONNECTING,       DEBUG, "[HTTP] Connecting to %s:%u...") \
+    X(HTTP_DNS_FAILED,       WARN,  "[HTTP] DNS lookup failed!") \
+    X(HTTP_CONNECT_FAILED,   WARN,  "[HTTP] Connection failed!") \
+    X(HTTP_SENDING,          DEBUG, "[HTTP] Connected, sending POST...") \
+    X(HTTP_PAYLOAD,          DEBUG, "[HTTP] Payload: %s") \
+    X(HTTP_WAITING,          DEBUG, "[HTTP] Waiting for response...") \
+    X(HTTP_NO_RESPONSE,      WARN,  "[HTTP] Response timeout!") \
+    X(HTTP_STATUS_LINE,      DEBUG, "[HTTP] Status line: %s") \
+    X(HTTP_RESPONSE,         INFO,  "[HTTP] Response: %d (success=%d)") \
+    X(HTTP_NO_BUFFER,        ERROR, "[HTTP] Arena '%s' exhausted, upload skipped") \
+    /* Report sequencing (report_outbox.h) */ \
+    X(UPLOAD_SEQ_RESTORED,   INFO,  "[UPLOAD] Sequence continues at %u") \
+    X(UPLOAD_ACK,            DEBUG, "[UPLOAD] Server has every report up to %u, %u held") \
+    X(UPLOAD_RESENT,         INFO,  "[UPLOAD] Report %u sent again (HTTP %d)") \
+    X(UPLOAD_GIVEN_UP,       WARN,  "[UPLOAD] Outbox full, report %u given up") \
+    /* Extra destinations (upload_fanout.h) */ \
+    X(FANOUT_DESTINATION,    INFO,  "[FANOUT] %s: %s:%u%s, %s, every %u s") \
+    X(FANOUT_DELIVERED,      DEBUG, "[FANOUT] %s: HTTP %d in %u ms, %u waiting") \
+    X(FANOUT_FAILED,         WARN,  "[FANOUT] %s: HTTP %d, retry in %u s, %u waiting") \
+    X(FANOUT_DROPPED,        WARN,  "[FANOUT] %s: backlog full, oldest report dropped") \
+    X(FANOUT_NO_SLOT,        ERROR, "[FANOUT] No free report slot, %s skipped") \
+    /* TLS (tls_client.h) */ \
+    X(TLS_INIT_FAILED,       ERROR, "[TLS] Setup failed (-0x%04x)") \
+    X(TLS_NO_PIN,            ERROR, "[TLS] No pin configured, not connecting") \
+    X(TLS_UNPINNED,          WARN,  "[TLS] No pin configured, server not authenticated") \
+    X(TLS_HANDSHAKE,         INFO,  "[TLS] %s handshake in %u ms, heap %u bytes") \
+    X(TLS_HANDSHAKE_FAILED,  WARN,  "[TLS] Handshake failed (-0x%04x)") \
+    X(TLS_PIN_MISMATCH,      ERROR, "[TLS] %s: server key does not match the pin") \
+    /* Links (dual_network_module.h) */ \
+    X(LINK_UP,               INFO,  "[LINK] %s up") \
+    X(LINK_DOWN,             WARN,  "[LINK] %s down") \
+    X(LINK_SWITCH,           INFO,  "[LINK] Uploads %s -> %s (%s)") \
+    X(LINK_FAILOVER,         INFO,  "[LINK] Report delivered on %s %u ms after the first failure") \
+    X(LINK_PROBE,            DEBUG, "[LINK] %s connect %u us, %u failures") \
+    /* GPS stream (gpsd_server.h) */ \
+    X(GPSD_CLIENT,           INFO,  "[GPSD] %s client on %s (%u/%u)") \
+    X(GPSD_REFUSED,          WARN,  "[GPSD] Client on %s refused, %u connected") \
+    X(GPSD_DROPPED,          WARN,  "[GPSD] Slow client on %s dropped, %u bytes behind") \
+    /* Firmware updates (ota_update.h) */ \
+    X(OTA_NO_SLOTS,          WARN,  "[OTA] No OTA partitions, updates disabled") \
+    X(OTA_PENDING_VERIFY,    WARN,  "[OTA] New image on %s, confirmed by the first report within %u s of link") \
+    X(OTA_CONFIRMED,         INFO,  "[OTA] Image on %s confirmed") \
+    X(OTA_ROLLBACK,          ERROR, "[OTA] No report within %u s of link, rolling back") \
+    X(OTA_NO_ROLLBACK,       ERROR, "[OTA] No previous image to roll back to, keeping this one") \
+    X(OTA_NO_UPDATE,         DEBUG, "[OTA] No update (HTTP %d)") \
+    X(OTA_CURRENT,           DEBUG, "[OTA] Patch produces the running image") \
+    X(OTA_REJECTED,          INFO,  "[OTA] Patch produces the image rolled back from %s, skipped") \
+    X(OTA_FAILED,            WARN,  "[OTA] Update failed: %s after %u patch bytes") \
+    X(OTA_APPLIED,           INFO,  "[OTA] %s: %u byte patch -> %u byte image (%u%%) in %u ms, %u KB/s") \
+    /* Track archive (track_archive.h) */ \
+    X(ARCHIVE_NO_PARTITION,  WARN,  "[ARCHIVE] No \"%s\" data partition, archive off") \
+    X(ARCHIVE_READY,         INFO,  "[ARCHIVE] %s: %u KB, %u pages stored, oldest fix %u") \
+    X(ARCHIVE_WRITE_FAILED,  ERROR, "[ARCHIVE] Page %u not written, %u fixes lost")
+
+#endif // LOG_MESSAGES_H
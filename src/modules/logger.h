@@ -0,0 +1,425 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+/**
+ * @file logger.h
+ * @brief Deferred binary logging: no heap, no formatting on the caller
+ *
+ *   LOG(HTTP_RESPONSE, response.statusCode, response.success);
+ *
+ * The caller copies the message ID, a millisecond timestamp and the
+ * arguments (tagged binary, strings copied and truncated) into one slot
+ * of a lock-free bounded MPSC ring and returns. A low-priority task
+ * formats records and writes them to Serial. Messages above LOG_LEVEL
+ * (or all of them with DEBUG_SERIAL false) compile away, arguments
+ * included. When the ring is full new records are dropped and counted.
+ *
+ * Messages are declared in log_messages.h.
+ */
+
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+#include "../config.h"
+#include "log_messages.h"
+#include "metrics.h"
+
+#if !defined(ESP_PLATFORM)
+#include <thread>
+#include <chrono>
+#endif
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL           3
+#endif
+#ifndef LOG_QUEUE_RECORDS
+#define LOG_QUEUE_RECORDS   64
+#endif
+#ifndef LOG_RECORD_SIZE
+#define LOG_RECORD_SIZE     64
+#endif
+#ifndef LOG_DRAIN_INTERVAL_MS
+#define LOG_DRAIN_INTERVAL_MS 20
+#endif
+
+namespace Log {
+
+enum Level : uint8_t {
+    OFF = 0,
+    ERROR,
+    WARN,
+    INFO,
+    DEBUG
+};
+
+enum class Id : uint16_t {
+#define LOG_ID(id, level, format) id,
+    LOG_MESSAGES(LOG_ID)
+#undef LOG_ID
+    COUNT
+};
+
+inline constexpr Level LEVELS[] = {
+#define LOG_LEVEL_OF(id, level, format) level,
+    LOG_MESSAGES(LOG_LEVEL_OF)
+#undef LOG_LEVEL_OF
+};
+
+inline constexpr const char* FORMATS[] = {
+#define LOG_FORMAT(id, level, format) format,
+    LOG_MESSAGES(LOG_FORMAT)
+#undef LOG_FORMAT
+};
+
+constexpr bool enabled(Id id) {
+    return DEBUG_SERIAL && LEVELS[(size_t)id] <= LOG_LEVEL;
+}
+
+// Argument tags
+enum Tag : uint8_t {
+    TAG_I32 = 1,
+    TAG_U32,
+    TAG_I64,
+    TAG_U64,
+    TAG_F64,
+    TAG_STR     // Followed by length byte and chars (no terminator)
+};
+
+/**
+ * One ring slot (Vyukov bounded queue cell)
+ */
+struct Record {
+    std::atomic<uint32_t> sequence;
+    uint32_t timestampMs;
+    uint16_t id;
+    uint8_t size;                               // Payload bytes used
+    uint8_t truncated;                          // Arguments did not fit
+    uint8_t payload[LOG_RECORD_SIZE - 12];
+};
+
+static_assert(sizeof(Record) == LOG_RECORD_SIZE, "LOG_RECORD_SIZE must be a multiple of 4 and >= 16");
+static_assert((LOG_QUEUE_RECORDS & (LOG_QUEUE_RECORDS - 1)) == 0, "LOG_QUEUE_RECORDS must be a power of two");
+
+/**
+ * Bounded multi-producer / single-consumer ring
+ */
+class Queue {
+public:
+    Queue() {
+        for (uint32_t i = 0; i < LOG_QUEUE_RECORDS; i++) {
+            _records[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Claim a slot; nullptr when full. Must be followed by commit().
+     */
+    Record* claim(uint32_t& position) {
+        uint32_t pos = _enqueue.load(std::memory_order_relaxed);
+        for (;;) {
+            Record& r = _records[pos % LOG_QUEUE_RECORDS];
+            const int32_t diff = (int32_t)(r.sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                if (_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    position = pos;
+                    return &r;
+                }
+            } else if (diff < 0) {
+                Metrics::registry.logDropped.inc();
+                return nullptr;
+            } else {
+                pos = _enqueue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void commit(Record* r, uint32_t position) {
+        r->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    /**
+     * Oldest committed record or nullptr (consumer only)
+     */
+    const Record* front() {
+        Record& r = _records[_dequeue % LOG_QUEUE_RECORDS];
+        if (r.sequence.load(std::memory_order_acquire) != _dequeue + 1) return nullptr;
+        return &r;
+    }
+
+    void pop() {
+        Record& r = _records[_dequeue % LOG_QUEUE_RECORDS];
+        r.sequence.store(_dequeue + LOG_QUEUE_RECORDS, std::memory_order_release);
+        _dequeue++;
+    }
+
+private:
+    Record _records[LOG_QUEUE_RECORDS];
+    std::atomic<uint32_t> _enqueue{0};
+    uint32_t _dequeue = 0;
+};
+
+inline Queue queue;
+inline std::atomic_flag draining = ATOMIC_FLAG_INIT;   // Single-consumer guard
+
+// ========================================
+// Producer side: binary argument capture
+// ========================================
+
+class Encoder {
+public:
+    explicit Encoder(Record& r) : _r(r) { _r.size = 0; _r.truncated = 0; }
+
+    template <typename T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+    void put(T v) {
+        if (std::is_floating_point<T>::value) {
+            const double d = (double)v;
+            putScalar(TAG_F64, &d, sizeof(d));
+        } else if (std::is_signed<T>::value && sizeof(T) <= 4) {
+            const int32_t i = (int32_t)v;
+            putScalar(TAG_I32, &i, sizeof(i));
+        } else if (std::is_signed<T>::value) {
+            const int64_t i = (int64_t)v;
+            putScalar(TAG_I64, &i, sizeof(i));
+        } else if (sizeof(T) <= 4) {
+            const uint32_t u = (uint32_t)v;
+            putScalar(TAG_U32, &u, sizeof(u));
+        } else {
+            const uint64_t u = (uint64_t)v;
+            putScalar(TAG_U64, &u, sizeof(u));
+        }
+    }
+
+    void put(const char* s) {
+        if (!s) s = "(null)";
+        if ((size_t)_r.size + 2 > sizeof(_r.payload)) { _r.truncated = 1; return; }
+        size_t len = strlen(s);
+        const size_t room = sizeof(_r.payload) - _r.size - 2;
+        if (len > room) { len = room; _r.truncated = 1; }
+        _r.payload[_r.size++] = TAG_STR;
+        _r.payload[_r.size++] = (uint8_t)len;
+        memcpy(_r.payload + _r.size, s, len);
+        _r.size += len;
+    }
+
+private:
+    Record& _r;
+
+    void putScalar(Tag tag, const void* v, size_t n) {
+        if ((size_t)_r.size + 1 + n > sizeof(_r.payload)) { _r.truncated = 1; return; }
+        _r.payload[_r.size++] = tag;
+        memcpy(_r.payload + _r.size, v, n);
+        _r.size += n;
+    }
+};
+
+inline void encodeArgs(Encoder&) {}
+
+template <typename T, typename... Rest>
+inline void encodeArgs(Encoder& e, const T& first, const Rest&... rest) {
+    e.put(first);
+    encodeArgs(e, rest...);
+}
+
+template <typename... Args>
+inline void write(Id id, const Args&... args) {
+    uint32_t position;
+    Record* r = queue.claim(position);
+    if (!r) return;
+    r->timestampMs = millis();
+    r->id = (uint16_t)id;
+    Encoder e(*r);
+    encodeArgs(e, args...);
+    queue.commit(r, position);
+}
+
+// ========================================
+// Consumer side: formatting and drain
+// ========================================
+
+/**
+ * Expand one record into "[<sec>s] <message>" (returns length)
+ */
+inline size_t format(const Record& r, char* out, size_t size) {
+    int n = snprintf(out, size, "[%lus] ", (unsigned long)(r.timestampMs / 1000));
+    size_t len = n > 0 ? min((size_t)n, size - 1) : 0;
+
+    const char* f = r.id < (uint16_t)Id::COUNT ? FORMATS[r.id] : "?";
+    size_t offset = 0;
+
+    while (*f && len < size - 1) {
+        if (*f != '%') { out[len++] = *f++; continue; }
+        if (f[1] == '%') { out[len++] = '%'; f += 2; continue; }
+
+        // Copy flags/width/precision, drop length modifiers
+        char spec[16] = "%";
+        size_t s = 1;
+        const char* p = f + 1;
+        while (*p && strchr("-+ #0123456789.", *p) && s < sizeof(spec) - 4) spec[s++] = *p++;
+        while (*p && strchr("hlLzjt", *p)) p++;
+        const char conv = *p ? *p++ : 's';
+        f = p;
+
+        const size_t room = size - len;
+        if (offset >= r.size) {
+            n = snprintf(out + len, room, "?");
+        } else {
+            const uint8_t tag = r.payload[offset++];
+            const uint8_t* v = r.payload + offset;
+            const bool integerConv = strchr("diuxXc", conv) != nullptr;
+            const bool floatConv = strchr("feEgG", conv) != nullptr;
+
+            if (tag == TAG_STR) {
+                const uint8_t slen = v[0];
+                offset += 1 + slen;
+                spec[s++] = '.';
+                spec[s++] = '*';
+                spec[s++] = 's';
+                spec[s] = '\0';
+                n = snprintf(out + len, room, spec, (int)slen, (const char*)v + 1);
+            } else if (tag == TAG_F64) {
+                double d;
+                memcpy(&d, v, sizeof(d));
+                offset += sizeof(d);
+                if (integerConv) {
+                    spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = conv; spec[s] = '\0';
+                    n = snprintf(out + len, room, spec, (long long)d);
+                } else {
+                    spec[s++] = floatConv ? conv : 'g'; spec[s] = '\0';
+                    n = snprintf(out + len, room, spec, d);
+                }
+            } else {
+                long long i = 0;
+                if (tag == TAG_I32) { int32_t x; memcpy(&x, v, 4); i = x; offset += 4; }
+                else if (tag == TAG_U32) { uint32_t x; memcpy(&x, v, 4); i = x; offset += 4; }
+                else if (tag == TAG_I64) { int64_t x; memcpy(&x, v, 8); i = x; offset += 8; }
+                else { uint64_t x; memcpy(&x, v, 8); i = (long long)x; offset += 8; }
+
+                if (floatConv) {
+                    spec[s++] = conv; spec[s] = '\0';
+                    n = snprintf(out + len, room, spec, (double)i);
+                } else if (conv == 'c') {
+                    spec[s++] = 'c'; spec[s] = '\0';
+                    n = snprintf(out + len, room, spec, (int)i);
+                } else {
+                    spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = integerConv ? conv : 'd'; spec[s] = '\0';
+                    n = snprintf(out + len, room, spec, i);
+                }
+            }
+        }
+        if (n > 0) len = min(len + (size_t)n, size - 1);
+    }
+
+    if (r.truncated && len < size - 1) out[len++] = '~';
+    out[len] = '\0';
+    return len;
+}
+
+inline size_t drainLocked(Print& out) {
+    static uint32_t reportedDrops = 0;
+    size_t count = 0;
+    char line[160];
+
+    while (const Record* r = queue.front()) {
+        const size_t len = format(*r, line, sizeof(line) - 1);
+        queue.pop();
+        line[len] = '\n';
+        out.write((const uint8_t*)line, len + 1);
+        count++;
+    }
+
+    const uint32_t dropped = Metrics::registry.logDropped.value();
+    if (dropped != reportedDrops) {
+        const int len = snprintf(line, sizeof(line), "[log] %u records dropped\n",
+                                 (unsigned)(dropped - reportedDrops));
+        out.write((const uint8_t*)line, len);
+        reportedDrops = dropped;
+    }
+    return count;
+}
+
+/**
+ * Format and write all pending records
+ * @return records written (0 if another drain is in progress)
+ */
+inline size_t drain(Print& out) {
+    if (draining.test_and_set(std::memory_order_acquire)) return 0;
+    const size_t count = drainLocked(out);
+    draining.clear(std::memory_order_release);
+    return count;
+}
+
+/**
+ * Synchronous drain from the caller (waits for a running drain)
+ */
+inline void flush() {
+    while (draining.test_and_set(std::memory_order_acquire)) yield();
+    drainLocked(Serial);
+    draining.clear(std::memory_order_release);
+}
+
+#if defined(ESP_PLATFORM)
+
+inline void drainTask(void*) {
+    for (;;) {
+        drain(Serial);
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+    }
+}
+
+/**
+ * Start the drain task (priority 1, core 0 next to the network stack)
+ */
+inline void begin() {
+    if (!DEBUG_SERIAL) return;
+    xTaskCreatePinnedToCore(drainTask, "log", 3072, nullptr, 1, nullptr, 0);
+}
+
+#else
+
+/**
+ * Host: drain thread, joined with a final drain at exit
+ */
+class DrainThread {
+public:
+    void start() {
+        if (_thread.joinable()) return;
+        _thread = std::thread([this] {
+            while (!_stop.load()) {
+                drain(Serial);
+                std::this_thread::sleep_for(std::chrono::milliseconds(LOG_DRAIN_INTERVAL_MS));
+            }
+        });
+    }
+
+    ~DrainThread() {
+        if (!_thread.joinable()) return;
+        _stop.store(true);
+        _thread.join();
+        drain(Serial);
+    }
+
+private:
+    std::thread _thread;
+    std::atomic<bool> _stop{false};
+};
+
+inline DrainThread drainThread;
+
+inline void begin() {
+    if (!DEBUG_SERIAL) return;
+    drainThread.start();
+}
+
+#endif
+
+} // namespace Log
+
+/**
+ * Log a catalog message; compiles to nothing when its level is filtered
+ */
+#define LOG(id, ...) \
+    do { \
+        if constexpr (Log::enabled(Log::Id::id)) Log::write(Log::Id::id, ##__VA_ARGS__); \
+    } while (0)
+
+#endif // LOGGER_H
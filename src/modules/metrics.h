@@ -0,0 +1,567 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/**
+ * @file metrics.h
+ * @brief Lock-free runtime counters and fixed-bucket histograms
+ *
+ * All hot-path updates are single relaxed 32-bit atomic adds (lock-free
+ * on Xtensa), so instrumentation can sit inside the UART read loop.
+ * Exported in Prometheus text format by writePrometheus() at /metrics.
+ *
+ * Durations are observed in microseconds. Histogram sums are 64-bit so
+ * they do not wrap on a device that runs for months; Xtensa has no
+ * 64-bit atomics, so that one add goes through the toolchain's atomic
+ * spinlock (observe() runs once per upload or loop pass, not per byte).
+ */
+
+#include <Arduino.h>
+#include <atomic>
+#include "arena.h"
+
+#ifndef UPLOAD_FANOUT_MAX
+#define UPLOAD_FANOUT_MAX   4       // Extra report destinations with their own series
+#endif
+
+namespace Metrics {
+
+class Counter {
+public:
+    void inc(uint32_t n = 1) { _value.fetch_add(n, std::memory_order_relaxed); }
+    uint32_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> _value{0};
+};
+
+class Gauge {
+public:
+    void set(uint32_t v) { _value.store(v, std::memory_order_relaxed); }
+    uint32_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> _value{0};
+};
+
+/**
+ * Histogram with fixed upper bounds (microseconds, ascending)
+ */
+template <size_t N>
+class Histogram {
+public:
+    explicit Histogram(const uint32_t (&bounds)[N]) : _bounds(bounds) {}
+
+    void observe(uint32_t valueUs) {
+        size_t i = 0;
+        while (i < N && valueUs > _bounds[i]) i++;
+        _buckets[i].fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(valueUs, std::memory_order_relaxed);
+    }
+
+    static constexpr size_t bucketCount() { return N; }
+    uint32_t bound(size_t i) const { return _bounds[i]; }
+    uint32_t bucket(size_t i) const { return _buckets[i].load(std::memory_order_relaxed); }
+    uint64_t sum() const { return _sum.load(std::memory_order_relaxed); }
+
+private:
+    const uint32_t (&_bounds)[N];
+    std::atomic<uint32_t> _buckets[N + 1] = {};  // Last bucket is +Inf
+    std::atomic<uint64_t> _sum{0};
+};
+
+/**
+ * Observes elapsed micros() into a histogram when it goes out of scope
+ */
+template <typename H>
+class ScopedTimer {
+public:
+    explicit ScopedTimer(H& histogram) : _histogram(histogram), _start(micros()) {}
+    ~ScopedTimer() { _histogram.observe(micros() - _start); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    H& _histogram;
+    const uint32_t _start;
+};
+
+// Bucket layouts (microseconds)
+inline constexpr uint32_t LATENCY_BOUNDS[] = {
+    1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000
+};
+inline constexpr uint32_t LOOP_BOUNDS[] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 50000, 100000, 500000, 2000000
+};
+inline constexpr size_t LATENCY_BUCKETS = sizeof(LATENCY_BOUNDS) / sizeof(LATENCY_BOUNDS[0]);
+inline constexpr size_t LOOP_BUCKETS = sizeof(LOOP_BOUNDS) / sizeof(LOOP_BOUNDS[0]);
+
+using LatencyHistogram = Histogram<LATENCY_BUCKETS>;
+using LoopHistogram = Histogram<LOOP_BUCKETS>;
+
+enum class HttpClass : uint8_t {
+    C2XX = 0,
+    C3XX,
+    C4XX,
+    C5XX,
+    ERROR,      // No status line (connect failure, timeout)
+    COUNT
+};
+
+enum class WebRoute : uint8_t {
+    DASHBOARD = 0,
+    EXPORT,
+    ARCHIVE,
+    CHART,
+    METRICS,
+    TRACE,
+    NOT_FOUND,
+    COUNT
+};
+
+enum class LoopTask : uint8_t {
+    GPS = 0,
+    UPLOAD,
+    WEB,
+    COUNT
+};
+
+enum class BootPhase : uint8_t {
+    GPS_READY = 0,      // UART up, aiding queued
+    TASKS_STARTED,
+    NETWORK_UP,
+    FIRST_FIX,
+    FIRST_REPORT,
+    COUNT
+};
+
+inline constexpr const char* BOOT_PHASE_NAMES[] = {
+    "gps_ready", "tasks_started", "network_up", "first_fix", "first_report"
+};
+
+enum class NetLink : uint8_t {
+    ETHERNET = 0,
+    WIFI,
+    COUNT
+};
+
+inline constexpr const char* NET_LINK_NAMES[] = {"ethernet", "wifi"};
+
+// Report destinations (upload_fanout.h): the primary server first
+inline constexpr size_t MAX_DESTINATIONS = 1 + UPLOAD_FANOUT_MAX;
+
+struct DestinationMetrics {
+    const char* name = nullptr;     // Label, nullptr = slot unused
+    LatencyHistogram latency{LATENCY_BOUNDS};   // Connect to response
+    Gauge backlog;                  // Reports waiting
+    Counter delivered;
+    Counter failed;
+    Counter dropped;                // Backlog full
+};
+
+/**
+ * All runtime metrics (single instance)
+ */
+struct Registry {
+    // GPS ingestion
+    Counter uartBytes;
+    Counter nmeaSentences;
+    Counter checksumFailures;
+    LatencyHistogram gpsRead{LATENCY_BOUNDS};
+
+    // Upload path (sendGPSData)
+    LatencyHistogram httpDns{LATENCY_BOUNDS};
+    LatencyHistogram httpConnect{LATENCY_BOUNDS};
+    LatencyHistogram httpSend{LATENCY_BOUNDS};
+    LatencyHistogram httpResponse{LATENCY_BOUNDS};
+    Counter httpStatus[(size_t)HttpClass::COUNT];
+    Gauge uploadHeld;           // Reports not yet acknowledged (report_outbox.h)
+    Gauge uploadAckSeq;         // Server watermark
+    Counter uploadResent;
+    Counter uploadGivenUp;      // Outbox full
+    DestinationMetrics destinations[MAX_DESTINATIONS];
+    LatencyHistogram tlsHandshakeFull{LATENCY_BOUNDS};
+    LatencyHistogram tlsHandshakeResumed{LATENCY_BOUNDS};
+    Gauge tlsHeapPeakBytes;     // Last handshake, sampled
+    Counter tlsFailures;
+    Counter tlsPinFailures;
+
+    // Links (dual_network_module.h)
+    Gauge linkUp[(size_t)NetLink::COUNT];
+    Gauge linkConnectUs[(size_t)NetLink::COUNT];   // Smoothed probe connect time
+    Counter linkFailures[(size_t)NetLink::COUNT];
+    Gauge linkActive;                               // NetLink index + 1, 0 = none
+    Counter linkSwitches;
+    Gauge linkFailoverMs;                           // First failure to first report on the next link
+
+    // W5500 driver (w5500.h)
+    Counter w5500Frames;        // SPI transactions
+    Counter w5500Bytes;         // Frame headers included
+    Counter w5500Interrupts;    // INTn services that found events
+
+    // GPS stream (gpsd_server.h)
+    Gauge gpsdClients;
+    Counter gpsdSentBytes;
+    Counter gpsdDropped;        // Too far behind
+    Counter gpsdRefused;        // All slots taken
+
+    // Firmware updates (ota_update.h)
+    Counter otaChecks;
+    Counter otaUpdates;         // Applied, booted at the next restart
+    Counter otaFailures;
+    Gauge otaPatchBytes;        // Last applied patch
+    Gauge otaApplyMs;           // Last download and apply
+    Gauge otaPendingVerify;     // Running image not yet confirmed
+
+    // Track archive (track_archive.h)
+    Counter archiveFixes;
+    Counter archivePagesWritten;
+    Counter archiveSectorErases;
+    Counter archiveFlashBytes;  // Programmed, headers included
+    Counter archiveWriteFailures;
+    Gauge archiveOldestTime;    // Unix time of the oldest fix kept
+
+    // Web server
+    Counter webRequests[(size_t)WebRoute::COUNT];
+
+    // Event loops
+    LoopHistogram loopIteration{LOOP_BOUNDS};
+    Counter loopWakeups[(size_t)LoopTask::COUNT];
+    Counter loopBusyMicros;     // All loops; wraps, read as deltas
+
+    // Power management
+    Gauge onBattery;
+    Gauge gpsPowerSave;
+    Gauge lightSleep;
+    Counter energyMillijoules;  // Estimated, see power_manager.h
+
+    // Geofencing
+    Gauge geofencesLoaded;
+    Gauge geofencesInside;
+    Counter geofenceEvaluations;
+    Counter geofenceEvalMicros;
+    Counter geofenceEnter;
+    Counter geofenceExit;
+    Counter geofenceDropped;    // Event queue full
+
+    // Position filter
+    Counter filterRejected;     // Positions gated out (multipath)
+    Counter filterPredicted;    // Epochs dead reckoned
+    Counter filterResets;
+    Counter filterEvalMicros;
+
+    // Planned route
+    Gauge routeCrossTrackM;     // Absolute
+    Gauge routeProgressM;
+    Gauge routeEtaSeconds;      // 0 = unknown
+    Counter routeBreaches;
+    Counter routeEvalMicros;
+
+    // Trip analytics
+    Gauge tripOdometerM;
+    Gauge tripMoving;
+    Counter tripsCompleted;
+    Counter tripFixesRejected;  // Outliers (implied speed too high)
+    Counter tripEvalMicros;
+
+    // Milliseconds from boot to each phase (0 = not reached yet)
+    Gauge bootPhaseMs[(size_t)BootPhase::COUNT];
+
+    /**
+     * Record a boot phase the first time it is reached
+     * @return true on the first call for this phase
+     */
+    bool markBoot(BootPhase phase) {
+        Gauge& g = bootPhaseMs[(size_t)phase];
+        if (g.value() != 0) return false;
+        g.set(max<uint32_t>(millis(), 1));
+        return true;
+    }
+
+    // Logging (ring full)
+    Counter logDropped;
+
+    void recordHttpStatus(int16_t statusCode) {
+        HttpClass c = HttpClass::ERROR;
+        if (statusCode >= 200 && statusCode < 300) c = HttpClass::C2XX;
+        else if (statusCode >= 300 && statusCode < 400) c = HttpClass::C3XX;
+        else if (statusCode >= 400 && statusCode < 500) c = HttpClass::C4XX;
+        else if (statusCode >= 500 && statusCode < 600) c = HttpClass::C5XX;
+        httpStatus[(size_t)c].inc();
+    }
+};
+
+inline Registry registry;
+
+/**
+ * Share of free heap not usable as one block (0 = unfragmented)
+ */
+inline uint32_t heapFragmentation() {
+    const uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap == 0) return 0;
+    return 100 - (uint32_t)((uint64_t)ESP.getMaxAllocHeap() * 100 / freeHeap);
+}
+
+// ========================================
+// Prometheus text exposition
+// ========================================
+
+inline void writeHeader(Print& out, const char* name, const char* type, const char* help) {
+    out.print(F("# HELP ")); out.print(name); out.print(' '); out.println(help);
+    out.print(F("# TYPE ")); out.print(name); out.print(' '); out.println(type);
+}
+
+inline void writeSample(Print& out, const char* name, const char* labels, uint32_t value) {
+    out.print(name);
+    if (labels && *labels) { out.print('{'); out.print(labels); out.print('}'); }
+    out.print(' ');
+    out.println(value);
+}
+
+inline void writeCounter(Print& out, const char* name, const char* help, const Counter& c) {
+    writeHeader(out, name, "counter", help);
+    writeSample(out, name, nullptr, c.value());
+}
+
+inline void writeGauge(Print& out, const char* name, const char* help, uint32_t value) {
+    writeHeader(out, name, "gauge", help);
+    writeSample(out, name, nullptr, value);
+}
+
+/**
+ * Write histogram samples (caller writes the HELP/TYPE header once per family)
+ */
+template <size_t N>
+inline void writeHistogram(Print& out, const char* name, const char* labels, const Histogram<N>& h) {
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i <= N; i++) {
+        cumulative += h.bucket(i);
+        out.print(name); out.print(F("_bucket{"));
+        if (labels && *labels) { out.print(labels); out.print(','); }
+        out.print(F("le=\""));
+        if (i < N) out.print(h.bound(i) / 1e6, 6);
+        else out.print(F("+Inf"));
+        out.print(F("\"} "));
+        out.println(cumulative);
+    }
+    out.print(name); out.print(F("_sum"));
+    if (labels && *labels) { out.print('{'); out.print(labels); out.print('}'); }
+    out.print(' ');
+    out.println(h.sum() / 1e6, 6);
+    out.print(name); out.print(F("_count"));
+    if (labels && *labels) { out.print('{'); out.print(labels); out.print('}'); }
+    out.print(' ');
+    out.println(cumulative);
+}
+
+inline void writePrometheus(Print& out) {
+    const Registry& r = registry;
+
+    writeCounter(out, "gps_uart_bytes_total", "Bytes read from the GPS UART", r.uartBytes);
+    writeCounter(out, "gps_nmea_sentences_total", "NMEA sentences with valid checksum", r.nmeaSentences);
+    writeCounter(out, "gps_checksum_failures_total", "NMEA sentences with bad checksum", r.checksumFailures);
+
+    writeHeader(out, "gps_read_duration_seconds", "histogram", "GPSModule::poll duration per UART burst");
+    writeHistogram(out, "gps_read_duration_seconds", nullptr, r.gpsRead);
+
+    writeHeader(out, "http_upload_phase_seconds", "histogram", "sendGPSData latency by phase");
+    writeHistogram(out, "http_upload_phase_seconds", "phase=\"dns\"", r.httpDns);
+    writeHistogram(out, "http_upload_phase_seconds", "phase=\"connect\"", r.httpConnect);
+    writeHistogram(out, "http_upload_phase_seconds", "phase=\"send\"", r.httpSend);
+    writeHistogram(out, "http_upload_phase_seconds", "phase=\"response\"", r.httpResponse);
+
+    static const char* const httpClassLabels[] = {
+        "class=\"2xx\"", "class=\"3xx\"", "class=\"4xx\"", "class=\"5xx\"", "class=\"error\""
+    };
+    writeHeader(out, "http_upload_responses_total", "counter", "Upload responses by status class");
+    for (size_t i = 0; i < (size_t)HttpClass::COUNT; i++) {
+        writeSample(out, "http_upload_responses_total", httpClassLabels[i], r.httpStatus[i].value());
+    }
+    writeGauge(out, "upload_reports_held", "Reports kept until the server acknowledges them", r.uploadHeld.value());
+    writeGauge(out, "upload_ack_sequence", "Highest sequence the server has stored without gaps", r.uploadAckSeq.value());
+    writeCounter(out, "upload_resent_total", "Reports sent again after no 2xx", r.uploadResent);
+    writeCounter(out, "upload_given_up_total", "Unacknowledged reports dropped from a full outbox", r.uploadGivenUp);
+
+    char destinationLabels[64];
+    writeHeader(out, "upload_destination_latency_seconds", "histogram", "Report request time per destination, connect to response");
+    for (const DestinationMetrics& d : r.destinations) {
+        if (!d.name) continue;
+        snprintf(destinationLabels, sizeof(destinationLabels), "destination=\"%s\"", d.name);
+        writeHistogram(out, "upload_destination_latency_seconds", destinationLabels, d.latency);
+    }
+    writeHeader(out, "upload_destination_backlog", "gauge", "Reports waiting per destination");
+    for (const DestinationMetrics& d : r.destinations) {
+        if (!d.name) continue;
+        snprintf(destinationLabels, sizeof(destinationLabels), "destination=\"%s\"", d.name);
+        writeSample(out, "upload_destination_backlog", destinationLabels, d.backlog.value());
+    }
+    writeHeader(out, "upload_destination_requests_total", "counter", "Report requests per destination by result");
+    for (const DestinationMetrics& d : r.destinations) {
+        if (!d.name) continue;
+        snprintf(destinationLabels, sizeof(destinationLabels), "destination=\"%s\",result=\"ok\"", d.name);
+        writeSample(out, "upload_destination_requests_total", destinationLabels, d.delivered.value());
+        snprintf(destinationLabels, sizeof(destinationLabels), "destination=\"%s\",result=\"failed\"", d.name);
+        writeSample(out, "upload_destination_requests_total", destinationLabels, d.failed.value());
+    }
+    writeHeader(out, "upload_destination_dropped_total", "counter", "Reports dropped from a full destination backlog");
+    for (const DestinationMetrics& d : r.destinations) {
+        if (!d.name) continue;
+        snprintf(destinationLabels, sizeof(destinationLabels), "destination=\"%s\"", d.name);
+        writeSample(out, "upload_destination_dropped_total", destinationLabels, d.dropped.value());
+    }
+
+    writeHeader(out, "tls_handshake_seconds", "histogram", "TLS handshake time by session");
+    writeHistogram(out, "tls_handshake_seconds", "session=\"full\"", r.tlsHandshakeFull);
+    writeHistogram(out, "tls_handshake_seconds", "session=\"resumed\"", r.tlsHandshakeResumed);
+    writeGauge(out, "tls_handshake_heap_peak_bytes", "Heap taken by the last TLS handshake (sampled)", r.tlsHeapPeakBytes.value());
+    writeCounter(out, "tls_handshake_failures_total", "TLS handshakes that failed or timed out", r.tlsFailures);
+    writeCounter(out, "tls_pin_failures_total", "Servers whose key did not match the pin", r.tlsPinFailures);
+
+    char linkLabels[20];
+    writeHeader(out, "link_up", "gauge", "1 while the link has an address");
+    for (size_t i = 0; i < (size_t)NetLink::COUNT; i++) {
+        snprintf(linkLabels, sizeof(linkLabels), "link=\"%s\"", NET_LINK_NAMES[i]);
+        writeSample(out, "link_up", linkLabels, r.linkUp[i].value());
+    }
+    writeHeader(out, "link_active", "gauge", "1 for the link carrying uploads");
+    for (size_t i = 0; i < (size_t)NetLink::COUNT; i++) {
+        snprintf(linkLabels, sizeof(linkLabels), "link=\"%s\"", NET_LINK_NAMES[i]);
+        writeSample(out, "link_active", linkLabels, r.linkActive.value() == i + 1);
+    }
+    writeHeader(out, "link_connect_microseconds", "gauge", "Smoothed TCP connect time to the server");
+    for (size_t i = 0; i < (size_t)NetLink::COUNT; i++) {
+        snprintf(linkLabels, sizeof(linkLabels), "link=\"%s\"", NET_LINK_NAMES[i]);
+        writeSample(out, "link_connect_microseconds", linkLabels, r.linkConnectUs[i].value());
+    }
+    writeHeader(out, "link_failures_total", "counter", "Failed probes and uploads per link");
+    for (size_t i = 0; i < (size_t)NetLink::COUNT; i++) {
+        snprintf(linkLabels, sizeof(linkLabels), "link=\"%s\"", NET_LINK_NAMES[i]);
+        writeSample(out, "link_failures_total", linkLabels, r.linkFailures[i].value());
+    }
+    writeCounter(out, "link_switches_total", "Changes of the upload link", r.linkSwitches);
+    writeGauge(out, "link_failover_milliseconds", "Last failover: first failure to first report on the next link", r.linkFailoverMs.value());
+
+    writeCounter(out, "w5500_spi_frames_total", "SPI transactions with the W5500", r.w5500Frames);
+    writeCounter(out, "w5500_spi_bytes_total", "SPI bytes to and from the W5500, frame headers included", r.w5500Bytes);
+    writeCounter(out, "w5500_interrupts_total", "W5500 interrupts serviced with socket events pending", r.w5500Interrupts);
+
+    writeGauge(out, "gpsd_clients", "Clients connected to the GPS stream", r.gpsdClients.value());
+    writeCounter(out, "gpsd_sent_bytes_total", "GPS stream bytes sent to clients", r.gpsdSentBytes);
+    writeCounter(out, "gpsd_clients_dropped_total", "Stream clients disconnected for falling too far behind", r.gpsdDropped);
+    writeCounter(out, "gpsd_clients_refused_total", "Stream connections refused, all slots taken", r.gpsdRefused);
+
+    writeCounter(out, "ota_checks_total", "Firmware update checks", r.otaChecks);
+    writeCounter(out, "ota_updates_total", "Delta updates applied", r.otaUpdates);
+    writeCounter(out, "ota_failures_total", "Delta updates that failed and were discarded", r.otaFailures);
+    writeGauge(out, "ota_patch_bytes", "Size of the last applied patch", r.otaPatchBytes.value());
+    writeGauge(out, "ota_apply_milliseconds", "Download and apply time of the last update", r.otaApplyMs.value());
+    writeGauge(out, "ota_pending_verify", "1 while the running image awaits its first report", r.otaPendingVerify.value());
+
+    writeCounter(out, "archive_fixes_total", "Fixes added to the flash track archive", r.archiveFixes);
+    writeCounter(out, "archive_pages_written_total", "Archive pages programmed", r.archivePagesWritten);
+    writeCounter(out, "archive_sector_erases_total", "Archive flash sectors erased", r.archiveSectorErases);
+    writeCounter(out, "archive_flash_bytes_written_total", "Archive bytes programmed", r.archiveFlashBytes);
+    writeCounter(out, "archive_write_failures_total", "Archive pages that failed to program", r.archiveWriteFailures);
+    writeGauge(out, "archive_oldest_fix_timestamp_seconds", "Unix time of the oldest archived fix", r.archiveOldestTime.value());
+
+    static const char* const routeLabels[] = {
+        "route=\"dashboard\"", "route=\"export\"", "route=\"archive\"", "route=\"chart\"", "route=\"metrics\"",
+        "route=\"trace\"", "route=\"not_found\""
+    };
+    static_assert(sizeof(routeLabels) / sizeof(routeLabels[0]) == (size_t)WebRoute::COUNT, "one label per WebRoute");
+    writeHeader(out, "web_requests_total", "counter", "Web server requests served");
+    for (size_t i = 0; i < (size_t)WebRoute::COUNT; i++) {
+        writeSample(out, "web_requests_total", routeLabels[i], r.webRequests[i].value());
+    }
+
+    writeHeader(out, "loop_iteration_seconds", "histogram", "Upload event loop busy time per wakeup");
+    writeHistogram(out, "loop_iteration_seconds", nullptr, r.loopIteration);
+
+    static const char* const taskLabels[] = {"task=\"gps\"", "task=\"upload\"", "task=\"web\""};
+    writeHeader(out, "event_loop_wakeups_total", "counter", "Event loop wakeups (timers and events)");
+    for (size_t i = 0; i < (size_t)LoopTask::COUNT; i++) {
+        writeSample(out, "event_loop_wakeups_total", taskLabels[i], r.loopWakeups[i].value());
+    }
+
+    writeCounter(out, "event_loop_busy_microseconds_total", "Time all event loops spent handling wakeups", r.loopBusyMicros);
+
+    writeGauge(out, "power_on_battery", "1 while the ship-power sense line is down", r.onBattery.value());
+    writeGauge(out, "power_gps_power_save", "1 while the receiver is in cyclic tracking", r.gpsPowerSave.value());
+    writeGauge(out, "power_light_sleep_enabled", "1 while automatic light sleep is allowed", r.lightSleep.value());
+    writeGauge(out, "cpu_frequency_mhz", "Maximum CPU frequency", getCpuFrequencyMhz());
+    writeCounter(out, "energy_estimated_millijoules_total", "Modelled energy use since boot", r.energyMillijoules);
+
+    writeGauge(out, "geofences_loaded", "Polygons in the geofence blob", r.geofencesLoaded.value());
+    writeGauge(out, "geofences_inside", "Geofences the vessel is confirmed inside", r.geofencesInside.value());
+    writeCounter(out, "geofence_evaluations_total", "Fixes checked against the geofences", r.geofenceEvaluations);
+    writeCounter(out, "geofence_evaluation_microseconds_total", "Time spent checking fixes", r.geofenceEvalMicros);
+    writeHeader(out, "geofence_transitions_total", "counter", "Confirmed geofence transitions");
+    writeSample(out, "geofence_transitions_total", "transition=\"enter\"", r.geofenceEnter.value());
+    writeSample(out, "geofence_transitions_total", "transition=\"exit\"", r.geofenceExit.value());
+    writeCounter(out, "geofence_events_dropped_total", "Transitions lost because the event queue was full", r.geofenceDropped);
+
+    writeCounter(out, "position_filter_rejected_total", "Positions gated out as multipath outliers", r.filterRejected);
+    writeCounter(out, "position_filter_predicted_total", "Epochs dead reckoned without a new position", r.filterPredicted);
+    writeCounter(out, "position_filter_resets_total", "Filter restarts from the raw fix", r.filterResets);
+    writeCounter(out, "position_filter_microseconds_total", "Time spent filtering fixes", r.filterEvalMicros);
+
+    writeGauge(out, "route_cross_track_metres", "Distance from the planned route", r.routeCrossTrackM.value());
+    writeGauge(out, "route_progress_metres", "Distance made good along the planned route", r.routeProgressM.value());
+    writeGauge(out, "route_eta_seconds", "Time to the next port (0 = unknown)", r.routeEtaSeconds.value());
+    writeCounter(out, "route_corridor_breaches_total", "Confirmed exits from the route corridor", r.routeBreaches);
+    writeCounter(out, "route_evaluation_microseconds_total", "Time spent matching fixes to the route", r.routeEvalMicros);
+
+    writeGauge(out, "trip_odometer_metres", "Distance sailed, kept across reboots", r.tripOdometerM.value());
+    writeGauge(out, "trip_moving", "1 while the vessel is confirmed moving", r.tripMoving.value());
+    writeCounter(out, "trips_completed_total", "Trips ended by a long stop", r.tripsCompleted);
+    writeCounter(out, "trip_fixes_rejected_total", "Fixes skipped as position outliers", r.tripFixesRejected);
+    writeCounter(out, "trip_evaluation_microseconds_total", "Time spent on trip analytics", r.tripEvalMicros);
+
+    writeCounter(out, "log_records_dropped_total", "Log records dropped because the ring was full", r.logDropped);
+
+    writeGauge(out, "heap_free_bytes", "Current free heap", ESP.getFreeHeap());
+    writeGauge(out, "heap_min_free_bytes", "Lowest free heap since boot", ESP.getMinFreeHeap());
+    writeGauge(out, "heap_largest_free_block_bytes", "Largest allocatable heap block", ESP.getMaxAllocHeap());
+    writeGauge(out, "heap_fragmentation_percent", "100 - largest free block / free heap", heapFragmentation());
+
+    const Arena* arenas[] = {&Memory::cycle, &Memory::web};
+    char labels[24];
+    writeHeader(out, "arena_capacity_bytes", "gauge", "Static arena size");
+    for (const Arena* a : arenas) {
+        snprintf(labels, sizeof(labels), "arena=\"%s\"", a->name());
+        writeSample(out, "arena_capacity_bytes", labels, a->capacity());
+    }
+    writeHeader(out, "arena_high_water_bytes", "gauge", "Peak arena usage since boot");
+    for (const Arena* a : arenas) {
+        snprintf(labels, sizeof(labels), "arena=\"%s\"", a->name());
+        writeSample(out, "arena_high_water_bytes", labels, a->highWater());
+    }
+    writeHeader(out, "arena_exhausted_total", "counter", "Arena allocations that did not fit");
+    for (const Arena* a : arenas) {
+        snprintf(labels, sizeof(labels), "arena=\"%s\"", a->name());
+        writeSample(out, "arena_exhausted_total", labels, a->exhausted());
+    }
+    writeHeader(out, "boot_phase_milliseconds", "gauge", "Time from boot to each phase (0 = not reached)");
+    for (size_t i = 0; i < (size_t)BootPhase::COUNT; i++) {
+        snprintf(labels, sizeof(labels), "phase=\"%s\"", BOOT_PHASE_NAMES[i]);
+        writeSample(out, "boot_phase_milliseconds", labels, r.bootPhaseMs[i].value());
+    }
+
+    writeGauge(out, "uptime_seconds", "Seconds since boot", millis() / 1000);
+}
+
+/**
+ * Serve /metrics
+ */
+inline void serve(Print& out) {
+    out.println(F("HTTP/1.1 200 OK"));
+    out.println(F("Content-Type: text/plain; version=0.0.4"));
+    out.println(F("Connection: close"));
+    out.println();
+    writePrometheus(out);
+}
+
+} // namespace Metrics
+
+#endif // METRICS_H
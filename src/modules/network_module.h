@@ -2,10 +2,20 @@
 #define NETWORK_MODULE_H
 
 #include <Arduino.h>
-#include <SPI.h>
-#include <Ethernet.h>
-#include <ArduinoJson.h>
+#include "ethernet_bus.h"
 #include "gps_module.h"
+#include "http_download.h"
+#include "http_upload.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+#if SERVER_TLS_ENABLE
+#include "tls_client.h"
+#endif
+
+#ifndef DHCP_SLICE_MS
+#define DHCP_SLICE_MS 1000     // Longest single hold of the Ethernet bus in begin()
+#endif
 
 /**
  * Network Status Enum
@@ -17,14 +27,6 @@ enum class NetworkStatus : uint8_t {
     ERROR
 };
 
-/**
- * HTTP Response Structure
- */
-struct HttpResponse {
-    int16_t statusCode;
-    bool success;
-};
-
 /**
  * Network Module Class - Handles Ethernet and HTTP operations
  */
@@ -38,8 +40,14 @@ public:
      * @param mac MAC address array (6 bytes)
      * @param timeoutMs DHCP timeout
      * @return true if connected successfully
+     *
+     * The bus lock is taken per step, not across the reset delays or the
+     * whole DHCP wait: the web task keeps serving meanwhile (over WiFi in
+     * dual-link mode), and isConnected() answers without the lock.
      */
     bool begin(const uint8_t* mac, uint32_t timeoutMs = 10000) {
+        _status = NetworkStatus::CONNECTING;
+
         // Hardware reset W5500
         pinMode(_rstPin, OUTPUT);
         digitalWrite(_rstPin, LOW);
@@ -47,47 +55,61 @@ public:
         digitalWrite(_rstPin, HIGH);
         delay(500);
 
-        // Initialize SPI
-        Ethernet.init(_csPin);
-
-        _status = NetworkStatus::CONNECTING;
-
-        // DHCP with timeout
-        if (Ethernet.begin(const_cast<uint8_t*>(mac)) == 0) {
-            _status = NetworkStatus::ERROR;
-            return false;
+        // DHCP in slices of DHCP_SLICE_MS, the bus free in between
+        const uint32_t start = millis();
+        bool leased = false;
+        while (!leased) {
+            {
+                Rtos::LockGuard guard(EthernetBus::mutex);
+                EthernetBus::ethernet.init(_csPin);
+                leased = EthernetBus::ethernet.begin(const_cast<uint8_t*>(mac), DHCP_SLICE_MS, DHCP_SLICE_MS) != 0 &&
+                         EthernetBus::ethernet.localIP() != IPAddress(0, 0, 0, 0);
+                if (leased) EthernetBus::enableInterrupts();  // The reset cleared the masks
+            }
+            if (leased || millis() - start >= timeoutMs) break;
+            delay(10);
         }
 
-        // Verify we got a valid IP
-        if (Ethernet.localIP() == IPAddress(0, 0, 0, 0)) {
-            _status = NetworkStatus::ERROR;
-            return false;
-        }
+        _status = leased ? NetworkStatus::CONNECTED : NetworkStatus::ERROR;
+        return leased;
+    }
 
-        _status = NetworkStatus::CONNECTED;
-        return true;
+    /**
+     * Cable and switch present (PHY link up); true when the chip cannot
+     * tell, so the caller still tries
+     */
+    bool linkUp() const {
+        Rtos::LockGuard guard(EthernetBus::mutex);
+        #if W5500_DRIVER_ENABLE
+        return EthernetBus::ethernet.linkUp();
+        #else
+        return EthernetBus::ethernet.linkStatus() != LinkOFF;
+        #endif
     }
 
     /**
      * Maintain Ethernet connection (call periodically)
      */
     void maintain() {
-        Ethernet.maintain();
+        Rtos::LockGuard guard(EthernetBus::mutex);
+        EthernetBus::ethernet.maintain();
     }
 
     /**
      * Check if connected
      */
     bool isConnected() const {
-        return _status == NetworkStatus::CONNECTED &&
-               Ethernet.localIP() != IPAddress(0, 0, 0, 0);
+        if (_status != NetworkStatus::CONNECTED) return false;
+        Rtos::LockGuard guard(EthernetBus::mutex);
+        return EthernetBus::ethernet.localIP() != IPAddress(0, 0, 0, 0);
     }
 
     /**
      * Get local IP as string
      */
     void getLocalIP(char* buffer, size_t bufferSize) const {
-        IPAddress ip = Ethernet.localIP();
+        Rtos::LockGuard guard(EthernetBus::mutex);
+        IPAddress ip = EthernetBus::ethernet.localIP();
         snprintf(buffer, bufferSize, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
     }
 
@@ -105,151 +127,158 @@ public:
      * @param port Server port
      * @param deviceId Device identifier
      * @param gpsData GPS data to send
+     * @param extras Event content for out-of-band reports
      * @return HttpResponse with status
      */
     HttpResponse sendGPSData(const char* host, const char* path, uint16_t port,
-                             const char* deviceId, const GPSData& gpsData) {
+                             const char* deviceId, const GPSData& gpsData,
+                             const HttpUpload::ReportExtras& extras = {}) {
+        char ipBuffer[16];
+        getLocalIP(ipBuffer, sizeof(ipBuffer));
+
+        ArenaScope scope(Memory::cycle);
+        const char* payload = HttpUpload::buildJsonPayload(Memory::cycle, deviceId, gpsData, ipBuffer, extras);
+        if (!payload) return HttpResponse{0, false};
+        return sendReport(host, path, port, payload);
+    }
+
+    /**
+     * POST a report already serialized (shared with other destinations)
+     */
+    HttpResponse sendReport(const char* host, const char* path, uint16_t port, const char* payload) {
         HttpResponse response = {0, false};
 
         if (!isConnected()) {
-            Serial.println("[HTTP] Ethernet not connected");
+            LOG(HTTP_NO_LINK, "Ethernet");
             return response;
         }
 
-        Serial.printf("[HTTP] Connecting to %s:%d...\n", host, port);
+        LOG(HTTP_CONNECTING, host, port);
 
-        // Connect to server
-        if (!_client.connect(host, port)) {
-            Serial.println("[HTTP] Connection failed!");
-            _client.stop();
+        // Resolve host (timed separately from connect)
+        if (!resolve(host, _serverIP)) {
+            LOG(HTTP_DNS_FAILED);
+            Metrics::registry.recordHttpStatus(0);
             return response;
         }
 
-        Serial.println("[HTTP] Connected, sending POST...");
-
-        // Build JSON payload using stack buffer
-        char jsonBuffer[384];
-        buildJsonPayload(jsonBuffer, sizeof(jsonBuffer), deviceId, gpsData);
-
-        Serial.printf("[HTTP] Payload: %s\n", jsonBuffer);
-
-        // Send HTTP POST request
-        sendHttpPost(host, path, jsonBuffer);
-
-        // Read response
-        response = readHttpResponse();
-
-        Serial.printf("[HTTP] Response: %d (success=%d)\n", response.statusCode, response.success);
-
-        // Cleanup
-        _client.stop();
-
-        return response;
+        LockedClient client(_client);  // Lock per call so the web task can interleave
+        #if SERVER_TLS_ENABLE
+        TlsClient tls(_tls, client, host);
+        return HttpUpload::postPayload(tls, _serverIP, host, path, port, payload);
+        #else
+        return HttpUpload::postPayload(client, _serverIP, host, path, port, payload);
+        #endif
     }
 
-private:
-    const uint8_t _csPin;
-    const uint8_t _rstPin;
-    NetworkStatus _status;
-    EthernetClient _client;
-
     /**
-     * Build JSON payload into buffer (no heap allocation)
+     * Stream the body of a GET into body (firmware patches)
      */
-    void buildJsonPayload(char* buffer, size_t bufferSize,
-                          const char* deviceId, const GPSData& gpsData) {
-        StaticJsonDocument<384> doc;
-
-        doc["device_id"] = deviceId;
-
-        if (gpsData.valid) {
-            doc["status"] = "online";
-            doc["latitude"] = gpsData.latitude;
-            doc["longitude"] = gpsData.longitude;
-            doc["speed"] = gpsData.speed;
-            doc["altitude"] = gpsData.altitude;
-            doc["course"] = gpsData.course;
-            doc["satellites"] = gpsData.satellites;
-            doc["timestamp"] = gpsData.datetime;
-        } else {
-            doc["status"] = "no_fix";
-            doc["satellites"] = gpsData.satellites;
+    HttpDownload::Result fetch(const char* host, const char* path, uint16_t port, Print& body) {
+        if (!isConnected()) {
+            LOG(HTTP_NO_LINK, "Ethernet");
+            return HttpDownload::Result{0, 0, false};
+        }
+        if (!resolve(host, _serverIP)) {
+            LOG(HTTP_DNS_FAILED);
+            return HttpDownload::Result{0, 0, false};
         }
 
-        // Add system info
-        char ipBuffer[16];
-        getLocalIP(ipBuffer, sizeof(ipBuffer));
-        doc["ip"] = ipBuffer;
-        doc["uptime_sec"] = millis() / 1000;
-        doc["free_heap"] = ESP.getFreeHeap();
-
-        serializeJson(doc, buffer, bufferSize);
+        LockedClient client(_client);
+        #if SERVER_TLS_ENABLE
+        TlsClient tls(_tls, client, host);
+        return HttpDownload::get(tls, _serverIP, host, path, port, body);
+        #else
+        return HttpDownload::get(client, _serverIP, host, path, port, body);
+        #endif
     }
 
     /**
-     * Send HTTP POST request
+     * Time a plain TCP connect to the server, for link scoring (uses the
+     * address from the last lookup)
+     * @param connectUs Receives the connect time
+     * @return false if the server could not be reached
      */
-    void sendHttpPost(const char* host, const char* path, const char* payload) {
-        const size_t payloadLen = strlen(payload);
-
-        _client.print(F("POST "));
-        _client.print(path);
-        _client.println(F(" HTTP/1.1"));
-
-        _client.print(F("Host: "));
-        _client.println(host);
-
-        _client.println(F("Content-Type: application/json"));
-        _client.println(F("Connection: close"));
-
-        _client.print(F("Content-Length: "));
-        _client.println(payloadLen);
-
-        _client.println();
-        _client.print(payload);
+    bool probe(const char* host, uint16_t port, uint32_t& connectUs) {
+        if (!isConnected()) return false;
+        if (_serverIP == IPAddress(0, 0, 0, 0) && !resolve(host, _serverIP)) return false;
+        LockedClient client(_client);
+        const uint32_t start = micros();
+        const bool connected = client.connect(_serverIP, port);
+        connectUs = micros() - start;
+        client.stop();
+        return connected;
     }
 
     /**
-     * Read HTTP response with timeout
+     * Own connection to one extra report destination (upload_fanout.h):
+     * a socket from the W5500 fan-out pool, its address and TLS session
      */
-    HttpResponse readHttpResponse() {
-        HttpResponse response = {0, false};
-        const uint32_t timeout = 5000;
-        const uint32_t startTime = millis();
-
-        Serial.println("[HTTP] Waiting for response...");
-
-        // Wait for response
-        while (_client.available() == 0) {
-            if (millis() - startTime > timeout) {
-                Serial.println("[HTTP] Response timeout!");
-                return response;
-            }
-            yield();
+    class Channel {
+    public:
+        Client& client() {
+            #if SERVER_TLS_ENABLE
+            return _tls;
+            #else
+            return _locked;
+            #endif
         }
 
-        // Read status line
-        if (_client.available()) {
-            char statusLine[64];
-            size_t len = _client.readBytesUntil('\n', statusLine, sizeof(statusLine) - 1);
-            statusLine[len] = '\0';
-
-            Serial.printf("[HTTP] Status line: %s\n", statusLine);
+    private:
+        friend class NetworkModule;
+        #if W5500_DRIVER_ENABLE
+        EthernetClient _socket{W5500Pool::FANOUT};
+        #else
+        EthernetClient _socket;
+        #endif
+        LockedClient _locked{_socket};
+        IPAddress _ip;      // Looked up once, again after a failed connect
+        #if SERVER_TLS_ENABLE
+        TlsContext _context;
+        TlsClient _tls{_context, _locked, ""};
+        #endif
+    };
 
-            // Parse status code from "HTTP/1.1 200 OK"
-            char* codeStart = strchr(statusLine, ' ');
-            if (codeStart) {
-                response.statusCode = atoi(codeStart + 1);
-                response.success = (response.statusCode >= 200 && response.statusCode < 300);
-            }
-        }
-
-        // Drain remaining response
-        while (_client.available()) {
-            _client.read();
+    /**
+     * Connect a channel; the caller writes, polls and stops its client()
+     * @param pin Base64 SHA-256 of the server's key ("" = refused unless TLS_ALLOW_UNPINNED)
+     * @return false without a link, address or connection
+     */
+    bool open(Channel& channel, const char* host, uint16_t port, const char* pin) {
+        if (!isConnected()) return false;
+        if (channel._ip == IPAddress(0, 0, 0, 0) && !resolve(host, channel._ip)) {
+            LOG(HTTP_DNS_FAILED);
+            return false;
         }
+        #if SERVER_TLS_ENABLE
+        channel._context.pin(pin);
+        channel._tls.setHostname(host);
+        #else
+        (void)pin;
+        #endif
+        if (channel.client().connect(channel._ip, port)) return true;
+        channel.client().stop();
+        channel._ip = IPAddress(0, 0, 0, 0);
+        return false;
+    }
 
-        return response;
+private:
+    const uint8_t _csPin;
+    const uint8_t _rstPin;
+    volatile NetworkStatus _status;  // Read without the bus lock
+    EthernetClient _client;
+    IPAddress _serverIP;    // Last lookup, reused by probes
+    #if SERVER_TLS_ENABLE
+    TlsContext _tls;    // Keeps the session between reports
+    #endif
+
+    bool resolve(const char* host, IPAddress& ip) {
+        TRACE_SPAN("dns");
+        Metrics::ScopedTimer<Metrics::LatencyHistogram> timer(Metrics::registry.httpDns);
+        Rtos::LockGuard guard(EthernetBus::mutex);
+        DNSClient dns;
+        dns.begin(EthernetBus::ethernet.dnsServerIP());
+        return dns.getHostByName(host, ip) == 1;
     }
 };
 
@@ -0,0 +1,254 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+/**
+ * @file ota_update.h
+ * @brief Delta firmware updates into the inactive OTA slot, with rollback
+ *
+ * Every OTA_CHECK_INTERVAL_MS the uploader asks the report server for a
+ * patch against the running image:
+ *   GET OTA_PATH?device=<id>&version=<FIRMWARE_VERSION>
+ * 200 carries a patch from tools/ota/make_delta.py, anything else means
+ * no update. The header names the image the patch was made against and
+ * the one it produces (SHA-256 of the first oldSize / newSize bytes of
+ * the slot, i.e. of the .bin files), so a static file server will do:
+ * a patch for another base is refused, one for the running image stops
+ * the download after the header.
+ *
+ * The body streams through DeltaApplier straight into the next OTA slot
+ * (old bytes are read back from the running slot). Once the new image
+ * hashes right it becomes the boot partition and the caller restarts.
+ * The image hash comes from the same server as the patch, so the server
+ * is what vouches for the image: updates need the pinned HTTPS link
+ * (tls_client.h), never plain HTTP or an unpinned server.
+ *
+ * Rollback needs the bootloader's app rollback (arduino-esp32 builds
+ * have it): the new image boots PENDING_VERIFY and confirms itself with
+ * its first successful report. No report within OTA_HEALTH_TIMEOUT_MS
+ * of link time (the caller runs the clock only while the link is up),
+ * or a crash or watchdog reset before then, brings the previous image
+ * back. That image stays in the other slot marked invalid, and a patch
+ * producing it again is refused until the server offers something else.
+ */
+
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include "../config.h"
+#include "delta_patch.h"
+#include "http_download.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+
+#ifndef OTA_PATH
+#define OTA_PATH                "/firmware/patch"
+#endif
+#ifndef OTA_CHECK_INTERVAL_MS
+#define OTA_CHECK_INTERVAL_MS   21600000UL  // 6 hours
+#endif
+#ifndef OTA_FIRST_CHECK_MS
+#define OTA_FIRST_CHECK_MS      60000
+#endif
+#ifndef OTA_HEALTH_TIMEOUT_MS
+#define OTA_HEALTH_TIMEOUT_MS   300000
+#endif
+
+#if !SERVER_TLS_ENABLE || (defined(TLS_ALLOW_UNPINNED) && TLS_ALLOW_UNPINNED)
+#error "OTA_ENABLE needs SERVER_TLS_ENABLE with TLS_PIN_SHA256: nothing else authenticates the patch"
+#endif
+
+/**
+ * DeltaApplier image: old bytes from the running slot, new bytes into
+ * the next one
+ */
+class OtaSlots {
+public:
+    bool begin() {
+        _running = esp_ota_get_running_partition();
+        _target = esp_ota_get_next_update_partition(nullptr);
+        return _running && _target;
+    }
+
+    DeltaError open(const DeltaHeader& header) {
+        if (header.newSize > _target->size) return DeltaError::NO_SPACE;
+        if (header.oldSize > _running->size) return DeltaError::WRONG_BASE;
+        if (runningHashIs(header.newSize, header.newSha256)) return DeltaError::CURRENT;
+        if (!runningHashIs(header.oldSize, header.oldSha256)) return DeltaError::WRONG_BASE;
+        if (rejected(header)) return DeltaError::ROLLED_BACK;
+        if (esp_ota_begin(_target, header.newSize, &_handle) != ESP_OK) return DeltaError::WRITE_FAILED;
+        _open = true;
+        return DeltaError::NONE;
+    }
+
+    bool readOld(uint32_t offset, uint8_t* out, size_t len) {
+        return esp_partition_read(_running, offset, out, len) == ESP_OK;
+    }
+
+    bool writeNew(const uint8_t* data, size_t len) {
+        return esp_ota_write(_handle, data, len) == ESP_OK;
+    }
+
+    /**
+     * Close the written image and boot it next
+     */
+    bool commit() {
+        _open = false;
+        return esp_ota_end(_handle) == ESP_OK && esp_ota_set_boot_partition(_target) == ESP_OK;
+    }
+
+    void abort() {
+        if (_open) esp_ota_abort(_handle);
+        _open = false;
+    }
+
+    const esp_partition_t* running() const { return _running; }
+    const esp_partition_t* target() const { return _target; }
+
+private:
+    const esp_partition_t* _running = nullptr;
+    const esp_partition_t* _target = nullptr;
+    esp_ota_handle_t _handle = 0;
+    bool _open = false;
+
+    // The running image cannot change until a restart: keep the last hash
+    uint32_t _hashedSize = 0;
+    uint8_t _hashed[32];
+
+    bool runningHashIs(uint32_t size, const uint8_t* sha) {
+        if (size != _hashedSize || size == 0) {
+            if (!hashPartition(_running, size, _hashed)) return false;
+            _hashedSize = size;
+        }
+        return memcmp(_hashed, sha, sizeof(_hashed)) == 0;
+    }
+
+    // The target slot still holds this very image, and the bootloader
+    // threw it out: applying it again would only roll back again
+    bool rejected(const DeltaHeader& header) {
+        esp_ota_img_states_t state;
+        if (esp_ota_get_state_partition(_target, &state) != ESP_OK) return false;
+        if (state != ESP_OTA_IMG_INVALID && state != ESP_OTA_IMG_ABORTED) return false;
+        uint8_t digest[32];
+        return hashPartition(_target, header.newSize, digest) &&
+               memcmp(digest, header.newSha256, sizeof(digest)) == 0;
+    }
+
+    static bool hashPartition(const esp_partition_t* partition, uint32_t size, uint8_t out[32]) {
+        Sha256 hash;
+        hash.begin();
+        uint8_t chunk[DELTA_READ_CHUNK];
+        for (uint32_t offset = 0; offset < size; offset += sizeof(chunk)) {
+            const size_t n = min((uint32_t)sizeof(chunk), size - offset);
+            if (esp_partition_read(partition, offset, chunk, n) != ESP_OK) return false;
+            hash.update(chunk, n);
+        }
+        hash.finish(out);
+        return true;
+    }
+};
+
+class OtaUpdater {
+public:
+    /**
+     * At boot: find the slots and whether this image still has to prove
+     * itself
+     */
+    void begin() {
+        _ready = _slots.begin();
+        if (!_ready) {
+            LOG(OTA_NO_SLOTS);
+            return;
+        }
+        esp_ota_img_states_t state;
+        _pendingVerify = esp_ota_get_state_partition(_slots.running(), &state) == ESP_OK &&
+                         state == ESP_OTA_IMG_PENDING_VERIFY;
+        Metrics::registry.otaPendingVerify.set(_pendingVerify);
+        if (_pendingVerify) LOG(OTA_PENDING_VERIFY, _slots.running()->label, OTA_HEALTH_TIMEOUT_MS / 1000);
+    }
+
+    bool ready() const { return _ready; }
+    bool pendingVerify() const { return _pendingVerify; }
+
+    /**
+     * A report went through: keep this image
+     */
+    void confirm() {
+        if (!_pendingVerify) return;
+        _pendingVerify = false;
+        Metrics::registry.otaPendingVerify.set(0);
+        if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) LOG(OTA_CONFIRMED, _slots.running()->label);
+    }
+
+    /**
+     * No report within OTA_HEALTH_TIMEOUT_MS of link: back to the previous image
+     * (restarts unless there is none)
+     */
+    void rollback() {
+        if (!_pendingVerify) return;
+        LOG(OTA_ROLLBACK, OTA_HEALTH_TIMEOUT_MS / 1000);
+        Log::flush();
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+        _pendingVerify = false;     // Still here: nothing to go back to
+        LOG(OTA_NO_ROLLBACK);
+    }
+
+    /**
+     * Ask for a patch and apply it
+     * @param network Provides fetch(host, path, port, Print&)
+     * @return true if the new image boots after a restart
+     */
+    template <typename Network>
+    bool update(Network& network, const char* deviceId) {
+        if (!_ready) return false;
+        TRACE_SPAN("ota");
+        Metrics::Registry& metrics = Metrics::registry;
+        metrics.otaChecks.inc();
+
+        char path[128];
+        snprintf(path, sizeof(path), "%s?device=%s&version=%s", OTA_PATH, deviceId, FIRMWARE_VERSION);
+        _applier.reset();
+        const uint32_t start = millis();
+        const HttpDownload::Result result = network.fetch(SERVER_HOST, path, SERVER_PORT, _applier);
+
+        DeltaError error = _applier.error();
+        if (result.statusCode != 200) {
+            LOG(OTA_NO_UPDATE, result.statusCode);
+            return false;
+        }
+        if (error == DeltaError::CURRENT) {
+            LOG(OTA_CURRENT);
+            return false;
+        }
+        if (error == DeltaError::ROLLED_BACK) {
+            LOG(OTA_REJECTED, _slots.target()->label);
+            return false;
+        }
+        if (error == DeltaError::NONE) error = result.complete ? _applier.finish() : DeltaError::TRUNCATED;
+        if (error == DeltaError::NONE && !_slots.commit()) error = DeltaError::WRITE_FAILED;
+        if (error != DeltaError::NONE) {
+            _slots.abort();
+            metrics.otaFailures.inc();
+            LOG(OTA_FAILED, DELTA_ERROR_NAMES[(size_t)error], result.bytes);
+            return false;
+        }
+
+        const uint32_t elapsed = max<uint32_t>(millis() - start, 1);
+        const uint32_t newSize = _applier.header().newSize;
+        metrics.otaUpdates.inc();
+        metrics.otaPatchBytes.set(result.bytes);
+        metrics.otaApplyMs.set(elapsed);
+        LOG(OTA_APPLIED, _slots.target()->label, result.bytes, newSize,
+            (unsigned)((uint64_t)result.bytes * 100 / max<uint32_t>(newSize, 1)), elapsed,
+            (unsigned)((uint64_t)newSize * 1000 / 1024 / elapsed));
+        return true;
+    }
+
+private:
+    OtaSlots _slots;
+    DeltaApplier<OtaSlots> _applier{_slots};    // Buffers live here, not on the task stack
+    bool _ready = false;
+    bool _pendingVerify = false;
+};
+
+#endif // OTA_UPDATE_H
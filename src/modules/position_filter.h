@@ -0,0 +1,264 @@
+#ifndef POSITION_FILTER_H
+#define POSITION_FILTER_H
+
+/**
+ * @file position_filter.h
+ * @brief Constant-velocity Kalman filter between the NMEA parser and
+ *        every consumer of the fix
+ *
+ * State is position and velocity east/north in a local frame around an
+ * E7 origin that follows the vessel, so single-precision float (the
+ * ESP32 FPU) keeps millimetres. East and north are independent 2-state
+ * filters; each epoch is one predict and one update with the position
+ * and the receiver's Doppler velocity (speed over ground and course).
+ *
+ * Measurement noise is HDOP times POSITION_UERE_M (position) and
+ * POSITION_SPEED_SIGMA_MPS (velocity). A position whose innovation
+ * fails the chi-square gate (multipath near cranes and hulls) is
+ * dropped and only the velocity is used; POSITION_MAX_REJECTS in a row
+ * restart the filter at the new position, since the vessel did move.
+ * Epochs without a new position (dropouts) are dead reckoned for up to
+ * POSITION_DR_MS, after which the fix is reported lost.
+ *
+ * Cost per epoch: about 70 float operations, a few divisions and
+ * sinf/cosf of the course; BM_PositionFilterUpdate checks it against
+ * POSITION_CYCLE_BUDGET.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include "../config.h"
+
+#ifndef POSITION_UERE_M
+#define POSITION_UERE_M             3.0
+#endif
+#ifndef POSITION_SPEED_SIGMA_MPS
+#define POSITION_SPEED_SIGMA_MPS    0.2
+#endif
+#ifndef POSITION_ACCEL_MPS2
+#define POSITION_ACCEL_MPS2         0.5
+#endif
+#ifndef POSITION_GATE
+#define POSITION_GATE               13.8    // Chi-square, 2 dof, 99.9 %
+#endif
+#ifndef POSITION_MAX_REJECTS
+#define POSITION_MAX_REJECTS        5
+#endif
+#ifndef POSITION_DR_MS
+#define POSITION_DR_MS              15000
+#endif
+#ifndef POSITION_CYCLE_BUDGET
+#define POSITION_CYCLE_BUDGET       4800    // Per epoch: 20 us at 240 MHz, 0.02 % of a core at 10 Hz
+#endif
+#ifndef POSITION_UNKNOWN_HDOP
+#define POSITION_UNKNOWN_HDOP       2.0     // Used until the first GGA
+#endif
+
+/**
+ * One epoch from the receiver
+ */
+struct PositionMeasurement {
+    int32_t latE7;
+    int32_t lonE7;
+    float hdop;             // 0 = unknown
+    float speedMps;
+    float courseDeg;
+    uint32_t timeMs;
+    bool fresh;             // false = no new position this epoch (dropout)
+};
+
+/**
+ * Filter output
+ */
+struct FilteredPosition {
+    int32_t latE7;
+    int32_t lonE7;
+    bool valid;             // false = no fix, or dead reckoned too long
+    bool deadReckoned;
+};
+
+enum class FilterStep : uint8_t {
+    ACCEPTED,
+    REJECTED,               // Position gated out, velocity used
+    PREDICTED,              // Dead reckoned
+    RESET,                  // Started from the measurement
+    LOST,                   // No fix for POSITION_DR_MS
+};
+
+class PositionFilter {
+public:
+    /**
+     * Process one epoch
+     * @param out Receives the estimate (valid = false while lost)
+     */
+    FilterStep update(const PositionMeasurement& m, FilteredPosition& out) {
+        if (!m.fresh) {
+            if (!_running || m.timeMs - _measuredMs > POSITION_DR_MS) {
+                _running = false;
+                out = FilteredPosition{m.latE7, m.lonE7, false, false};
+                return FilterStep::LOST;
+            }
+            predict(m.timeMs);
+            output(out, true);
+            return FilterStep::PREDICTED;
+        }
+
+        const float hdop = m.hdop > 0 ? m.hdop : (float)POSITION_UNKNOWN_HDOP;
+        const float rp = sq(hdop * (float)POSITION_UERE_M);
+        const float rv = sq(hdop * (float)POSITION_SPEED_SIGMA_MPS);
+        const float course = m.courseDeg * (float)DEG_TO_RAD;
+        const float ve = m.speedMps * sinf(course);
+        const float vn = m.speedMps * cosf(course);
+
+        FilterStep step;
+        if (!_running || m.timeMs - _measuredMs > POSITION_DR_MS) {
+            start(m, rp, ve, vn, rv);
+            step = FilterStep::RESET;
+        } else {
+            predict(m.timeMs);
+            const float ze = (float)((int64_t)m.lonE7 - _originLonE7) * _kx;
+            const float zn = (float)((int64_t)m.latE7 - _originLatE7) * METRES_PER_E7;
+            const float ye = ze - _east.p, yn = zn - _north.p;
+            const float d2 = ye * ye / (_east.pp + rp) + yn * yn / (_north.pp + rp);
+
+            if (d2 <= (float)POSITION_GATE) {
+                _rejects = 0;
+                _east.update(ze, rp, ve, rv);
+                _north.update(zn, rp, vn, rv);
+                step = FilterStep::ACCEPTED;
+            } else if (++_rejects >= POSITION_MAX_REJECTS) {
+                start(m, rp, ve, vn, rv);
+                step = FilterStep::RESET;
+            } else {
+                _east.updateVelocity(ve, rv);
+                _north.updateVelocity(vn, rv);
+                step = FilterStep::REJECTED;
+            }
+        }
+        _measuredMs = m.timeMs;
+        recentre();
+        output(out, false);
+        return step;
+    }
+
+    void reset() {
+        _running = false;
+        _rejects = 0;
+    }
+
+    bool running() const { return _running; }
+
+private:
+    static constexpr float METRES_PER_E7 = 0.0111319f;
+    static constexpr float E7_PER_METRE = 1 / METRES_PER_E7;
+    static constexpr float RECENTRE_M = 500;
+
+    /**
+     * One axis: position p, velocity v, covariance [pp pv; pv vv]
+     */
+    struct Axis {
+        float p, v, pp, pv, vv;
+
+        void start(float zp, float rp, float zv, float rv) {
+            p = zp;
+            v = zv;
+            pp = rp;
+            pv = 0;
+            vv = rv;
+        }
+
+        // White acceleration with spectral density q
+        void predict(float dt, float q) {
+            p += v * dt;
+            const float dt2 = dt * dt;
+            pp += dt * (2 * pv + dt * vv) + q * dt2 * dt * (1.0f / 3);
+            pv += dt * vv + q * dt2 * 0.5f;
+            vv += q * dt;
+        }
+
+        // Position and velocity measured (H = I, R diagonal)
+        void update(float zp, float rp, float zv, float rv) {
+            const float s00 = pp + rp, s11 = vv + rv;
+            const float inv = 1 / (s00 * s11 - pv * pv);
+            const float i00 = s11 * inv, i01 = -pv * inv, i11 = s00 * inv;
+            const float k00 = pp * i00 + pv * i01, k01 = pp * i01 + pv * i11;
+            const float k10 = pv * i00 + vv * i01, k11 = pv * i01 + vv * i11;
+            const float yp = zp - p, yv = zv - v;
+            p += k00 * yp + k01 * yv;
+            v += k10 * yp + k11 * yv;
+            const float npp = (1 - k00) * pp - k01 * pv;
+            const float npv = (1 - k00) * pv - k01 * vv;
+            vv = (1 - k11) * vv - k10 * pv;
+            pp = npp;
+            pv = npv;
+        }
+
+        // Velocity only (H = [0 1])
+        void updateVelocity(float zv, float rv) {
+            const float inv = 1 / (vv + rv);
+            const float k0 = pv * inv, k1 = vv * inv;
+            const float y = zv - v;
+            p += k0 * y;
+            v += k1 * y;
+            pp -= k0 * pv;
+            pv -= k0 * vv;
+            vv -= k1 * vv;
+        }
+    };
+
+    Axis _east{};
+    Axis _north{};
+    int32_t _originLatE7 = 0;
+    int32_t _originLonE7 = 0;
+    float _kx = METRES_PER_E7;      // Metres per E7 of longitude at the origin
+    float _kxInv = E7_PER_METRE;
+    uint32_t _timeMs = 0;           // Time of the state
+    uint32_t _measuredMs = 0;       // Last fix used
+    uint8_t _rejects = 0;
+    bool _running = false;
+
+    void start(const PositionMeasurement& m, float rp, float ve, float vn, float rv) {
+        setOrigin(m.latE7, m.lonE7);
+        _east.start(0, rp, ve, rv);
+        _north.start(0, rp, vn, rv);
+        _timeMs = m.timeMs;
+        _rejects = 0;
+        _running = true;
+    }
+
+    void setOrigin(int32_t latE7, int32_t lonE7) {
+        _originLatE7 = latE7;
+        _originLonE7 = lonE7;
+        _kx = METRES_PER_E7 * cosf(latE7 * 1e-7f * (float)DEG_TO_RAD);
+        _kxInv = 1 / _kx;
+    }
+
+    void predict(uint32_t timeMs) {
+        const int32_t elapsed = (int32_t)(timeMs - _timeMs);
+        if (elapsed <= 0) return;
+        const float dt = elapsed * 0.001f;
+        const float q = sq((float)POSITION_ACCEL_MPS2);
+        _east.predict(dt, q);
+        _north.predict(dt, q);
+        _timeMs = timeMs;
+    }
+
+    // Keep the local coordinates small so float resolves millimetres
+    void recentre() {
+        if (fabsf(_east.p) < RECENTRE_M && fabsf(_north.p) < RECENTRE_M) return;
+        const int32_t dLat = (int32_t)lroundf(_north.p * E7_PER_METRE);
+        const int32_t dLon = (int32_t)lroundf(_east.p * _kxInv);
+        _north.p -= dLat * METRES_PER_E7;
+        _east.p -= dLon * _kx;
+        setOrigin(_originLatE7 + dLat, _originLonE7 + dLon);
+    }
+
+    void output(FilteredPosition& out, bool deadReckoned) const {
+        out.latE7 = _originLatE7 + (int32_t)lroundf(_north.p * E7_PER_METRE);
+        out.lonE7 = _originLonE7 + (int32_t)lroundf(_east.p * _kxInv);
+        out.valid = true;
+        out.deadReckoned = deadReckoned;
+    }
+};
+
+#endif // POSITION_FILTER_H
@@ -0,0 +1,346 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+/**
+ * @file power_manager.h
+ * @brief CPU frequency, automatic light sleep and GPS power-save policy
+ *
+ * On ship power the CPU may run at POWER_CPU_MHZ. When the sense line
+ * (POWER_SENSE_PIN) reports battery backup, the maximum drops to
+ * POWER_CPU_MHZ_BATTERY and the idle task may enter light sleep whenever
+ * every task waits on a timer (ESP-IDF power management: DFS plus
+ * tickless idle). A vessel slower than POWER_STATIONARY_KMH for
+ * POWER_STATIONARY_MS puts the receiver into cyclic tracking; it returns
+ * to continuous tracking once it moves or loses the fix.
+ *
+ * Light sleep stops the UART clock: while sleep is allowed the GPS RX
+ * line is a GPIO wake source, and the GPS task keeps the CPU awake for
+ * the rest of a burst (holdAwake). The first characters of a burst may
+ * still be lost; the truncated sentence fails its checksum. GPIO edge
+ * interrupts cannot wake light sleep, so on battery the web task polls
+ * the W5500 every POWER_WEB_POLL_MS instead of relying on INTn alone.
+ *
+ * Decisions depend only on millis() and the inputs, so they behave the
+ * same under the host's virtual clock. Energy is a model (POWER_MA_*
+ * currents and the event loops' busy time), not a measurement.
+ */
+
+#include <Arduino.h>
+#include <atomic>
+#include "../config.h"
+#include "gps_module.h"
+#include "metrics.h"
+
+#if defined(ESP_PLATFORM)
+#include <driver/gpio.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#endif
+
+#ifndef POWER_SENSE_PIN
+#define POWER_SENSE_PIN         -1
+#endif
+#ifndef POWER_SENSE_SHIP_LEVEL
+#define POWER_SENSE_SHIP_LEVEL  HIGH
+#endif
+#ifndef POWER_CHECK_MS
+#define POWER_CHECK_MS          1000
+#endif
+#ifndef POWER_CPU_MHZ
+#define POWER_CPU_MHZ           240
+#endif
+#ifndef POWER_CPU_MHZ_BATTERY
+#define POWER_CPU_MHZ_BATTERY   80
+#endif
+#ifndef POWER_CPU_MHZ_MIN
+#define POWER_CPU_MHZ_MIN       80
+#endif
+#ifndef POWER_STATIONARY_KMH
+#define POWER_STATIONARY_KMH    1.0
+#endif
+#ifndef POWER_MOVING_KMH
+#define POWER_MOVING_KMH        3.0
+#endif
+#ifndef POWER_STATIONARY_MS
+#define POWER_STATIONARY_MS     120000
+#endif
+#ifndef POWER_GPS_PSM_PERIOD_MS
+#define POWER_GPS_PSM_PERIOD_MS 10000
+#endif
+#ifndef POWER_UART_AWAKE_MS
+#define POWER_UART_AWAKE_MS     100
+#endif
+#ifndef POWER_WEB_POLL_MS
+#define POWER_WEB_POLL_MS       250
+#endif
+#ifndef POWER_SUPPLY_MV
+#define POWER_SUPPLY_MV         3300
+#endif
+#ifndef POWER_MA_CPU_240
+#define POWER_MA_CPU_240        50
+#endif
+#ifndef POWER_MA_CPU_80
+#define POWER_MA_CPU_80         22
+#endif
+#ifndef POWER_MA_LIGHT_SLEEP
+#define POWER_MA_LIGHT_SLEEP    1
+#endif
+#ifndef POWER_MA_GPS
+#define POWER_MA_GPS            25
+#endif
+#ifndef POWER_MA_GPS_PSM
+#define POWER_MA_GPS_PSM        8
+#endif
+#ifndef POWER_MA_NETWORK
+#define POWER_MA_NETWORK        130
+#endif
+
+/**
+ * Energy used between two reports
+ */
+struct EnergyReport {
+    uint32_t millijoules;
+    uint32_t periodMs;
+
+    uint32_t averageMilliwatts() const {
+        return periodMs ? (uint32_t)((uint64_t)millijoules * 1000 / periodMs) : 0;
+    }
+};
+
+class PowerManager {
+public:
+    enum Change : uint8_t {
+        CHANGED_SUPPLY = 1 << 0,    // CPU limit and light sleep
+        CHANGED_GPS    = 1 << 1     // Receiver power mode
+    };
+
+    /**
+     * Call once from setup(), before the tasks start
+     */
+    void begin() {
+        #if POWER_SENSE_PIN >= 0
+        pinMode(POWER_SENSE_PIN, INPUT);
+        #endif
+
+        #if defined(ESP_PLATFORM) && CONFIG_PM_ENABLE
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "gps_rx", &_awakeLock);
+        #endif
+
+        const uint32_t now = millis();
+        _accountedMs = now;
+        _reportedMs = now;
+        _busyMark = Metrics::registry.loopBusyMicros.value();
+        _onBattery = readSupply();
+        applySupply();
+    }
+
+    /**
+     * Re-evaluate supply and motion (upload task, every POWER_CHECK_MS)
+     * @param fix Latest fix, aged by LatestFix
+     * @return Change bits; the caller tells the GPS and web tasks
+     */
+    uint8_t update(const GPSData& fix, uint32_t nowMs) {
+        return update(fix, readSupply(), nowMs);
+    }
+
+    /**
+     * Same, with the supply given instead of read (host simulations)
+     */
+    uint8_t update(const GPSData& fix, bool onBattery, uint32_t nowMs) {
+        uint8_t changes = 0;
+
+        if (onBattery != _onBattery) {
+            account(nowMs);
+            _onBattery = onBattery;
+            applySupply();
+            changes |= CHANGED_SUPPLY;
+        }
+
+        const bool stationary = updateMotion(fix, nowMs);
+        if (stationary != _gpsPowerSave.load(std::memory_order_relaxed)) {
+            account(nowMs);
+            _gpsPowerSave.store(stationary, std::memory_order_relaxed);
+            Metrics::registry.gpsPowerSave.set(stationary);
+            changes |= CHANGED_GPS;
+        }
+        return changes;
+    }
+
+    bool onBattery() const { return _onBattery; }
+    bool lightSleep() const { return _lightSleep.load(std::memory_order_relaxed); }
+    bool gpsPowerSave() const { return _gpsPowerSave.load(std::memory_order_relaxed); }
+    uint32_t cpuMhz() const { return _onBattery ? POWER_CPU_MHZ_BATTERY : POWER_CPU_MHZ; }
+
+    /**
+     * Keep the CPU out of light sleep while a UART burst arrives
+     * (GPS task only)
+     */
+    void holdAwake(bool hold) {
+        if (hold == _awake) return;
+        _awake = hold;
+        #if defined(ESP_PLATFORM) && CONFIG_PM_ENABLE
+        if (_awakeLock) {
+            if (hold) esp_pm_lock_acquire(_awakeLock);
+            else esp_pm_lock_release(_awakeLock);
+        }
+        #endif
+        const uint32_t now = millis();
+        if (hold) _awakeSinceMs = now;
+        else _awakeMs.fetch_add(now - _awakeSinceMs, std::memory_order_relaxed);
+    }
+
+    /**
+     * Energy since the previous report (upload task)
+     */
+    EnergyReport takeReport(uint32_t nowMs) {
+        account(nowMs);
+        const uint32_t mj = (uint32_t)(_microjoules / 1000);
+        _microjoules -= (uint64_t)mj * 1000;
+        Metrics::registry.energyMillijoules.inc(mj);
+
+        const EnergyReport report{mj, nowMs - _reportedMs};
+        _reportedMs = nowMs;
+        return report;
+    }
+
+private:
+    bool _onBattery = false;
+    std::atomic<bool> _lightSleep{false};
+    std::atomic<bool> _gpsPowerSave{false};
+
+    // Motion (hysteresis between POWER_STATIONARY_KMH and POWER_MOVING_KMH)
+    bool _slow = false;
+    uint32_t _slowSinceMs = 0;
+
+    // Awake hold (GPS task)
+    bool _awake = false;
+    uint32_t _awakeSinceMs = 0;
+    std::atomic<uint32_t> _awakeMs{0};
+    #if defined(ESP_PLATFORM) && CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t _awakeLock = nullptr;
+    #endif
+
+    // Energy model
+    uint64_t _microjoules = 0;
+    uint32_t _accountedMs = 0;
+    uint32_t _reportedMs = 0;
+    uint32_t _busyMark = 0;
+    uint32_t _awakeMark = 0;
+
+    static bool readSupply() {
+        #if POWER_SENSE_PIN >= 0
+        return digitalRead(POWER_SENSE_PIN) != POWER_SENSE_SHIP_LEVEL;
+        #else
+        return false;  // No sense line: always on ship power
+        #endif
+    }
+
+    bool updateMotion(const GPSData& fix, uint32_t nowMs) {
+        const bool stationary = _gpsPowerSave.load(std::memory_order_relaxed);
+        if (!fix.valid || fix.speed >= POWER_MOVING_KMH) {
+            _slow = false;
+            return false;
+        }
+        if (stationary) return true;
+        if (fix.speed >= POWER_STATIONARY_KMH) {
+            _slow = false;
+            return false;
+        }
+        if (!_slow) {
+            _slow = true;
+            _slowSinceMs = nowMs;
+        }
+        return nowMs - _slowSinceMs >= POWER_STATIONARY_MS;
+    }
+
+    /**
+     * Program DFS and light sleep for the current supply; without
+     * CONFIG_PM_ENABLE only the fixed CPU frequency changes
+     */
+    void applySupply() {
+        const uint32_t maxMhz = cpuMhz();
+        bool sleep = false;
+
+        #if defined(ESP_PLATFORM) && CONFIG_PM_ENABLE
+        #if ESP_IDF_VERSION_MAJOR >= 5
+        esp_pm_config_t config = {};
+        #else
+        esp_pm_config_esp32_t config = {};
+        #endif
+        config.max_freq_mhz = maxMhz;
+        config.min_freq_mhz = min<uint32_t>(POWER_CPU_MHZ_MIN, maxMhz);
+        config.light_sleep_enable = _onBattery;
+        if (esp_pm_configure(&config) == ESP_OK) {
+            sleep = _onBattery;
+        } else {
+            // Light sleep needs tickless idle; fall back to DFS only
+            config.light_sleep_enable = false;
+            if (esp_pm_configure(&config) != ESP_OK) setCpuFrequencyMhz(maxMhz);
+        }
+        #else
+        setCpuFrequencyMhz(maxMhz);
+        #if !defined(ESP_PLATFORM)
+        sleep = _onBattery;  // Modelled on the host
+        #endif
+        #endif
+
+        #if defined(ESP_PLATFORM)
+        if (sleep != lightSleep()) armWakeup(sleep);
+        #endif
+        _lightSleep.store(sleep, std::memory_order_relaxed);
+        Metrics::registry.onBattery.set(_onBattery);
+        Metrics::registry.lightSleep.set(sleep);
+    }
+
+    #if defined(ESP_PLATFORM)
+    // The GPS RX start bit wakes light sleep; armed only while sleep is
+    // allowed, so on ship power the pin is left to the UART alone
+    static void armWakeup(bool arm) {
+        if (arm) {
+            gpio_wakeup_enable((gpio_num_t)GPS_RX_PIN, GPIO_INTR_LOW_LEVEL);
+            esp_sleep_enable_gpio_wakeup();
+        } else {
+            gpio_wakeup_disable((gpio_num_t)GPS_RX_PIN);
+            esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+        }
+    }
+    #endif
+
+    static uint32_t activeMa(uint32_t mhz) {
+        // Linear between the 80 and 240 MHz figures
+        const int32_t ma = POWER_MA_CPU_80 + ((int32_t)mhz - 80) * (POWER_MA_CPU_240 - POWER_MA_CPU_80) / 160;
+        return (uint32_t)max<int32_t>(ma, 1);
+    }
+
+    /**
+     * Charge the time since the last call to the current state
+     */
+    void account(uint32_t nowMs) {
+        const uint64_t wallUs = (uint64_t)(nowMs - _accountedMs) * 1000;
+        _accountedMs = nowMs;
+
+        const uint32_t busyTotal = Metrics::registry.loopBusyMicros.value();
+        const uint64_t busyUs = min<uint64_t>(busyTotal - _busyMark, wallUs);
+        _busyMark = busyTotal;
+
+        const uint32_t awakeTotal = _awakeMs.load(std::memory_order_relaxed);
+        const uint64_t awakeUs = min<uint64_t>((uint64_t)(awakeTotal - _awakeMark) * 1000, wallUs - busyUs);
+        _awakeMark = awakeTotal;
+
+        // Idle time runs at the DFS minimum, or sleeps unless held awake
+        const uint64_t idleUs = wallUs - busyUs;
+        const uint64_t sleepUs = lightSleep() ? idleUs - awakeUs : 0;
+        const uint32_t idleMa = activeMa(min<uint32_t>(POWER_CPU_MHZ_MIN, cpuMhz()));
+        const uint32_t gpsMa = gpsPowerSave() ? POWER_MA_GPS_PSM : POWER_MA_GPS;
+
+        // mA * mV * us = pJ
+        const uint64_t picojoules = (uint64_t)POWER_SUPPLY_MV * (
+            activeMa(cpuMhz()) * busyUs +
+            idleMa * (idleUs - sleepUs) +
+            POWER_MA_LIGHT_SLEEP * sleepUs +
+            (uint64_t)(gpsMa + POWER_MA_NETWORK) * wallUs);
+        _microjoules += picojoules / 1000000;
+    }
+};
+
+#endif // POWER_MANAGER_H
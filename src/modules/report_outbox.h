@@ -0,0 +1,202 @@
+#ifndef REPORT_OUTBOX_H
+#define REPORT_OUTBOX_H
+
+/**
+ * @file report_outbox.h
+ * @brief Sequence-numbered reports, held until the server has them all
+ *
+ * Every report gets the next per-device sequence number ("seq"). The
+ * server answers with X-Ack-Seq, the highest sequence up to which it has
+ * stored every report; held reports at or below it are done. Reports
+ * that got no 2xx are gaps and are sent again, oldest first. A lost
+ * response costs nothing: the next acknowledgement covers the report,
+ * and a report that arrives twice is recognised by its sequence.
+ *
+ * Reports also carry "seq_base", the oldest sequence still held. Lower
+ * sequences never come (given up when the outbox was full, or lost in a
+ * reboot), so the server can move its watermark past them.
+ *
+ * Without X-Ack-Seq (a server that ignores the sequence) a 2xx settles
+ * the report on its own, as before.
+ *
+ * The numbering survives reboots without a flash write per report: NVS
+ * holds a limit raised UPLOAD_SEQ_BLOCK at a time, and after a reboot
+ * the numbering continues from it, skipping the rest of the block.
+ *
+ * Uploader task only.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "../config.h"
+#include "http_upload.h"
+#include "logger.h"
+#include "metrics.h"
+
+#ifndef UPLOAD_OUTBOX_CAPACITY
+#define UPLOAD_OUTBOX_CAPACITY  16
+#endif
+#ifndef UPLOAD_RETRANSMIT_MAX
+#define UPLOAD_RETRANSMIT_MAX   4
+#endif
+#ifndef UPLOAD_SEQ_BLOCK
+#define UPLOAD_SEQ_BLOCK        64
+#endif
+
+static_assert(UPLOAD_OUTBOX_CAPACITY >= 1, "UPLOAD_OUTBOX_CAPACITY must be at least 1");
+static_assert(UPLOAD_SEQ_BLOCK >= 1, "UPLOAD_SEQ_BLOCK must be at least 1");
+
+/**
+ * A report as first sent: the fix and its out-of-band event
+ */
+struct HeldReport {
+    enum class Event : uint8_t { NONE, GEOFENCE, ROUTE, TRIP };
+
+    uint32_t seq;
+    bool delivered;     // Got a 2xx; only waits for the watermark
+    Event event;
+    GPSData fix;
+    union {
+        GeofenceEvent geofence;
+        RouteEvent route;
+        TripEvent trip;
+    };
+
+    /**
+     * Content for sending it (again); the caller adds seqBase
+     */
+    HttpUpload::ReportExtras extras() const {
+        HttpUpload::ReportExtras e;
+        if (event == Event::GEOFENCE) e.geofence = &geofence;
+        if (event == Event::ROUTE) e.routeEvent = &route;
+        if (event == Event::TRIP) e.tripEvent = &trip;
+        e.seq = seq;
+        return e;
+    }
+};
+
+class ReportOutbox {
+public:
+    static constexpr size_t Capacity = UPLOAD_OUTBOX_CAPACITY;
+
+    /**
+     * Continue the numbering from NVS (setup(), before the uploader starts)
+     */
+    void begin() {
+        Preferences prefs;
+        if (prefs.begin(NVS_NAMESPACE, true)) {
+            _limit = prefs.getUInt(NVS_KEY, 0);
+            prefs.end();
+        }
+        _next = _limit ? _limit : 1;
+        if (_limit) LOG(UPLOAD_SEQ_RESTORED, _next);
+    }
+
+    /**
+     * Number and hold a new report; gives up the oldest when full
+     * @param extras Its event, if any, is copied
+     */
+    HeldReport& add(const GPSData& fix, const HttpUpload::ReportExtras& extras) {
+        if (_count == Capacity) {
+            LOG(UPLOAD_GIVEN_UP, at(0).seq);
+            Metrics::registry.uploadGivenUp.inc();
+            Metrics::registry.destinations[0].dropped.inc();
+            pop();
+        }
+        if (_next >= _limit) reserve();
+
+        HeldReport& r = at(_count++);
+        r.seq = _next++;
+        r.delivered = false;
+        r.fix = fix;
+        r.event = HeldReport::Event::NONE;
+        if (extras.geofence) {
+            r.event = HeldReport::Event::GEOFENCE;
+            r.geofence = *extras.geofence;
+        } else if (extras.routeEvent) {
+            r.event = HeldReport::Event::ROUTE;
+            r.route = *extras.routeEvent;
+        } else if (extras.tripEvent) {
+            r.event = HeldReport::Event::TRIP;
+            r.trip = *extras.tripEvent;
+        }
+        setHeld();
+        return r;
+    }
+
+    /**
+     * Record the server's answer to r (r may be released)
+     */
+    void settle(HeldReport& r, const HttpResponse& response) {
+        if (!response.success) return;
+        r.delivered = true;
+        _watermarked = response.ackSeq != HttpResponse::NO_ACK;
+        if (_watermarked && response.ackSeq > _acked) {
+            _acked = response.ackSeq;
+            Metrics::registry.uploadAckSeq.set(_acked);
+        }
+        while (_count > 0 && done(at(0))) pop();
+        setHeld();
+        LOG(UPLOAD_ACK, _watermarked ? _acked : r.seq, (unsigned)_count);
+    }
+
+    /**
+     * Oldest report still without a 2xx, above after (0 = any)
+     */
+    HeldReport* nextGap(uint32_t after = 0) {
+        for (size_t i = 0; i < _count; i++) {
+            HeldReport& r = at(i);
+            if (!r.delivered && r.seq > after && !done(r)) return &r;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Oldest sequence still held (the next one if none)
+     */
+    uint32_t base() const { return _count ? at(0).seq : _next; }
+
+    size_t held() const { return _count; }
+    uint32_t acked() const { return _acked; }
+
+private:
+    static constexpr const char* NVS_NAMESPACE = "upload";
+    static constexpr const char* NVS_KEY = "seq";
+
+    HeldReport _reports[Capacity];
+    size_t _head = 0;
+    size_t _count = 0;
+    uint32_t _next = 1;
+    uint32_t _limit = 0;        // First sequence not reserved in NVS
+    uint32_t _acked = 0;        // Server watermark
+    bool _watermarked = false;  // The last answer carried X-Ack-Seq
+
+    HeldReport& at(size_t i) { return _reports[(_head + i) % Capacity]; }
+    const HeldReport& at(size_t i) const { return _reports[(_head + i) % Capacity]; }
+
+    void setHeld() {
+        Metrics::registry.uploadHeld.set(_count);
+        Metrics::registry.destinations[0].backlog.set(_count);     // The primary's, upload_fanout.h
+    }
+
+    void pop() {
+        _head = (_head + 1) % Capacity;
+        _count--;
+    }
+
+    bool done(const HeldReport& r) const {
+        return r.seq <= _acked || (!_watermarked && r.delivered);
+    }
+
+    // Until a write succeeds, numbers past the stored limit could come
+    // again after a reboot: tried again with every report
+    void reserve() {
+        Preferences prefs;
+        if (!prefs.begin(NVS_NAMESPACE)) return;
+        const uint32_t limit = _next + UPLOAD_SEQ_BLOCK;
+        if (prefs.putUInt(NVS_KEY, limit) == sizeof(limit)) _limit = limit;
+        prefs.end();
+    }
+};
+
+#endif // REPORT_OUTBOX_H
@@ -0,0 +1,318 @@
+#ifndef ROUTE_TRACKER_H
+#define ROUTE_TRACKER_H
+
+/**
+ * @file route_tracker.h
+ * @brief Planned-route corridor check and ETA to the next port
+ *
+ * The route is a polyline from a flash blob with per-segment data
+ * precomputed (local east/north vector, length, distance from the start)
+ * and a uniform grid of segments. A fix is projected onto the segments
+ * around the last matched one; only when none of them is within the
+ * corridor is the fix's grid cell searched as well, so the cost per fix
+ * does not grow with the route length.
+ *
+ * Cross-track distance is signed (positive = starboard of the route).
+ * Speed along the route is an exponential average of progress over time
+ * (ROUTE_SPEED_TAU_S); the ETA is the remaining distance to the next
+ * port at that speed.
+ *
+ * Blob layout (little endian, 4-byte aligned; built by
+ * tools/route/build_route.py):
+ *   RouteBlobHeader
+ *   RouteSegment[segmentCount]
+ *   RoutePort[portCount]                   ordered by distance
+ *   uint32_t cellStart[rows * cols + 1]
+ *   uint32_t cellSegments[cellEntryCount]
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include "../config.h"
+
+#ifndef ROUTE_CONFIRM_FIXES
+#define ROUTE_CONFIRM_FIXES     3
+#endif
+#ifndef ROUTE_RETURN_MARGIN_M
+#define ROUTE_RETURN_MARGIN_M   20
+#endif
+#ifndef ROUTE_SPEED_TAU_S
+#define ROUTE_SPEED_TAU_S       120
+#endif
+#ifndef ROUTE_MIN_SPEED_MPS
+#define ROUTE_MIN_SPEED_MPS     0.5f
+#endif
+#ifndef ROUTE_SEARCH_BACK
+#define ROUTE_SEARCH_BACK       2
+#endif
+#ifndef ROUTE_SEARCH_AHEAD
+#define ROUTE_SEARCH_AHEAD      6
+#endif
+#ifndef ROUTE_EVENT_QUEUE
+#define ROUTE_EVENT_QUEUE       4
+#endif
+
+struct RouteBlobHeader {
+    static constexpr uint32_t MAGIC = 0x31455452;  // "RTE1"
+    uint32_t magic;
+    uint16_t version;
+    uint16_t portCount;
+    uint32_t segmentCount;
+    float corridorM;        // Half-width
+    int32_t gridLatE7;      // South-west corner
+    int32_t gridLonE7;
+    uint32_t cellLatE7;
+    uint32_t cellLonE7;
+    uint16_t rows;
+    uint16_t cols;
+    uint32_t cellEntryCount;
+};
+
+struct RouteSegment {
+    int32_t latE7;          // Start point
+    int32_t lonE7;
+    float eastM;            // Start -> end
+    float northM;
+    float lengthM;
+    float startM;           // Route distance at the start point
+};
+
+struct RoutePort {
+    uint16_t id;
+    uint16_t reserved;
+    float distanceM;        // Route distance of the port
+};
+
+static_assert(sizeof(RouteBlobHeader) == 40, "blob header layout");
+static_assert(sizeof(RouteSegment) == 24, "blob segment layout");
+static_assert(sizeof(RoutePort) == 8, "blob port layout");
+
+/**
+ * Position against the route (published by the GPS task)
+ */
+struct RouteStatus {
+    bool onRoute;           // Matched to a segment
+    bool inCorridor;        // Confirmed state, see ROUTE_CONFIRM_FIXES
+    uint16_t nextPortId;    // Valid if etaSeconds != 0 or remainingM > 0
+    float crossTrackM;
+    float progressM;
+    float remainingM;       // To the next port, 0 past the last one
+    float speedMps;         // Along the route, smoothed
+    uint32_t etaSeconds;    // 0 = unknown (stopped, or no port ahead)
+};
+
+/**
+ * Confirmed corridor transition
+ */
+struct RouteEvent {
+    bool breach;            // false = back inside
+    float crossTrackM;
+};
+
+class RouteTracker {
+public:
+    /**
+     * Use a blob in place (it must stay mapped)
+     * @return false if the blob is malformed; the tracker is then idle
+     */
+    bool load(const uint8_t* blob, size_t size) {
+        _header = nullptr;
+        reset();
+        if (!blob || ((uintptr_t)blob & 3) || size < sizeof(RouteBlobHeader)) return false;
+
+        const RouteBlobHeader* h = reinterpret_cast<const RouteBlobHeader*>(blob);
+        if (h->magic != RouteBlobHeader::MAGIC || h->version != 1) return false;
+
+        const size_t cells = (size_t)h->rows * h->cols;
+        size_t offset = sizeof(RouteBlobHeader);
+        const size_t segmentsAt = offset;
+        offset += (size_t)h->segmentCount * sizeof(RouteSegment);
+        const size_t portsAt = offset;
+        offset += (size_t)h->portCount * sizeof(RoutePort);
+        const size_t cellStartAt = offset;
+        offset += (cells + 1) * sizeof(uint32_t);
+        const size_t cellSegmentsAt = offset;
+        offset += (size_t)h->cellEntryCount * sizeof(uint32_t);
+        if (offset > size || h->segmentCount == 0 || cells == 0 ||
+            h->cellLatE7 == 0 || h->cellLonE7 == 0) {
+            return false;
+        }
+
+        _segments = reinterpret_cast<const RouteSegment*>(blob + segmentsAt);
+        _ports = reinterpret_cast<const RoutePort*>(blob + portsAt);
+        _cellStart = reinterpret_cast<const uint32_t*>(blob + cellStartAt);
+        _cellSegments = reinterpret_cast<const uint32_t*>(blob + cellSegmentsAt);
+
+        if (_cellStart[cells] != h->cellEntryCount) return false;
+        for (size_t i = 0; i < cells; i++) {
+            if (_cellStart[i] > _cellStart[i + 1]) return false;
+        }
+        for (uint32_t i = 0; i < h->cellEntryCount; i++) {
+            if (_cellSegments[i] >= h->segmentCount) return false;
+        }
+
+        _header = h;
+        return true;
+    }
+
+    bool loaded() const { return _header != nullptr; }
+    float corridorM() const { return _header ? _header->corridorM : 0; }
+    float lengthM() const {
+        if (!_header) return 0;
+        const RouteSegment& last = _segments[_header->segmentCount - 1];
+        return last.startM + last.lengthM;
+    }
+
+    const RouteStatus& status() const { return _status; }
+
+    /**
+     * Evaluate one fix
+     * @param nowMs Fix time, for the speed estimate
+     * @param event Receives a confirmed corridor transition
+     * @return true if event was written
+     */
+    bool update(int32_t latE7, int32_t lonE7, uint32_t nowMs, RouteEvent& event) {
+        if (!_header) return false;
+
+        const float kx = METRES_PER_E7 * cosf(latE7 * 1e-7f * (float)DEG_TO_RAD);
+        Match best{UINT32_MAX, INFINITY, 0, 0};
+
+        // Segments around the last match first, the grid cell if none fits
+        if (_status.onRoute) {
+            const uint32_t first = _segment > ROUTE_SEARCH_BACK ? _segment - ROUTE_SEARCH_BACK : 0;
+            const uint32_t last = min<uint32_t>(_segment + ROUTE_SEARCH_AHEAD, _header->segmentCount - 1);
+            for (uint32_t i = first; i <= last; i++) project(i, latE7, lonE7, kx, best);
+        }
+        uint32_t cell;
+        if (best.distanceM > _header->corridorM && cellOf(latE7, lonE7, cell)) {
+            for (uint32_t i = _cellStart[cell]; i < _cellStart[cell + 1]; i++) {
+                project(_cellSegments[i], latE7, lonE7, kx, best);
+            }
+        }
+
+        if (best.segment == UINT32_MAX) {
+            // Not near any segment: off the route entirely
+            _status.onRoute = false;
+            _status.crossTrackM = INFINITY;
+            _hasProgress = false;
+            return confirm(false, event);
+        }
+
+        _segment = best.segment;
+        _status.onRoute = true;
+        _status.crossTrackM = best.crossTrackM;
+        updateSpeed(best.progressM, nowMs);
+        _status.progressM = best.progressM;
+        updateEta();
+
+        const bool inside = _status.inCorridor
+                                ? best.distanceM <= _header->corridorM
+                                : best.distanceM <= _header->corridorM - ROUTE_RETURN_MARGIN_M;
+        return confirm(inside, event);
+    }
+
+    void reset() {
+        _status = RouteStatus{false, true, 0, 0, 0, 0, 0, 0};
+        _segment = 0;
+        _nextPort = 0;
+        _pending = 0;
+        _hasProgress = false;
+        _hasSpeed = false;
+    }
+
+private:
+    static constexpr float METRES_PER_E7 = 0.0111319f;
+
+    struct Match {
+        uint32_t segment;
+        float distanceM;
+        float crossTrackM;
+        float progressM;
+    };
+
+    const RouteBlobHeader* _header = nullptr;
+    const RouteSegment* _segments = nullptr;
+    const RoutePort* _ports = nullptr;
+    const uint32_t* _cellStart = nullptr;
+    const uint32_t* _cellSegments = nullptr;
+
+    RouteStatus _status;
+    uint32_t _segment = 0;      // Last matched
+    uint16_t _nextPort = 0;     // First port ahead of the progress
+    uint8_t _pending = 0;       // Consecutive fixes disagreeing with inCorridor
+    bool _hasProgress = false;
+    bool _hasSpeed = false;     // First speed sample seeds the average
+    float _lastProgressM = 0;
+    uint32_t _lastMs = 0;
+
+    bool cellOf(int32_t latE7, int32_t lonE7, uint32_t& cell) const {
+        const int64_t dLat = (int64_t)latE7 - _header->gridLatE7;
+        const int64_t dLon = (int64_t)lonE7 - _header->gridLonE7;
+        if (dLat < 0 || dLon < 0) return false;
+        const uint64_t row = (uint64_t)dLat / _header->cellLatE7;
+        const uint64_t col = (uint64_t)dLon / _header->cellLonE7;
+        if (row >= _header->rows || col >= _header->cols) return false;
+        cell = (uint32_t)(row * _header->cols + col);
+        return true;
+    }
+
+    void project(uint32_t index, int32_t latE7, int32_t lonE7, float kx, Match& best) const {
+        const RouteSegment& s = _segments[index];
+        const float px = (lonE7 - s.lonE7) * kx;
+        const float py = (latE7 - s.latE7) * METRES_PER_E7;
+        float t = s.lengthM > 0 ? (px * s.eastM + py * s.northM) / (s.lengthM * s.lengthM) : 0;
+        t = t < 0 ? 0 : (t > 1 ? 1 : t);
+        const float dx = px - t * s.eastM, dy = py - t * s.northM;
+        const float distance = sqrtf(dx * dx + dy * dy);
+        if (distance >= best.distanceM) return;
+
+        // Right of the direction of travel is positive
+        const float side = s.northM * px - s.eastM * py;
+        best = Match{index, distance, side < 0 ? -distance : distance, s.startM + t * s.lengthM};
+    }
+
+    void updateSpeed(float progressM, uint32_t nowMs) {
+        if (_hasProgress && nowMs != _lastMs) {
+            const float dt = (nowMs - _lastMs) / 1000.0f;
+            const float speed = (progressM - _lastProgressM) / dt;
+            const float alpha = dt / (ROUTE_SPEED_TAU_S + dt);
+            _status.speedMps = _hasSpeed ? _status.speedMps + alpha * (speed - _status.speedMps) : speed;
+            _hasSpeed = true;
+        }
+        _hasProgress = true;
+        _lastProgressM = progressM;
+        _lastMs = nowMs;
+    }
+
+    void updateEta() {
+        // Progress moves a little per fix: the cursor moves a step or two
+        const uint16_t ports = _header->portCount;
+        while (_nextPort < ports && _ports[_nextPort].distanceM <= _status.progressM) _nextPort++;
+        while (_nextPort > 0 && _ports[_nextPort - 1].distanceM > _status.progressM) _nextPort--;
+
+        if (_nextPort == ports) {
+            _status.remainingM = 0;
+            _status.etaSeconds = 0;
+            return;
+        }
+        _status.nextPortId = _ports[_nextPort].id;
+        _status.remainingM = _ports[_nextPort].distanceM - _status.progressM;
+        _status.etaSeconds = _status.speedMps >= ROUTE_MIN_SPEED_MPS
+                                 ? (uint32_t)lroundf(_status.remainingM / _status.speedMps)
+                                 : 0;
+    }
+
+    bool confirm(bool inside, RouteEvent& event) {
+        if (inside == _status.inCorridor) {
+            _pending = 0;
+            return false;
+        }
+        if (++_pending < ROUTE_CONFIRM_FIXES) return false;
+        _pending = 0;
+        _status.inCorridor = inside;
+        event = RouteEvent{!inside, _status.crossTrackM};
+        return true;
+    }
+};
+
+#endif // ROUTE_TRACKER_H
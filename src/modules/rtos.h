@@ -0,0 +1,321 @@
+#ifndef RTOS_H
+#define RTOS_H
+
+/**
+ * @file rtos.h
+ * @brief Tasks, bounded queues and mutexes on FreeRTOS and on the host
+ *
+ * ESP32: thin wrappers over statically allocated FreeRTOS objects.
+ * Host (env:native): std::thread / std::mutex with the same interface.
+ * Notifier is the per-task event word behind EventLoop (task
+ * notifications on ESP32).
+ * Host tasks run while Rtos::running() is true; it turns false at exit
+ * and every task is joined before static destructors run, so task loops
+ * must check it and never block for more than about a second.
+ */
+
+#include <Arduino.h>
+
+#if defined(ESP_PLATFORM)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_task_wdt.h>
+#else
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+namespace Rtos {
+
+typedef void (*TaskFn)(void* arg);
+
+static constexpr uint32_t WAIT_FOREVER = UINT32_MAX;
+
+#if defined(ESP_PLATFORM)
+
+inline bool running() { return true; }
+
+/**
+ * Retire the Arduino loop task once the work lives in other tasks
+ */
+inline void endLoopTask() {
+    esp_task_wdt_delete(NULL);
+    vTaskDelete(NULL);
+}
+
+/**
+ * Create a task pinned to a core
+ */
+inline bool startTask(TaskFn fn, const char* name, uint32_t stackBytes,
+                      uint8_t priority, uint8_t core, void* arg) {
+    return xTaskCreatePinnedToCore(fn, name, stackBytes, arg, priority, nullptr, core) == pdPASS;
+}
+
+class Mutex {
+public:
+    Mutex() : _handle(xSemaphoreCreateMutexStatic(&_storage)) {}
+
+    void lock() { xSemaphoreTake(_handle, portMAX_DELAY); }
+    bool tryLock(uint32_t timeoutMs) { return xSemaphoreTake(_handle, pdMS_TO_TICKS(timeoutMs)) == pdTRUE; }
+    void unlock() { xSemaphoreGive(_handle); }
+
+private:
+    StaticSemaphore_t _storage;
+    SemaphoreHandle_t _handle;
+};
+
+/**
+ * Fixed-capacity FIFO of trivially copyable items
+ */
+template <typename T, size_t N>
+class Queue {
+public:
+    Queue() : _handle(xQueueCreateStatic(N, sizeof(T), _items, &_storage)) {}
+
+    bool send(const T& item, uint32_t timeoutMs = 0) {
+        return xQueueSend(_handle, &item, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+    }
+
+    bool receive(T& item, uint32_t timeoutMs) {
+        return xQueueReceive(_handle, &item, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+    }
+
+    size_t size() const { return uxQueueMessagesWaiting(_handle); }
+
+private:
+    StaticQueue_t _storage;
+    uint8_t _items[N * sizeof(T)];
+    QueueHandle_t _handle;
+};
+
+/**
+ * Event bits for one task (direct-to-task notification)
+ */
+class Notifier {
+public:
+    /**
+     * Bind to the calling task; only that task may wait()
+     */
+    void bind() { _task = xTaskGetCurrentTaskHandle(); }
+
+    void notify(uint32_t bits) {
+        if (_task) xTaskNotify(_task, bits, eSetBits);
+    }
+
+    void IRAM_ATTR notifyFromISR(uint32_t bits) {
+        BaseType_t woken = pdFALSE;
+        if (_task) xTaskNotifyFromISR(_task, bits, eSetBits, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+
+    /**
+     * @return bits posted since the last wait (0 on timeout)
+     */
+    uint32_t wait(uint32_t timeoutMs) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits,
+                        timeoutMs == WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs));
+        return bits;
+    }
+
+private:
+    TaskHandle_t volatile _task = nullptr;
+};
+
+#else
+
+/**
+ * Host task registry; stop() is registered with atexit on first use
+ */
+class Tasks {
+public:
+    static Tasks& instance() {
+        static Tasks tasks;
+        return tasks;
+    }
+
+    bool running() const { return _running.load(); }
+
+    void start(TaskFn fn, void* arg) {
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (_threads.empty()) atexit([] { Tasks::instance().stop(); });
+        NativeClock::attachThread();
+        _threads.emplace_back([fn, arg] {
+            fn(arg);
+            NativeClock::detachThread();
+        });
+    }
+
+    void stop() {
+        _running.store(false);
+        NativeClock::detachThread();  // the caller no longer sleeps on virtual time
+        std::lock_guard<std::mutex> guard(_mutex);
+        for (std::thread& t : _threads) {
+            if (t.joinable()) t.join();
+        }
+        _threads.clear();
+    }
+
+private:
+    std::atomic<bool> _running{true};
+    std::mutex _mutex;
+    std::vector<std::thread> _threads;
+};
+
+inline bool running() { return Tasks::instance().running(); }
+
+// The host main thread keeps calling loop() until --duration; idle it
+inline void endLoopTask() { delay(1000); }
+
+inline bool startTask(TaskFn fn, const char* name, uint32_t stackBytes,
+                      uint8_t priority, uint8_t core, void* arg) {
+    (void)name; (void)stackBytes; (void)priority; (void)core;
+    Tasks::instance().start(fn, arg);
+    return true;
+}
+
+/**
+ * Under the virtual clock a blocked thread must sleep on virtual time,
+ * otherwise the clock stalls and the thread it waits for never wakes
+ */
+template <typename Pred>
+bool pollVirtual(uint32_t timeoutMs, Pred ready) {
+    const uint64_t deadline = NativeClock::nowMicros() + (uint64_t)timeoutMs * 1000;
+    while (!ready()) {
+        if (NativeClock::nowMicros() >= deadline) return false;
+        NativeClock::sleepMicros(1000);  // one FreeRTOS tick
+    }
+    return true;
+}
+
+class Mutex {
+public:
+    void lock() {
+        if (NativeClock::isVirtual()) {
+            pollVirtual(UINT32_MAX, [this] { return _mutex.try_lock(); });
+        } else {
+            _mutex.lock();
+        }
+    }
+    bool tryLock(uint32_t timeoutMs) {
+        if (NativeClock::isVirtual()) {
+            return pollVirtual(timeoutMs, [this] { return _mutex.try_lock(); });
+        }
+        return _mutex.try_lock_for(std::chrono::milliseconds(timeoutMs));
+    }
+    void unlock() { _mutex.unlock(); }
+
+private:
+    std::timed_mutex _mutex;
+};
+
+template <typename T, size_t N>
+class Queue {
+public:
+    bool send(const T& item, uint32_t timeoutMs = 0) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!waitFor(lock, timeoutMs, [this] { return _count < N; })) return false;
+        _items[(_head + _count) % N] = item;
+        _count++;
+        _changed.notify_all();
+        return true;
+    }
+
+    bool receive(T& item, uint32_t timeoutMs) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!waitFor(lock, timeoutMs, [this] { return _count > 0; })) return false;
+        item = _items[_head];
+        _head = (_head + 1) % N;
+        _count--;
+        _changed.notify_all();
+        return true;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> guard(_mutex);
+        return _count;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    T _items[N];
+    size_t _head = 0;
+    size_t _count = 0;
+
+    template <typename Pred>
+    bool waitFor(std::unique_lock<std::mutex>& lock, uint32_t timeoutMs, Pred ready) {
+        if (ready()) return true;
+        if (timeoutMs == 0) return false;
+        if (NativeClock::isVirtual()) {
+            lock.unlock();
+            const bool ok = pollVirtual(timeoutMs, [this, &ready] {
+                std::lock_guard<std::mutex> guard(_mutex);
+                return ready();
+            });
+            lock.lock();
+            return ok && ready();
+        }
+        return _changed.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+    }
+};
+
+class Notifier {
+public:
+    void bind() {}
+
+    void notify(uint32_t bits) {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _bits |= bits;
+        _changed.notify_one();
+    }
+
+    void notifyFromISR(uint32_t bits) { notify(bits); }
+
+    uint32_t wait(uint32_t timeoutMs) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (NativeClock::isVirtual()) {
+            lock.unlock();
+            pollVirtual(timeoutMs, [this] {
+                std::lock_guard<std::mutex> guard(_mutex);
+                return _bits != 0;
+            });
+            lock.lock();
+        } else if (timeoutMs == WAIT_FOREVER) {
+            _changed.wait(lock, [this] { return _bits != 0; });
+        } else {
+            _changed.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return _bits != 0; });
+        }
+        const uint32_t bits = _bits;
+        _bits = 0;
+        return bits;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    uint32_t _bits = 0;
+};
+
+#endif
+
+class LockGuard {
+public:
+    explicit LockGuard(Mutex& mutex) : _mutex(mutex) { _mutex.lock(); }
+    ~LockGuard() { _mutex.unlock(); }
+
+    LockGuard(const LockGuard&) = delete;
+    LockGuard& operator=(const LockGuard&) = delete;
+
+private:
+    Mutex& _mutex;
+};
+
+} // namespace Rtos
+
+#endif // RTOS_H
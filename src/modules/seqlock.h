@@ -0,0 +1,71 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+/**
+ * @file seqlock.h
+ * @brief Single-writer sequence lock for publishing small snapshots
+ *
+ * The writer never blocks and readers never block the writer: a reader
+ * copies the value and retries if the sequence changed meanwhile. The
+ * value is stored as relaxed atomic words, so concurrent copies are
+ * well-defined on both ESP32 cores and on the host.
+ */
+
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+public:
+    SeqLock() {
+        for (auto& w : _words) w.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Publish a new value (one writer only)
+     */
+    void write(const T& value) {
+        uint32_t words[WORDS] = {};
+        memcpy(words, &value, sizeof(T));
+
+        const uint32_t seq = _sequence.load(std::memory_order_relaxed);
+        _sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) {
+            _words[i].store(words[i], std::memory_order_relaxed);
+        }
+        _sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * Copy the latest consistent value
+     * @return sequence number (0 = never written)
+     */
+    uint32_t read(T& out) const {
+        uint32_t words[WORDS];
+        uint32_t before, after;
+        do {
+            before = _sequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = _words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = _sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        memcpy(&out, words, sizeof(T));
+        return before / 2;
+    }
+
+private:
+    static constexpr size_t WORDS = (sizeof(T) + 3) / 4;
+
+    std::atomic<uint32_t> _sequence{0};
+    std::atomic<uint32_t> _words[WORDS];
+};
+
+#endif // SEQLOCK_H
@@ -0,0 +1,84 @@
+#ifndef STREAM_RING_H
+#define STREAM_RING_H
+
+/**
+ * @file stream_ring.h
+ * @brief Single-writer byte ring that many readers follow with cursors
+ *
+ * The writer never waits for readers: it overwrites the oldest bytes.
+ * Each reader keeps its own 32-bit cursor (absolute stream position,
+ * wraps with the counters) and sends straight out of the ring, so one
+ * copy of the stream serves every client. Bytes become visible at line
+ * ends only, so readers never see a partial sentence at the head.
+ *
+ * Overwrites are detected like in SeqLock: the writer announces how far
+ * it is about to write before touching the bytes, and a reader checks
+ * that announcement after it used them (intact()). A reader that was
+ * overtaken has sent garbage and must be dropped.
+ */
+
+#include <Arduino.h>
+#include <atomic>
+
+template <size_t CAPACITY>
+class StreamRing : public Print {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "StreamRing capacity must be a power of two");
+
+public:
+    static constexpr size_t capacity() { return CAPACITY; }
+
+    /**
+     * Append bytes (one writer only); visible up to the last '\n'
+     */
+    size_t write(const uint8_t* data, size_t size) override {
+        size_t done = 0;
+        while (done < size) {
+            const size_t offset = _tail & (CAPACITY - 1);
+            const size_t n = min(size - done, CAPACITY - offset);
+            _limit.store(_tail + (uint32_t)n, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(&_buffer[offset], data + done, n);
+            size_t lineEnd = n;
+            while (lineEnd > 0 && data[done + lineEnd - 1] != '\n') lineEnd--;
+            if (lineEnd > 0) _head.store(_tail + (uint32_t)lineEnd, std::memory_order_release);
+            _tail += (uint32_t)n;
+            done += n;
+        }
+        return size;
+    }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    using Print::write;
+
+    /**
+     * End of the visible stream; a new reader starts here
+     */
+    uint32_t head() const { return _head.load(std::memory_order_acquire); }
+
+    /**
+     * Contiguous bytes from cursor towards head (the rest follows from
+     * the start of the buffer)
+     * @return length; 0 if the reader is up to date
+     */
+    size_t peek(uint32_t cursor, uint32_t head, const uint8_t*& data) const {
+        const size_t offset = cursor & (CAPACITY - 1);
+        data = &_buffer[offset];
+        return min<size_t>(head - cursor, CAPACITY - offset);
+    }
+
+    /**
+     * Were the bytes from cursor still in place while they were read?
+     */
+    bool intact(uint32_t cursor) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return _limit.load(std::memory_order_relaxed) - cursor <= CAPACITY;
+    }
+
+private:
+    uint8_t _buffer[CAPACITY];
+    uint32_t _tail = 0;                 // Writer only: end of the appended bytes
+    std::atomic<uint32_t> _head{0};     // End of the visible bytes
+    std::atomic<uint32_t> _limit{0};    // End of the bytes being written
+};
+
+#endif // STREAM_RING_H
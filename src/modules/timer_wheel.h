@@ -0,0 +1,229 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel with intrusive, heap-free timers
+ *
+ * Three levels of 64 slots at TIMER_TICK_MS resolution cover about 44
+ * minutes at 10 ms ticks; later deadlines wait in the last level and are
+ * re-filed as it turns. Scheduling and cancelling are O(1); advancing
+ * touches only the slots that fall due, and nextDueMs() tells the event
+ * loop how long it may sleep.
+ *
+ * Timers are owned by the caller and must outlive their registration.
+ * A wheel is used by one task only.
+ */
+
+#include <Arduino.h>
+#include "../config.h"
+
+#ifndef TIMER_TICK_MS
+#define TIMER_TICK_MS   10
+#endif
+
+class TimerWheel;
+
+class Timer {
+public:
+    typedef void (*Callback)(void* arg);
+
+    Timer(Callback callback, void* arg) : _callback(callback), _arg(arg) {}
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    /**
+     * Timer that calls a member function, e.g.
+     * Timer t{Timer::member<App, &App::onSend>(), this};
+     */
+    template <typename T, void (T::*Method)()>
+    static Callback member() {
+        return [](void* self) { (static_cast<T*>(self)->*Method)(); };
+    }
+
+    bool active() const { return _pprev != nullptr; }
+
+private:
+    friend class TimerWheel;
+
+    Callback _callback;
+    void* _arg;
+    Timer* _next = nullptr;
+    Timer** _pprev = nullptr;   // Link that points at this timer
+    uint32_t _expires = 0;      // Absolute tick
+    uint32_t _periodTicks = 0;  // 0 = one-shot
+};
+
+class TimerWheel {
+public:
+    static constexpr uint8_t SLOT_BITS = 6;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint8_t LEVELS = 3;
+    static constexpr uint32_t NEVER = UINT32_MAX;
+
+    explicit TimerWheel(uint32_t nowMs = 0) : _now(nowMs / TIMER_TICK_MS) {
+        memset(_slots, 0, sizeof(_slots));
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * Start counting from nowMs (ignored once a timer is armed)
+     */
+    void rebase(uint32_t nowMs) {
+        if (_active == 0) _now = nowMs / TIMER_TICK_MS;
+    }
+
+    /**
+     * (Re)arm a timer; it fires once after delayMs, then every periodMs
+     * if that is non-zero
+     */
+    void schedule(Timer& timer, uint32_t delayMs, uint32_t periodMs = 0) {
+        cancel(timer);
+        timer._expires = _now + delayMs / TIMER_TICK_MS;
+        timer._periodTicks = periodMs ? max<uint32_t>(periodMs / TIMER_TICK_MS, 1) : 0;
+        link(timer);
+    }
+
+    void cancel(Timer& timer) {
+        if (!timer._pprev) return;
+        *timer._pprev = timer._next;
+        if (timer._next) timer._next->_pprev = timer._pprev;
+        timer._next = nullptr;
+        timer._pprev = nullptr;
+        _active--;
+    }
+
+    /**
+     * Run every timer that is due at nowMs
+     * @return number of callbacks run
+     */
+    uint32_t advance(uint32_t nowMs) {
+        const uint32_t target = nowMs / TIMER_TICK_MS;
+        uint32_t fired = 0;
+        while ((int32_t)(target - _now) >= 0) {
+            fired += processTick();
+        }
+        return fired;
+    }
+
+    /**
+     * Milliseconds from nowMs until the next slot that needs attention
+     * (a due timer or a cascade), or NEVER when no timer is armed
+     */
+    uint32_t nextDueMs(uint32_t nowMs) const {
+        const uint32_t tick = nextTick();
+        if (tick == _now - 1) return NEVER;
+        const int32_t ticks = (int32_t)(tick - nowMs / TIMER_TICK_MS);
+        return ticks > 0 ? ticks * TIMER_TICK_MS : 0;
+    }
+
+    size_t active() const { return _active; }
+
+private:
+    Timer* _slots[LEVELS][SLOTS];
+    Timer* _pending = nullptr;  // Slot being fired
+    uint32_t _now;              // Next tick to process
+    size_t _active = 0;
+
+    // Tick of the next due slot or cascade; _now - 1 when idle
+    uint32_t nextTick() const {
+        if (_active == 0) return _now - 1;
+
+        const uint32_t index0 = _now & (SLOTS - 1);
+        for (uint32_t i = 0; i < SLOTS; i++) {
+            if (_slots[0][(index0 + i) & (SLOTS - 1)]) return _now + i;
+        }
+
+        // Nothing in the next 64 ticks: wake when the next level that
+        // holds a timer cascades into the one below
+        for (uint8_t level = 1; level < LEVELS; level++) {
+            const uint8_t shift = level * SLOT_BITS;
+            const uint32_t base = _now >> shift;
+            for (uint32_t i = 1; i <= SLOTS; i++) {
+                if (_slots[level][(base + i) & (SLOTS - 1)]) return (base + i) << shift;
+            }
+        }
+        return _now - 1;
+    }
+
+    void link(Timer& timer) {
+        const uint32_t delta = timer._expires - _now;
+        Timer** head;
+        if ((int32_t)delta < 0) {
+            head = &_slots[0][_now & (SLOTS - 1)];  // Overdue: next tick
+        } else if (delta < SLOTS) {
+            head = &_slots[0][timer._expires & (SLOTS - 1)];
+        } else if (delta < (SLOTS << SLOT_BITS)) {
+            head = &_slots[1][(timer._expires >> SLOT_BITS) & (SLOTS - 1)];
+        } else {
+            const uint32_t limit = SLOTS << (2 * SLOT_BITS);
+            const uint32_t filed = delta < limit ? timer._expires : _now + limit - 1;
+            head = &_slots[2][(filed >> (2 * SLOT_BITS)) & (SLOTS - 1)];
+        }
+
+        timer._next = *head;
+        if (timer._next) timer._next->_pprev = &timer._next;
+        timer._pprev = head;
+        *head = &timer;
+        _active++;
+    }
+
+    // Re-file every timer of one slot against the current tick
+    void cascade(uint8_t level, uint32_t index) {
+        Timer* t = _slots[level][index];
+        _slots[level][index] = nullptr;
+        while (t) {
+            Timer* next = t->_next;
+            t->_pprev = nullptr;
+            t->_next = nullptr;
+            _active--;
+            link(*t);
+            t = next;
+        }
+    }
+
+    uint32_t processTick() {
+        const uint32_t tick = _now;
+        const uint32_t index = tick & (SLOTS - 1);
+        if (index == 0) {
+            const uint32_t index1 = (tick >> SLOT_BITS) & (SLOTS - 1);
+            if (index1 == 0) cascade(2, (tick >> (2 * SLOT_BITS)) & (SLOTS - 1));
+            cascade(1, index1);
+        }
+
+        // Move the slot to _pending: callbacks may cancel or reschedule
+        // any timer, including ones still waiting in this list
+        _pending = _slots[0][index];
+        _slots[0][index] = nullptr;
+        if (_pending) _pending->_pprev = &_pending;
+        _now++;
+
+        uint32_t fired = 0;
+        while (_pending) {
+            Timer& t = *_pending;
+            _pending = t._next;
+            if (_pending) _pending->_pprev = &_pending;
+            t._next = nullptr;
+            t._pprev = nullptr;
+            _active--;
+
+            if ((int32_t)(t._expires - tick) > 0) {
+                link(t);  // Filed early from the top level, not due yet
+                continue;
+            }
+            if (t._periodTicks) {
+                t._expires += t._periodTicks;
+                if ((int32_t)(t._expires - _now) < 0) t._expires = _now;  // Skip missed periods
+                link(t);
+            }
+            t._callback(t._arg);
+            fired++;
+        }
+        return fired;
+    }
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,418 @@
+#ifndef TLS_CLIENT_H
+#define TLS_CLIENT_H
+
+/**
+ * @file tls_client.h
+ * @brief mbedTLS over any Arduino Client, with session resumption and
+ *        public key pinning
+ *
+ * TlsContext lives as long as the network module: mbedTLS configuration,
+ * DRBG, and the session from the last successful handshake. TlsClient
+ * wraps the transport's Client (EthernetClient behind LockedClient, or
+ * WiFiClient) for one connection and offers that session, so repeat
+ * reports take the abbreviated handshake (session ticket, or session ID
+ * if the server has no tickets): no certificate, no key exchange.
+ *
+ * Trust is the pin: on a full handshake one certificate in the chain
+ * must have a public key whose SHA-256 (base64, as in HPKP) equals
+ * TLS_PIN_SHA256 or TLS_PIN_SHA256_BACKUP, so no CA store is needed and
+ * the server certificate can be renewed as long as the key (or the
+ * pinned CA key) stays. The pinned certificate is the trust anchor:
+ * every certificate below it must be signed by the one above, and below
+ * a CA pin the leaf must name the host. A resumed session was pinned
+ * when it was made. A context for another server (upload_fanout.h)
+ * takes its own pin. Without a pin no connection is made, unless
+ * TLS_ALLOW_UNPINNED accepts an unauthenticated server.
+ *
+ * TLS 1.2 only: its tickets resume within the handshake, which is what
+ * the session cache relies on (mbedTLS 2.28 in arduino-esp32 2.x, 3.x
+ * in 3.x).
+ *
+ * Handshake heap is the drop in free heap, sampled in the transport
+ * callbacks and between handshake calls; short-lived peaks inside one
+ * crypto step are not seen.
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+#include <mbedtls/base64.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/version.h>
+#include <mbedtls/x509_crt.h>
+#include "../config.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+
+#ifndef TLS_PIN_SHA256
+#define TLS_PIN_SHA256              ""
+#endif
+#ifndef TLS_PIN_SHA256_BACKUP
+#define TLS_PIN_SHA256_BACKUP       ""
+#endif
+#ifndef TLS_ALLOW_UNPINNED
+#define TLS_ALLOW_UNPINNED          false
+#endif
+#ifndef TLS_HANDSHAKE_TIMEOUT_MS
+#define TLS_HANDSHAKE_TIMEOUT_MS    10000
+#endif
+
+#if SERVER_TLS_ENABLE && !TLS_ALLOW_UNPINNED
+static_assert(sizeof(TLS_PIN_SHA256) > 1 || sizeof(TLS_PIN_SHA256_BACKUP) > 1,
+              "SERVER_TLS_ENABLE needs TLS_PIN_SHA256 (see config.example.h), or TLS_ALLOW_UNPINNED true");
+#endif
+
+class TlsContext {
+public:
+    TlsContext() {
+        mbedtls_ssl_config_init(&_config);
+        mbedtls_entropy_init(&_entropy);
+        mbedtls_ctr_drbg_init(&_drbg);
+        mbedtls_ssl_session_init(&_session);
+    }
+
+    ~TlsContext() {
+        mbedtls_ssl_session_free(&_session);
+        mbedtls_ctr_drbg_free(&_drbg);
+        mbedtls_entropy_free(&_entropy);
+        mbedtls_ssl_config_free(&_config);
+    }
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    /**
+     * Set up on first use (seeding needs the RNG running)
+     * @return false if mbedTLS could not be configured
+     */
+    bool ready() {
+        if (!pinned() && !TLS_ALLOW_UNPINNED) {
+            LOG(TLS_NO_PIN);
+            return false;
+        }
+        if (_ready) return true;
+        static const char PERSONALIZATION[] = "gps-tracker";
+        int ret = mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy,
+                                        (const unsigned char*)PERSONALIZATION, sizeof(PERSONALIZATION) - 1);
+        if (ret == 0) {
+            ret = mbedtls_ssl_config_defaults(&_config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                              MBEDTLS_SSL_PRESET_DEFAULT);
+        }
+        if (ret != 0) {
+            LOG(TLS_INIT_FAILED, -ret);
+            return false;
+        }
+
+        #if MBEDTLS_VERSION_MAJOR >= 3
+        mbedtls_ssl_conf_max_tls_version(&_config, MBEDTLS_SSL_VERSION_TLS1_2);
+        #else
+        mbedtls_ssl_conf_max_version(&_config, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+        #endif
+        // Trust comes from the pin (checked after the handshake), so the
+        // chain's flags do not end it here
+        mbedtls_ssl_conf_authmode(&_config, MBEDTLS_SSL_VERIFY_OPTIONAL);
+        mbedtls_ssl_conf_verify(&_config, onCertificate, this);
+        mbedtls_ssl_conf_rng(&_config, mbedtls_ctr_drbg_random, &_drbg);
+        #if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_conf_session_tickets(&_config, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+        #endif
+
+        if (!pinned()) LOG(TLS_UNPINNED);
+        _ready = true;
+        return true;
+    }
+
+    /**
+     * Pin another server's key instead of TLS_PIN_SHA256 (before the
+     * first handshake); "" and "" = refused unless TLS_ALLOW_UNPINNED
+     */
+    void pin(const char* sha256, const char* backup = "") {
+        _pin = sha256;
+        _pinBackup = backup;
+    }
+
+    const mbedtls_ssl_config* config() const { return &_config; }
+
+    /**
+     * Before the handshake: offer the cached session
+     */
+    void prepare(mbedtls_ssl_context& ssl) {
+        _certificates = 0;
+        _pinMatched = false;
+        if (_hasSession && mbedtls_ssl_set_session(&ssl, &_session) != 0) forgetSession();
+    }
+
+    /**
+     * After the handshake: check the pin (full handshake only) and cache
+     * the session for the next connection
+     * @param resumed Receives whether the abbreviated handshake was used
+     * @return false if the pin does not match
+     */
+    bool finish(mbedtls_ssl_context& ssl, bool& resumed) {
+        resumed = _certificates == 0;
+        if (!resumed && pinned() && !_pinMatched) {
+            forgetSession();
+            return false;
+        }
+        mbedtls_ssl_session_free(&_session);
+        mbedtls_ssl_session_init(&_session);
+        _hasSession = mbedtls_ssl_get_session(&ssl, &_session) == 0;
+        return true;
+    }
+
+    void forgetSession() {
+        mbedtls_ssl_session_free(&_session);
+        mbedtls_ssl_session_init(&_session);
+        _hasSession = false;
+    }
+
+private:
+    mbedtls_ssl_config _config;
+    mbedtls_entropy_context _entropy;
+    mbedtls_ctr_drbg_context _drbg;
+    mbedtls_ssl_session _session;
+    bool _ready = false;
+    bool _hasSession = false;
+    uint8_t _certificates = 0;  // Seen in this handshake (0 = resumed)
+    bool _pinMatched = false;
+    const char* _pin = TLS_PIN_SHA256;
+    const char* _pinBackup = TLS_PIN_SHA256_BACKUP;
+
+    bool pinned() const { return _pin[0] != '\0' || _pinBackup[0] != '\0'; }
+
+    /**
+     * Called for every certificate in the verified chain, from the top
+     * down to the server's own at depth 0; flags hold what mbedTLS found
+     * wrong with it (not trusted at the top, as there is no CA store)
+     */
+    static int onCertificate(void* arg, mbedtls_x509_crt* crt, int depth, uint32_t* flags) {
+        TlsContext* self = static_cast<TlsContext*>(arg);
+        if (self->_certificates < UINT8_MAX) self->_certificates++;
+
+        // pk_raw is the SubjectPublicKeyInfo DER, what the pin hashes
+        unsigned char hash[32];
+        #if MBEDTLS_VERSION_MAJOR >= 3
+        mbedtls_sha256(crt->pk_raw.p, crt->pk_raw.len, hash, 0);
+        #else
+        mbedtls_sha256_ret(crt->pk_raw.p, crt->pk_raw.len, hash, 0);
+        #endif
+        unsigned char pin[48];
+        size_t pinLength = 0;
+        if (mbedtls_base64_encode(pin, sizeof(pin), &pinLength, hash, sizeof(hash)) == 0 &&
+            (strcmp((const char*)pin, self->_pin) == 0 || strcmp((const char*)pin, self->_pinBackup) == 0)) {
+            self->_pinMatched = true;
+            return 0;
+        }
+        // Below the pin each certificate must carry a good signature from
+        // the one above, or any leaf could be sent along with the real CA
+        uint32_t broken = MBEDTLS_X509_BADCERT_NOT_TRUSTED | MBEDTLS_X509_BADCERT_BAD_MD |
+                          MBEDTLS_X509_BADCERT_BAD_PK;
+        if (depth == 0) broken |= MBEDTLS_X509_BADCERT_CN_MISMATCH;     // CA pin: not our host
+        if (*flags & broken) self->_pinMatched = false;
+        return 0;
+    }
+};
+
+/**
+ * One TLS connection over a transport Client
+ */
+class TlsClient : public Client {
+public:
+    /**
+     * @param hostname For SNI; must outlive the client
+     */
+    TlsClient(TlsContext& context, Client& transport, const char* hostname)
+        : _context(context), _transport(transport), _hostname(hostname) {}
+
+    ~TlsClient() { stop(); }
+
+    TlsClient(const TlsClient&) = delete;
+    TlsClient& operator=(const TlsClient&) = delete;
+
+    /**
+     * SNI for the next connect (a client kept for one server at a time)
+     */
+    void setHostname(const char* hostname) { _hostname = hostname; }
+
+    int connect(IPAddress ip, uint16_t port) override {
+        if (!_context.ready() || !_transport.connect(ip, port)) return 0;
+        return handshake();
+    }
+
+    int connect(const char* host, uint16_t port) override {
+        if (!_context.ready() || !_transport.connect(host, port)) return 0;
+        return handshake();
+    }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        size_t written = 0;
+        const uint32_t start = millis();
+        while (_connected && written < size) {
+            const int ret = mbedtls_ssl_write(&_ssl, buffer + written, size - written);
+            if (ret > 0) {
+                written += ret;
+            } else if ((ret == MBEDTLS_ERR_SSL_WANT_WRITE || ret == MBEDTLS_ERR_SSL_WANT_READ) &&
+                       millis() - start < TLS_HANDSHAKE_TIMEOUT_MS) {
+                delay(1);
+            } else {
+                _connected = false;
+            }
+        }
+        return written;
+    }
+
+    int available() override {
+        if (!_connected) return _peek >= 0 ? 1 : 0;
+        if (_peek < 0 && mbedtls_ssl_get_bytes_avail(&_ssl) == 0) {
+            // Decrypts the next record if one has arrived
+            uint8_t c;
+            if (receive(&c, 1) == 1) _peek = c;
+        }
+        return (_peek >= 0 ? 1 : 0) + (int)mbedtls_ssl_get_bytes_avail(&_ssl);
+    }
+
+    int read() override {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+
+    int read(uint8_t* buffer, size_t size) override {
+        if (size == 0) return 0;
+        size_t n = 0;
+        if (_peek >= 0) {
+            buffer[n++] = (uint8_t)_peek;
+            _peek = -1;
+        }
+        if (n < size) {
+            const int ret = receive(buffer + n, size - n);
+            if (ret > 0) n += ret;
+        }
+        return n ? (int)n : -1;
+    }
+
+    int peek() override {
+        if (_peek < 0) {
+            uint8_t c;
+            if (receive(&c, 1) == 1) _peek = c;
+        }
+        return _peek;
+    }
+
+    void flush() override { _transport.flush(); }
+
+    void stop() override {
+        if (_active) {
+            if (_connected) mbedtls_ssl_close_notify(&_ssl);
+            mbedtls_ssl_free(&_ssl);
+            _active = false;
+        }
+        _connected = false;
+        _peek = -1;
+        _transport.stop();
+    }
+
+    uint8_t connected() override { return _connected || _peek >= 0; }
+    operator bool() override { return _connected; }
+
+private:
+    TlsContext& _context;
+    Client& _transport;
+    const char* _hostname;
+    mbedtls_ssl_context _ssl;
+    bool _active = false;       // _ssl initialised
+    bool _connected = false;    // Handshake done, no error since
+    int _peek = -1;
+    uint32_t _minFreeHeap = 0;
+
+    int handshake() {
+        TRACE_SPAN("tls");
+        Metrics::Registry& metrics = Metrics::registry;
+        const uint32_t heapBefore = ESP.getFreeHeap();
+        _minFreeHeap = heapBefore;
+        const uint32_t start = micros();
+
+        mbedtls_ssl_init(&_ssl);
+        _active = true;
+        int ret = mbedtls_ssl_setup(&_ssl, _context.config());
+        if (ret == 0) ret = mbedtls_ssl_set_hostname(&_ssl, _hostname);
+        if (ret == 0) {
+            mbedtls_ssl_set_bio(&_ssl, this, onSend, onReceive, nullptr);
+            _context.prepare(_ssl);
+            const uint32_t startMs = millis();
+            while ((ret = mbedtls_ssl_handshake(&_ssl)) != 0) {
+                sampleHeap();
+                if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) break;
+                if (millis() - startMs > TLS_HANDSHAKE_TIMEOUT_MS) {
+                    ret = MBEDTLS_ERR_SSL_TIMEOUT;
+                    break;
+                }
+                delay(1);
+            }
+        }
+        sampleHeap();
+        if (ret != 0) {
+            LOG(TLS_HANDSHAKE_FAILED, -ret);
+            metrics.tlsFailures.inc();
+            _context.forgetSession();
+            stop();
+            return 0;
+        }
+
+        bool resumed;
+        if (!_context.finish(_ssl, resumed)) {
+            LOG(TLS_PIN_MISMATCH, _hostname);
+            metrics.tlsPinFailures.inc();
+            stop();
+            return 0;
+        }
+        const uint32_t elapsed = micros() - start;
+        const uint32_t heapPeak = heapBefore > _minFreeHeap ? heapBefore - _minFreeHeap : 0;
+        (resumed ? metrics.tlsHandshakeResumed : metrics.tlsHandshakeFull).observe(elapsed);
+        metrics.tlsHeapPeakBytes.set(heapPeak);
+        LOG(TLS_HANDSHAKE, resumed ? "resumed" : "full", elapsed / 1000, heapPeak);
+        _connected = true;
+        return 1;
+    }
+
+    int receive(uint8_t* buffer, size_t size) {
+        if (!_connected) return -1;
+        const int ret = mbedtls_ssl_read(&_ssl, buffer, size);
+        if (ret > 0) return ret;
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            _connected = false;     // Close notify, EOF or error
+        }
+        return -1;
+    }
+
+    void sampleHeap() {
+        const uint32_t freeHeap = ESP.getFreeHeap();
+        if (freeHeap < _minFreeHeap) _minFreeHeap = freeHeap;
+    }
+
+    static int onSend(void* arg, const unsigned char* buffer, size_t length) {
+        TlsClient* self = static_cast<TlsClient*>(arg);
+        self->sampleHeap();
+        const size_t n = self->_transport.write(buffer, length);
+        if (n > 0) return (int)n;
+        return self->_transport.connected() ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+
+    static int onReceive(void* arg, unsigned char* buffer, size_t length) {
+        TlsClient* self = static_cast<TlsClient*>(arg);
+        self->sampleHeap();
+        const int available = self->_transport.available();
+        if (available <= 0) {
+            return self->_transport.connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+        }
+        const int n = self->_transport.read(buffer, min(length, (size_t)available));
+        return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+    }
+};
+
+#endif // TLS_CLIENT_H
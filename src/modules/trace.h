@@ -0,0 +1,193 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * @file trace.h
+ * @brief Cycle-counter tracing spans with Chrome trace_event export
+ *
+ * TRACE_SPAN("name") records the enclosing scope into a fixed-size ring
+ * buffer per CPU core. Recording is two cycle-counter reads and one
+ * relaxed atomic increment; names must be string literals (only the
+ * pointer is stored). With TRACE_ENABLE false every macro expands to
+ * nothing and this header defines no code.
+ *
+ * Dump with GET /trace or the serial command 't', then load the JSON in
+ * chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Timestamps are converted to microseconds at dump time with the current
+ * CPU frequency, so spans recorded before a frequency change are scaled
+ * with the new one.
+ */
+
+#include <Arduino.h>
+#include "../config.h"
+
+#if TRACE_ENABLE
+
+#include <atomic>
+#if !defined(ESP_PLATFORM)
+#include <chrono>
+#endif
+
+namespace Trace {
+
+struct Event {
+    const char* name;
+    uint32_t startLow;      // Start cycle (low 32 bits)
+    uint32_t startHigh;     // Start cycle (high 32 bits)
+    uint32_t duration;      // Cycles
+};
+
+#if defined(ESP_PLATFORM)
+static constexpr size_t CORE_COUNT = portNUM_PROCESSORS;
+
+inline uint32_t cycleCount() {
+    return ESP.getCycleCount();
+}
+
+inline size_t coreId() {
+    return xPortGetCoreID();
+}
+
+inline uint32_t cyclesPerMicro() {
+    return ESP.getCpuFreqMHz();
+}
+#else
+// Host: nanoseconds from the monotonic clock stand in for cycles
+static constexpr size_t CORE_COUNT = 1;
+
+inline uint32_t cycleCount() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline size_t coreId() {
+    return 0;
+}
+
+inline uint32_t cyclesPerMicro() {
+    return 1000;
+}
+#endif
+
+/**
+ * Per-core event ring and 32 -> 64 bit cycle extension
+ */
+struct CoreBuffer {
+    Event events[TRACE_BUFFER_EVENTS];
+    std::atomic<uint32_t> next{0};
+    uint32_t lastCycle = 0;
+    uint32_t wraps = 0;
+
+    // Extend the 32-bit counter. Only valid when called at least once per
+    // wrap period (~17 s at 240 MHz); Trace::tick() guarantees that.
+    // Counters must come in time order, or the step back counts as a wrap.
+    uint64_t extend(uint32_t cycle) {
+        if (cycle < lastCycle) wraps++;
+        lastCycle = cycle;
+        return ((uint64_t)wraps << 32) | cycle;
+    }
+};
+
+inline CoreBuffer buffers[CORE_COUNT];
+inline std::atomic<bool> recording{true};
+
+/**
+ * @param start64 Start, extended when the span opened
+ */
+inline void record(const char* name, uint64_t start64, uint32_t end) {
+    if (!recording.load(std::memory_order_relaxed)) return;
+    CoreBuffer& buf = buffers[coreId()];
+    buf.extend(end);
+
+    const uint32_t slot = buf.next.fetch_add(1, std::memory_order_relaxed) % TRACE_BUFFER_EVENTS;
+    Event& e = buf.events[slot];
+    e.name = name;
+    e.startLow = (uint32_t)start64;
+    e.startHigh = (uint32_t)(start64 >> 32);
+    e.duration = end - (uint32_t)start64;
+}
+
+/**
+ * Keep the cycle extension in step; call from the main loop
+ */
+inline void tick() {
+    buffers[coreId()].extend(cycleCount());
+}
+
+/**
+ * Extends its start when it opens: by the time it closes, inner spans
+ * have moved the extension on past it
+ */
+class Span {
+public:
+    explicit Span(const char* name) : _name(name), _start(buffers[coreId()].extend(cycleCount())) {}
+    ~Span() { record(_name, _start, cycleCount()); }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    const char* _name;
+    const uint64_t _start;
+};
+
+/**
+ * Write all buffered spans as Chrome trace_event JSON
+ */
+inline void writeChromeTrace(Print& out) {
+    recording.store(false);  // Freeze rings while reading them
+
+    const uint32_t cpm = cyclesPerMicro();
+    out.print(F("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    bool first = true;
+
+    for (size_t core = 0; core < CORE_COUNT; core++) {
+        const CoreBuffer& buf = buffers[core];
+        const uint32_t written = buf.next.load();
+        const uint32_t count = min<uint32_t>(written, TRACE_BUFFER_EVENTS);
+
+        for (uint32_t i = written - count; i != written; i++) {
+            const Event& e = buf.events[i % TRACE_BUFFER_EVENTS];
+            const uint64_t start = ((uint64_t)e.startHigh << 32) | e.startLow;
+            char line[128];
+            snprintf(line, sizeof(line),
+                     "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                     first ? "" : ",\n", e.name, (unsigned)core,
+                     (double)start / cpm, (double)e.duration / cpm);
+            out.print(line);
+            first = false;
+        }
+    }
+
+    out.println(F("]}"));
+    recording.store(true);
+}
+
+/**
+ * Serve /trace
+ */
+inline void serve(Print& out) {
+    out.println(F("HTTP/1.1 200 OK"));
+    out.println(F("Content-Type: application/json"));
+    out.println(F("Content-Disposition: attachment; filename=\"trace.json\""));
+    out.println(F("Connection: close"));
+    out.println();
+    writeChromeTrace(out);
+}
+
+} // namespace Trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(name) Trace::Span TRACE_CONCAT(_traceSpan, __LINE__)(name)
+#define TRACE_TICK() Trace::tick()
+
+#else
+
+#define TRACE_SPAN(name)
+#define TRACE_TICK()
+
+#endif // TRACE_ENABLE
+
+#endif // TRACE_H
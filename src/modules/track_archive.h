@@ -0,0 +1,430 @@
+#ifndef TRACK_ARCHIVE_H
+#define TRACK_ARCHIVE_H
+
+/**
+ * @file track_archive.h
+ * @brief Log-structured, time-indexed track history on a flash partition
+ *
+ * Every fix goes into a RAM page of ARCHIVE_PAGE_SIZE bytes; a full page
+ * is programmed into the next slot of the ARCHIVE_PARTITION data
+ * partition, round and round. Page seq (counted since the archive was
+ * created) lives at byte (seq % pages) * ARCHIVE_PAGE_SIZE, and the
+ * sector a page starts is erased first, which drops the oldest sector:
+ * retention is circular and every flash byte is written once per lap.
+ *
+ * Page layout:
+ *   ArchivePageHeader   seq, record count, the first fix in full
+ *   records             each later fix as deltas from the one before:
+ *                       varint seconds, zigzag varints latitude,
+ *                       longitude, speed, altitude and course, then
+ *                       satellites and flags (about 10 bytes at 1 Hz)
+ * The records are programmed before the header, whose magic is last, so
+ * a page torn by a reset has no valid header and is skipped.
+ *
+ * The time index is one entry per sector in RAM (first fix time of the
+ * sector); on flash it is the headers themselves, read back at boot. A
+ * range lookup is a binary search over the sectors, then at most
+ * SPI_FLASH_SEC_SIZE / ARCHIVE_PAGE_SIZE page headers, then a decode
+ * from there on, page by page, with one page buffer.
+ *
+ * A reset loses the fixes of the open RAM page; flush() writes it early
+ * (before a restart or on battery).
+ */
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include "../config.h"
+#include "logger.h"
+#include "metrics.h"
+#include "rtos.h"
+#include "track_store.h"
+
+#ifndef SPI_FLASH_SEC_SIZE
+#define SPI_FLASH_SEC_SIZE      4096
+#endif
+#ifndef ARCHIVE_PARTITION
+#define ARCHIVE_PARTITION       "spiffs"
+#endif
+#ifndef ARCHIVE_PAGE_SIZE
+#define ARCHIVE_PAGE_SIZE       512
+#endif
+#ifndef ARCHIVE_MAX_SECTORS
+#define ARCHIVE_MAX_SECTORS     1024
+#endif
+
+static_assert(SPI_FLASH_SEC_SIZE % ARCHIVE_PAGE_SIZE == 0, "ARCHIVE_PAGE_SIZE must divide the flash sector");
+
+struct __attribute__((packed)) ArchivePageHeader {
+    static constexpr uint32_t MAGIC = 0x314B5254;  // "TRK1"
+
+    uint32_t seq;
+    uint16_t count;         // Fixes, the first one included
+    uint16_t bytes;         // Record bytes after the header
+    TrackPoint first;
+    uint32_t magic;         // Programmed last
+};
+
+class TrackArchive {
+public:
+    static constexpr uint32_t PAGES_PER_SECTOR = SPI_FLASH_SEC_SIZE / ARCHIVE_PAGE_SIZE;
+    static constexpr size_t RECORD_MAX = 6 * 5 + 2;     // Six varints at their longest
+
+    /**
+     * Find the partition and pick up where the last run stopped
+     * (setup(), before the GPS task starts)
+     * @return false without a partition
+     */
+    bool begin() {
+        _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, ARCHIVE_PARTITION);
+        if (!_partition) {
+            LOG(ARCHIVE_NO_PARTITION, ARCHIVE_PARTITION);
+            return false;
+        }
+        _sectors = min<uint32_t>(_partition->size / SPI_FLASH_SEC_SIZE, ARCHIVE_MAX_SECTORS);
+        _pages = _sectors * PAGES_PER_SECTOR;
+        if (_sectors < 2) {
+            _partition = nullptr;
+            return false;
+        }
+        recover();
+        LOG(ARCHIVE_READY, _partition->label, (unsigned)(_sectors * SPI_FLASH_SEC_SIZE / 1024),
+            (unsigned)(_nextSeq - _oldestSeq), oldestTime());
+        return true;
+    }
+
+    bool ready() const { return _partition != nullptr; }
+
+    /**
+     * Append a fix (GPS task). Fixes without time or not newer than the
+     * last one are dropped, so the archive stays in time order.
+     * @return true if stored
+     */
+    bool append(const TrackPoint& point) {
+        if (!_partition || point.time == 0) return false;
+        Rtos::LockGuard guard(_mutex);
+        if (point.time <= _last.time) return false;
+        if (_head.count && _head.bytes + RECORD_MAX > BODY_SIZE) flushLocked();
+        if (_head.count == 0) {
+            _head.first = point;
+            _head.count = 1;
+        } else {
+            _head.bytes += encode(_last, point, _body + _head.bytes);
+            _head.count++;
+        }
+        _last = point;
+        Metrics::registry.archiveFixes.inc();
+        return true;
+    }
+
+    /**
+     * Write the open page now (reset or power loss ahead)
+     */
+    void flush() {
+        if (!_partition) return;
+        Rtos::LockGuard guard(_mutex);
+        flushLocked();
+    }
+
+    /**
+     * Erase everything
+     */
+    bool clear() {
+        if (!_partition) return false;
+        Rtos::LockGuard guard(_mutex);
+        const bool ok = esp_partition_erase_range(_partition, 0, _sectors * SPI_FLASH_SEC_SIZE) == ESP_OK;
+        _oldestSeq = _nextSeq = 0;
+        _head = ArchivePageHeader{};
+        _last = TrackPoint{};
+        memset(_sectorTime, 0, sizeof(_sectorTime));
+        Metrics::registry.archiveOldestTime.set(0);
+        return ok;
+    }
+
+    /**
+     * Fixes with from <= time <= to, oldest first, the open page included
+     * @param page ARCHIVE_PAGE_SIZE bytes of scratch
+     * @param emit bool(const TrackPoint&); false stops the query
+     * @return fixes emitted
+     */
+    template <typename Emit>
+    uint32_t query(uint32_t from, uint32_t to, uint8_t* page, Emit&& emit) const {
+        if (!_partition || from > to) return 0;
+        uint32_t seq = startSeq(from);
+        uint32_t emitted = 0;
+        for (;;) {
+            bool open = false;
+            {
+                Rtos::LockGuard guard(_mutex);
+                if (seq < _oldestSeq) seq = _oldestSeq;     // Overwritten meanwhile
+                if (seq < _nextSeq) {
+                    if (!readPage(seq, page)) {
+                        seq++;
+                        continue;
+                    }
+                } else if (seq == _nextSeq && _head.count) {
+                    memcpy(page, &_head, sizeof(_head));
+                    memcpy(page + sizeof(_head), _body, _head.bytes);
+                    open = true;
+                } else {
+                    break;
+                }
+            }
+            const ArchivePageHeader& head = *reinterpret_cast<const ArchivePageHeader*>(page);
+            if (head.first.time > to) break;
+            bool more = true;
+            decode(head, page + sizeof(head), [&](const TrackPoint& p) {
+                if (p.time > to) return more = false;
+                if (p.time < from) return true;
+                emitted++;
+                return more = emit(p);
+            });
+            if (!more || open) break;
+            seq++;
+        }
+        return emitted;
+    }
+
+    /**
+     * Time of the oldest fix on flash (0 = empty)
+     */
+    uint32_t oldestTime() const {
+        if (_oldestSeq == _nextSeq) return _head.count ? _head.first.time : 0;
+        return _sectorTime[sectorOf(_oldestSeq)];
+    }
+
+    uint32_t newestTime() const {
+        Rtos::LockGuard guard(_mutex);
+        return _last.time;
+    }
+
+    uint32_t pagesStored() const { return _nextSeq - _oldestSeq; }
+
+private:
+    static constexpr size_t BODY_SIZE = ARCHIVE_PAGE_SIZE - sizeof(ArchivePageHeader);
+
+    const esp_partition_t* _partition = nullptr;
+    uint32_t _sectors = 0;
+    uint32_t _pages = 0;
+    uint32_t _oldestSeq = 0;    // Pages [_oldestSeq, _nextSeq) are on flash
+    uint32_t _nextSeq = 0;      // The open page
+    uint32_t _sectorTime[ARCHIVE_MAX_SECTORS] = {};     // First fix time per sector, a lower bound
+
+    ArchivePageHeader _head{};  // Open page
+    uint8_t _body[BODY_SIZE];
+    TrackPoint _last{};
+    mutable Rtos::Mutex _mutex;  // GPS task appends while the web task queries
+
+    uint32_t sectorOf(uint32_t seq) const { return seq / PAGES_PER_SECTOR % _sectors; }
+    size_t offsetOf(uint32_t seq) const { return (size_t)(seq % _pages) * ARCHIVE_PAGE_SIZE; }
+
+    bool readHeader(uint32_t slot, ArchivePageHeader& head) const {
+        return esp_partition_read(_partition, (size_t)slot * ARCHIVE_PAGE_SIZE, &head, sizeof(head)) == ESP_OK &&
+               head.magic == ArchivePageHeader::MAGIC && head.count > 0 && head.bytes <= BODY_SIZE;
+    }
+
+    bool readPage(uint32_t seq, uint8_t* page) const {
+        if (esp_partition_read(_partition, offsetOf(seq), page, ARCHIVE_PAGE_SIZE) != ESP_OK) return false;
+        const ArchivePageHeader& head = *reinterpret_cast<const ArchivePageHeader*>(page);
+        return head.magic == ArchivePageHeader::MAGIC && head.seq == seq && head.count > 0 &&
+               head.bytes <= BODY_SIZE;
+    }
+
+    // Last sector starting at or before from, then the last page in it
+    uint32_t startSeq(uint32_t from) const {
+        uint32_t oldest, next, lo, hi, base;
+        {
+            Rtos::LockGuard guard(_mutex);
+            oldest = _oldestSeq;
+            next = _nextSeq;
+            if (oldest == next) return next;
+            base = oldest - oldest % PAGES_PER_SECTOR;
+            lo = 0;
+            hi = (next - 1) / PAGES_PER_SECTOR - base / PAGES_PER_SECTOR;
+            while (lo < hi) {
+                const uint32_t mid = lo + (hi - lo + 1) / 2;
+                if (_sectorTime[sectorOf(base + mid * PAGES_PER_SECTOR)] <= from) lo = mid;
+                else hi = mid - 1;
+            }
+        }
+        uint32_t seq = max(base + lo * PAGES_PER_SECTOR, oldest);
+        const uint32_t end = min(seq - seq % PAGES_PER_SECTOR + PAGES_PER_SECTOR, next);
+        for (uint32_t candidate = seq + 1; candidate < end; candidate++) {
+            ArchivePageHeader head;
+            Rtos::LockGuard guard(_mutex);
+            if (!readHeader(candidate % _pages, head) || head.seq != candidate) continue;
+            if (head.first.time > from) break;
+            seq = candidate;
+        }
+        return seq;
+    }
+
+    void flushLocked() {
+        if (_head.count == 0) return;
+        Metrics::Registry& metrics = Metrics::registry;
+        const uint32_t seq = _nextSeq++;
+        const size_t offset = offsetOf(seq);
+        bool ok = true;
+        if (seq % PAGES_PER_SECTOR == 0) {
+            ok = esp_partition_erase_range(_partition, offset, SPI_FLASH_SEC_SIZE) == ESP_OK;
+            metrics.archiveSectorErases.inc();
+            if (seq + PAGES_PER_SECTOR > _pages) _oldestSeq = max(_oldestSeq, seq + PAGES_PER_SECTOR - _pages);
+            _sectorTime[sectorOf(seq)] = _head.first.time;
+        }
+        _head.seq = seq;
+        _head.magic = ArchivePageHeader::MAGIC;
+        ok = ok && esp_partition_write(_partition, offset + sizeof(_head), _body, _head.bytes) == ESP_OK &&
+             esp_partition_write(_partition, offset, &_head, sizeof(_head)) == ESP_OK;
+        if (ok) {
+            metrics.archivePagesWritten.inc();
+            metrics.archiveFlashBytes.inc(sizeof(_head) + _head.bytes);
+        } else {
+            metrics.archiveWriteFailures.inc();
+            LOG(ARCHIVE_WRITE_FAILED, (unsigned)seq, _head.count);
+        }
+        metrics.archiveOldestTime.set(_sectorTime[sectorOf(_oldestSeq)]);
+        _head = ArchivePageHeader{};
+    }
+
+    /**
+     * The newest page on flash, then the slot after it; pages behind it
+     * by less than the partition are kept
+     */
+    void recover() {
+        memset(_sectorTime, 0, sizeof(_sectorTime));
+        bool found = false;
+        uint32_t newest = 0;
+        for (uint32_t s = 0; s < _sectors; s++) {
+            ArchivePageHeader head;
+            if (firstPage(s, head) && (!found || head.seq > newest)) {
+                newest = head.seq;
+                found = true;
+            }
+        }
+        if (!found) {
+            _oldestSeq = _nextSeq = 0;
+            return;
+        }
+
+        // Last page of the head sector, then skip slots a reset left dirty
+        uint32_t seq = newest;
+        const uint32_t sectorEnd = newest - newest % PAGES_PER_SECTOR + PAGES_PER_SECTOR;
+        for (uint32_t next = newest + 1; next < sectorEnd; next++) {
+            ArchivePageHeader head;
+            if (readHeader(next % _pages, head) && head.seq == next) seq = next;
+        }
+        _nextSeq = seq + 1;
+        ArchivePageHeader last;
+        if (readHeader(seq % _pages, last) &&
+            esp_partition_read(_partition, offsetOf(seq) + sizeof(last), _body, last.bytes) == ESP_OK) {
+            decode(last, _body, [this](const TrackPoint& p) {
+                _last = p;
+                return true;
+            });
+        }
+        while (_nextSeq % PAGES_PER_SECTOR && !erased(_nextSeq)) _nextSeq++;
+
+        const uint32_t headBase = newest - newest % PAGES_PER_SECTOR;
+        _oldestSeq = headBase + PAGES_PER_SECTOR > _pages ? headBase + PAGES_PER_SECTOR - _pages : 0;
+        bool first = true;
+        uint32_t time = 0;
+        for (uint32_t base = _oldestSeq; base <= headBase; base += PAGES_PER_SECTOR) {
+            ArchivePageHeader head;
+            const uint32_t s = sectorOf(base);
+            if (firstPage(s, head) && head.seq >= base && head.seq < base + PAGES_PER_SECTOR) {
+                if (first) _oldestSeq = head.seq;
+                first = false;
+                time = head.first.time;
+            }
+            _sectorTime[s] = time;  // A sector without pages keeps the order
+        }
+        if (first) _oldestSeq = _nextSeq;
+        Metrics::registry.archiveOldestTime.set(oldestTime());
+    }
+
+    bool firstPage(uint32_t sector, ArchivePageHeader& head) const {
+        for (uint32_t p = 0; p < PAGES_PER_SECTOR; p++) {
+            const uint32_t slot = sector * PAGES_PER_SECTOR + p;
+            if (readHeader(slot, head) && head.seq % _pages == slot) return true;
+        }
+        return false;
+    }
+
+    bool erased(uint32_t seq) const {
+        uint32_t words[32];
+        for (size_t offset = 0; offset < ARCHIVE_PAGE_SIZE; offset += sizeof(words)) {
+            if (esp_partition_read(_partition, offsetOf(seq) + offset, words, sizeof(words)) != ESP_OK) return false;
+            for (uint32_t w : words) {
+                if (w != 0xFFFFFFFF) return false;
+            }
+        }
+        return true;
+    }
+
+    static size_t putVarint(uint8_t* out, uint32_t value) {
+        size_t n = 0;
+        while (value >= 0x80) {
+            out[n++] = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        out[n++] = (uint8_t)value;
+        return n;
+    }
+
+    static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+    static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+    static size_t encode(const TrackPoint& prev, const TrackPoint& p, uint8_t* out) {
+        int32_t course = (int32_t)p.course - prev.course;     // Shorter way round
+        if (course > 18000) course -= 36000;
+        else if (course < -18000) course += 36000;
+        size_t n = putVarint(out, p.time - prev.time);
+        n += putVarint(out + n, zigzag((int32_t)((uint32_t)p.lat - (uint32_t)prev.lat)));
+        n += putVarint(out + n, zigzag((int32_t)((uint32_t)p.lng - (uint32_t)prev.lng)));
+        n += putVarint(out + n, zigzag((int32_t)p.speed - prev.speed));
+        n += putVarint(out + n, zigzag((int32_t)p.altitude - prev.altitude));
+        n += putVarint(out + n, zigzag(course));
+        out[n++] = p.satellites;
+        out[n++] = p.flags;
+        return n;
+    }
+
+    static bool getVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+        value = 0;
+        for (uint8_t shift = 0; in < end && shift < 35; shift += 7) {
+            const uint8_t b = *in++;
+            value |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    /**
+     * Calls emit(point) for each fix of a page until it returns false
+     */
+    template <typename Emit>
+    static void decode(const ArchivePageHeader& head, const uint8_t* body, Emit&& emit) {
+        TrackPoint p = head.first;
+        if (!emit(p)) return;
+        const uint8_t* in = body;
+        const uint8_t* const end = in + head.bytes;
+        for (uint16_t i = 1; i < head.count; i++) {
+            uint32_t dt, lat, lng, speed, alt, course;
+            if (!getVarint(in, end, dt) || !getVarint(in, end, lat) || !getVarint(in, end, lng) ||
+                !getVarint(in, end, speed) || !getVarint(in, end, alt) || !getVarint(in, end, course) ||
+                end - in < 2) {
+                return;
+            }
+            p.time += dt;
+            p.lat = (int32_t)((uint32_t)p.lat + (uint32_t)unzigzag(lat));
+            p.lng = (int32_t)((uint32_t)p.lng + (uint32_t)unzigzag(lng));
+            p.speed = (uint16_t)(p.speed + unzigzag(speed));
+            p.altitude = (int16_t)(p.altitude + unzigzag(alt));
+            p.course = (uint16_t)(((int32_t)p.course + unzigzag(course) + 36000) % 36000);
+            p.satellites = *in++;
+            p.flags = *in++;
+            if (!emit(p)) return;
+        }
+    }
+};
+
+#endif // TRACK_ARCHIVE_H
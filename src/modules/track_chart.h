@@ -0,0 +1,288 @@
+#ifndef TRACK_CHART_H
+#define TRACK_CHART_H
+
+/**
+ * @file track_chart.h
+ * @brief Downsampled trend charts of the track history (SVG sparklines)
+ *
+ * One series (speed, altitude, satellites or free heap) over a time
+ * window, reduced to at most `points` points with Largest-Triangle-
+ * Three-Buckets: the first and last point stay, the rest is split into
+ * equal-count buckets, and each bucket keeps the point that spans the
+ * largest triangle with the point kept before it and the average of the
+ * bucket after it.
+ *
+ * The history is read once, oldest first. A bucket's point can only be
+ * picked once the next bucket's average is known, so each bucket holds
+ * just its lowest and highest point as candidates (MinMaxLTTB) and is
+ * decided one bucket late. Memory is the kept points, O(points), from
+ * the web arena.
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+#include <esp_task_wdt.h>
+#include "../config.h"
+#include "arena.h"
+#include "buffered_print.h"
+#include "http_request.h"
+#include "track_store.h"
+
+#ifndef CHART_DEFAULT_WINDOW_S
+#define CHART_DEFAULT_WINDOW_S  3600
+#endif
+#ifndef CHART_MAX_POINTS
+#define CHART_MAX_POINTS        120
+#endif
+
+namespace TrackChart {
+
+enum class Series : uint8_t {
+    SPEED = 0,
+    ALTITUDE,
+    SATELLITES,
+    HEAP,
+    COUNT
+};
+
+struct SeriesInfo {
+    const char* name;   // Query value and label
+    const char* unit;
+    const char* color;
+};
+
+static const SeriesInfo SERIES[(size_t)Series::COUNT] = {
+    {"speed", "km/h", "#38bdf8"},
+    {"altitude", "m", "#a78bfa"},
+    {"satellites", "", "#4ade80"},
+    {"heap", "KB", "#facc15"},
+};
+
+// Sparkline size; the plot sits below a one-line label
+static constexpr int WIDTH = 300;
+static constexpr int HEIGHT = 64;
+static constexpr int PLOT_TOP = 16;
+
+struct Point {
+    uint32_t time;
+    float value;
+};
+
+static_assert(WEB_ARENA_SIZE >= HTTP_BUFFER_SIZE + CHART_MAX_POINTS * sizeof(Point) + 8,
+              "WEB_ARENA_SIZE too small for CHART_MAX_POINTS");
+
+inline bool parseSeries(const char* name, Series& series) {
+    for (size_t i = 0; i < (size_t)Series::COUNT; i++) {
+        if (strcmp(name, SERIES[i].name) == 0) {
+            series = (Series)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline float value(Series series, const TrackPoint& p, uint16_t heapKb) {
+    switch (series) {
+        case Series::SPEED: return p.speed / 100.0f;
+        case Series::ALTITUDE: return p.altitude;
+        case Series::SATELLITES: return p.satellites;
+        default: return heapKb;
+    }
+}
+
+/**
+ * Streaming LTTB: add() every point in time order, then finish()
+ */
+class Downsampler {
+public:
+    /**
+     * @param out Room for points kept points (at least 3)
+     * @param total Number of points that will be added
+     */
+    Downsampler(Point* out, size_t points, size_t total)
+        : _out(out), _points(points), _total(total) {}
+
+    void add(const Point& p) {
+        const size_t k = _added++;
+        if (_total <= _points || k == 0) {
+            _out[_kept++] = p;      // Nothing to reduce, or the first point
+            return;
+        }
+        if (k == _total - 1) {
+            close();
+            if (_pendingSet) pick(p.time, p.value);
+            _out[_kept++] = p;
+            return;
+        }
+        const size_t bucket = (uint64_t)(k - 1) * (_points - 2) / (_total - 2);
+        if (bucket != _bucket) {
+            close();
+            _bucket = bucket;
+        }
+        if (_current.count == 0 || p.value < _current.low.value) _current.low = p;
+        if (_current.count == 0 || p.value > _current.high.value) _current.high = p;
+        _current.sumTime += p.time - _out[0].time;
+        _current.sumValue += p.value;
+        _current.count++;
+    }
+
+    /**
+     * @return Points kept (fewer added than announced still ends cleanly)
+     */
+    size_t finish() {
+        close();
+        if (_pendingSet) pick(_pending.averageTime(_out[0].time), _pending.averageValue());
+        return _kept;
+    }
+
+private:
+    struct Bucket {
+        Point low, high;
+        double sumTime;     // Offsets from the first point
+        double sumValue;
+        uint32_t count;
+
+        double averageTime(uint32_t origin) const { return origin + sumTime / count; }
+        double averageValue() const { return sumValue / count; }
+    };
+
+    Point* _out;
+    const size_t _points;
+    const size_t _total;
+    size_t _added = 0;
+    size_t _kept = 0;
+    size_t _bucket = 0;
+    Bucket _current{};
+    Bucket _pending{};          // Closed, waiting for the next average
+    bool _pendingSet = false;
+
+    // The current bucket's average decides the pending one
+    void close() {
+        if (_current.count == 0) return;
+        if (_pendingSet) pick(_current.averageTime(_out[0].time), _current.averageValue());
+        _pending = _current;
+        _pendingSet = true;
+        _current = Bucket{};
+    }
+
+    void pick(double nextTime, double nextValue) {
+        const Point& a = _out[_kept - 1];
+        const Point& chosen = area(a, _pending.low, nextTime, nextValue) >=
+                              area(a, _pending.high, nextTime, nextValue) ? _pending.low : _pending.high;
+        _out[_kept++] = chosen;
+        _pendingSet = false;
+    }
+
+    // Twice the triangle area; only differences, so epoch times keep precision
+    static double area(const Point& a, const Point& b, double cTime, double cValue) {
+        return fabs(((double)a.time - cTime) * ((double)b.value - a.value) -
+                    ((double)a.time - b.time) * (cValue - a.value));
+    }
+};
+
+/**
+ * Downsample store records [first, last) of one series
+ * @return Points written to out
+ */
+inline size_t downsample(const TrackStore& store, size_t first, size_t last, Series series,
+                         Point* out, size_t points) {
+    Downsampler lttb(out, points, last - first);
+    for (size_t i = first; i < last; i++) {
+        uint16_t heapKb;
+        const TrackPoint p = store.at(i, heapKb);
+        lttb.add(Point{p.time, value(series, p, heapKb)});
+    }
+    return lttb.finish();
+}
+
+/**
+ * SVG sparkline of n points in time order, with a label (last value, range)
+ */
+inline void render(Print& out, Series series, const Point* points, size_t n) {
+    const SeriesInfo& info = SERIES[(size_t)series];
+    char buf[160];
+    snprintf(buf, sizeof(buf),
+             "<svg xmlns='http://www.w3.org/2000/svg' width='%d' height='%d' viewBox='0 0 %d %d'>"
+             "<rect width='100%%' height='100%%' rx='6' fill='#0f172a'/>",
+             WIDTH, HEIGHT, WIDTH, HEIGHT);
+    out.print(buf);
+    if (n == 0) {
+        snprintf(buf, sizeof(buf),
+                 "<text x='6' y='12' font-family='sans-serif' font-size='10' fill='#64748b'>%s: no data</text></svg>",
+                 info.name);
+        out.print(buf);
+        return;
+    }
+
+    float low = points[0].value, high = points[0].value;
+    for (size_t i = 1; i < n; i++) {
+        low = min(low, points[i].value);
+        high = max(high, points[i].value);
+    }
+    snprintf(buf, sizeof(buf),
+             "<text x='6' y='12' font-family='sans-serif' font-size='10' fill='#94a3b8'>"
+             "%s %.1f %s (%.1f-%.1f)</text>",
+             info.name, points[n - 1].value, info.unit, low, high);
+    out.print(buf);
+
+    snprintf(buf, sizeof(buf), "<polyline fill='none' stroke='%s' stroke-width='1.5' points='", info.color);
+    out.print(buf);
+    const uint32_t span = points[n - 1].time - points[0].time;
+    const float range = high - low;
+    for (size_t i = 0; i < n; i++) {
+        const float x = span ? 2 + (float)(points[i].time - points[0].time) * (WIDTH - 4) / span : WIDTH / 2;
+        const float y = HEIGHT - 2 - (range > 0 ? (points[i].value - low) * (HEIGHT - 2 - PLOT_TOP) / range
+                                                : (HEIGHT - 2 - PLOT_TOP) / 2.0f);
+        snprintf(buf, sizeof(buf), "%.1f,%.1f ", x, y);
+        out.print(buf);
+    }
+    out.print("'/></svg>");
+}
+
+/**
+ * Serve /chart.svg
+ * Query: series=speed|altitude|satellites|heap (default speed),
+ * from=<epoch>&to=<epoch> (inclusive, default the last
+ * CHART_DEFAULT_WINDOW_S), points=<n> (3 to CHART_MAX_POINTS, default
+ * the most)
+ */
+inline void serve(Client& client, const HttpRequest& request, const TrackStore& store) {
+    char name[16] = "speed";
+    request.param("series", name, sizeof(name));
+    Series series;
+    if (!parseSeries(name, series)) {
+        client.println(F("HTTP/1.1 400 Bad Request"));
+        client.println(F("Content-Type: text/plain"));
+        client.println(F("Connection: close"));
+        client.println();
+        client.println(F("series: speed, altitude, satellites or heap"));
+        return;
+    }
+
+    const size_t size = store.size();
+    const uint32_t newest = size ? store.at(size - 1).time : 0;
+    const uint32_t from = request.paramUInt("from", newest > CHART_DEFAULT_WINDOW_S ? newest - CHART_DEFAULT_WINDOW_S : 0);
+    const uint32_t to = request.paramUInt("to", UINT32_MAX);
+    const size_t points = constrain(request.paramUInt("points", CHART_MAX_POINTS), 3UL, (unsigned long)CHART_MAX_POINTS);
+
+    client.println(F("HTTP/1.1 200 OK"));
+    client.println(F("Content-Type: image/svg+xml"));
+    client.println(F("Cache-Control: no-cache"));
+    client.println(F("Connection: close"));
+    client.println();
+    if (strcmp(request.method, "HEAD") == 0) return;
+
+    Point* kept = (Point*)Memory::web.allocate(points * sizeof(Point), alignof(Point));
+    if (!kept) return;
+    const size_t first = store.lowerBound(from);
+    const size_t last = max(first, store.upperBound(to));
+    const size_t n = downsample(store, first, last, series, kept, points);
+    esp_task_wdt_reset();
+
+    BufferedPrint out(client, Memory::web, HTTP_BUFFER_SIZE);
+    render(out, series, kept, n);
+}
+
+} // namespace TrackChart
+
+#endif // TRACK_CHART_H
@@ -0,0 +1,499 @@
+#ifndef TRACK_EXPORT_H
+#define TRACK_EXPORT_H
+
+/**
+ * @file track_export.h
+ * @brief Streaming GPX / GeoJSON export of stored track points
+ *
+ * Every track point is rendered into one line at its natural width.
+ * Fields are fixed-point integers written digit by digit, so the length
+ * of a line can be counted without rendering it: the document length
+ * (exact Content-Length) is one counting pass over the records, and a
+ * Range request counts its way to the record holding its first byte.
+ * The document is produced chunk by chunk with constant RAM regardless
+ * of track length. Records are addressed by append sequence, so fixes
+ * stored during a download leave its bytes alone; once the oldest
+ * records are overwritten the body after the last whole record is
+ * padded with whitespace up to the counted length.
+ *
+ * Sources without random access (the flash archive) are streamed
+ * instead, with the same lines.
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+#include <esp_task_wdt.h>
+#include "../config.h"
+#include "arena.h"
+#include "buffered_print.h"
+#include "http_request.h"
+#include "track_store.h"
+
+namespace TrackExport {
+
+enum class Format : uint8_t {
+    GPX = 0,
+    GEOJSON
+};
+
+// Longest rendered point with its newline (GPX, every field at its
+// widest: 187 bytes)
+static constexpr size_t RECORD_MAX = 192;
+
+/**
+ * Appends text to a buffer, or only counts it when out is nullptr
+ */
+class RecordWriter {
+public:
+    RecordWriter(char* out, size_t size) : _out(out), _size(size) {}
+
+    void text(const char* s) {
+        while (*s) put(*s++);
+    }
+
+    /**
+     * Unsigned decimal, zero-padded to width digits
+     */
+    void number(uint32_t value, uint8_t width = 1) {
+        char digits[10];
+        uint8_t n = 0;
+        do {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value || n < width);
+        while (n) put(digits[--n]);
+    }
+
+    void integer(int32_t value) {
+        if (value < 0) put('-');
+        number(value < 0 ? 0u - (uint32_t)value : (uint32_t)value);
+    }
+
+    /**
+     * value / 10^decimals with all decimals ("%.<decimals>f")
+     */
+    void fixed(int32_t value, uint8_t decimals) {
+        uint32_t scale = 1;
+        for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+        const uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+        if (value < 0) put('-');
+        number(magnitude / scale);
+        put('.');
+        number(magnitude % scale, decimals);
+    }
+
+    /**
+     * Epoch seconds as ISO-8601 UTC ("2024-01-31T12:00:00Z"), always 20
+     * characters (years 1970 to 2106)
+     */
+    void time(uint32_t epoch) {
+        if (!_out) {
+            _len += 20;
+            return;
+        }
+        const uint32_t days = epoch / 86400UL;
+        const uint32_t secs = epoch % 86400UL;
+
+        // Civil from days (Howard Hinnant)
+        const int32_t z = (int32_t)days + 719468;
+        const int32_t era = z / 146097;
+        const uint32_t doe = (uint32_t)(z - era * 146097);
+        const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const uint32_t mp = (5 * doy + 2) / 153;
+        const uint32_t day = doy - (153 * mp + 2) / 5 + 1;
+        const uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+        const uint32_t year = yoe + era * 400 + (month <= 2 ? 1 : 0);
+
+        number(year, 4);
+        put('-');
+        number(month, 2);
+        put('-');
+        number(day, 2);
+        put('T');
+        number(secs / 3600, 2);
+        put(':');
+        number(secs % 3600 / 60, 2);
+        put(':');
+        number(secs % 60, 2);
+        put('Z');
+    }
+
+    /**
+     * Full length, also the part that did not fit
+     */
+    size_t length() const { return _len; }
+
+private:
+    char* const _out;
+    const size_t _size;
+    size_t _len = 0;
+
+    void put(char c) {
+        if (_out && _len < _size) _out[_len] = c;
+        _len++;
+    }
+};
+
+/**
+ * Document start for a track of deviceId
+ * @return length written (truncated to size - 1)
+ */
+inline size_t renderHeader(Format format, const char* deviceId, char* out, size_t size) {
+    int len;
+    if (format == Format::GPX) {
+        len = snprintf(out, size,
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<gpx version=\"1.1\" creator=\"PELNI GPS Tracker\" "
+            "xmlns=\"http://www.topografix.com/GPX/1/1\">\n"
+            "<trk><name>%s</name><trkseg>\n", deviceId);
+    } else {
+        len = snprintf(out, size,
+            "{\"type\":\"FeatureCollection\",\"properties\":{\"device_id\":\"%s\"},"
+            "\"features\":[\n", deviceId);
+    }
+    return len < 0 ? 0 : min((size_t)len, size - 1);
+}
+
+inline const char* footer(Format format) {
+    return format == Format::GPX ? "</trkseg></trk></gpx>\n" : "]}\n";
+}
+
+/**
+ * One point, without line end; first drops the GeoJSON separator
+ * @param out nullptr only counts
+ * @return full length (written up to size)
+ */
+inline size_t renderPoint(Format format, const TrackPoint& p, bool first, char* out, size_t size) {
+    RecordWriter w(out, size);
+    if (format == Format::GPX) {
+        w.text("<trkpt lat=\"");
+        w.fixed(p.lat, 7);
+        w.text("\" lon=\"");
+        w.fixed(p.lng, 7);
+        w.text("\"><ele>");
+        w.integer(p.altitude);
+        w.text("</ele><time>");
+        w.time(p.time);
+        w.text("</time><sat>");
+        w.number(p.satellites);
+        w.text("</sat><extensions><speed>");
+        w.fixed(((uint32_t)p.speed * 10 + 18) / 36, 2);     // m/s
+        w.text("</speed><course>");
+        w.fixed(p.course, 2);
+        w.text("</course></extensions></trkpt>");
+    } else {
+        w.text(first ? " " : ",");
+        w.text("{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[");
+        w.fixed(p.lng, 7);
+        w.text(",");
+        w.fixed(p.lat, 7);
+        w.text(",");
+        w.integer(p.altitude);
+        w.text("]},\"properties\":{\"time\":\"");
+        w.time(p.time);
+        w.text("\",\"speed\":");
+        w.fixed(p.speed, 2);
+        w.text(",\"course\":");
+        w.fixed(p.course, 2);
+        w.text(",\"sat\":");
+        w.number(p.satellites);
+        w.text("}}");
+    }
+    return w.length();
+}
+
+/**
+ * Byte-addressable view of an exported document
+ */
+class ExportDocument {
+public:
+    /**
+     * @param firstSeq Append sequence of the first record
+     *                 (TrackStore::findSequences)
+     */
+    ExportDocument(const TrackStore& store, Format format,
+                   uint32_t firstSeq, size_t count, const char* deviceId)
+        : _store(store), _format(format), _firstSeq(firstSeq), _count(count) {
+        _headerLen = renderHeader(_format, deviceId, _header, sizeof(_header));
+        TrackPoint p;
+        for (size_t i = 0; i < _count; i++) {
+            if (!_store.atSequence(_firstSeq + i, p)) {
+                _count = i;     // Overwritten while counting
+                break;
+            }
+            if (i == 0) _firstTime = p.time;
+            _lastTime = p.time;
+            _bodyLen += renderPoint(_format, p, i == 0, nullptr, 0) + 1;
+        }
+    }
+
+    size_t length() const {
+        return _headerLen + _bodyLen + strlen(footer(_format));
+    }
+
+    size_t count() const { return _count; }
+    uint32_t firstTime() const { return _firstTime; }
+    uint32_t lastTime() const { return _lastTime; }
+
+    /**
+     * Copy document bytes [offset, offset + len) into out; fastest in
+     * ascending order
+     * @return number of bytes copied
+     */
+    size_t read(size_t offset, uint8_t* out, size_t len) {
+        const size_t bodyEnd = _headerLen + _bodyLen;
+        const char* tail = footer(_format);
+        size_t copied = 0;
+
+        while (copied < len) {
+            const char* src;
+            size_t avail;
+
+            if (offset < _headerLen) {
+                src = _header + offset;
+                avail = _headerLen - offset;
+            } else if (offset < bodyEnd) {
+                const size_t rel = offset - _headerLen;
+                if (seek(rel)) {
+                    src = _record + (rel - _start);
+                    avail = min(_recordLen - (rel - _start), bodyEnd - offset);
+                } else {
+                    // Overwritten since the length was counted: pad to it
+                    // after the last whole record (the ETag changed, so a
+                    // resume starts over)
+                    const size_t n = min(bodyEnd - offset, len - copied);
+                    memset(out + copied, ' ', n);
+                    copied += n;
+                    offset += n;
+                    continue;
+                }
+            } else {
+                const size_t rel = offset - bodyEnd;
+                const size_t tailLen = strlen(tail);
+                if (rel >= tailLen) break;
+                src = tail + rel;
+                avail = tailLen - rel;
+            }
+
+            const size_t n = min(avail, len - copied);
+            memcpy(out + copied, src, n);
+            copied += n;
+            offset += n;
+        }
+        return copied;
+    }
+
+private:
+    const TrackStore& _store;
+    const Format _format;
+    const uint32_t _firstSeq;
+    size_t _count;
+    char _header[192];
+    size_t _headerLen = 0;
+    size_t _bodyLen = 0;
+    uint32_t _firstTime = 0;
+    uint32_t _lastTime = 0;
+
+    // Cursor: record _index starts at body offset _start
+    size_t _index = 0;
+    size_t _start = 0;
+    bool _rendered = false;
+    bool _lost = false;         // A record was gone: the rest is padding
+    char _record[RECORD_MAX];
+    size_t _recordLen = 0;
+
+    // Move the cursor to the record holding body offset rel and render it
+    bool seek(size_t rel) {
+        if (_lost) return false;
+        if (rel < _start) {
+            _index = 0;
+            _start = 0;
+            _rendered = false;
+        }
+        TrackPoint p;
+        for (;;) {
+            if (_index >= _count) return false;
+            if (_rendered) {
+                if (rel < _start + _recordLen) return true;
+                _start += _recordLen;
+            } else {
+                // A sequence never changes content, so this is the counted
+                // length; a gap would break the GeoJSON separators after it
+                if (!_store.atSequence(_firstSeq + _index, p)) {
+                    _lost = true;
+                    return false;
+                }
+                const size_t len = renderPoint(_format, p, _index == 0, nullptr, 0) + 1;
+                if (rel < _start + len) {
+                    const size_t n = min(renderPoint(_format, p, _index == 0,
+                                                     _record, sizeof(_record) - 1), sizeof(_record) - 1);
+                    _record[n] = '\n';
+                    _recordLen = n + 1;
+                    _rendered = true;
+                    return true;
+                }
+                _start += len;
+            }
+            _index++;
+            _rendered = false;
+        }
+    }
+};
+
+enum class RangeResult : uint8_t {
+    NONE = 0,       // No usable Range header, send full document
+    PARTIAL,        // Valid single range
+    UNSATISFIABLE
+};
+
+/**
+ * Parse a single "bytes=start-end" range against document length
+ */
+inline RangeResult parseRange(const char* header, size_t total, size_t& start, size_t& end) {
+    if (strncmp(header, "bytes=", 6) != 0) return RangeResult::NONE;
+    const char* spec = header + 6;
+    if (strchr(spec, ',')) return RangeResult::NONE;  // Multi-range not supported
+
+    const char* dash = strchr(spec, '-');
+    if (!dash) return RangeResult::NONE;
+
+    if (dash == spec) {
+        // Suffix range: last N bytes
+        const unsigned long suffix = strtoul(dash + 1, nullptr, 10);
+        if (suffix == 0 || total == 0) return RangeResult::UNSATISFIABLE;
+        start = suffix >= total ? 0 : total - suffix;
+        end = total;
+        return RangeResult::PARTIAL;
+    }
+
+    const unsigned long first = strtoul(spec, nullptr, 10);
+    if (first >= total) return RangeResult::UNSATISFIABLE;
+    unsigned long last = total - 1;
+    if (*(dash + 1) != '\0') {
+        last = strtoul(dash + 1, nullptr, 10);
+        if (last < first) return RangeResult::NONE;
+        if (last >= total) last = total - 1;
+    }
+    start = first;
+    end = last + 1;
+    return RangeResult::PARTIAL;
+}
+
+/**
+ * Serve /export.gpx or /export.geojson
+ * Query: from=<epoch>&to=<epoch> (both inclusive, optional)
+ */
+inline void serve(Client& client, const HttpRequest& request, const TrackStore& store,
+                  Format format, const char* deviceId) {
+    const uint32_t from = request.paramUInt("from", 0);
+    const uint32_t to = request.paramUInt("to", UINT32_MAX);
+    uint32_t firstSeq = 0;
+    const size_t count = store.findSequences(from, to, firstSeq);
+
+    ExportDocument doc(store, format, firstSeq, count, deviceId);
+    const size_t total = doc.length();
+
+    // ETag identifies the exact record set so a resumed download can
+    // detect that the window changed underneath it
+    char etag[40];
+    snprintf(etag, sizeof(etag), "\"%c%lx-%lx-%lx\"",
+             format == Format::GPX ? 'g' : 'j',
+             (unsigned long)doc.firstTime(), (unsigned long)doc.lastTime(),
+             (unsigned long)doc.count());
+
+    size_t start = 0;
+    size_t end = total;
+    RangeResult range = RangeResult::NONE;
+    if (request.range[0] != '\0' &&
+        (request.ifRange[0] == '\0' || strcmp(request.ifRange, etag) == 0)) {
+        range = parseRange(request.range, total, start, end);
+    }
+
+    if (range == RangeResult::UNSATISFIABLE) {
+        client.println(F("HTTP/1.1 416 Range Not Satisfiable"));
+        client.print(F("Content-Range: bytes */"));
+        client.println(total);
+        client.println(F("Connection: close"));
+        client.println();
+        return;
+    }
+
+    const bool gpx = format == Format::GPX;
+    client.println(range == RangeResult::PARTIAL ? F("HTTP/1.1 206 Partial Content") : F("HTTP/1.1 200 OK"));
+    client.print(F("Content-Type: "));
+    client.println(gpx ? F("application/gpx+xml") : F("application/geo+json"));
+    client.print(F("Content-Disposition: attachment; filename=\"track."));
+    client.print(gpx ? F("gpx") : F("geojson"));
+    client.println(F("\""));
+    client.println(F("Accept-Ranges: bytes"));
+    client.print(F("ETag: "));
+    client.println(etag);
+    if (range == RangeResult::PARTIAL) {
+        client.print(F("Content-Range: bytes "));
+        client.print(start);
+        client.print('-');
+        client.print(end - 1);
+        client.print('/');
+        client.println(total);
+    }
+    client.print(F("Content-Length: "));
+    client.println(end - start);
+    client.println(F("Connection: close"));
+    client.println();
+
+    if (strcmp(request.method, "HEAD") == 0) return;
+
+    ArenaScope scope(Memory::web);
+    uint8_t* chunk = (uint8_t*)Memory::web.allocate(TRACK_EXPORT_CHUNK_SIZE, 1);
+    if (!chunk) return;
+
+    size_t offset = start;
+    while (offset < end && client.connected()) {
+        const size_t n = doc.read(offset, chunk, min((size_t)TRACK_EXPORT_CHUNK_SIZE, end - offset));
+        if (n == 0 || client.write(chunk, n) != n) break;
+        offset += n;
+        yield();
+    }
+}
+
+/**
+ * Serve a track whose length is not known up front, rendered as it is
+ * read: no Content-Length and no Range, the body ends with the
+ * connection
+ * @param query void(emit), calls bool emit(const TrackPoint&) per point
+ *              in time order and stops once it returns false
+ */
+template <typename Query>
+inline void serveStream(Client& client, const HttpRequest& request, Format format,
+                        const char* deviceId, Query&& query) {
+    const bool gpx = format == Format::GPX;
+    client.println(F("HTTP/1.1 200 OK"));
+    client.print(F("Content-Type: "));
+    client.println(gpx ? F("application/gpx+xml") : F("application/geo+json"));
+    client.print(F("Content-Disposition: attachment; filename=\"archive."));
+    client.print(gpx ? F("gpx") : F("geojson"));
+    client.println(F("\""));
+    client.println(F("Connection: close"));
+    client.println();
+
+    if (strcmp(request.method, "HEAD") == 0) return;
+
+    BufferedPrint out(client, Memory::web, HTTP_BUFFER_SIZE);
+    char record[RECORD_MAX];
+    out.write((const uint8_t*)record, renderHeader(format, deviceId, record, sizeof(record)));
+    bool first = true;
+    query([&](const TrackPoint& p) {
+        const size_t len = min(renderPoint(format, p, first, record, sizeof(record) - 1), sizeof(record) - 1);
+        record[len] = '\n';
+        out.write((const uint8_t*)record, len + 1);
+        first = false;
+        esp_task_wdt_reset();   // A long range runs inside one event
+        return client.connected() != 0;
+    });
+    out.print(footer(format));
+}
+
+} // namespace TrackExport
+
+#endif // TRACK_EXPORT_H
@@ -0,0 +1,172 @@
+#ifndef TRACK_STORE_H
+#define TRACK_STORE_H
+
+/**
+ * @file track_store.h
+ * @brief Fixed-capacity in-RAM history of GPS fixes
+ *
+ * Fixes are stored as compact fixed-point records in a ring buffer.
+ * Records are kept in time order so range lookups are a binary search.
+ * Each record has the free heap at the time beside it, for the trend
+ * charts (not part of TrackPoint, so exports and the archive skip it).
+ *
+ * Indices shift by one whenever a full store takes a fix. Readers that
+ * span many calls (a streamed export) use the append sequence instead:
+ * a record keeps its sequence number until it is overwritten.
+ */
+
+#include <Arduino.h>
+#include "../config.h"
+#include "rtos.h"
+#include "gps_module.h"
+
+/**
+ * Compact fix record (20 bytes)
+ */
+struct TrackPoint {
+    uint32_t time;          // Unix epoch seconds
+    int32_t lat;            // Degrees * 1e7
+    int32_t lng;            // Degrees * 1e7
+    uint16_t speed;         // km/h * 100
+    int16_t altitude;       // Meters
+    uint16_t course;        // Degrees * 100
+    uint8_t satellites;
+    uint8_t flags;
+
+    static TrackPoint fromGPSData(const GPSData& data) {
+        TrackPoint p;
+        p.time = data.epoch;
+        p.lat = (int32_t)lround(data.latitude * 1e7);
+        p.lng = (int32_t)lround(data.longitude * 1e7);
+        p.speed = (uint16_t)constrain(lround(data.speed * 100.0), 0L, 65535L);
+        p.altitude = (int16_t)constrain(lround(data.altitude), -32768L, 32767L);
+        p.course = (uint16_t)constrain(lround(data.course * 100.0), 0L, 35999L);
+        p.satellites = data.satellites;
+        p.flags = 0;
+        return p;
+    }
+
+    double latitude() const { return lat / 1e7; }
+    double longitude() const { return lng / 1e7; }
+    double speedKmh() const { return speed / 100.0; }
+    double courseDeg() const { return course / 100.0; }
+};
+
+/**
+ * Ring buffer of TrackPoints, oldest first
+ */
+class TrackStore {
+public:
+    static constexpr size_t Capacity = TRACK_STORE_CAPACITY;
+
+    /**
+     * Append a fix. Fixes without time or older than the newest stored
+     * fix are rejected so the buffer stays sorted.
+     * @param heapKb Free heap when the fix was stored
+     * @return true if stored
+     */
+    bool append(const TrackPoint& point, uint16_t heapKb = 0) {
+        if (point.time == 0) return false;
+        Rtos::LockGuard guard(_mutex);
+        if (_count > 0 && point.time <= get(_count - 1).time) return false;
+
+        _points[(_head + _count) % Capacity] = point;
+        _heapKb[(_head + _count) % Capacity] = heapKb;
+        if (_count < Capacity) {
+            _count++;
+        } else {
+            _head = (_head + 1) % Capacity;
+        }
+        _appended++;
+        return true;
+    }
+
+    size_t size() const {
+        Rtos::LockGuard guard(_mutex);
+        return _count;
+    }
+
+    /**
+     * Get record by index (0 = oldest), copied under the lock
+     */
+    TrackPoint at(size_t index) const {
+        Rtos::LockGuard guard(_mutex);
+        return get(index);
+    }
+
+    /**
+     * Record and the free heap stored with it, copied under the lock
+     */
+    TrackPoint at(size_t index, uint16_t& heapKb) const {
+        Rtos::LockGuard guard(_mutex);
+        heapKb = _heapKb[(_head + index) % Capacity];
+        return get(index);
+    }
+
+    /**
+     * Index of first record with time >= t (size() if none)
+     */
+    size_t lowerBound(uint32_t t) const {
+        Rtos::LockGuard guard(_mutex);
+        return search(t, false);
+    }
+
+    /**
+     * Index of first record with time > t (size() if none)
+     */
+    size_t upperBound(uint32_t t) const {
+        Rtos::LockGuard guard(_mutex);
+        return search(t, true);
+    }
+
+    /**
+     * Records with from <= time <= to, by append sequence
+     * @param firstSeq Sequence of the first one
+     * @return number of records
+     */
+    size_t findSequences(uint32_t from, uint32_t to, uint32_t& firstSeq) const {
+        Rtos::LockGuard guard(_mutex);
+        const size_t first = search(from, false);
+        const size_t last = search(to, true);
+        firstSeq = _appended - _count + first;
+        return last > first ? last - first : 0;
+    }
+
+    /**
+     * Record by append sequence, copied under the lock
+     * @return false if not appended yet or already overwritten
+     */
+    bool atSequence(uint32_t seq, TrackPoint& point) const {
+        Rtos::LockGuard guard(_mutex);
+        const uint32_t index = seq - (_appended - _count);  // Wraps past _count when overwritten
+        if (index >= _count) return false;
+        point = get(index);
+        return true;
+    }
+
+private:
+    TrackPoint _points[Capacity];
+    uint16_t _heapKb[Capacity];
+    size_t _head = 0;
+    size_t _count = 0;
+    uint32_t _appended = 0;      // Fixes ever stored, the next sequence
+    mutable Rtos::Mutex _mutex;  // Uploader appends while the web task exports
+
+    const TrackPoint& get(size_t index) const {
+        return _points[(_head + index) % Capacity];
+    }
+
+    // First index with time >= t, or > t when after; caller holds the lock
+    size_t search(uint32_t t, bool after) const {
+        size_t lo = 0, hi = _count;
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            const uint32_t time = get(mid).time;
+            if (time < t || (after && time == t)) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+};
+
+#endif // TRACK_STORE_H
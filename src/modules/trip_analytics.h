@@ -0,0 +1,503 @@
+#ifndef TRIP_ANALYTICS_H
+#define TRIP_ANALYTICS_H
+
+/**
+ * @file trip_analytics.h
+ * @brief Odometer, stop/move detection and per-trip statistics
+ *
+ * Fed every fix by the GPS task, constant work per fix. Step distances
+ * are haversine in fixed point (TripMath): the ESP32 has no double FPU,
+ * and float cannot resolve a metre at this scale. The odometer adds
+ * integer millimetres, so it does not drift over a long voyage.
+ *
+ * Stop/move detection uses the receiver's speed with hysteresis
+ * (TRIP_STOP_KMH / TRIP_MOVE_KMH) and a confirmation time; once a change
+ * is confirmed it dates back to its first fix, and distance sailed while
+ * a stop was pending is dropped as GPS jitter. A trip starts with the
+ * first confirmed move and ends once a stop lasts TRIP_END_STOP_S.
+ * Steps implying more than TRIP_MAX_SPEED_KMH are outliers and skipped.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "../config.h"
+
+#ifndef TRIP_STOP_KMH
+#define TRIP_STOP_KMH           1.0
+#endif
+#ifndef TRIP_STOP_CONFIRM_S
+#define TRIP_STOP_CONFIRM_S     120
+#endif
+#ifndef TRIP_MOVE_KMH
+#define TRIP_MOVE_KMH           3.0
+#endif
+#ifndef TRIP_MOVE_CONFIRM_S
+#define TRIP_MOVE_CONFIRM_S     10
+#endif
+#ifndef TRIP_END_STOP_S
+#define TRIP_END_STOP_S         900
+#endif
+#ifndef TRIP_MAX_SPEED_KMH
+#define TRIP_MAX_SPEED_KMH      150
+#endif
+#ifndef TRIP_MAX_REJECTS
+#define TRIP_MAX_REJECTS        5       // Consecutive outliers: restart from the new position
+#endif
+#ifndef TRIP_ODOMETER_SAVE_M
+#define TRIP_ODOMETER_SAVE_M    1000
+#endif
+#ifndef TRIP_EVENT_QUEUE
+#define TRIP_EVENT_QUEUE        4
+#endif
+
+namespace TripMath {
+
+/**
+ * Integer square root, rounded to nearest
+ */
+inline uint32_t isqrt64(uint64_t v) {
+    if (v == 0) return 0;
+    uint64_t result = 0;
+    uint64_t bit = 1ULL << ((63 - __builtin_clzll(v)) & ~1);
+    while (bit) {
+        if (v >= result + bit) {
+            v -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)(v > result ? result + 1 : result);
+}
+
+/**
+ * (a * b) >> shift without a 128-bit product; needs shift >= 16 and
+ * bits(a) + bits(b) <= 80
+ */
+inline uint64_t mulShift(uint64_t a, uint64_t b, unsigned shift) {
+    return ((a * (b >> 16)) >> (shift - 16)) + ((a * (b & 0xFFFF)) >> shift);
+}
+
+// 1e-7 degree in radians, Q56
+static constexpr uint64_t RAD_PER_E7_Q56 = 125764227ULL;
+// Earth diameter (mean radius 6371008.8 m) in millimetres
+static constexpr uint64_t EARTH_DIAMETER_MM = 12742017600ULL;
+// Steps beyond this (per axis) are not measured
+static constexpr int64_t MAX_STEP_E7 = 10000000;
+
+/**
+ * x^3 / 6 for an angle in Q44 (x < 2^39)
+ */
+inline uint64_t cubeSixthQ44(uint64_t x) {
+    return mulShift(x, mulShift(x, x, 44), 44) / 6;
+}
+
+/**
+ * Cosine of a latitude, Q30 (Taylor series to x^12, error < 1e-8)
+ */
+inline uint32_t cosLatQ30(int64_t latE7) {
+    static constexpr int64_t ONE = 1LL << 30;
+    const int64_t x = (int64_t)(((uint64_t)(latE7 < 0 ? -latE7 : latE7) * RAD_PER_E7_Q56) >> 26);
+    const int64_t x2 = (x * x) >> 30;
+    int64_t t = ONE;
+    for (int64_t k : {132, 90, 56, 30, 12, 2}) t = ONE - ((x2 * t) >> 30) / k;
+    return t > 0 ? (uint32_t)t : 0;
+}
+
+/**
+ * Great-circle distance between two E7 positions in millimetres
+ * (haversine, 64-bit integer math)
+ * @return UINT32_MAX if the points are more than a degree apart on
+ *         either axis
+ */
+inline uint32_t distanceMm(int32_t lat1E7, int32_t lon1E7, int32_t lat2E7, int32_t lon2E7) {
+    int64_t dLat = (int64_t)lat2E7 - lat1E7;
+    int64_t dLon = (int64_t)lon2E7 - lon1E7;
+    if (dLon > 1800000000LL) dLon -= 3600000000LL;
+    if (dLon < -1800000000LL) dLon += 3600000000LL;
+    if (dLat < 0) dLat = -dLat;
+    if (dLon < 0) dLon = -dLon;
+    if (dLat > MAX_STEP_E7 || dLon > MAX_STEP_E7) return UINT32_MAX;
+
+    // Half angles, Q44, and their sines
+    const uint64_t hLat = ((uint64_t)dLat * RAD_PER_E7_Q56 + (1ULL << 12)) >> 13;
+    const uint64_t hLon = ((uint64_t)dLon * RAD_PER_E7_Q56 + (1ULL << 12)) >> 13;
+    const uint64_t sLat = hLat - cubeSixthQ44(hLat);
+    const uint64_t sLon = hLon - cubeSixthQ44(hLon);
+
+    // cos(lat1) cos(lat2) = cos^2(mean lat) - sin^2(dLat / 2), Q30
+    const uint64_t cosMean = cosLatQ30(((int64_t)lat1E7 + lat2E7) / 2);
+    const uint64_t cos2 = (cosMean * cosMean) >> 30;
+    const uint64_t sLat2 = mulShift(sLat, sLat, 58);
+    const uint64_t k = isqrt64((cos2 > sLat2 ? cos2 - sLat2 : 0) << 30);
+
+    // sqrt(haversine) = hypot(sLat, k * sLon), scaled into 31 bits
+    const uint64_t y = mulShift(sLon, k, 30);
+    const uint64_t larger = sLat > y ? sLat : y;
+    unsigned shift = 0;
+    while ((larger >> shift) >= (1ULL << 31)) shift++;
+    const uint64_t a = sLat >> shift, b = y >> shift;
+    const uint64_t root = (uint64_t)isqrt64(a * a + b * b) << shift;
+
+    // d = 2R asin(root), asin x = x + x^3/6 + O(x^5); rounded to the mm
+    return (uint32_t)((mulShift(root + cubeSixthQ44(root), EARTH_DIAMETER_MM, 40) + 8) >> 4);
+}
+
+} // namespace TripMath
+
+enum class Motion : uint8_t {
+    STOPPED = 0,
+    MOVING
+};
+
+inline const char* motionName(Motion motion) {
+    return motion == Motion::MOVING ? "moving" : "stopped";
+}
+
+/**
+ * One fix as the analytics see it
+ */
+struct TripSample {
+    int32_t latE7;
+    int32_t lonE7;
+    uint32_t speedCms;      // Speed over ground from the receiver
+    uint32_t timeMs;        // Monotonic fix time
+    uint32_t epoch;         // Unix time, 0 = unknown
+};
+
+/**
+ * Trip so far, or a finished one
+ */
+struct TripSummary {
+    uint32_t id;            // 0 = no trip yet
+    uint32_t startEpoch;    // 0 = unknown
+    uint32_t endEpoch;      // 0 = in progress (or unknown)
+    uint32_t distanceM;
+    uint32_t movingS;
+    uint32_t stoppedS;      // Stops within the trip, not the one ending it
+    uint32_t stops;
+    uint32_t maxSpeedCms;
+    uint32_t avgSpeedCms;   // Distance over moving time
+    uint32_t speedSdCms;    // Standard deviation of the moving speed samples
+};
+
+/**
+ * Motion state and trip (published by the GPS task)
+ */
+struct TripStatus {
+    Motion motion;
+    bool inTrip;            // trip is the current one, else the last one
+    uint32_t dwellS;        // In the current motion state
+    uint32_t odometerM;
+    uint32_t trips;         // Started so far, kept with the odometer
+    TripSummary trip;
+};
+
+/**
+ * Trip start or end
+ */
+struct TripEvent {
+    bool ended;
+    TripSummary trip;
+};
+
+class TripAnalytics {
+public:
+    /**
+     * Continue the odometer and trip numbering (before the first fix)
+     */
+    void restore(uint32_t odometerM, uint32_t tripCount) {
+        _odometerMm = (uint64_t)odometerM * 1000;
+        _tripCount = tripCount;
+    }
+
+    uint32_t odometerM() const { return (uint32_t)(_odometerMm / 1000); }
+    uint32_t tripCount() const { return _tripCount; }
+    uint32_t rejected() const { return _rejected; }
+
+    /**
+     * Process one fix
+     * @param event Receives a trip start or end
+     * @return true if event was written
+     */
+    bool update(const TripSample& s, TripEvent& event) {
+        if (!_hasFix) {
+            _hasFix = true;
+            _stateMs = s.timeMs;
+            _stateEpoch = s.epoch;
+            accept(s);
+            return false;
+        }
+        const uint32_t dt = s.timeMs - _lastMs;
+        if (dt == 0) return false;
+
+        uint32_t step = TripMath::distanceMm(_latE7, _lonE7, s.latE7, s.lonE7);
+        // mm/ms * 3.6 = km/h
+        if (step == UINT32_MAX || (uint64_t)step * 36 > (uint64_t)TRIP_MAX_SPEED_KMH * 10 * dt) {
+            _rejected++;
+            if (++_rejectRun < TRIP_MAX_REJECTS) return false;
+            step = 0;   // The outlier was the last accepted fix
+        }
+        accept(s);
+
+        if (_motion == Motion::MOVING) return moving(s, step, event);
+        return stopped(s, step, event);
+    }
+
+    /**
+     * Live values as of the last fix
+     */
+    TripStatus status() const {
+        TripStatus st;
+        st.motion = _motion;
+        st.inTrip = _inTrip;
+        st.dwellS = _hasFix ? (_lastMs - _stateMs) / 1000 : 0;
+        st.odometerM = odometerM();
+        st.trips = _tripCount;
+        if (!_inTrip) {
+            st.trip = _last;
+            return st;
+        }
+
+        uint64_t movingMs = _movingMs;
+        uint64_t stoppedMs = _stoppedMs;
+        if (_motion == Motion::MOVING) {
+            movingMs += (_pending ? _pendingMs : _lastMs) - _stateMs;
+        } else {
+            stoppedMs += _lastMs - _stateMs;
+        }
+        st.trip = summary(movingMs, stoppedMs, _stops + (_motion == Motion::STOPPED), 0);
+        return st;
+    }
+
+private:
+    static constexpr uint32_t STOP_CMS = (uint32_t)(TRIP_STOP_KMH * 1000 / 36 + 0.5);
+    static constexpr uint32_t MOVE_CMS = (uint32_t)(TRIP_MOVE_KMH * 1000 / 36 + 0.5);
+
+    /**
+     * Running count, sum and sum of squares (exact, integer)
+     */
+    struct SpeedStats {
+        uint32_t count = 0;
+        uint32_t max = 0;
+        uint64_t sum = 0;
+        uint64_t sumSquares = 0;
+
+        void add(uint32_t v) {
+            count++;
+            sum += v;
+            sumSquares += (uint64_t)v * v;
+            if (v > max) max = v;
+        }
+        void merge(const SpeedStats& o) {
+            count += o.count;
+            sum += o.sum;
+            sumSquares += o.sumSquares;
+            if (o.max > max) max = o.max;
+        }
+        uint32_t sd() const {
+            if (count < 2) return 0;
+            const uint64_t mean = sum / count;
+            const uint64_t meanSquares = sumSquares / count;
+            return meanSquares > mean * mean ? TripMath::isqrt64(meanSquares - mean * mean) : 0;
+        }
+    };
+
+    // Last accepted fix
+    bool _hasFix = false;
+    int32_t _latE7 = 0;
+    int32_t _lonE7 = 0;
+    uint32_t _lastMs = 0;
+    uint8_t _rejectRun = 0;
+    uint32_t _rejected = 0;
+
+    // Confirmed state since
+    Motion _motion = Motion::STOPPED;
+    uint32_t _stateMs = 0;
+    uint32_t _stateEpoch = 0;
+
+    // Change waiting for confirmation
+    bool _pending = false;
+    uint32_t _pendingMs = 0;
+    uint32_t _pendingEpoch = 0;
+    uint64_t _pendingMm = 0;
+    SpeedStats _pendingSpeed;
+
+    // Current trip
+    bool _inTrip = false;
+    uint32_t _startEpoch = 0;
+    uint32_t _stops = 0;
+    uint64_t _tripMm = 0;
+    uint64_t _movingMs = 0;
+    uint64_t _stoppedMs = 0;
+    SpeedStats _speed;
+
+    TripSummary _last{};
+    uint64_t _odometerMm = 0;
+    uint32_t _tripCount = 0;
+
+    void accept(const TripSample& s) {
+        _latE7 = s.latE7;
+        _lonE7 = s.lonE7;
+        _lastMs = s.timeMs;
+        _rejectRun = 0;
+    }
+
+    void beginPending(const TripSample& s) {
+        _pending = true;
+        _pendingMs = s.timeMs;
+        _pendingEpoch = s.epoch;
+        _pendingMm = 0;
+        _pendingSpeed = SpeedStats();
+    }
+
+    void addDistance(uint64_t mm) {
+        _tripMm += mm;
+        _odometerMm += mm;
+    }
+
+    bool moving(const TripSample& s, uint32_t step, TripEvent&) {
+        if (s.speedCms >= STOP_CMS) {
+            if (_pending) {
+                // Slow, not stopped: the pending part was real
+                addDistance(_pendingMm);
+                _speed.merge(_pendingSpeed);
+                _pending = false;
+            }
+            addDistance(step);
+            _speed.add(s.speedCms);
+            return false;
+        }
+
+        if (!_pending) beginPending(s);
+        _pendingMm += step;
+        _pendingSpeed.add(s.speedCms);
+        if (s.timeMs - _pendingMs < TRIP_STOP_CONFIRM_S * 1000UL) return false;
+
+        // Stopped since the pending started; its distance was jitter
+        _movingMs += _pendingMs - _stateMs;
+        enter(Motion::STOPPED, _pendingMs, _pendingEpoch);
+        return false;
+    }
+
+    bool stopped(const TripSample& s, uint32_t step, TripEvent& event) {
+        if (s.speedCms < MOVE_CMS) {
+            _pending = false;
+            if (!_inTrip || s.timeMs - _stateMs < TRIP_END_STOP_S * 1000UL) return false;
+
+            // The stop that ends the trip is not part of it
+            _last = summary(_movingMs, _stoppedMs, _stops, _stateEpoch);
+            _inTrip = false;
+            event = TripEvent{true, _last};
+            return true;
+        }
+
+        if (!_pending) beginPending(s);
+        _pendingMm += step;
+        _pendingSpeed.add(s.speedCms);
+        if (s.timeMs - _pendingMs < TRIP_MOVE_CONFIRM_S * 1000UL) return false;
+
+        const bool started = !_inTrip;
+        if (started) {
+            _inTrip = true;
+            _startEpoch = _pendingEpoch;
+            _stops = 0;
+            _tripMm = 0;
+            _movingMs = 0;
+            _stoppedMs = 0;
+            _speed = SpeedStats();
+            _tripCount++;
+        } else {
+            _stoppedMs += _pendingMs - _stateMs;
+            _stops++;
+        }
+        addDistance(_pendingMm);
+        _speed.merge(_pendingSpeed);
+        enter(Motion::MOVING, _pendingMs, _pendingEpoch);
+        if (started) event = TripEvent{false, summary(_movingMs, _stoppedMs, 0, 0)};
+        return started;
+    }
+
+    void enter(Motion motion, uint32_t sinceMs, uint32_t sinceEpoch) {
+        _motion = motion;
+        _stateMs = sinceMs;
+        _stateEpoch = sinceEpoch;
+        _pending = false;
+    }
+
+    TripSummary summary(uint64_t movingMs, uint64_t stoppedMs, uint32_t stops, uint32_t endEpoch) const {
+        TripSummary t;
+        t.id = _tripCount;
+        t.startEpoch = _startEpoch;
+        t.endEpoch = endEpoch;
+        t.distanceM = (uint32_t)(_tripMm / 1000);
+        t.movingS = (uint32_t)(movingMs / 1000);
+        t.stoppedS = (uint32_t)(stoppedMs / 1000);
+        t.stops = stops;
+        t.maxSpeedCms = _speed.max;
+        // mm/ms = m/s
+        t.avgSpeedCms = movingMs ? (uint32_t)(_tripMm * 100 / movingMs) : 0;
+        t.speedSdCms = _speed.sd();
+        return t;
+    }
+};
+
+/**
+ * Odometer and trip count in NVS, written every TRIP_ODOMETER_SAVE_M
+ */
+class OdometerStore {
+public:
+    /**
+     * Load the saved values (setup(), before the GPS task starts)
+     * @return true if found
+     */
+    bool begin() {
+        Preferences prefs;
+        if (!prefs.begin(NVS_NAMESPACE, true)) return false;
+        Record r;
+        const bool found = prefs.getBytes(NVS_KEY, &r, sizeof(r)) == sizeof(r) && r.version == Record::VERSION;
+        prefs.end();
+        if (found) _saved = r;
+        return found;
+    }
+
+    uint32_t odometerM() const { return _saved.odometerM; }
+    uint32_t tripCount() const { return _saved.tripCount; }
+
+    /**
+     * Persist if the odometer advanced TRIP_ODOMETER_SAVE_M or a trip
+     * started (upload task)
+     * @param force Write whatever changed
+     * @return true if written
+     */
+    bool save(uint32_t odometerM, uint32_t tripCount, bool force = false) {
+        if (odometerM == _saved.odometerM && tripCount == _saved.tripCount) return false;
+        if (!force && tripCount == _saved.tripCount && odometerM - _saved.odometerM < TRIP_ODOMETER_SAVE_M) {
+            return false;
+        }
+
+        Record r{Record::VERSION, odometerM, tripCount};
+        Preferences prefs;
+        if (!prefs.begin(NVS_NAMESPACE)) return false;
+        const bool ok = prefs.putBytes(NVS_KEY, &r, sizeof(r)) == sizeof(r);
+        prefs.end();
+        if (ok) _saved = r;
+        return ok;
+    }
+
+private:
+    static constexpr const char* NVS_NAMESPACE = "trip";
+    static constexpr const char* NVS_KEY = "odo";
+
+    struct Record {
+        static constexpr uint32_t VERSION = 1;
+        uint32_t version;
+        uint32_t odometerM;
+        uint32_t tripCount;
+    };
+
+    Record _saved{Record::VERSION, 0, 0};
+};
+
+#endif // TRIP_ANALYTICS_H
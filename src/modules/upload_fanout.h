@@ -0,0 +1,332 @@
+#ifndef UPLOAD_FANOUT_H
+#define UPLOAD_FANOUT_H
+
+/**
+ * @file upload_fanout.h
+ * @brief Reports to more destinations at once (e.g. a regulator's endpoint
+ *        besides SERVER_HOST), each with its own format, interval and retries
+ *
+ * UPLOAD_DESTINATIONS lists the destinations besides SERVER_HOST. In each
+ * report cycle submit() hands every destination that is due (its interval
+ * has passed, or the report carries an event) the report in its format,
+ * and sends each destination's oldest waiting report on its own socket
+ * before the primary upload starts; finish() collects the answers after
+ * it, taking each status line as its bytes arrive so a slow destination
+ * holds up no other. The servers work on their requests at the same
+ * time, so a slow endpoint costs the cycle only what it takes beyond the
+ * primary exchange instead of a second blocking upload. Connects and TLS handshakes still
+ * run one after the other (Client::connect blocks).
+ *
+ * Each fix is serialized once per format: FULL is the primary's payload
+ * (copied, not built again), POSITION (HttpUpload::buildPositionPayload)
+ * is built if any destination takes it. The bytes sit in a reference-
+ * counted slot shared by the destinations until the last one delivered
+ * or dropped them.
+ *
+ * A destination that fails keeps its reports (the oldest is dropped
+ * beyond UPLOAD_FANOUT_BACKLOG) and is tried again after a backoff that
+ * doubles from UPLOAD_FANOUT_RETRY_MS to UPLOAD_FANOUT_RETRY_MAX_MS. Once
+ * it answers, waiting reports go out oldest first, up to
+ * 1 + UPLOAD_RETRANSMIT_MAX per cycle. Any 2xx delivers: these
+ * destinations have no acknowledgement watermark, and "seq_base" in FULL
+ * reports is the primary outbox's.
+ *
+ * Uploader task only.
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+#include <esp_task_wdt.h>
+#include "../config.h"
+#include "arena.h"
+#include "http_upload.h"
+#include "logger.h"
+#include "metrics.h"
+#include "report_outbox.h"
+
+#ifndef UPLOAD_FANOUT_BACKLOG
+#define UPLOAD_FANOUT_BACKLOG       4
+#endif
+#ifndef UPLOAD_FANOUT_RETRY_MS
+#define UPLOAD_FANOUT_RETRY_MS      10000
+#endif
+#ifndef UPLOAD_FANOUT_RETRY_MAX_MS
+#define UPLOAD_FANOUT_RETRY_MAX_MS  300000
+#endif
+
+enum class ReportFormat : uint8_t {
+    FULL = 0,       // The primary's JSON (buildJsonPayload)
+    POSITION,       // Fix and event only (buildPositionPayload)
+    COUNT
+};
+
+inline constexpr const char* REPORT_FORMAT_NAMES[] = {"full", "position"};
+
+struct UploadDestination {
+    const char* name;       // Log and metric label
+    const char* host;
+    const char* path;
+    uint16_t port;
+    const char* pin;        // TLS key pin (base64 SHA-256), "" = refused unless TLS_ALLOW_UNPINNED
+    ReportFormat format;
+    uint32_t intervalMs;    // Least time between reports taken, 0 = every one
+};
+
+#ifndef UPLOAD_DESTINATIONS
+#error "UPLOAD_FANOUT_ENABLE needs UPLOAD_DESTINATIONS in config.h"
+#endif
+
+static const UploadDestination DESTINATIONS[] = UPLOAD_DESTINATIONS;
+static constexpr size_t DESTINATION_COUNT = sizeof(DESTINATIONS) / sizeof(DESTINATIONS[0]);
+
+static_assert(DESTINATION_COUNT <= UPLOAD_FANOUT_MAX, "More UPLOAD_DESTINATIONS than UPLOAD_FANOUT_MAX");
+static_assert(UPLOAD_FANOUT_BACKLOG >= 1, "UPLOAD_FANOUT_BACKLOG must be at least 1");
+#if UPLOAD_FANOUT_ENABLE && W5500_DRIVER_ENABLE && (LINK_DUAL_ENABLE || !WIFI_ENABLE)
+static_assert(W5500_FANOUT_SOCKETS >= DESTINATION_COUNT,
+              "Every UPLOAD_DESTINATIONS entry needs a W5500_FANOUT_SOCKETS socket");
+#endif
+
+/**
+ * @tparam Network NetworkModule, WiFiNetworkModule or DualNetworkModule
+ *                 (Channel, open())
+ */
+template <typename Network>
+class UploadFanout {
+public:
+    static constexpr size_t Count = DESTINATION_COUNT;
+    static constexpr size_t Backlog = UPLOAD_FANOUT_BACKLOG;
+
+    explicit UploadFanout(Network& network) : _network(network) {}
+
+    /**
+     * Name the metric series and log the destinations (setup())
+     */
+    void begin() {
+        Metrics::DestinationMetrics* metrics = Metrics::registry.destinations;
+        metrics[0].name = "primary";
+        for (size_t i = 0; i < Count; i++) {
+            const UploadDestination& d = DESTINATIONS[i];
+            metrics[1 + i].name = d.name;
+            LOG(FANOUT_DESTINATION, d.name, d.host, d.port, d.path,
+                REPORT_FORMAT_NAMES[(size_t)d.format], d.intervalMs / 1000);
+        }
+    }
+
+    /**
+     * Queue the report for the destinations that are due and start a
+     * request on every destination with reports waiting
+     * @param full The report as serialized for the primary server
+     * @param event The report carries an event: every destination takes it
+     * @param buildPosition Called as (buffer, size) to serialize POSITION
+     */
+    template <typename BuildPosition>
+    void submit(const char* full, bool event, BuildPosition&& buildPosition) {
+        TRACE_SPAN("fanoutSubmit");
+        const uint32_t now = millis();
+        int built[(size_t)ReportFormat::COUNT];
+        for (int& slot : built) slot = -1;
+
+        for (size_t i = 0; i < Count; i++) {
+            Lane& lane = _lanes[i];
+            const UploadDestination& d = DESTINATIONS[i];
+            if (lane.taken && !event && now - lane.takenMs < d.intervalMs) continue;
+
+            int& slot = built[(size_t)d.format];
+            if (slot < 0) {
+                slot = acquire();
+                if (slot < 0) {
+                    LOG(FANOUT_NO_SLOT, d.name);
+                    continue;
+                }
+                char* bytes = _slots[slot].bytes;
+                if (d.format == ReportFormat::FULL) {
+                    const size_t length = min(strlen(full), (size_t)JSON_BUFFER_SIZE - 1);
+                    memcpy(bytes, full, length);
+                    bytes[length] = '\0';
+                } else {
+                    buildPosition(bytes, (size_t)JSON_BUFFER_SIZE);
+                }
+            }
+            lane.taken = true;
+            lane.takenMs = now;
+            push(i, (uint8_t)slot);
+        }
+        for (int slot : built) {
+            if (slot >= 0) release((uint8_t)slot);
+        }
+
+        _cycleStartMs = now;
+        for (size_t i = 0; i < Count; i++) {
+            Lane& lane = _lanes[i];
+            lane.requests = 0;
+            if (lane.count > 0 && (lane.backoffMs == 0 || now - lane.failedMs >= lane.backoffMs)) start(i);
+        }
+    }
+
+    /**
+     * Collect the answers (after the primary exchange); a destination that
+     * answered sends its next waiting report straight away. Returns once
+     * no request is open.
+     */
+    void finish() {
+        TRACE_SPAN("fanoutFinish");
+        for (;;) {
+            bool open = false;
+            for (size_t i = 0; i < Count; i++) {
+                if (!_lanes[i].inFlight) continue;
+                poll(i);
+                open |= _lanes[i].inFlight;
+            }
+            if (!open) return;
+            esp_task_wdt_reset();
+            delay(1);
+        }
+    }
+
+    /**
+     * The primary exchange, in the same per-destination series (its
+     * backlog is the outbox, set by ReportOutbox)
+     */
+    void recordPrimary(const HttpResponse& response, uint32_t elapsedUs) {
+        Metrics::DestinationMetrics& metrics = Metrics::registry.destinations[0];
+        if (response.statusCode != 0) metrics.latency.observe(elapsedUs);
+        (response.success ? metrics.delivered : metrics.failed).inc();
+    }
+
+private:
+    static constexpr uint32_t RESPONSE_TIMEOUT_MS = 5000;   // As HttpUpload::postPayload
+    static constexpr uint8_t MAX_REQUESTS = 1 + UPLOAD_RETRANSMIT_MAX;     // Per destination and cycle
+
+    // Every backlog full, plus one new report per format
+    static constexpr size_t SlotCount = Count * Backlog + (size_t)ReportFormat::COUNT;
+    static_assert(SlotCount <= UINT8_MAX, "UPLOAD_FANOUT_BACKLOG too large");
+
+    struct Slot {
+        uint8_t refs;
+        char bytes[JSON_BUFFER_SIZE];
+    };
+
+    struct Lane {
+        typename Network::Channel channel;
+        uint8_t queue[Backlog];     // Slots, oldest first
+        uint8_t head = 0;
+        uint8_t count = 0;
+        uint8_t requests = 0;       // Started this cycle
+        bool inFlight = false;
+        bool taken = false;         // A report was taken (takenMs valid)
+        uint32_t takenMs = 0;
+        uint32_t startMs = 0;
+        uint32_t startUs = 0;
+        uint32_t failedMs = 0;
+        uint32_t backoffMs = 0;     // 0 = last request delivered
+        uint8_t statusLen = 0;
+        char status[16];            // Status line so far, "HTTP/1.1 200 OK"
+    };
+
+    Network& _network;
+    Slot _slots[SlotCount] = {};
+    Lane _lanes[Count];
+    uint32_t _cycleStartMs = 0;
+
+    static Metrics::DestinationMetrics& metrics(size_t i) { return Metrics::registry.destinations[1 + i]; }
+
+    int acquire() {
+        for (size_t s = 0; s < SlotCount; s++) {
+            if (_slots[s].refs == 0) {
+                _slots[s].refs = 1;
+                return (int)s;
+            }
+        }
+        return -1;
+    }
+
+    void release(uint8_t slot) { _slots[slot].refs--; }
+
+    void push(size_t i, uint8_t slot) {
+        Lane& lane = _lanes[i];
+        if (lane.count == Backlog) {
+            release(lane.queue[lane.head]);
+            lane.head = (lane.head + 1) % Backlog;
+            lane.count--;
+            metrics(i).dropped.inc();
+            LOG(FANOUT_DROPPED, DESTINATIONS[i].name);
+        }
+        lane.queue[(lane.head + lane.count++) % Backlog] = slot;
+        _slots[slot].refs++;
+        metrics(i).backlog.set(lane.count);
+    }
+
+    // Connect and send the oldest waiting report
+    void start(size_t i) {
+        Lane& lane = _lanes[i];
+        const UploadDestination& d = DESTINATIONS[i];
+        lane.requests++;
+        lane.statusLen = 0;
+        lane.startMs = millis();
+        lane.startUs = micros();
+        Client& client = lane.channel.client();
+        if (_network.open(lane.channel, d.host, d.port, d.pin) &&
+            HttpUpload::sendHttpPost(client, d.host, d.path, _slots[lane.queue[lane.head]].bytes)) {
+            lane.inFlight = true;
+            return;
+        }
+        client.stop();
+        complete(i, HttpResponse{0, false});
+    }
+
+    // Takes what has arrived of the status line without waiting; only
+    // the code counts (no watermark here), the rest goes with the socket
+    void poll(size_t i) {
+        Lane& lane = _lanes[i];
+        Client& client = lane.channel.client();
+        uint8_t& len = lane.statusLen;
+        while (len < sizeof(lane.status) - 1 && (len == 0 || lane.status[len - 1] != '\n') &&
+               client.available() > 0) {
+            lane.status[len++] = (char)client.read();
+        }
+        lane.status[len] = '\0';
+        const bool whole = len == sizeof(lane.status) - 1 || (len > 0 && lane.status[len - 1] == '\n');
+        if (!whole && client.connected() && millis() - lane.startMs < RESPONSE_TIMEOUT_MS) return;
+
+        HttpResponse response = {0, false};
+        const char* code = strchr(lane.status, ' ');
+        if (whole && code) {
+            response.statusCode = atoi(code + 1);
+            response.success = response.statusCode >= 200 && response.statusCode < 300;
+        }
+        client.stop();
+        lane.inFlight = false;
+        complete(i, response);
+
+        // It works: more of its backlog, within this cycle's budget
+        if (response.success && lane.count > 0 && lane.requests < MAX_REQUESTS &&
+            millis() - _cycleStartMs < RESPONSE_TIMEOUT_MS) {
+            start(i);
+        }
+    }
+
+    void complete(size_t i, const HttpResponse& response) {
+        Lane& lane = _lanes[i];
+        Metrics::DestinationMetrics& m = metrics(i);
+        const uint32_t elapsedUs = micros() - lane.startUs;
+        if (response.statusCode != 0) m.latency.observe(elapsedUs);
+
+        if (response.success) {
+            release(lane.queue[lane.head]);
+            lane.head = (lane.head + 1) % Backlog;
+            lane.count--;
+            lane.backoffMs = 0;
+            m.delivered.inc();
+            LOG(FANOUT_DELIVERED, DESTINATIONS[i].name, response.statusCode, elapsedUs / 1000, (unsigned)lane.count);
+        } else {
+            lane.backoffMs = lane.backoffMs ? min<uint32_t>(lane.backoffMs * 2, UPLOAD_FANOUT_RETRY_MAX_MS)
+                                            : UPLOAD_FANOUT_RETRY_MS;
+            lane.failedMs = millis();
+            m.failed.inc();
+            LOG(FANOUT_FAILED, DESTINATIONS[i].name, response.statusCode, lane.backoffMs / 1000, (unsigned)lane.count);
+        }
+        m.backlog.set(lane.count);
+    }
+};
+
+#endif // UPLOAD_FANOUT_H
@@ -0,0 +1,735 @@
+#ifndef W5500_H
+#define W5500_H
+
+/**
+ * @file w5500.h
+ * @brief W5500 register access and socket core over the ESP-IDF SPI master
+ *
+ * Takes the place of the Arduino Ethernet library's register layer; the
+ * Client/Server, DHCP and DNS on top are in w5500_ethernet.h.
+ *
+ * - Every access is one SPI frame: address, control byte, burst data.
+ *   Frames up to 4 bytes carry their data inline, longer ones go through
+ *   a DMA bounce buffer, and bursts above W5500_SPIN_MAX bytes wait on
+ *   the SPI interrupt instead of spinning. The bus is acquired once, so
+ *   no frame pays for bus setup.
+ * - Socket buffers are sized per user (W5500_*_KB): large windows for
+ *   the uploader and the web server, none for unused sockets.
+ * - The driver keeps each socket's buffer pointers and reads the whole
+ *   socket register block (status, free space, pointers) in one frame.
+ *   RECV is only issued once half the receive buffer was read, and
+ *   single-byte reads come from a small per-socket cache.
+ * - With W5500_INT_PIN, INTn marks the sockets that had events and the
+ *   others are not read at all; without it a socket is read again at
+ *   most every W5500_POLL_US.
+ *
+ * On the host the SPI driver shim hands the frames to a register-level
+ * simulator (lib/arduino_native/src/w5500_sim.cpp).
+ *
+ * All socket calls expect EthernetBus::mutex to be held.
+ */
+
+#include <Arduino.h>
+#include <atomic>
+#include <driver/spi_master.h>
+#include "../config.h"
+#include "metrics.h"
+
+#if defined(ARDUINO_NATIVE)
+#include <w5500_sim.h>
+#endif
+
+#ifndef W5500_INT_PIN
+#define W5500_INT_PIN       -1
+#endif
+#ifndef W5500_SPI_HZ
+#define W5500_SPI_HZ        20000000
+#endif
+#ifndef W5500_SPI_HOST
+#define W5500_SPI_HOST      SPI3_HOST   // VSPI
+#endif
+#ifndef W5500_SCK_PIN
+#define W5500_SCK_PIN       18
+#endif
+#ifndef W5500_MISO_PIN
+#define W5500_MISO_PIN      19
+#endif
+#ifndef W5500_MOSI_PIN
+#define W5500_MOSI_PIN      23
+#endif
+#ifndef W5500_DMA_CHUNK
+#define W5500_DMA_CHUNK     1024    // Longest frame; longer bursts are split
+#endif
+#ifndef W5500_SPIN_MAX
+#define W5500_SPIN_MAX      64      // Longer frames wait on the SPI interrupt
+#endif
+#ifndef W5500_RX_CACHE
+#define W5500_RX_CACHE      64
+#endif
+#ifndef W5500_POLL_US
+#define W5500_POLL_US       1000
+#endif
+#ifndef W5500_CONNECT_TIMEOUT_MS
+#define W5500_CONNECT_TIMEOUT_MS 1000
+#endif
+#ifndef W5500_CLOSE_TIMEOUT_MS
+#define W5500_CLOSE_TIMEOUT_MS   1000
+#endif
+
+// Socket buffers in KB (0, 1, 2, 4, 8 or 16); each direction has 16 KB
+#ifndef W5500_UPLOAD_TX_KB
+#define W5500_UPLOAD_TX_KB  2
+#endif
+#ifndef W5500_UPLOAD_RX_KB
+#define W5500_UPLOAD_RX_KB  4
+#endif
+#ifndef W5500_FANOUT_SOCKETS
+#define W5500_FANOUT_SOCKETS 0      // Extra report destinations (upload_fanout.h)
+#endif
+#ifndef W5500_FANOUT_TX_KB
+#define W5500_FANOUT_TX_KB  1
+#endif
+#ifndef W5500_FANOUT_RX_KB
+#define W5500_FANOUT_RX_KB  1
+#endif
+#ifndef W5500_WEB_SOCKETS
+#if WEBSERVER_ENABLE
+#define W5500_WEB_SOCKETS   2
+#else
+#define W5500_WEB_SOCKETS   0
+#endif
+#endif
+#ifndef W5500_WEB_TX_KB
+#define W5500_WEB_TX_KB     4
+#endif
+#ifndef W5500_WEB_RX_KB
+#define W5500_WEB_RX_KB     2
+#endif
+#ifndef W5500_STREAM_SOCKETS
+#if WEBSERVER_ENABLE && GPSD_ENABLE
+#define W5500_STREAM_SOCKETS (GPSD_MAX_CLIENTS + (GPSD_NMEA_PORT ? 2 : 1))    // Clients and listeners
+#else
+#define W5500_STREAM_SOCKETS 0
+#endif
+#endif
+#ifndef W5500_STREAM_TX_KB
+#define W5500_STREAM_TX_KB  1
+#endif
+#ifndef W5500_STREAM_RX_KB
+#define W5500_STREAM_RX_KB  1
+#endif
+
+/**
+ * Who may take a socket; sockets are laid out in this order, with one
+ * upload and one UDP (DHCP, DNS) socket
+ */
+enum class W5500Pool : uint8_t { NONE, UPLOAD, FANOUT, WEB, STREAM, UDP };
+
+struct W5500Plan {
+    W5500Pool pool;
+    uint8_t txKB;
+    uint8_t rxKB;
+};
+
+// Socket s falls in the next pool of count sockets, else s moves past it
+// (count as a parameter: a pool of 0 is no always-false comparison)
+constexpr bool w5500InPool(uint8_t& s, uint8_t count) {
+    if (s < count) return true;
+    s -= count;
+    return false;
+}
+
+constexpr W5500Plan w5500Plan(uint8_t s) {
+    if (w5500InPool(s, 1)) return {W5500Pool::UPLOAD, W5500_UPLOAD_TX_KB, W5500_UPLOAD_RX_KB};
+    if (w5500InPool(s, W5500_FANOUT_SOCKETS)) return {W5500Pool::FANOUT, W5500_FANOUT_TX_KB, W5500_FANOUT_RX_KB};
+    if (w5500InPool(s, W5500_WEB_SOCKETS)) return {W5500Pool::WEB, W5500_WEB_TX_KB, W5500_WEB_RX_KB};
+    if (w5500InPool(s, W5500_STREAM_SOCKETS)) return {W5500Pool::STREAM, W5500_STREAM_TX_KB, W5500_STREAM_RX_KB};
+    if (w5500InPool(s, 1)) return {W5500Pool::UDP, 1, 1};
+    return {W5500Pool::NONE, 0, 0};
+}
+
+constexpr bool w5500PlanValid() {
+    unsigned tx = 0, rx = 0;
+    for (uint8_t s = 0; s < 8; s++) {
+        const W5500Plan p = w5500Plan(s);
+        for (uint8_t kb : {p.txKB, p.rxKB}) {
+            if (kb != 0 && kb != 1 && kb != 2 && kb != 4 && kb != 8 && kb != 16) return false;
+        }
+        tx += p.txKB;
+        rx += p.rxKB;
+    }
+    return tx <= 16 && rx <= 16;
+}
+
+static_assert(2 + W5500_FANOUT_SOCKETS + W5500_WEB_SOCKETS + W5500_STREAM_SOCKETS <= 8,
+              "W5500 has 8 sockets: lower W5500_FANOUT_SOCKETS, W5500_WEB_SOCKETS or GPSD_MAX_CLIENTS");
+static_assert(w5500PlanValid(), "W5500 socket buffers must be 0/1/2/4/8/16 KB and total 16 KB per direction");
+static_assert(W5500_DMA_CHUNK % 4 == 0, "W5500_DMA_CHUNK must be a multiple of 4");
+
+class W5500Class {
+public:
+    static constexpr uint8_t SOCKETS = 8;
+
+    // Common registers
+    static constexpr uint16_t MR = 0x0000;
+    static constexpr uint16_t GAR = 0x0001;     // Gateway, subnet, MAC and IP follow
+    static constexpr uint16_t SIR = 0x0017;
+    static constexpr uint16_t SIMR = 0x0018;
+    static constexpr uint16_t PHYCFGR = 0x002E;
+    static constexpr uint16_t VERSIONR = 0x0039;
+    static constexpr uint8_t MR_RST = 0x80;
+    static constexpr uint8_t PHY_LINK = 0x01;
+    static constexpr uint8_t VERSION = 0x04;
+
+    // Socket registers
+    static constexpr uint16_t Sn_MR = 0x00;
+    static constexpr uint16_t Sn_CR = 0x01;
+    static constexpr uint16_t Sn_IR = 0x02;
+    static constexpr uint16_t Sn_SR = 0x03;
+    static constexpr uint16_t Sn_PORT = 0x04;   // Destination MAC, IP and port follow
+    static constexpr uint16_t Sn_DIPR = 0x0C;
+    static constexpr uint16_t Sn_RXBUF_SIZE = 0x1E;
+    static constexpr uint16_t Sn_TX_FSR = 0x20;
+    static constexpr uint16_t Sn_TX_RD = 0x22;
+    static constexpr uint16_t Sn_TX_WR = 0x24;
+    static constexpr uint16_t Sn_RX_RSR = 0x26;
+    static constexpr uint16_t Sn_RX_RD = 0x28;
+    static constexpr uint16_t Sn_IMR = 0x2C;
+
+    static constexpr uint8_t MR_TCP = 0x21;     // With no delayed ACK
+    static constexpr uint8_t MR_UDP = 0x02;
+
+    static constexpr uint8_t CR_OPEN = 0x01;
+    static constexpr uint8_t CR_LISTEN = 0x02;
+    static constexpr uint8_t CR_CONNECT = 0x04;
+    static constexpr uint8_t CR_DISCON = 0x08;
+    static constexpr uint8_t CR_CLOSE = 0x10;
+    static constexpr uint8_t CR_SEND = 0x20;
+    static constexpr uint8_t CR_RECV = 0x40;
+
+    static constexpr uint8_t IR_EVENTS = 0x0F;  // CON | DISCON | RECV | TIMEOUT
+
+    static constexpr uint8_t SR_CLOSED = 0x00;
+    static constexpr uint8_t SR_INIT = 0x13;
+    static constexpr uint8_t SR_LISTEN = 0x14;
+    static constexpr uint8_t SR_ESTABLISHED = 0x17;
+    static constexpr uint8_t SR_FIN_WAIT = 0x18;
+    static constexpr uint8_t SR_CLOSE_WAIT = 0x1C;
+    static constexpr uint8_t SR_UDP = 0x22;
+
+    static constexpr uint8_t COMMON = 0;
+    static constexpr uint8_t regs(uint8_t s) { return (uint8_t)(s * 4 + 1); }
+    static constexpr uint8_t txBuffer(uint8_t s) { return (uint8_t)(s * 4 + 2); }
+    static constexpr uint8_t rxBuffer(uint8_t s) { return (uint8_t)(s * 4 + 3); }
+
+    /**
+     * SPI bus (first call), soft reset, MAC, socket buffers and event masks
+     * @return false if no W5500 answers
+     */
+    bool begin(const uint8_t mac[6]) {
+        if (!_spi && !beginBus()) return false;
+
+        write8(COMMON, MR, MR_RST);
+        const uint32_t start = millis();
+        while (read8(COMMON, MR) & MR_RST) {
+            if (millis() - start > 100) return false;
+            delay(1);
+        }
+        if (read8(COMMON, VERSIONR) != VERSION) return false;
+
+        for (uint8_t s = 0; s < SOCKETS; s++) {
+            const W5500Plan plan = w5500Plan(s);
+            const uint8_t sizes[2] = {plan.rxKB, plan.txKB};
+            write(regs(s), Sn_RXBUF_SIZE, sizes, sizeof(sizes));
+            write8(regs(s), Sn_IMR, IR_EVENTS);
+            _sockets[s] = Socket{};
+            _sockets[s].gen = ++_gen;
+        }
+        setAddress(mac, IPAddress(), IPAddress(), IPAddress());
+
+        #if W5500_INT_PIN >= 0
+        write8(COMMON, SIMR, 0xFF);
+        if (!_interruptLine) {
+            #if defined(ARDUINO_NATIVE)
+            nativeW5500OnInterrupt(onInterrupt);
+            #else
+            pinMode(W5500_INT_PIN, INPUT_PULLUP);
+            ::attachInterrupt(digitalPinToInterrupt(W5500_INT_PIN), onInterrupt, FALLING);
+            #endif
+            _interruptLine = true;
+        }
+        _irqCount.fetch_add(1);  // Events before the reset gave no edge
+        #endif
+        return true;
+    }
+
+    /**
+     * Gateway, subnet, MAC and address in one frame
+     */
+    void setAddress(const uint8_t mac[6], const IPAddress& ip, const IPAddress& subnet, const IPAddress& gateway) {
+        uint8_t block[18];
+        for (int i = 0; i < 4; i++) {
+            block[i] = gateway[i];
+            block[4 + i] = subnet[i];
+            block[14 + i] = ip[i];
+        }
+        memcpy(block + 8, mac, 6);
+        write(COMMON, GAR, block, sizeof(block));
+    }
+
+    bool linkUp() { return read8(COMMON, PHYCFGR) & PHY_LINK; }
+
+    /**
+     * Also call isr on socket events (from the interrupt)
+     * @return false without W5500_INT_PIN
+     */
+    bool attachInterrupt(void (*isr)()) {
+        _isr = isr;
+        return W5500_INT_PIN >= 0;
+    }
+
+    /**
+     * Acknowledge socket events after an INTn edge and mark their sockets
+     * for a read, until the line is released
+     */
+    void serviceInterrupts() {
+        if (!_interruptLine) return;
+        const uint32_t count = _irqCount.load();
+        if (count == _irqSeen) return;
+        _irqSeen = count;
+        for (int pass = 0; pass < 4; pass++) {
+            const uint8_t sir = read8(COMMON, SIR);
+            if (!sir) return;
+            Metrics::registry.w5500Interrupts.inc();
+            for (uint8_t s = 0; s < SOCKETS; s++) {
+                if (!(sir & (1u << s))) continue;
+                write8(regs(s), Sn_IR, 0xFF);
+                _sockets[s].dirty = true;
+            }
+        }
+        _irqSeen = count - 1;   // Still held low: service again on the next call
+    }
+
+    // ========================================
+    // Sockets
+    // ========================================
+
+    /**
+     * Free socket of pool (reclaims closed ones). Like the Ethernet
+     * library, aborts a socket still closing when nothing else is free.
+     * @return index, or -1 if all are in use
+     */
+    int allocate(W5500Pool pool) {
+        int closing = -1;
+        for (uint8_t s = 0; s < SOCKETS; s++) {
+            if (w5500Plan(s).pool != pool) continue;
+            if (_sockets[s].use == Use::CLOSING) reclaim(s);
+            if (_sockets[s].use == Use::FREE) return claim(s);
+            if (_sockets[s].use == Use::CLOSING && closing < 0) closing = s;
+        }
+        if (closing < 0) return -1;
+        close(closing);
+        return claim(closing);
+    }
+
+    /**
+     * Open s (allocated) as TCP or UDP
+     * @param destination Set for CONNECT and UDP sends
+     * @return false if the chip did not take it
+     */
+    bool open(uint8_t s, uint8_t mode, uint16_t port, const IPAddress& destination = IPAddress(),
+              uint16_t destinationPort = 0) {
+        // Port, destination MAC (unused), address and port in one frame
+        uint8_t block[14] = {(uint8_t)(port >> 8), (uint8_t)port};
+        for (int i = 0; i < 4; i++) block[8 + i] = destination[i];
+        block[12] = (uint8_t)(destinationPort >> 8);
+        block[13] = (uint8_t)destinationPort;
+        write(regs(s), Sn_PORT, block, sizeof(block));
+
+        // Mode, OPEN and clearing old events in one frame
+        waitCommand(s);
+        const uint8_t open[3] = {mode, CR_OPEN, 0xFF};
+        write(regs(s), Sn_MR, open, sizeof(open));
+        Socket& k = _sockets[s];
+        k.commandPending = true;
+        refresh(s);
+        k.txWr = k.chipTxWr;
+        k.rxRd = k.rxCommitted = k.chipRxRd;
+        k.rxAvail = 0;
+        return k.status == (mode == MR_UDP ? SR_UDP : SR_INIT);
+    }
+
+    void setDestination(uint8_t s, const IPAddress& ip, uint16_t port) {
+        const uint8_t block[6] = {ip[0], ip[1], ip[2], ip[3], (uint8_t)(port >> 8), (uint8_t)port};
+        write(regs(s), Sn_DIPR, block, sizeof(block));
+    }
+
+    /**
+     * Issue a command (LISTEN, CONNECT, ...); the socket is read again next
+     */
+    void command(uint8_t s, uint8_t command) {
+        waitCommand(s);
+        write8(regs(s), Sn_CR, command);
+        _sockets[s].commandPending = true;
+        _sockets[s].dirty = true;
+    }
+
+    /**
+     * Read status, free space and pointers in one frame
+     */
+    void refresh(uint8_t s) {
+        uint8_t b[Sn_RX_RD + 2 - Sn_CR];
+        read(regs(s), Sn_CR, b, sizeof(b));
+        Socket& k = _sockets[s];
+        const W5500Plan plan = w5500Plan(s);
+        const uint16_t txSize = plan.txKB * 1024, rxSize = plan.rxKB * 1024;
+        auto at = [&](uint16_t reg) { return (uint16_t)((b[reg - Sn_CR] << 8) | b[reg - Sn_CR + 1]); };
+
+        k.commandPending = b[0] != 0;
+        k.status = b[Sn_SR - Sn_CR];
+        k.chipTxWr = at(Sn_TX_WR);
+        k.chipRxRd = at(Sn_RX_RD);
+        // The pointers only move forward between our own updates, so a
+        // read torn between the two bytes is low; out of range means torn
+        if (k.sending && at(Sn_TX_RD) == k.txWr) k.sending = false;
+        if (!k.sending) {
+            const uint16_t free = at(Sn_TX_FSR);
+            k.txFree = free <= txSize ? free : 0;
+        }
+        const uint16_t received = at(Sn_RX_RSR);
+        const uint16_t consumed = k.rxRd - k.rxCommitted;
+        k.rxAvail = (received >= consumed && received <= rxSize) ? received - consumed : 0;
+        k.polledUs = micros();
+        k.dirty = false;
+    }
+
+    /**
+     * True if the socket may have changed since its last read
+     */
+    bool stale(uint8_t s) {
+        serviceInterrupts();
+        const Socket& k = _sockets[s];
+        if (k.dirty) return true;
+        return !_interruptLine && micros() - k.polledUs >= W5500_POLL_US;
+    }
+
+    uint8_t status(uint8_t s) {
+        if (stale(s)) refresh(s);
+        return _sockets[s].status;
+    }
+
+    /**
+     * Bytes ready to read (cache and chip); reads the chip only when
+     * nothing is known and the socket may have changed
+     */
+    size_t readable(uint8_t s) {
+        Socket& k = _sockets[s];
+        if (k.cachePos == k.cacheLen && k.rxAvail == 0 && stale(s)) refresh(s);
+        return (size_t)(k.cacheLen - k.cachePos) + k.rxAvail;
+    }
+
+    /**
+     * Up to len received bytes: cache first, then one burst from the chip
+     */
+    size_t recv(uint8_t s, uint8_t* out, size_t len) {
+        Socket& k = _sockets[s];
+        size_t n = min(len, (size_t)(k.cacheLen - k.cachePos));
+        memcpy(out, k.cache + k.cachePos, n);
+        k.cachePos += n;
+        const size_t direct = min(len - n, (size_t)k.rxAvail);
+        if (direct) {
+            take(s, out + n, direct);
+            n += direct;
+        }
+        return n;
+    }
+
+    /**
+     * Next byte without consuming it; -1 if none
+     */
+    int peek(uint8_t s) {
+        Socket& k = _sockets[s];
+        if (k.cachePos == k.cacheLen) {
+            if (readable(s) == 0) return -1;
+            const size_t n = min((size_t)W5500_RX_CACHE, (size_t)k.rxAvail);
+            take(s, k.cache, n);
+            k.cacheLen = (uint8_t)n;
+            k.cachePos = 0;
+        }
+        return k.cache[k.cachePos];
+    }
+
+    /**
+     * One received byte through the cache; -1 if none
+     */
+    int recvByte(uint8_t s) {
+        const int c = peek(s);
+        if (c >= 0) _sockets[s].cachePos++;
+        return c;
+    }
+
+    /**
+     * Drop len received bytes (rest of a UDP datagram)
+     */
+    void skip(uint8_t s, size_t len) {
+        Socket& k = _sockets[s];
+        const size_t cached = min(len, (size_t)(k.cacheLen - k.cachePos));
+        k.cachePos += cached;
+        len = min(len - cached, (size_t)k.rxAvail);
+        k.rxRd += len;
+        k.rxAvail -= len;
+        commitIfHalf(s);
+    }
+
+    /**
+     * TX space for the next write; 0 while the last send is going out
+     */
+    size_t writable(uint8_t s) {
+        Socket& k = _sockets[s];
+        if (k.sending) refresh(s);
+        return k.sending ? 0 : k.txFree;
+    }
+
+    /**
+     * Copy up to writable() bytes to the TX buffer and send them
+     * @return bytes taken, 0 if no room yet
+     */
+    size_t send(uint8_t s, const uint8_t* data, size_t len) {
+        Socket& k = _sockets[s];
+        if (k.sending || k.txFree < len) refresh(s);
+        if (k.sending) return 0;
+        const size_t n = min(len, (size_t)k.txFree);
+        if (n == 0) return 0;
+        write(txBuffer(s), k.txWr, data, n);    // The chip wraps inside the buffer
+        k.txWr += n;
+        k.txFree -= n;
+        write16(regs(s), Sn_TX_WR, k.txWr);
+        command(s, CR_SEND);
+        k.sending = true;
+        return n;
+    }
+
+    /**
+     * Wait for the last send to leave
+     * @return false on timeout or if the connection went away
+     */
+    bool drain(uint8_t s, uint32_t timeoutMs) {
+        const uint32_t start = millis();
+        while (_sockets[s].sending) {
+            refresh(s);
+            const uint8_t st = _sockets[s].status;
+            if (st != SR_ESTABLISHED && st != SR_CLOSE_WAIT && st != SR_UDP) return false;
+            if (millis() - start > timeoutMs) return false;
+            if (_sockets[s].sending) yield();
+        }
+        return true;
+    }
+
+    /**
+     * Graceful close: FIN after the data, reclaimed once the chip closed
+     * it (or W5500_CLOSE_TIMEOUT_MS later) instead of waiting here
+     */
+    void disconnect(uint8_t s) {
+        Socket& k = _sockets[s];
+        const uint8_t st = status(s);
+        if (st == SR_ESTABLISHED || st == SR_CLOSE_WAIT) {
+            drain(s, W5500_CLOSE_TIMEOUT_MS);
+            command(s, CR_DISCON);
+            k.use = Use::CLOSING;
+            k.closeMs = millis();
+        } else {
+            close(s);
+        }
+    }
+
+    void close(uint8_t s) {
+        command(s, CR_CLOSE);
+        const uint8_t gen = _sockets[s].gen;
+        _sockets[s] = Socket{};
+        _sockets[s].gen = gen;
+    }
+
+    // Bookkeeping for clients and servers
+    uint8_t generation(uint8_t s) const { return _sockets[s].gen; }
+    bool current(uint8_t s, uint8_t gen) const { return _sockets[s].gen == gen && _sockets[s].use == Use::OPEN; }
+    uint16_t listenPort(uint8_t s) const { return _sockets[s].use == Use::OPEN ? _sockets[s].port : 0; }
+    void setListenPort(uint8_t s, uint16_t port) { _sockets[s].port = port; }
+    bool accepted(uint8_t s) const { return _sockets[s].accepted; }
+    void setAccepted(uint8_t s) { _sockets[s].accepted = true; }
+
+    // ========================================
+    // Frames
+    // ========================================
+
+    uint8_t read8(uint8_t block, uint16_t address) {
+        uint8_t value;
+        read(block, address, &value, 1);
+        return value;
+    }
+
+    void write8(uint8_t block, uint16_t address, uint8_t value) { write(block, address, &value, 1); }
+
+    void write16(uint8_t block, uint16_t address, uint16_t value) {
+        const uint8_t bytes[2] = {(uint8_t)(value >> 8), (uint8_t)value};
+        write(block, address, bytes, 2);
+    }
+
+    void read(uint8_t block, uint16_t address, uint8_t* out, size_t len) {
+        transfer((uint8_t)(block << 3), address, nullptr, out, len);
+    }
+
+    void write(uint8_t block, uint16_t address, const uint8_t* data, size_t len) {
+        transfer((uint8_t)(block << 3 | 0x04), address, data, nullptr, len);
+    }
+
+private:
+    enum class Use : uint8_t { FREE, OPEN, CLOSING };
+
+    struct Socket {
+        uint16_t txWr = 0;          // Our Sn_TX_WR
+        uint16_t txFree = 0;        // Known free TX space, a lower bound
+        uint16_t rxRd = 0;          // Next byte to read from the chip
+        uint16_t rxCommitted = 0;   // Sn_RX_RD as last given with RECV
+        uint16_t rxAvail = 0;       // Unread bytes in the chip, a lower bound
+        uint16_t chipTxWr = 0;      // As read after OPEN
+        uint16_t chipRxRd = 0;
+        uint16_t port = 0;          // Listening port (server sockets)
+        uint32_t polledUs = 0;
+        uint32_t closeMs = 0;
+        Use use = Use::FREE;
+        uint8_t gen = 0;            // Tells clients of a reused socket apart
+        uint8_t status = SR_CLOSED;
+        bool sending = false;       // SEND issued, Sn_TX_RD not there yet
+        bool commandPending = false;    // Sn_CR may not be back to 0
+        bool dirty = true;
+        bool accepted = false;
+        uint8_t cacheLen = 0;
+        uint8_t cachePos = 0;
+        uint8_t cache[W5500_RX_CACHE];
+    };
+
+    spi_device_handle_t _spi = nullptr;
+    alignas(4) uint8_t _dma[W5500_DMA_CHUNK];
+    Socket _sockets[SOCKETS];
+    uint8_t _gen = 0;
+    bool _interruptLine = false;
+    uint32_t _irqSeen = 0;
+
+    static inline std::atomic<uint32_t> _irqCount{0};
+    static inline void (*_isr)() = nullptr;
+
+    static void IRAM_ATTR onInterrupt() {
+        _irqCount.fetch_add(1, std::memory_order_relaxed);
+        if (_isr) _isr();
+    }
+
+    bool beginBus() {
+        spi_bus_config_t bus = {};
+        bus.mosi_io_num = W5500_MOSI_PIN;
+        bus.miso_io_num = W5500_MISO_PIN;
+        bus.sclk_io_num = W5500_SCK_PIN;
+        bus.quadwp_io_num = -1;
+        bus.quadhd_io_num = -1;
+        bus.max_transfer_sz = W5500_DMA_CHUNK;
+        if (spi_bus_initialize(W5500_SPI_HOST, &bus, SPI_DMA_CH_AUTO) != ESP_OK) return false;
+
+        // Frame header as the command (address) and address (control) phases
+        spi_device_interface_config_t device = {};
+        device.command_bits = 16;
+        device.address_bits = 8;
+        device.mode = 0;
+        device.clock_speed_hz = W5500_SPI_HZ;
+        device.spics_io_num = W5500_CS_PIN;
+        device.queue_size = 1;
+        if (spi_bus_add_device(W5500_SPI_HOST, &device, &_spi) != ESP_OK) return false;
+        // Sole user of the bus: no arbitration per frame
+        return spi_device_acquire_bus(_spi, portMAX_DELAY) == ESP_OK;
+    }
+
+    void transfer(uint8_t control, uint16_t address, const uint8_t* tx, uint8_t* rx, size_t len) {
+        while (len) {
+            const size_t n = min(len, (size_t)W5500_DMA_CHUNK);
+            frame(control, address, tx, rx, n);
+            address += n;
+            if (tx) tx += n;
+            if (rx) rx += n;
+            len -= n;
+        }
+    }
+
+    void frame(uint8_t control, uint16_t address, const uint8_t* tx, uint8_t* rx, size_t len) {
+        spi_transaction_t t = {};
+        t.cmd = address;
+        t.addr = control;
+        t.length = len * 8;
+        if (len <= 4) {
+            if (tx) {
+                t.flags = SPI_TRANS_USE_TXDATA;
+                memcpy(t.tx_data, tx, len);
+            } else {
+                t.flags = SPI_TRANS_USE_RXDATA;
+                t.rxlength = len * 8;
+            }
+        } else if (tx) {
+            memcpy(_dma, tx, len);
+            t.tx_buffer = _dma;
+        } else {
+            t.rx_buffer = _dma;
+            t.rxlength = len * 8;
+        }
+        if (len > W5500_SPIN_MAX) spi_device_transmit(_spi, &t);
+        else spi_device_polling_transmit(_spi, &t);
+        if (rx) memcpy(rx, len <= 4 ? t.rx_data : _dma, len);
+        Metrics::registry.w5500Frames.inc();
+        Metrics::registry.w5500Bytes.inc(3 + len);
+    }
+
+    void waitCommand(uint8_t s) {
+        Socket& k = _sockets[s];
+        for (int i = 0; k.commandPending && i < 100; i++) {
+            k.commandPending = read8(regs(s), Sn_CR) != 0;
+        }
+        k.commandPending = false;
+    }
+
+    // Take len bytes from the chip at the read pointer
+    void take(uint8_t s, uint8_t* out, size_t len) {
+        Socket& k = _sockets[s];
+        read(rxBuffer(s), k.rxRd, out, len);
+        k.rxRd += len;
+        k.rxAvail -= len;
+        commitIfHalf(s);
+    }
+
+    // RECV frees buffer space: worth two frames once half the buffer is read
+    void commitIfHalf(uint8_t s) {
+        Socket& k = _sockets[s];
+        if ((uint16_t)(k.rxRd - k.rxCommitted) < w5500Plan(s).rxKB * 512) return;
+        write16(regs(s), Sn_RX_RD, k.rxRd);
+        command(s, CR_RECV);
+        k.rxCommitted = k.rxRd;
+    }
+
+    int claim(uint8_t s) {
+        Socket& k = _sockets[s];
+        const uint8_t gen = ++_gen;
+        k = Socket{};
+        k.gen = gen;
+        k.use = Use::OPEN;
+        return s;
+    }
+
+    void reclaim(uint8_t s) {
+        Socket& k = _sockets[s];
+        refresh(s);     // A closing socket raises no event we wait for
+        if (k.status == SR_CLOSED) {
+            k.use = Use::FREE;
+        } else if (millis() - k.closeMs > W5500_CLOSE_TIMEOUT_MS) {
+            close(s);
+        }
+    }
+};
+
+inline W5500Class W5500;
+
+#endif // W5500_H
@@ -0,0 +1,559 @@
+#ifndef W5500_ETHERNET_H
+#define W5500_ETHERNET_H
+
+/**
+ * @file w5500_ethernet.h
+ * @brief Arduino Ethernet API (Client, Server, DHCP, DNS) on the W5500 driver
+ *
+ * Drop-in for the parts of the Ethernet library the firmware uses;
+ * ethernet_bus.h maps EthernetClient, EthernetServer and DNSClient
+ * onto these with W5500_DRIVER_ENABLE. Outgoing connections take the
+ * upload socket, servers take sockets from their pool (W5500Pool), and
+ * DHCP and DNS share the UDP socket. Callers hold EthernetBus::mutex.
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+#include <Server.h>
+#include "w5500.h"
+
+/**
+ * TCP connection on one W5500 socket; copies share the socket, and a
+ * client whose socket was closed and reused stays closed
+ */
+class W5500Client : public Client {
+public:
+    W5500Client() {}
+    /**
+     * Outgoing connections on sockets from pool (default the uploader's)
+     */
+    explicit W5500Client(W5500Pool pool) : _pool(pool) {}
+    explicit W5500Client(uint8_t socket) : _socket((int8_t)socket), _gen(W5500.generation(socket)) {}
+
+    int connect(IPAddress ip, uint16_t port) override {
+        stop();
+        if (ip == IPAddress(0, 0, 0, 0) || ip == IPAddress(255, 255, 255, 255) || port == 0) return 0;
+        const int s = W5500.allocate(_pool);
+        if (s < 0) return 0;
+        if (!W5500.open(s, W5500Class::MR_TCP, nextPort(), ip, port)) {
+            W5500.close(s);
+            return 0;
+        }
+        W5500.command(s, W5500Class::CR_CONNECT);
+
+        const uint32_t start = millis();
+        for (;;) {
+            const uint8_t status = W5500.status(s);
+            if (status == W5500Class::SR_ESTABLISHED || status == W5500Class::SR_CLOSE_WAIT) {
+                _socket = (int8_t)s;
+                _gen = W5500.generation(s);
+                return 1;
+            }
+            if (status == W5500Class::SR_CLOSED || millis() - start > _timeoutMs) break;
+            delay(1);
+        }
+        W5500.close(s);
+        return 0;
+    }
+
+    int connect(const char* host, uint16_t port) override;
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!valid()) return 0;
+        size_t sent = 0;
+        while (sent < size) {
+            const size_t n = W5500.send(_socket, buf + sent, size - sent);
+            if (n) {
+                sent += n;
+                continue;
+            }
+            const uint8_t status = W5500.status(_socket);
+            if (status != W5500Class::SR_ESTABLISHED && status != W5500Class::SR_CLOSE_WAIT) break;
+            yield();
+        }
+        return sent;
+    }
+
+    using Print::write;
+
+    int available() override { return valid() ? (int)W5500.readable(_socket) : 0; }
+    int availableForWrite() override { return valid() ? (int)W5500.writable(_socket) : 0; }
+    int read() override { return valid() ? W5500.recvByte(_socket) : -1; }
+
+    int read(uint8_t* buf, size_t size) override {
+        if (!valid() || W5500.readable(_socket) == 0) return -1;
+        return (int)W5500.recv(_socket, buf, size);
+    }
+
+    int peek() override { return valid() ? W5500.peek(_socket) : -1; }
+
+    /**
+     * Wait until the written data left the chip
+     */
+    void flush() override {
+        if (valid()) W5500.drain(_socket, _timeoutMs);
+    }
+
+    void stop() override {
+        if (valid()) W5500.disconnect(_socket);
+        _socket = -1;
+    }
+
+    uint8_t connected() override {
+        if (!valid()) return 0;
+        const uint8_t status = W5500.status(_socket);
+        if (status == W5500Class::SR_LISTEN || status == W5500Class::SR_CLOSED ||
+            status == W5500Class::SR_FIN_WAIT) {
+            return 0;
+        }
+        if (status == W5500Class::SR_CLOSE_WAIT) return W5500.readable(_socket) > 0;
+        return 1;
+    }
+
+    operator bool() override { return valid(); }
+
+    void setConnectionTimeout(uint32_t timeoutMs) { _timeoutMs = timeoutMs; }
+
+private:
+    int8_t _socket = -1;
+    uint8_t _gen = 0;
+    W5500Pool _pool = W5500Pool::UPLOAD;
+    uint32_t _timeoutMs = W5500_CONNECT_TIMEOUT_MS;
+
+    static inline uint16_t _port = 0;
+
+    bool valid() const { return _socket >= 0 && W5500.current(_socket, _gen); }
+
+    // Ephemeral ports from a random start, so a reboot does not reuse them
+    static uint16_t nextPort() {
+        if (_port < 49152) _port = 49152 + random(0, 16000);
+        return _port++;
+    }
+};
+
+/**
+ * Listening port on sockets from a pool: one socket listens, accepted
+ * connections keep theirs
+ */
+class W5500Server : public Server {
+public:
+    explicit W5500Server(uint16_t port, W5500Pool pool = W5500Pool::WEB) : _port(port), _pool(pool) {}
+
+    void begin(uint16_t port = 0) override {
+        if (port) _port = port;
+        listen();
+    }
+
+    /**
+     * New connection (once per connection)
+     */
+    W5500Client accept() {
+        listen();
+        for (uint8_t s = 0; s < W5500Class::SOCKETS; s++) {
+            if (!mine(s) || W5500.accepted(s)) continue;
+            const uint8_t status = W5500.status(s);
+            if (status == W5500Class::SR_ESTABLISHED || status == W5500Class::SR_CLOSE_WAIT) {
+                W5500.setAccepted(s);
+                return W5500Client(s);
+            }
+        }
+        return W5500Client();
+    }
+
+    /**
+     * Connection with data to read; peers that closed without sending
+     * anything are dropped
+     */
+    W5500Client available() {
+        listen();
+        for (uint8_t s = 0; s < W5500Class::SOCKETS; s++) {
+            if (!mine(s)) continue;
+            const uint8_t status = W5500.status(s);
+            if (status != W5500Class::SR_ESTABLISHED && status != W5500Class::SR_CLOSE_WAIT) continue;
+            if (W5500.readable(s)) {
+                W5500.setAccepted(s);
+                return W5500Client(s);
+            }
+            if (status == W5500Class::SR_CLOSE_WAIT) W5500.disconnect(s);
+        }
+        return W5500Client();
+    }
+
+    size_t write(uint8_t) override { return 0; }
+    using Print::write;
+
+private:
+    uint16_t _port;
+    W5500Pool _pool;
+
+    bool mine(uint8_t s) const { return w5500Plan(s).pool == _pool && W5500.listenPort(s) == _port; }
+
+    // Keep one socket listening; drop connections reset before accept
+    void listen() {
+        bool listening = false;
+        for (uint8_t s = 0; s < W5500Class::SOCKETS; s++) {
+            if (!mine(s)) continue;
+            const uint8_t status = W5500.status(s);
+            if (status == W5500Class::SR_LISTEN) listening = true;
+            else if (status == W5500Class::SR_CLOSED && !W5500.accepted(s)) W5500.close(s);
+        }
+        if (listening) return;
+        const int s = W5500.allocate(_pool);
+        if (s < 0) return;
+        if (!W5500.open(s, W5500Class::MR_TCP, _port)) {
+            W5500.close(s);
+            return;
+        }
+        W5500.setListenPort(s, _port);
+        W5500.command(s, W5500Class::CR_LISTEN);
+    }
+};
+
+/**
+ * Datagrams on the UDP socket, for DHCP and DNS
+ */
+class W5500Udp {
+public:
+    static constexpr size_t HEADER = 8;     // Source address, port and length
+
+    ~W5500Udp() { stop(); }
+
+    bool begin(uint16_t port) {
+        stop();
+        const int s = W5500.allocate(W5500Pool::UDP);
+        if (s < 0) return false;
+        if (!W5500.open(s, W5500Class::MR_UDP, port)) {
+            W5500.close(s);
+            return false;
+        }
+        _socket = (int8_t)s;
+        return true;
+    }
+
+    void stop() {
+        if (_socket >= 0) W5500.close(_socket);
+        _socket = -1;
+    }
+
+    bool send(const IPAddress& ip, uint16_t port, const uint8_t* data, size_t len) {
+        if (_socket < 0) return false;
+        W5500.setDestination(_socket, ip, port);
+        return W5500.send(_socket, data, len) == len && W5500.drain(_socket, 100);
+    }
+
+    /**
+     * Next datagram, cut to size
+     * @return its length, 0 if none is waiting
+     */
+    size_t receive(uint8_t* out, size_t size, IPAddress* from = nullptr) {
+        if (_socket < 0 || W5500.readable(_socket) < HEADER) return 0;
+        uint8_t header[HEADER];
+        W5500.recv(_socket, header, HEADER);
+        if (from) *from = IPAddress(header[0], header[1], header[2], header[3]);
+        const size_t len = (size_t)(header[6] << 8 | header[7]);
+        const size_t n = W5500.recv(_socket, out, min(len, size));
+        W5500.skip(_socket, len - n);
+        return n;
+    }
+
+    static inline uint8_t packet[548];  // DHCP and DNS messages, one at a time
+
+private:
+    int8_t _socket = -1;
+};
+
+/**
+ * DNS A lookups, as the Ethernet library's DNSClient
+ */
+class W5500Dns {
+public:
+    static constexpr int SUCCESS = 1;
+    static constexpr int TIMED_OUT = -1;
+    static constexpr int INVALID_SERVER = -2;
+    static constexpr int INVALID_RESPONSE = -4;
+
+    void begin(const IPAddress& server) { _server = server; }
+
+    int getHostByName(const char* host, IPAddress& result, uint16_t timeout = 5000) {
+        if (result.fromString(host)) return SUCCESS;
+        if (_server == IPAddress(0, 0, 0, 0)) return INVALID_SERVER;
+        const size_t queryLen = buildQuery(host);
+        if (!queryLen) return INVALID_RESPONSE;
+
+        W5500Udp udp;
+        if (!udp.begin(1024 + random(0, 30000))) return TIMED_OUT;
+        for (int attempt = 0; attempt < 3; attempt++) {
+            if (!udp.send(_server, 53, W5500Udp::packet, queryLen)) continue;
+            const uint32_t start = millis();
+            while (millis() - start < timeout / 3) {
+                IPAddress from;
+                const size_t n = udp.receive(W5500Udp::packet, sizeof(W5500Udp::packet), &from);
+                if (n && from == _server) {
+                    const int rc = parseResponse(n, result);
+                    if (rc != 0) return rc;
+                }
+                delay(1);
+            }
+            buildQuery(host);   // The buffer held a stray datagram
+        }
+        return TIMED_OUT;
+    }
+
+private:
+    IPAddress _server;
+    uint16_t _id = 0;
+
+    size_t buildQuery(const char* host) {
+        uint8_t* p = W5500Udp::packet;
+        _id = (uint16_t)random(0, 0x10000);
+        const uint8_t header[12] = {(uint8_t)(_id >> 8), (uint8_t)_id, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0};
+        memcpy(p, header, sizeof(header));
+        size_t pos = sizeof(header);
+        while (*host) {
+            const char* dot = strchr(host, '.');
+            const size_t label = dot ? (size_t)(dot - host) : strlen(host);
+            if (label == 0 || label > 63 || pos + label + 6 > sizeof(W5500Udp::packet)) return 0;
+            p[pos++] = (uint8_t)label;
+            memcpy(p + pos, host, label);
+            pos += label;
+            host += label + (dot ? 1 : 0);
+        }
+        const uint8_t question[5] = {0, 0, 1, 0, 1};  // Root, type A, class IN
+        memcpy(p + pos, question, sizeof(question));
+        return pos + sizeof(question);
+    }
+
+    // 0 for another query's answer
+    int parseResponse(size_t len, IPAddress& result) {
+        const uint8_t* p = W5500Udp::packet;
+        if (len < 12 || (p[0] << 8 | p[1]) != _id) return 0;
+        if (!(p[2] & 0x80) || (p[3] & 0x0F) != 0) return INVALID_RESPONSE;
+        const uint16_t questions = p[4] << 8 | p[5];
+        const uint16_t answers = p[6] << 8 | p[7];
+        size_t pos = 12;
+        for (uint16_t i = 0; i < questions; i++) {
+            if (!skipName(len, pos) || pos + 4 > len) return INVALID_RESPONSE;
+            pos += 4;
+        }
+        for (uint16_t i = 0; i < answers; i++) {
+            if (!skipName(len, pos) || pos + 10 > len) return INVALID_RESPONSE;
+            const uint16_t type = p[pos] << 8 | p[pos + 1];
+            const uint16_t dataLen = p[pos + 8] << 8 | p[pos + 9];
+            pos += 10;
+            if (pos + dataLen > len) return INVALID_RESPONSE;
+            if (type == 1 && dataLen == 4) {
+                result = IPAddress(p[pos], p[pos + 1], p[pos + 2], p[pos + 3]);
+                return SUCCESS;
+            }
+            pos += dataLen;
+        }
+        return INVALID_RESPONSE;
+    }
+
+    static bool skipName(size_t len, size_t& pos) {
+        const uint8_t* p = W5500Udp::packet;
+        while (pos < len) {
+            const uint8_t label = p[pos];
+            if (label == 0) {
+                pos++;
+                return true;
+            }
+            if ((label & 0xC0) == 0xC0) {
+                pos += 2;
+                return pos <= len;
+            }
+            pos += 1 + label;
+        }
+        return false;
+    }
+};
+
+/**
+ * Interface setup and DHCP lease, as the Ethernet library's EthernetClass
+ */
+class W5500EthernetClass {
+public:
+    void init(uint8_t csPin) { (void)csPin; }  // W5500_CS_PIN is fixed at build time
+
+    /**
+     * Chip setup and a DHCP lease
+     * @return 1 with an address, 0 if no chip or no lease
+     */
+    int begin(uint8_t* mac, unsigned long timeout = 60000, unsigned long responseTimeout = 4000) {
+        memcpy(_mac, mac, sizeof(_mac));
+        _lease = Lease{};
+        if (!W5500.begin(_mac)) return 0;
+        _responseTimeoutMs = responseTimeout;
+        const uint32_t start = millis();
+        do {
+            if (dhcp(false)) return 1;
+            yield();
+        } while (millis() - start < timeout);
+        return 0;
+    }
+
+    /**
+     * Renew the lease at T1, rebind at T2, drop it when it runs out
+     * @return 0 nothing done, 1 renew failed, 2 renewed, 3 rebind failed, 4 rebound
+     */
+    int maintain() {
+        if (!_lease.seconds) return 0;
+        const uint32_t held = (millis() - _lease.startMs) / 1000;
+        if (held >= _lease.seconds) {
+            _lease = Lease{};
+            W5500.setAddress(_mac, IPAddress(), IPAddress(), IPAddress());
+            return 3;
+        }
+        const uint32_t t1 = _lease.seconds / 2, t2 = _lease.seconds / 8 * 7;
+        if (held < t1 || millis() - _lastTryMs < _responseTimeoutMs * 4) return 0;
+        _lastTryMs = millis();
+        const bool rebind = held >= t2;
+        if (dhcp(true, rebind)) return rebind ? 4 : 2;
+        return rebind ? 3 : 1;
+    }
+
+    IPAddress localIP() const { return _lease.ip; }
+    IPAddress subnetMask() const { return _lease.subnet; }
+    IPAddress gatewayIP() const { return _lease.gateway; }
+    IPAddress dnsServerIP() const { return _lease.dns; }
+    void MACAddress(uint8_t* mac) const { memcpy(mac, _mac, sizeof(_mac)); }
+    bool linkUp() { return W5500.linkUp(); }
+
+private:
+    // DHCP message types and options
+    static constexpr uint8_t DISCOVER = 1, OFFER = 2, REQUEST = 3, ACK = 5, NAK = 6;
+    static constexpr uint8_t OPT_SUBNET = 1, OPT_ROUTER = 3, OPT_DNS = 6, OPT_HOSTNAME = 12;
+    static constexpr uint8_t OPT_REQUESTED_IP = 50, OPT_LEASE = 51, OPT_TYPE = 53, OPT_SERVER = 54;
+    static constexpr uint8_t OPT_PARAMETERS = 55, OPT_END = 255;
+    static constexpr size_t OPTIONS = 240;  // BOOTP header and magic cookie
+
+    struct Lease {
+        IPAddress ip, subnet, gateway, dns, server;
+        uint32_t seconds = 0;
+        uint32_t startMs = 0;
+    };
+
+    uint8_t _mac[6] = {0};
+    Lease _lease;
+    uint32_t _xid = 0;
+    uint32_t _responseTimeoutMs = 4000;
+    uint32_t _lastTryMs = 0;
+
+    /**
+     * One exchange: DISCOVER/OFFER/REQUEST/ACK, or a REQUEST for the
+     * current address (unicast renew, broadcast rebind)
+     */
+    bool dhcp(bool renew, bool rebind = false) {
+        W5500Udp udp;
+        if (!udp.begin(68)) return false;
+        _xid = (uint32_t)random(1, 0x7FFFFFFF);
+        Lease offer = _lease;
+        if (!renew) {
+            if (!exchange(udp, DISCOVER, IPAddress(255, 255, 255, 255), offer, OFFER)) return false;
+        }
+        const IPAddress server = renew && !rebind ? _lease.server : IPAddress(255, 255, 255, 255);
+        Lease ack = offer;
+        if (!exchange(udp, REQUEST, server, ack, ACK)) return false;
+        ack.startMs = millis();
+        if (!ack.seconds) ack.seconds = 86400;
+        _lease = ack;
+        W5500.setAddress(_mac, _lease.ip, _lease.subnet, _lease.gateway);
+        return true;
+    }
+
+    bool exchange(W5500Udp& udp, uint8_t type, const IPAddress& to, Lease& lease, uint8_t expect) {
+        const size_t len = buildMessage(type, lease);
+        if (!udp.send(to, 67, W5500Udp::packet, len)) return false;
+        const uint32_t start = millis();
+        while (millis() - start < _responseTimeoutMs) {
+            const size_t n = udp.receive(W5500Udp::packet, sizeof(W5500Udp::packet));
+            if (n) {
+                const uint8_t got = parseMessage(n, lease);
+                if (got == expect) return true;
+                if (got == NAK) return false;
+            }
+            delay(1);
+        }
+        return false;
+    }
+
+    size_t buildMessage(uint8_t type, const Lease& lease) {
+        uint8_t* p = W5500Udp::packet;
+        memset(p, 0, OPTIONS);
+        p[0] = 1;   // BOOTREQUEST
+        p[1] = 1;   // Ethernet
+        p[2] = 6;
+        p[4] = (uint8_t)(_xid >> 24); p[5] = (uint8_t)(_xid >> 16); p[6] = (uint8_t)(_xid >> 8); p[7] = (uint8_t)_xid;
+        const bool bound = _lease.seconds != 0 && lease.ip == _lease.ip;
+        if (bound) {
+            for (int i = 0; i < 4; i++) p[12 + i] = _lease.ip[i];  // ciaddr while renewing
+        } else {
+            p[10] = 0x80;   // Broadcast reply: no address yet
+        }
+        memcpy(p + 28, _mac, sizeof(_mac));
+        p[236] = 99; p[237] = 130; p[238] = 83; p[239] = 99;
+
+        size_t pos = OPTIONS;
+        p[pos++] = OPT_TYPE; p[pos++] = 1; p[pos++] = type;
+        if (type == REQUEST && !bound) {
+            p[pos++] = OPT_REQUESTED_IP; p[pos++] = 4;
+            for (int i = 0; i < 4; i++) p[pos++] = lease.ip[i];
+            p[pos++] = OPT_SERVER; p[pos++] = 4;
+            for (int i = 0; i < 4; i++) p[pos++] = lease.server[i];
+        }
+        static const char HOSTNAME[] = "gps-tracker";
+        p[pos++] = OPT_HOSTNAME; p[pos++] = sizeof(HOSTNAME) - 1;
+        memcpy(p + pos, HOSTNAME, sizeof(HOSTNAME) - 1);
+        pos += sizeof(HOSTNAME) - 1;
+        const uint8_t parameters[] = {OPT_PARAMETERS, 4, OPT_SUBNET, OPT_ROUTER, OPT_DNS, OPT_LEASE};
+        memcpy(p + pos, parameters, sizeof(parameters));
+        pos += sizeof(parameters);
+        p[pos++] = OPT_END;
+        return pos;
+    }
+
+    // Message type, 0 if not a reply to us
+    uint8_t parseMessage(size_t len, Lease& lease) {
+        const uint8_t* p = W5500Udp::packet;
+        if (len < OPTIONS || p[0] != 2) return 0;
+        const uint32_t xid = (uint32_t)p[4] << 24 | (uint32_t)p[5] << 16 | (uint32_t)p[6] << 8 | p[7];
+        if (xid != _xid || memcmp(p + 28, _mac, sizeof(_mac)) != 0) return 0;
+
+        uint8_t type = 0;
+        lease.ip = IPAddress(p[16], p[17], p[18], p[19]);
+        for (size_t pos = OPTIONS; pos < len && p[pos] != OPT_END;) {
+            const uint8_t option = p[pos];
+            if (option == 0) {
+                pos++;
+                continue;
+            }
+            if (pos + 2 > len || pos + 2 + p[pos + 1] > len) break;
+            const uint8_t* v = p + pos + 2;
+            const uint8_t size = p[pos + 1];
+            if (option == OPT_TYPE && size >= 1) type = v[0];
+            else if (size >= 4 && option == OPT_SUBNET) lease.subnet = IPAddress(v[0], v[1], v[2], v[3]);
+            else if (size >= 4 && option == OPT_ROUTER) lease.gateway = IPAddress(v[0], v[1], v[2], v[3]);
+            else if (size >= 4 && option == OPT_DNS) lease.dns = IPAddress(v[0], v[1], v[2], v[3]);
+            else if (size >= 4 && option == OPT_SERVER) lease.server = IPAddress(v[0], v[1], v[2], v[3]);
+            else if (size >= 4 && option == OPT_LEASE) {
+                lease.seconds = (uint32_t)v[0] << 24 | (uint32_t)v[1] << 16 | (uint32_t)v[2] << 8 | v[3];
+            }
+            pos += 2 + size;
+        }
+        return type;
+    }
+};
+
+inline W5500EthernetClass W5500Ethernet;
+
+inline int W5500Client::connect(const char* host, uint16_t port) {
+    IPAddress ip;
+    W5500Dns dns;
+    dns.begin(W5500Ethernet.dnsServerIP());
+    if (dns.getHostByName(host, ip) != W5500Dns::SUCCESS) return 0;
+    return connect(ip, port);
+}
+
+#endif // W5500_ETHERNET_H
@@ -0,0 +1,125 @@
+#ifndef WEB_ROUTER_H
+#define WEB_ROUTER_H
+
+/**
+ * @file web_router.h
+ * @brief Request routing shared by the Ethernet and WiFi web servers
+ */
+
+#include <Arduino.h>
+#include <Client.h>
+#include "../config.h"
+#include "arena.h"
+#include "buffered_print.h"
+#include "gps_module.h"
+#include "http_request.h"
+#include "metrics.h"
+#include "seqlock.h"
+#include "track_store.h"
+#include "trace.h"
+#include "track_chart.h"
+#include "track_export.h"
+#include "trip_analytics.h"
+#include "webpage_renderer.h"
+
+#if ARCHIVE_ENABLE
+#include "track_archive.h"
+
+#ifndef ARCHIVE_DEFAULT_WINDOW_S
+#define ARCHIVE_DEFAULT_WINDOW_S    3600
+#endif
+
+static_assert(WEB_ARENA_SIZE >= HTTP_BUFFER_SIZE + ARCHIVE_PAGE_SIZE + 8,
+              "WEB_ARENA_SIZE too small for an archive query");
+#endif
+
+/**
+ * Application state exposed to web handlers
+ */
+struct WebContext {
+    const LatestFix& fix;
+    const TrackStore& track;
+    const char* deviceId;
+    const SeqLock<TripStatus>* trip = nullptr;  // nullptr: no trip card
+#if ARCHIVE_ENABLE
+    const TrackArchive* archive = nullptr;      // nullptr: no /archive.*
+#endif
+};
+
+namespace WebRouter {
+
+inline void sendNotFound(Print& out) {
+    out.println(F("HTTP/1.1 404 Not Found"));
+    out.println(F("Content-Type: text/plain"));
+    out.println(F("Connection: close"));
+    out.println();
+    out.println(F("Not Found"));
+}
+
+#if ARCHIVE_ENABLE
+/**
+ * /archive.gpx, /archive.geojson
+ * Query: from=<epoch>&to=<epoch> (inclusive), default the last
+ * ARCHIVE_DEFAULT_WINDOW_S
+ */
+inline void serveArchive(Client& client, const HttpRequest& request, const TrackArchive& archive,
+                         TrackExport::Format format, const char* deviceId) {
+    const uint32_t newest = archive.newestTime();
+    const uint32_t from = request.paramUInt("from", newest > ARCHIVE_DEFAULT_WINDOW_S ? newest - ARCHIVE_DEFAULT_WINDOW_S : 0);
+    const uint32_t to = request.paramUInt("to", UINT32_MAX);
+    uint8_t* page = (uint8_t*)Memory::web.allocate(ARCHIVE_PAGE_SIZE, 4);
+    if (!page) return;
+    TrackExport::serveStream(client, request, format, deviceId, [&](auto&& emit) {
+        archive.query(from, to, page, emit);
+    });
+}
+#endif
+
+inline void dispatch(Client& client, const HttpRequest& request, const WebContext& ctx) {
+    Metrics::Counter* served = Metrics::registry.webRequests;
+    ArenaScope scope(Memory::web);
+
+    if (request.isPath("/")) {
+        served[(size_t)Metrics::WebRoute::DASHBOARD].inc();
+        GPSData gpsData;
+        ctx.fix.read(gpsData);
+        TripStatus trip;
+        const bool hasTrip = ctx.trip && ctx.trip->read(trip) != 0;
+        BufferedPrint out(client, Memory::web, HTTP_BUFFER_SIZE);
+        WebPage::render(out, gpsData, gpsData.valid, hasTrip ? &trip : nullptr);
+    } else if (request.isPath("/export.gpx")) {
+        served[(size_t)Metrics::WebRoute::EXPORT].inc();
+        TrackExport::serve(client, request, ctx.track, TrackExport::Format::GPX, ctx.deviceId);
+    } else if (request.isPath("/export.geojson")) {
+        served[(size_t)Metrics::WebRoute::EXPORT].inc();
+        TrackExport::serve(client, request, ctx.track, TrackExport::Format::GEOJSON, ctx.deviceId);
+    } else if (request.isPath("/chart.svg")) {
+        served[(size_t)Metrics::WebRoute::CHART].inc();
+        TrackChart::serve(client, request, ctx.track);
+#if ARCHIVE_ENABLE
+    } else if (ctx.archive && request.isPath("/archive.gpx")) {
+        served[(size_t)Metrics::WebRoute::ARCHIVE].inc();
+        serveArchive(client, request, *ctx.archive, TrackExport::Format::GPX, ctx.deviceId);
+    } else if (ctx.archive && request.isPath("/archive.geojson")) {
+        served[(size_t)Metrics::WebRoute::ARCHIVE].inc();
+        serveArchive(client, request, *ctx.archive, TrackExport::Format::GEOJSON, ctx.deviceId);
+#endif
+    } else if (request.isPath("/metrics")) {
+        served[(size_t)Metrics::WebRoute::METRICS].inc();
+        BufferedPrint out(client, Memory::web, HTTP_BUFFER_SIZE);
+        Metrics::serve(out);
+#if TRACE_ENABLE
+    } else if (request.isPath("/trace")) {
+        served[(size_t)Metrics::WebRoute::TRACE].inc();
+        BufferedPrint out(client, Memory::web, HTTP_BUFFER_SIZE);
+        Trace::serve(out);
+#endif
+    } else {
+        served[(size_t)Metrics::WebRoute::NOT_FOUND].inc();
+        sendNotFound(client);
+    }
+}
+
+} // namespace WebRouter
+
+#endif // WEB_ROUTER_H
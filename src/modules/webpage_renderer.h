@@ -5,23 +5,77 @@
  * @file webpage_renderer.h
  * @brief Dashboard View - Resource monitoring webpage renderer
  *
- * Displays ESP32 system info: Memory, CPU, Network, GPS status
+ * Displays ESP32 system info: Memory, CPU, Network, GPS status, trip
  * For map view, use webpage_renderer_map.h instead
  */
 
 #include <Arduino.h>
 #include "../config.h"
 #include "gps_module.h"
+#include "trace.h"
+#include "trip_analytics.h"
 
-#if WIFI_ENABLE
+#if LINK_DUAL_ENABLE
+#include <WiFi.h>
+#include "ethernet_bus.h"
+#include "metrics.h"
+#elif WIFI_ENABLE
 #include <WiFi.h>
 #else
-#include <Ethernet.h>
+#include "ethernet_bus.h"
 #endif
 
 namespace WebPage {
 
-inline void render(Print& out, const GPSData& gpsData, bool gpsValid) {
+/**
+ * Link shown on the dashboard (with both up, the one carrying uploads)
+ */
+struct LinkInfo {
+    bool wifi;
+    IPAddress ip;
+    uint8_t mac[6];
+    int32_t rssi;
+};
+
+inline void currentLink(LinkInfo& link) {
+    #if LINK_DUAL_ENABLE
+    link.wifi = Metrics::registry.linkActive.value() == (uint32_t)Metrics::NetLink::WIFI + 1;
+    #else
+    link.wifi = WIFI_ENABLE;
+    #endif
+    #if LINK_DUAL_ENABLE || WIFI_ENABLE
+    if (link.wifi) {
+        link.ip = WiFi.localIP();
+        WiFi.macAddress(link.mac);
+        link.rssi = WiFi.RSSI();
+        return;
+    }
+    #endif
+    #if LINK_DUAL_ENABLE || !WIFI_ENABLE
+    link.ip = EthernetBus::ethernet.localIP();
+    EthernetBus::ethernet.MACAddress(link.mac);
+    link.rssi = 0;
+    #endif
+}
+
+/**
+ * "1h 05m" or "4m 30s"
+ */
+inline void printDuration(Print& out, uint32_t seconds) {
+    const uint32_t h = seconds / 3600, m = (seconds / 60) % 60, s = seconds % 60;
+    if (h) {
+        out.print(h); out.print("h "); if (m < 10) out.print("0"); out.print(m); out.print("m");
+    } else {
+        out.print(m); out.print("m "); if (s < 10) out.print("0"); out.print(s); out.print("s");
+    }
+}
+
+/**
+ * @param trip Trip analytics, nullptr to leave the card out
+ */
+inline void render(Print& out, const GPSData& gpsData, bool gpsValid, const TripStatus* trip = nullptr) {
+    TRACE_SPAN("WebPage::render");
+
     // System info
     uint32_t freeHeap = ESP.getFreeHeap();
     uint32_t totalHeap = ESP.getHeapSize();
@@ -42,29 +96,20 @@ inline void render(Print& out, const GPSData& gpsData, bool gpsValid) {
     uint8_t sat = gpsData.satellites;
 
     // Network info
-    #if WIFI_ENABLE
-    int32_t rssi = WiFi.RSSI();
-    const char* netType = "WiFi";
-    char ssidBuf[33];
-    strncpy(ssidBuf, WiFi.SSID().c_str(), sizeof(ssidBuf) - 1);
-    ssidBuf[sizeof(ssidBuf) - 1] = '\0';
-    #else
-    int32_t rssi = 0;
-    const char* netType = "Ethernet";
-    const char* ssidBuf = "-";
-    #endif
+    LinkInfo link;
+    currentLink(link);
+    const char* netType = link.wifi ? "WiFi" : "Ethernet";
+    const char* ssidBuf = WIFI_SSID;  // WiFi.SSID() would allocate a String per render
 
     // Signal quality
-    const char* signalQuality = "No Signal";
-    #if WIFI_ENABLE
-    if (rssi >= -50) { signalQuality = "Excellent"; }
-    else if (rssi >= -60) { signalQuality = "Good"; }
-    else if (rssi >= -70) { signalQuality = "Fair"; }
-    else if (rssi >= -80) { signalQuality = "Weak"; }
-    else { signalQuality = "Very Weak"; }
-    #else
-    signalQuality = "Wired";
-    #endif
+    const char* signalQuality = "Wired";
+    if (link.wifi) {
+        if (link.rssi >= -50) { signalQuality = "Excellent"; }
+        else if (link.rssi >= -60) { signalQuality = "Good"; }
+        else if (link.rssi >= -70) { signalQuality = "Fair"; }
+        else if (link.rssi >= -80) { signalQuality = "Weak"; }
+        else { signalQuality = "Very Weak"; }
+    }
 
     // Device ID
     char deviceId[24];
@@ -73,20 +118,11 @@ inline void render(Print& out, const GPSData& gpsData, bool gpsValid) {
 
     // IP Address
     char ipBuf[16] = "0.0.0.0";
-    #if WIFI_ENABLE
-    IPAddress ip = WiFi.localIP();
-    uint8_t mac[6];
-    WiFi.macAddress(mac);
-    #else
-    IPAddress ip = Ethernet.localIP();
-    uint8_t mac[6];
-    Ethernet.MACAddress(mac);
-    #endif
-    snprintf(ipBuf, sizeof(ipBuf), "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+    snprintf(ipBuf, sizeof(ipBuf), "%d.%d.%d.%d", link.ip[0], link.ip[1], link.ip[2], link.ip[3]);
 
     // MAC Address
     char macBuf[18];
-    snprintf(macBuf, sizeof(macBuf), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(macBuf, sizeof(macBuf), "%02X:%02X:%02X:%02X:%02X:%02X", link.mac[0], link.mac[1], link.mac[2], link.mac[3], link.mac[4], link.mac[5]);
 
     // HTTP Response
     out.println("HTTP/1.1 200 OK");
@@ -132,6 +168,7 @@ inline void render(Print& out, const GPSData& gpsData, bool gpsValid) {
     out.println(".network-row{display:flex;justify-content:space-between;align-items:center;padding:8px 12px;background:#0f172a;border-radius:6px}");
     out.println(".network-label{font-size:.75rem;color:#64748b}");
     out.println(".network-value{font-size:.875rem;color:#e2e8f0;font-weight:500}");
+    out.println(".chart{display:block;width:100%;height:auto;margin-top:8px}");
     out.println(".footer{text-align:center;margin-top:30px;font-size:.75rem;color:#475569}");
     out.println("@media(max-width:640px){body{padding:12px}.card{padding:16px}.card-value{font-size:1.5rem}}");
 
@@ -193,24 +230,24 @@ inline void render(Print& out, const GPSData& gpsData, bool gpsValid) {
     out.println("<div class='card-header'><span class='card-title'>Network Status</span>");
     out.println("<div class='card-icon'><svg fill='none' viewBox='0 0 24 24' stroke='currentColor'><path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M21 12a9 9 0 01-9 9m9-9a9 9 0 00-9-9m9 9H3m9 9a9 9 0 01-9-9m9 9c1.657 0 3-4.03 3-9s-1.343-9-3-9m0 18c-1.657 0-3-4.03-3-9s1.343-9 3-9m-9 9a9 9 0 019-9'/></svg></div></div>");
 
-    #if WIFI_ENABLE
-    out.println("<div class='network-badge wifi'>");
-    out.println("<svg fill='none' viewBox='0 0 24 24' stroke='currentColor'><path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M8.111 16.404a5.5 5.5 0 017.778 0M12 20h.01m-7.08-7.071c3.904-3.905 10.236-3.905 14.141 0M1.394 9.393c5.857-5.857 15.355-5.857 21.213 0'/></svg>");
-    out.println("WiFi</div>");
-    #else
-    out.println("<div class='network-badge ethernet'>");
-    out.println("<svg fill='none' viewBox='0 0 24 24' stroke='currentColor'><path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M5 12h14M5 12a2 2 0 01-2-2V6a2 2 0 012-2h14a2 2 0 012 2v4a2 2 0 01-2 2M5 12a2 2 0 00-2 2v4a2 2 0 002 2h14a2 2 0 002-2v-4a2 2 0 00-2-2m-2-4h.01M17 16h.01'/></svg>");
-    out.println("Ethernet</div>");
-    #endif
+    if (link.wifi) {
+        out.println("<div class='network-badge wifi'>");
+        out.println("<svg fill='none' viewBox='0 0 24 24' stroke='currentColor'><path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M8.111 16.404a5.5 5.5 0 017.778 0M12 20h.01m-7.08-7.071c3.904-3.905 10.236-3.905 14.141 0M1.394 9.393c5.857-5.857 15.355-5.857 21.213 0'/></svg>");
+        out.println("WiFi</div>");
+    } else {
+        out.println("<div class='network-badge ethernet'>");
+        out.println("<svg fill='none' viewBox='0 0 24 24' stroke='currentColor'><path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M5 12h14M5 12a2 2 0 01-2-2V6a2 2 0 012-2h14a2 2 0 012 2v4a2 2 0 01-2 2M5 12a2 2 0 00-2 2v4a2 2 0 002 2h14a2 2 0 002-2v-4a2 2 0 00-2-2m-2-4h.01M17 16h.01'/></svg>");
+        out.println("Ethernet</div>");
+    }
 
     out.println("<div class='network-info'>");
     out.print("<div class='network-row'><span class='network-label'>IP Address</span><span class='network-value'>"); out.print(ipBuf); out.println("</span></div>");
-    #if WIFI_ENABLE
-    out.print("<div class='network-row'><span class='network-label'>SSID</span><span class='network-value'>"); out.print(ssidBuf); out.println("</span></div>");
-    out.print("<div class='network-row'><span class='network-label'>Signal</span><span class='network-value'>"); out.print(rssi); out.print(" dBm ("); out.print(signalQuality); out.println(")</span></div>");
-    #else
-    out.println("<div class='network-row'><span class='network-label'>Connection</span><span class='network-value'>Wired</span></div>");
-    #endif
+    if (link.wifi) {
+        out.print("<div class='network-row'><span class='network-label'>SSID</span><span class='network-value'>"); out.print(ssidBuf); out.println("</span></div>");
+        out.print("<div class='network-row'><span class='network-label'>Signal</span><span class='network-value'>"); out.print(link.rssi); out.print(" dBm ("); out.print(signalQuality); out.println(")</span></div>");
+    } else {
+        out.println("<div class='network-row'><span class='network-label'>Connection</span><span class='network-value'>Wired</span></div>");
+    }
     out.print("<div class='network-row'><span class='network-label'>MAC Address</span><span class='network-value'>"); out.print(macBuf); out.println("</span></div>");
     out.println("</div></div>");
 
@@ -252,6 +289,43 @@ inline void render(Print& out, const GPSData& gpsData, bool gpsValid) {
     out.print("<div class='network-row'><span class='network-label'>Heading</span><span class='network-value'>"); out.print(crs, 1); out.println("&deg;</span></div>");
     out.println("</div></div>");
 
+    // Trip Card
+    if (trip) {
+        const TripSummary& t = trip->trip;
+        out.println("<div class='card'>");
+        out.println("<div class='card-header'><span class='card-title'>Trip</span>");
+        out.println("<div class='card-icon'><svg fill='none' viewBox='0 0 24 24' stroke='currentColor'><path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M9 20l-5.447-2.724A1 1 0 013 16.382V5.618a1 1 0 011.447-.894L9 7m0 13l6-3m-6 3V7m6 10l4.553 2.276A1 1 0 0021 18.382V7.618a1 1 0 00-.553-.894L15 4m0 13V4m0 0L9 7'/></svg></div></div>");
+        out.print("<div class='card-value'>"); out.print(trip->odometerM / 1000.0, 1); out.println("<span class='card-unit'>km</span></div>");
+        out.print("<div class='card-detail'>Odometer | ");
+        out.print(trip->motion == Motion::MOVING ? "Moving" : "Stopped"); out.print(" for "); printDuration(out, trip->dwellS);
+        out.println("</div>");
+
+        out.println("<div class='network-info'>");
+        if (t.id == 0) {
+            out.println("<div class='network-row'><span class='network-label'>Trip</span><span class='network-value'>None yet</span></div>");
+        } else {
+            out.print("<div class='network-row'><span class='network-label'>Trip #"); out.print(t.id);
+            out.print(trip->inTrip ? "" : " (last)"); out.print("</span><span class='network-value'>");
+            out.print(t.distanceM / 1000.0, 2); out.println(" km</span></div>");
+            out.print("<div class='network-row'><span class='network-label'>Moving / Stopped</span><span class='network-value'>");
+            printDuration(out, t.movingS); out.print(" / "); printDuration(out, t.stoppedS); out.println("</span></div>");
+            out.print("<div class='network-row'><span class='network-label'>Stops</span><span class='network-value'>"); out.print(t.stops); out.println("</span></div>");
+            out.print("<div class='network-row'><span class='network-label'>Avg / Max Speed</span><span class='network-value'>");
+            out.print(t.avgSpeedCms * 0.036, 1); out.print(" / "); out.print(t.maxSpeedCms * 0.036, 1); out.println(" km/h</span></div>");
+        }
+        out.println("</div></div>");
+    }
+
+    // Trends Card (downsampled history, /chart.svg)
+    out.println("<div class='card'>");
+    out.println("<div class='card-header'><span class='card-title'>Trends (last hour)</span>");
+    out.println("<div class='card-icon'><svg fill='none' viewBox='0 0 24 24' stroke='currentColor'><path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M7 12l3-3 3 3 4-4M8 21l4-4 4 4M3 4h18M4 4h16v12a1 1 0 01-1 1H5a1 1 0 01-1-1V4z'/></svg></div></div>");
+    out.println("<img class='chart' src='/chart.svg?series=speed' alt='speed'>");
+    out.println("<img class='chart' src='/chart.svg?series=altitude' alt='altitude'>");
+    out.println("<img class='chart' src='/chart.svg?series=satellites' alt='satellites'>");
+    out.println("<img class='chart' src='/chart.svg?series=heap' alt='free heap'>");
+    out.println("</div>");
+
     // Grid End
     out.println("</div>");
 
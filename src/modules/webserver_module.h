@@ -2,11 +2,12 @@
 #define WEBSERVER_MODULE_H
 
 #include <Arduino.h>
-#include <SPI.h>
-#include <Ethernet.h>
 #include "../config.h"
+#include "arena.h"
+#include "ethernet_bus.h"
 #include "gps_module.h"
-#include "webpage_renderer.h"
+#include "http_request.h"
+#include "web_router.h"
 
 // Workaround: ESP32 Server class requires begin(uint16_t) override
 class ESP32EthernetServer : public EthernetServer {
@@ -20,32 +21,47 @@ public:
     WebServerModule(uint16_t port) : _server(port) {}
 
     void begin() {
+        Rtos::LockGuard guard(EthernetBus::mutex);
         _server.begin();
     }
 
-    void handle(const GPSData& gpsData, bool gpsValid) {
+    /**
+     * Wake isr on socket events instead of polling
+     * @return false without an interrupt line
+     */
+    bool attachInterrupt(void (*isr)()) {
+        return EthernetBus::attachInterrupt(isr);
+    }
+
+    /**
+     * Serve every pending connection
+     * @return false if the bus was busy; try again shortly
+     */
+    bool handle(const WebContext& ctx) {
+        // Bounded wait: the uploader may hold the bus through a DHCP renew
+        if (!EthernetBus::mutex.tryLock(WEB_POLL_MS)) return false;
+        EthernetBus::clearInterrupts();  // Events after this give a new edge
+        while (handleLocked(ctx)) {}
+        EthernetBus::mutex.unlock();
+        return true;
+    }
+
+private:
+    ESP32EthernetServer _server;
+
+    bool handleLocked(const WebContext& ctx) {
         EthernetClient client = _server.available();
-        if (!client) return;
-
-        boolean blankLine = false;
-
-        while (client.connected()) {
-            if (client.available()) {
-                char c = client.read();
-                if (c == '\n' && blankLine) {
-                    WebPage::render(client, gpsData, gpsValid);
-                    break;
-                }
-                if (c == '\n') blankLine = true;
-                else if (c != '\r') blankLine = false;
-            }
+        if (!client) return false;
+
+        Memory::web.reset();
+        HttpRequest request;
+        if (request.read(client)) {
+            WebRouter::dispatch(client, request, ctx);
         }
         delay(1);
         client.stop();
+        return true;
     }
-
-private:
-    ESP32EthernetServer _server;
 };
 
 #endif // WEBSERVER_MODULE_H
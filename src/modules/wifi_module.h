@@ -3,8 +3,15 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <ArduinoJson.h>
 #include "gps_module.h"
+#include "http_download.h"
+#include "http_upload.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+#if SERVER_TLS_ENABLE
+#include "tls_client.h"
+#endif
 
 enum class WiFiNetworkStatus : uint8_t {
     DISCONNECTED = 0,
@@ -13,18 +20,18 @@ enum class WiFiNetworkStatus : uint8_t {
     ERROR
 };
 
-struct HttpResponse {
-    int16_t statusCode;
-    bool success;
-};
-
 class WiFiNetworkModule {
 public:
+    /**
+     * @param timeoutMs 0 = return at once, the station associates (and
+     *                  reconnects) in the background
+     */
     bool begin(const char* ssid, const char* password, uint32_t timeoutMs = 10000) {
         _status = WiFiNetworkStatus::CONNECTING;
 
         WiFi.mode(WIFI_STA);
         WiFi.begin(ssid, password);
+        if (timeoutMs == 0) return isConnected();
 
         uint32_t startTime = millis();
         while (WiFi.status() != WL_CONNECTED) {
@@ -40,9 +47,7 @@ public:
     }
 
     void maintain() {
-        if (WiFi.status() != WL_CONNECTED) {
-            _status = WiFiNetworkStatus::DISCONNECTED;
-        }
+        _status = WiFi.status() == WL_CONNECTED ? WiFiNetworkStatus::CONNECTED : WiFiNetworkStatus::DISCONNECTED;
     }
 
     bool isConnected() const {
@@ -59,127 +64,140 @@ public:
     }
 
     HttpResponse sendGPSData(const char* host, const char* path, uint16_t port,
-                             const char* deviceId, const GPSData& gpsData) {
+                             const char* deviceId, const GPSData& gpsData,
+                             const HttpUpload::ReportExtras& extras = {}) {
+        char ipBuffer[16];
+        getLocalIP(ipBuffer, sizeof(ipBuffer));
+
+        ArenaScope scope(Memory::cycle);
+        const char* payload = HttpUpload::buildJsonPayload(Memory::cycle, deviceId, gpsData, ipBuffer, extras);
+        if (!payload) return HttpResponse{0, false};
+        return sendReport(host, path, port, payload);
+    }
+
+    /**
+     * POST a report already serialized (shared with other destinations)
+     */
+    HttpResponse sendReport(const char* host, const char* path, uint16_t port, const char* payload) {
         HttpResponse response = {0, false};
 
         if (!isConnected()) {
-            Serial.println("[HTTP] WiFi not connected");
+            LOG(HTTP_NO_LINK, "WiFi");
             return response;
         }
 
-        Serial.printf("[HTTP] Connecting to %s:%d...\n", host, port);
+        LOG(HTTP_CONNECTING, host, port);
 
-        if (!_client.connect(host, port)) {
-            Serial.println("[HTTP] Connection failed!");
-            _client.stop();
+        if (!resolve(host, _serverIP)) {
+            LOG(HTTP_DNS_FAILED);
+            Metrics::registry.recordHttpStatus(0);
             return response;
         }
 
-        Serial.println("[HTTP] Connected, sending POST...");
-
-        char jsonBuffer[384];
-        buildJsonPayload(jsonBuffer, sizeof(jsonBuffer), deviceId, gpsData);
-
-        Serial.printf("[HTTP] Payload: %s\n", jsonBuffer);
-
-        sendHttpPost(host, path, jsonBuffer);
-
-        response = readHttpResponse();
-
-        Serial.printf("[HTTP] Response: %d (success=%d)\n", response.statusCode, response.success);
-
-        _client.stop();
-
-        return response;
+        #if SERVER_TLS_ENABLE
+        TlsClient tls(_tls, _client, host);
+        return HttpUpload::postPayload(tls, _serverIP, host, path, port, payload);
+        #else
+        return HttpUpload::postPayload(_client, _serverIP, host, path, port, payload);
+        #endif
     }
 
-private:
-    WiFiNetworkStatus _status = WiFiNetworkStatus::DISCONNECTED;
-    WiFiClient _client;
-
-    void buildJsonPayload(char* buffer, size_t bufferSize,
-                          const char* deviceId, const GPSData& gpsData) {
-        StaticJsonDocument<384> doc;
-
-        doc["device_id"] = deviceId;
-
-        if (gpsData.valid) {
-            doc["status"] = "online";
-            doc["latitude"] = gpsData.latitude;
-            doc["longitude"] = gpsData.longitude;
-            doc["speed"] = gpsData.speed;
-            doc["altitude"] = gpsData.altitude;
-            doc["course"] = gpsData.course;
-            doc["satellites"] = gpsData.satellites;
-            doc["timestamp"] = gpsData.datetime;
-        } else {
-            doc["status"] = "no_fix";
-            doc["satellites"] = gpsData.satellites;
+    /**
+     * Stream the body of a GET into body (firmware patches)
+     */
+    HttpDownload::Result fetch(const char* host, const char* path, uint16_t port, Print& body) {
+        if (!isConnected()) {
+            LOG(HTTP_NO_LINK, "WiFi");
+            return HttpDownload::Result{0, 0, false};
+        }
+        if (!resolve(host, _serverIP)) {
+            LOG(HTTP_DNS_FAILED);
+            return HttpDownload::Result{0, 0, false};
         }
 
-        char ipBuffer[16];
-        getLocalIP(ipBuffer, sizeof(ipBuffer));
-        doc["ip"] = ipBuffer;
-        doc["uptime_sec"] = millis() / 1000;
-        doc["free_heap"] = ESP.getFreeHeap();
-
-        serializeJson(doc, buffer, bufferSize);
+        #if SERVER_TLS_ENABLE
+        TlsClient tls(_tls, _client, host);
+        return HttpDownload::get(tls, _serverIP, host, path, port, body);
+        #else
+        return HttpDownload::get(_client, _serverIP, host, path, port, body);
+        #endif
     }
 
-    void sendHttpPost(const char* host, const char* path, const char* payload) {
-        const size_t payloadLen = strlen(payload);
-
-        _client.print(F("POST "));
-        _client.print(path);
-        _client.println(F(" HTTP/1.1"));
-
-        _client.print(F("Host: "));
-        _client.println(host);
-
-        _client.println(F("Content-Type: application/json"));
-        _client.println(F("Connection: close"));
-
-        _client.print(F("Content-Length: "));
-        _client.println(payloadLen);
-
-        _client.println();
-        _client.print(payload);
+    /**
+     * Time a plain TCP connect to the server, for link scoring (uses the
+     * address from the last lookup)
+     * @param connectUs Receives the connect time
+     * @return false if the server could not be reached
+     */
+    bool probe(const char* host, uint16_t port, uint32_t& connectUs) {
+        if (!isConnected()) return false;
+        if (_serverIP == IPAddress(0, 0, 0, 0) && !resolve(host, _serverIP)) return false;
+        const uint32_t start = micros();
+        const bool connected = _client.connect(_serverIP, port);
+        connectUs = micros() - start;
+        _client.stop();
+        return connected;
     }
 
-    HttpResponse readHttpResponse() {
-        HttpResponse response = {0, false};
-        const uint32_t timeout = 5000;
-        const uint32_t startTime = millis();
-
-        Serial.println("[HTTP] Waiting for response...");
-
-        while (_client.available() == 0) {
-            if (millis() - startTime > timeout) {
-                Serial.println("[HTTP] Response timeout!");
-                return response;
-            }
-            yield();
+    /**
+     * Own connection to one extra report destination (upload_fanout.h):
+     * a socket, its address and TLS session
+     */
+    class Channel {
+    public:
+        Client& client() {
+            #if SERVER_TLS_ENABLE
+            return _tls;
+            #else
+            return _socket;
+            #endif
         }
 
-        if (_client.available()) {
-            char statusLine[64];
-            size_t len = _client.readBytesUntil('\n', statusLine, sizeof(statusLine) - 1);
-            statusLine[len] = '\0';
-
-            Serial.printf("[HTTP] Status line: %s\n", statusLine);
-
-            char* codeStart = strchr(statusLine, ' ');
-            if (codeStart) {
-                response.statusCode = atoi(codeStart + 1);
-                response.success = (response.statusCode >= 200 && response.statusCode < 300);
-            }
-        }
-
-        while (_client.available()) {
-            _client.read();
+    private:
+        friend class WiFiNetworkModule;
+        WiFiClient _socket;
+        IPAddress _ip;      // Looked up once, again after a failed connect
+        #if SERVER_TLS_ENABLE
+        TlsContext _context;
+        TlsClient _tls{_context, _socket, ""};
+        #endif
+    };
+
+    /**
+     * Connect a channel; the caller writes, polls and stops its client()
+     * @param pin Base64 SHA-256 of the server's key ("" = refused unless TLS_ALLOW_UNPINNED)
+     * @return false without a link, address or connection
+     */
+    bool open(Channel& channel, const char* host, uint16_t port, const char* pin) {
+        if (!isConnected()) return false;
+        if (channel._ip == IPAddress(0, 0, 0, 0) && !resolve(host, channel._ip)) {
+            LOG(HTTP_DNS_FAILED);
+            return false;
         }
+        #if SERVER_TLS_ENABLE
+        channel._context.pin(pin);
+        channel._tls.setHostname(host);
+        #else
+        (void)pin;
+        #endif
+        if (channel.client().connect(channel._ip, port)) return true;
+        channel.client().stop();
+        channel._ip = IPAddress(0, 0, 0, 0);
+        return false;
+    }
 
-        return response;
+private:
+    WiFiNetworkStatus _status = WiFiNetworkStatus::DISCONNECTED;
+    WiFiClient _client;
+    IPAddress _serverIP;    // Last lookup, reused by probes
+    #if SERVER_TLS_ENABLE
+    TlsContext _tls;    // Keeps the session between reports
+    #endif
+
+    bool resolve(const char* host, IPAddress& ip) {
+        TRACE_SPAN("dns");
+        Metrics::ScopedTimer<Metrics::LatencyHistogram> timer(Metrics::registry.httpDns);
+        return WiFi.hostByName(host, ip) == 1;
     }
 };
 
@@ -4,8 +4,10 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include "../config.h"
+#include "arena.h"
 #include "gps_module.h"
-#include "webpage_renderer.h"
+#include "http_request.h"
+#include "web_router.h"
 
 class WiFiWebServerModule {
 public:
@@ -15,29 +17,38 @@ public:
         _server.begin();
     }
 
-    void handle(const GPSData& gpsData, bool gpsValid) {
+    /**
+     * No interrupt source for lwIP sockets; the web task polls
+     */
+    bool attachInterrupt(void (*isr)()) {
+        (void)isr;
+        return false;
+    }
+
+    /**
+     * Serve every pending connection
+     */
+    bool handle(const WebContext& ctx) {
+        while (handleOne(ctx)) {}
+        return true;
+    }
+
+private:
+    WiFiServer _server;
+
+    bool handleOne(const WebContext& ctx) {
         WiFiClient client = _server.available();
-        if (!client) return;
-
-        boolean blankLine = false;
-
-        while (client.connected()) {
-            if (client.available()) {
-                char c = client.read();
-                if (c == '\n' && blankLine) {
-                    WebPage::render(client, gpsData, gpsValid);
-                    break;
-                }
-                if (c == '\n') blankLine = true;
-                else if (c != '\r') blankLine = false;
-            }
+        if (!client) return false;
+
+        Memory::web.reset();
+        HttpRequest request;
+        if (request.read(client)) {
+            WebRouter::dispatch(client, request, ctx);
         }
         delay(1);
         client.stop();
+        return true;
     }
-
-private:
-    WiFiServer _server;
 };
 
 #endif // WIFI_WEBSERVER_MODULE_H
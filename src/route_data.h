@@ -0,0 +1,32 @@
+// Generated by tools/route/build_route.py from example_route.geojson; do not edit
+#ifndef ROUTE_DATA_H
+#define ROUTE_DATA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+alignas(4) static const uint8_t ROUTE_BLOB[] = {
+    0x52, 0x54, 0x45, 0x31, 0x01, 0x00, 0x02, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc8, 0x42,
+    0x92, 0xf0, 0x5c, 0xfc, 0xd2, 0x1c, 0xa8, 0x3f, 0x8c, 0x01, 0x01, 0x00, 0x8c, 0x01, 0x01, 0x00,
+    0x04, 0x00, 0x03, 0x00, 0x14, 0x00, 0x00, 0x00, 0xc0, 0x36, 0x5d, 0xfc, 0x00, 0x63, 0xa8, 0x3f,
+    0x95, 0x08, 0xa6, 0x43, 0x7f, 0xfa, 0xa6, 0x43, 0xdc, 0x79, 0xeb, 0x43, 0x00, 0x00, 0x00, 0x00,
+    0xf0, 0xab, 0x5d, 0xfc, 0x30, 0xd8, 0xa8, 0x3f, 0xd2, 0x08, 0xa6, 0x43, 0x7f, 0xfa, 0xa6, 0x43,
+    0x07, 0x7a, 0xeb, 0x43, 0xdc, 0x79, 0xeb, 0x43, 0x20, 0x21, 0x5e, 0xfc, 0x60, 0x4d, 0xa9, 0x3f,
+    0x19, 0x09, 0x26, 0x43, 0x54, 0xa3, 0xde, 0x43, 0xc3, 0x9c, 0xed, 0x43, 0xf1, 0x79, 0x6b, 0x44,
+    0x60, 0xbd, 0x5e, 0xfc, 0xf8, 0x87, 0xa9, 0x3f, 0x6a, 0x09, 0x26, 0x43, 0x54, 0xa3, 0xde, 0x43,
+    0xd1, 0x9c, 0xed, 0x43, 0x29, 0x24, 0xb1, 0x44, 0xa0, 0x59, 0x5f, 0xfc, 0x90, 0xc2, 0xa9, 0x3f,
+    0xb1, 0x09, 0xa6, 0x43, 0x7f, 0xfa, 0xa6, 0x43, 0xa4, 0x7a, 0xeb, 0x43, 0x5e, 0x8b, 0xec, 0x44,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0xb5, 0x13, 0x45,
+    0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00,
+    0x09, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x0e, 0x00, 0x00, 0x00,
+    0x11, 0x00, 0x00, 0x00, 0x12, 0x00, 0x00, 0x00, 0x12, 0x00, 0x00, 0x00, 0x13, 0x00, 0x00, 0x00,
+    0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x03, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+    0x04, 0x00, 0x00, 0x00,
+};
+static const size_t ROUTE_BLOB_SIZE = sizeof(ROUTE_BLOB);
+
+#endif // ROUTE_DATA_H
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Compare two benchmark runs and flag regressions.
+
+Inputs are either the JSON written by `--json <file>` or a raw serial log
+containing BENCH_JSON_BEGIN / BENCH_JSON_END.
+
+Usage:
+    python3 tools/bench/compare.py baseline.json current.json [--threshold 10]
+
+Exit status is 1 if any case got slower than the threshold (percent) or
+allocates more often or more heap bytes than before. Runs from before
+processed_bytes_per_op existed reported processed bytes as bytes_per_op,
+so their heap bytes are not compared.
+"""
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        text = f.read()
+    if "BENCH_JSON_BEGIN" in text:
+        text = text.split("BENCH_JSON_BEGIN", 1)[1].split("BENCH_JSON_END", 1)[0]
+    doc = json.loads(text)
+    return doc.get("context", {}), {b["name"]: b for b in doc["benchmarks"]}
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("baseline")
+    ap.add_argument("current")
+    ap.add_argument("--threshold", type=float, default=10.0,
+                    help="allowed ns/op increase in percent")
+    args = ap.parse_args()
+
+    base_ctx, base = load(args.baseline)
+    cur_ctx, cur = load(args.current)
+    if base_ctx.get("platform") != cur_ctx.get("platform"):
+        print("warning: comparing %s against %s" % (base_ctx.get("platform"), cur_ctx.get("platform")),
+              file=sys.stderr)
+
+    print("%-28s %12s %12s %8s %10s %10s" % ("benchmark", "base ns/op", "cur ns/op", "delta", "base alloc", "cur alloc"))
+    regressed = False
+    for name in sorted(set(base) | set(cur)):
+        if name not in base or name not in cur:
+            print("%-28s %s" % (name, "only in " + ("current" if name in cur else "baseline")))
+            continue
+        b, c = base[name], cur[name]
+        delta = (c["ns_per_op"] - b["ns_per_op"]) * 100.0 / b["ns_per_op"] if b["ns_per_op"] else 0.0
+        mark = ""
+        if delta > args.threshold:
+            mark = "  SLOWER"
+            regressed = True
+        if c["allocs_per_op"] > b["allocs_per_op"]:
+            mark += "  ALLOCS"
+            regressed = True
+        elif "processed_bytes_per_op" in b and c["bytes_per_op"] > b["bytes_per_op"]:
+            mark += "  HEAP"
+            regressed = True
+        print("%-28s %12.1f %12.1f %+7.1f%% %10.2f %10.2f%s" % (
+            name, b["ns_per_op"], c["ns_per_op"], delta, b["allocs_per_op"], c["allocs_per_op"], mark))
+
+    return 1 if regressed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,324 @@
+#ifndef FLEET_RECEIVER_H
+#define FLEET_RECEIVER_H
+
+/**
+ * @file fleet_receiver.h
+ * @brief Reference ingest endpoint for the fleet simulator
+ *
+ * What a minimal webhook backend does per report: read the request,
+ * parse the JSON body, check that it names a device, answer and close
+ * (trackers send Connection: close). Each thread runs its own
+ * SO_REUSEPORT listener and epoll loop, so the kernel spreads the
+ * connections without a shared accept queue.
+ *
+ * Reports with a sequence number ("seq", report_outbox.h) are stored
+ * once: a copy is counted as a duplicate. The answer carries X-Ack-Seq,
+ * the highest sequence up to which the device's reports are all stored
+ * (or given up below its "seq_base"). dropResponses() stores a share of
+ * the reports but closes without an answer, as when the response is
+ * lost on the way back.
+ *
+ * CPU time is read per receiver thread, so the simulated trackers in
+ * the same process do not count against the backend.
+ */
+
+#include <ArduinoJson.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../../src/config.h"
+
+#ifndef FLEET_RECEIVER_BACKLOG
+#define FLEET_RECEIVER_BACKLOG      4096
+#endif
+#ifndef FLEET_RECEIVER_MAX_REQUEST
+#define FLEET_RECEIVER_MAX_REQUEST  4096
+#endif
+
+class FleetReceiver {
+public:
+    struct Totals {
+        uint64_t requests;      // Stored reports
+        uint64_t rejected;      // Malformed request or body
+        uint64_t duplicates;    // Sequence already stored
+        uint64_t unanswered;    // Stored, response dropped on purpose
+        uint64_t bytesIn;
+        uint64_t bytesOut;
+        uint64_t cpuNs;         // All receiver threads
+    };
+
+    /**
+     * Sequence state of one device
+     */
+    struct Ledger {
+        uint32_t watermark = 0;         // Everything up to here stored or given up
+        std::set<uint32_t> above;       // Stored beyond a gap
+    };
+
+    ~FleetReceiver() { stop(); }
+
+    /**
+     * Listen on port (all interfaces) with one loop per thread
+     */
+    bool start(uint16_t port, size_t threads) {
+        _running = true;
+        for (size_t i = 0; i < threads; i++) {
+            std::unique_ptr<Loop> loop(new Loop());
+            loop->listenFd = listenOn(port);
+            loop->epollFd = epoll_create1(0);
+            if (loop->listenFd < 0 || loop->epollFd < 0) {
+                if (loop->listenFd >= 0) close(loop->listenFd);
+                if (loop->epollFd >= 0) close(loop->epollFd);
+                stop();
+                return false;
+            }
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = loop->listenFd;
+            epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->listenFd, &ev);
+            Loop* raw = loop.get();
+            loop->thread = std::thread([this, raw] { run(*raw); });
+            _loops.push_back(std::move(loop));
+        }
+        return true;
+    }
+
+    /**
+     * Store pct % of the reports without answering (before start())
+     */
+    void dropResponses(uint32_t pct) { _dropPct = pct; }
+
+    /**
+     * Call fn(deviceId, ledger) for every device that sent a sequence
+     */
+    template <typename Fn>
+    void forEachLedger(Fn fn) {
+        std::lock_guard<std::mutex> lock(_ledgerMutex);
+        for (const auto& entry : _ledgers) fn(entry.first.c_str(), entry.second);
+    }
+
+    void stop() {
+        _running = false;
+        for (auto& loop : _loops) {
+            if (loop->thread.joinable()) loop->thread.join();
+            if (loop->listenFd >= 0) close(loop->listenFd);
+            if (loop->epollFd >= 0) close(loop->epollFd);
+        }
+        _loops.clear();
+    }
+
+    Totals totals() const {
+        Totals t{0, 0, 0, 0, 0, 0, 0};
+        for (const auto& loop : _loops) {
+            t.requests += loop->requests.load(std::memory_order_relaxed);
+            t.rejected += loop->rejected.load(std::memory_order_relaxed);
+            t.duplicates += loop->duplicates.load(std::memory_order_relaxed);
+            t.unanswered += loop->unanswered.load(std::memory_order_relaxed);
+            t.bytesIn += loop->bytesIn.load(std::memory_order_relaxed);
+            t.bytesOut += loop->bytesOut.load(std::memory_order_relaxed);
+            t.cpuNs += threadCpuNs(*loop);
+        }
+        return t;
+    }
+
+private:
+    struct Connection {
+        char data[FLEET_RECEIVER_MAX_REQUEST];
+        size_t len = 0;
+    };
+
+    struct Loop {
+        int listenFd = -1;
+        int epollFd = -1;
+        std::thread thread;
+        std::unordered_map<int, std::unique_ptr<Connection>> connections;
+        std::atomic<uint64_t> requests{0}, rejected{0}, duplicates{0}, unanswered{0}, bytesIn{0}, bytesOut{0};
+        uint32_t answers = 0;   // Picks the responses to drop
+    };
+
+    /**
+     * What store() made of a request
+     */
+    struct Stored {
+        bool ok;
+        bool duplicate;
+        bool sequenced;
+        uint32_t ack;
+    };
+
+    std::vector<std::unique_ptr<Loop>> _loops;
+    std::atomic<bool> _running{false};
+    uint32_t _dropPct = 0;
+    std::mutex _ledgerMutex;
+    std::unordered_map<std::string, Ledger> _ledgers;
+
+    static int listenOn(uint16_t port) {
+        const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0) return -1;
+        const int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, FLEET_RECEIVER_BACKLOG) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    static uint64_t threadCpuNs(Loop& loop) {
+        clockid_t clock;
+        timespec ts;
+        if (pthread_getcpuclockid(loop.thread.native_handle(), &clock) != 0) return 0;
+        if (clock_gettime(clock, &ts) != 0) return 0;
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    void run(Loop& loop) {
+        epoll_event events[64];
+        while (_running) {
+            const int n = epoll_wait(loop.epollFd, events, 64, 50);
+            for (int i = 0; i < n; i++) {
+                if (events[i].data.fd == loop.listenFd) {
+                    acceptAll(loop);
+                } else {
+                    receive(loop, events[i].data.fd);
+                }
+            }
+        }
+        for (auto& c : loop.connections) close(c.first);
+        loop.connections.clear();
+    }
+
+    void acceptAll(Loop& loop) {
+        for (;;) {
+            const int fd = accept4(loop.listenFd, nullptr, nullptr, SOCK_NONBLOCK);
+            if (fd < 0) return;
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(loop.epollFd, EPOLL_CTL_ADD, fd, &ev);
+            loop.connections[fd].reset(new Connection());
+        }
+    }
+
+    void receive(Loop& loop, int fd) {
+        auto it = loop.connections.find(fd);
+        if (it == loop.connections.end()) return;
+        Connection& c = *it->second;
+
+        // Read what is there; a request too large is judged as it is
+        bool full = false;
+        for (;;) {
+            if (c.len == sizeof(c.data) - 1) {
+                full = true;
+                break;
+            }
+            const ssize_t n = recv(fd, c.data + c.len, sizeof(c.data) - 1 - c.len, 0);
+            if (n > 0) {
+                c.len += n;
+                loop.bytesIn.fetch_add(n, std::memory_order_relaxed);
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                finish(loop, fd);   // Closed before a full request
+                return;
+            }
+        }
+        c.data[c.len] = '\0';
+
+        char* body = strstr(c.data, "\r\n\r\n");
+        if (!body && !full) return;
+        size_t contentLength = 0;
+        if (body) {
+            body += 4;
+            const char* field = strcasestr(c.data, "\r\nContent-Length:");
+            if (field && field < body) contentLength = strtoul(field + 17, nullptr, 10);
+            if ((size_t)(c.data + c.len - body) < contentLength && !full) return;
+        }
+
+        Stored stored{false, false, false, 0};
+        if (body && strncmp(c.data, "POST ", 5) == 0) stored = store(body, contentLength);
+        if (stored.duplicate) {
+            loop.duplicates.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            (stored.ok ? loop.requests : loop.rejected).fetch_add(1, std::memory_order_relaxed);
+        }
+        if (stored.ok && _dropPct && (++loop.answers * 2654435761u >> 16) % 100 < _dropPct) {
+            loop.unanswered.fetch_add(1, std::memory_order_relaxed);
+            finish(loop, fd);
+            return;
+        }
+
+        static const char OK[] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                                 "Content-Length: 11\r\nConnection: close\r\n\r\n{\"ok\":true}";
+        static const char BAD[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        char acked[160];
+        const char* response = stored.ok ? OK : BAD;
+        size_t length = stored.ok ? sizeof(OK) - 1 : sizeof(BAD) - 1;
+        if (stored.sequenced) {
+            length = snprintf(acked, sizeof(acked),
+                              "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nX-Ack-Seq: %u\r\n"
+                              "Content-Length: 11\r\nConnection: close\r\n\r\n{\"ok\":true}",
+                              (unsigned)stored.ack);
+            response = acked;
+        }
+        const ssize_t sent = send(fd, response, length, MSG_NOSIGNAL);
+        if (sent > 0) loop.bytesOut.fetch_add(sent, std::memory_order_relaxed);
+        finish(loop, fd);
+    }
+
+    // What a backend would check before it stores the report (parsed in
+    // place, like the tracker's own document)
+    Stored store(char* body, size_t length) {
+        Stored stored{false, false, false, 0};
+        StaticJsonDocument<JSON_BUFFER_SIZE> doc;
+        if (deserializeJson(doc, body, length) != DeserializationError::Ok) return stored;
+        const char* device = doc["device_id"];
+        const char* status = doc["status"];
+        stored.ok = device && *device && status;
+        const uint32_t seq = doc["seq"] | 0u;
+        if (!stored.ok || seq == 0) return stored;
+
+        stored.sequenced = true;
+        std::lock_guard<std::mutex> lock(_ledgerMutex);
+        Ledger& ledger = _ledgers[device];
+        stored.duplicate = seq <= ledger.watermark || !ledger.above.insert(seq).second;
+        const uint32_t base = doc["seq_base"] | 0u;
+        if (base > ledger.watermark + 1) ledger.watermark = base - 1;  // Given up by the device
+        auto it = ledger.above.begin();
+        while (it != ledger.above.end() && *it <= ledger.watermark + 1) {
+            ledger.watermark = std::max(ledger.watermark, *it);
+            it = ledger.above.erase(it);
+        }
+        stored.ack = ledger.watermark;
+        return stored;
+    }
+
+    static void finish(Loop& loop, int fd) {
+        epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        loop.connections.erase(fd);
+    }
+};
+
+#endif // FLEET_RECEIVER_H
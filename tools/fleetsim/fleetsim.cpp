@@ -0,0 +1,498 @@
+/**
+ * @file fleetsim.cpp
+ * @brief Fleet load generator against a reference ingest receiver (host)
+ *
+ * Shows what report interval and payload changes do to the backend
+ * before a fleet is switched over. Thousands of simulated trackers
+ * follow synthetic vessels (vessel_track.h) on a virtual fleet clock and
+ * report the way GPSTrackerApp does: every SEND_INTERVAL_NORMAL with a
+ * fix, every SEND_INTERVAL_NO_FIX without one, at once when the fix
+ * comes back, and out of band at each trip start and end (TRIP_ENABLE),
+ * which restarts the interval.
+ *
+ * Reports go through the firmware's HttpUpload::post (payload, request
+ * and response handling) over real sockets to FleetReceiver. A pool of
+ * workers, each with its own cycle arena, plays the trackers' uploader
+ * tasks; a tracker is never in flight twice. The fleet clock runs as
+ * fast as the workers get reports through, or at --speedup times real
+ * time. Latencies and receiver CPU are real.
+ *
+ *   pio run -e fleetsim_native
+ *   .pio/build/fleetsim_native/program --trackers 1000,5000 --interval 10,30 --payload base,full
+ *   .pio/build/fleetsim_native/program --receive-only --port 8010 --drop-responses 20
+ *
+ * Options:
+ *   --trackers <n,..>       Fleet sizes (default 1000)
+ *   --interval <s,..>       Report interval with a fix (SEND_INTERVAL_NORMAL)
+ *   --payload <p,..>        base | trip | route | full: which of TRIP_ENABLE
+ *                           and ROUTE_ENABLE the firmware is built with (full)
+ *   --no-fix-interval <s>   Report interval without a fix (SEND_INTERVAL_NO_FIX)
+ *   --dropout-pct <n>       Share of voyage legs with a GPS dropout (5)
+ *   --minutes <n>           Fleet time per configuration (60)
+ *   --connections <n>       Reports in flight at once (32)
+ *   --receiver-threads <n>  Receiver event loops (4)
+ *   --port <n>              Receiver port (8090)
+ *   --speedup <x>           Pace the fleet clock at x times real time (0 = flat out)
+ *   --json <file>           Results as JSON
+ *   --receive-only          Only run the receiver (for real or native trackers)
+ *   --drop-responses <pct>  Store that share of reports without answering
+ *
+ * Every combination of the list options is one configuration.
+ */
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <poll.h>
+#include <signal.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "fleet_receiver.h"
+#include "vessel_track.h"
+#include "../../src/config.h"
+#include "../../src/modules/arena.h"
+#include "../../src/modules/http_upload.h"
+
+using SteadyClock = std::chrono::steady_clock;
+
+static constexpr uint32_t FLEET_START_EPOCH = 1790812800;   // 2026-10-01 00:00 UTC
+
+enum class Payload : uint8_t { BASE, TRIP, ROUTE, FULL };
+static const char* const PAYLOAD_NAMES[] = {"base", "trip", "route", "full"};
+
+static bool hasTrip(Payload p) { return p == Payload::TRIP || p == Payload::FULL; }
+static bool hasRoute(Payload p) { return p == Payload::ROUTE || p == Payload::FULL; }
+
+struct FleetConfig {
+    uint32_t trackers;
+    uint32_t intervalS;
+    Payload payload;
+};
+
+struct Options {
+    std::vector<uint32_t> trackers{1000};
+    std::vector<uint32_t> intervals{SEND_INTERVAL_NORMAL / 1000};
+    std::vector<Payload> payloads{Payload::FULL};
+    uint32_t noFixIntervalS = SEND_INTERVAL_NO_FIX / 1000;
+    uint32_t dropoutPct = 5;
+    uint32_t minutes = 60;
+    uint32_t connections = 32;
+    uint32_t receiverThreads = 4;
+    uint16_t port = 8090;
+    double speedup = 0;
+    const char* jsonPath = nullptr;
+    bool receiveOnly = false;
+    uint32_t dropResponsesPct = 0;
+};
+
+struct FleetResult {
+    FleetConfig config;
+    uint64_t reports;
+    uint64_t failed;            // No answer, or not 2xx
+    uint64_t rejected;          // Refused by the receiver
+    double wallS;
+    double fleetRps;            // At the fleet's own pace
+    double fleetBytesPerS;
+    double bytesPerReport;      // Request and response
+    double simRps;              // Achieved by the simulation
+    double p50Ms, p99Ms, p999Ms, maxMs;
+    double cpuUsPerReport;      // Receiver
+    double cores;               // Receiver CPU at the fleet's pace
+};
+
+/**
+ * One report as the uploader task would send it
+ */
+struct Report {
+    uint32_t tracker;
+    GPSData fix;
+    TripStatus trip;
+    RouteStatus route;
+    TripEvent event;
+    bool withTrip;
+    bool withRoute;
+    bool withEvent;
+};
+
+/**
+ * Blocks in poll() while waiting for the response, so the workers leave
+ * the CPU to the receiver instead of spinning in readHttpResponse
+ */
+class FleetClient : public EthernetClient {
+public:
+    int available() override {
+        const int n = EthernetClient::available();
+        if (n > 0 || fd() < 0) return n;
+        pollfd p{fd(), POLLIN, 0};
+        poll(&p, 1, 1);
+        return EthernetClient::available();
+    }
+};
+
+/**
+ * Bounded hand-off from the fleet clock to the upload workers
+ */
+class ReportQueue {
+public:
+    explicit ReportQueue(size_t capacity) : _capacity(capacity) {}
+
+    void push(const Report& report) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notFull.wait(lock, [this] { return _reports.size() < _capacity; });
+        _reports.push_back(report);
+        _notEmpty.notify_one();
+    }
+
+    /**
+     * @return false once closed and empty
+     */
+    bool pop(Report& report) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notEmpty.wait(lock, [this] { return !_reports.empty() || _closed; });
+        if (_reports.empty()) return false;
+        report = _reports.front();
+        _reports.pop_front();
+        _notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _notEmpty.notify_all();
+    }
+
+private:
+    const size_t _capacity;
+    std::mutex _mutex;
+    std::condition_variable _notEmpty, _notFull;
+    std::deque<Report> _reports;
+    bool _closed = false;
+};
+
+/**
+ * One uploader: sends queued reports with the firmware's upload code
+ */
+class UploadWorker {
+public:
+    std::vector<uint32_t> latencyUs;
+    uint64_t failed = 0;
+
+    void run(ReportQueue& queue, uint16_t port) {
+        Report r;
+        while (queue.pop(r)) {
+            char deviceId[24];
+            char localIp[16];
+            snprintf(deviceId, sizeof(deviceId), "%s%06X", DEVICE_ID_PREFIX, (unsigned)r.tracker);
+            snprintf(localIp, sizeof(localIp), "10.%u.%u.%u", (unsigned)(r.tracker >> 16 & 0xFF),
+                     (unsigned)(r.tracker >> 8 & 0xFF), (unsigned)(r.tracker & 0xFF));
+
+            HttpUpload::ReportExtras extras;
+            if (r.withTrip) extras.trip = &r.trip;
+            if (r.withRoute) extras.route = &r.route;
+            if (r.withEvent) extras.tripEvent = &r.event;
+
+            _arena.reset();     // Per-cycle buffers start empty
+            const auto start = SteadyClock::now();
+            const HttpResponse response = HttpUpload::post(_client, IPAddress(127, 0, 0, 1), SERVER_HOST, SERVER_PATH,
+                                                           port, deviceId, r.fix, localIp, extras, _arena);
+            latencyUs.push_back((uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                SteadyClock::now() - start).count());
+            if (!response.success) failed++;
+        }
+    }
+
+private:
+    StaticArena<CYCLE_ARENA_SIZE> _arena{"fleet"};
+    FleetClient _client;
+};
+
+/**
+ * Pending report on the fleet clock; stale once the tracker reported
+ * since it was scheduled
+ */
+struct Due {
+    uint64_t ms;
+    uint32_t tracker;
+    uint32_t generation;
+
+    bool operator>(const Due& other) const { return ms > other.ms; }
+};
+
+struct SimTracker {
+    VesselTrack vessel;
+    uint32_t generation;
+};
+
+class FleetSim {
+public:
+    FleetSim(const Options& options, FleetReceiver& receiver) : _options(options), _receiver(receiver) {}
+
+    FleetResult run(const FleetConfig& config) {
+        const uint64_t endMs = (uint64_t)_options.minutes * 60000;
+        const uint64_t intervalMs = (uint64_t)config.intervalS * 1000;
+        std::vector<SimTracker> trackers(config.trackers);
+        std::priority_queue<Due, std::vector<Due>, std::greater<Due>> due;
+        for (uint32_t i = 0; i < config.trackers; i++) {
+            trackers[i].vessel.begin(i + 1, _options.dropoutPct, FLEET_START_EPOCH);
+            trackers[i].generation = 0;
+            // Trackers booted at random times: spread over one interval
+            due.push(Due{(uint64_t)i * intervalMs / config.trackers, i, 0});
+        }
+
+        ReportQueue queue(_options.connections * 2);
+        std::vector<UploadWorker> workers(_options.connections);
+        std::vector<std::thread> threads;
+        for (UploadWorker& w : workers) {
+            threads.emplace_back([&w, &queue, this] { w.run(queue, _options.port); });
+        }
+
+        const FleetReceiver::Totals before = _receiver.totals();
+        const auto wallStart = SteadyClock::now();
+        uint64_t reports = 0;
+
+        while (!due.empty() && due.top().ms < endMs) {
+            const Due d = due.top();
+            due.pop();
+            SimTracker& t = trackers[d.tracker];
+            if (d.generation != t.generation) continue;
+            if (_options.speedup > 0) {
+                std::this_thread::sleep_until(wallStart + std::chrono::microseconds(
+                    (uint64_t)(d.ms * 1000 / _options.speedup)));
+            }
+
+            const VesselEvents events = t.vessel.advance((uint32_t)(d.ms / 1000));
+            Report r;
+            r.tracker = d.tracker;
+            t.vessel.fix(r.fix);
+            r.withTrip = hasTrip(config.payload);
+            r.withRoute = hasRoute(config.payload) && r.fix.valid;
+            r.withEvent = r.withTrip && (events.tripStarted || events.tripEnded);
+            if (r.withTrip) r.trip = t.vessel.trip();
+            if (r.withRoute) r.route = t.vessel.route();
+            if (r.withEvent) r.event = TripEvent{events.tripEnded, events.tripEnded ? t.vessel.lastTrip() : r.trip.trip};
+            queue.push(r);
+            reports++;
+
+            // Next report: the interval restarts from this one
+            t.generation++;
+            const uint64_t next = d.ms + (r.fix.valid ? intervalMs : (uint64_t)_options.noFixIntervalS * 1000);
+            due.push(Due{next, d.tracker, t.generation});
+            uint64_t early = VesselTrack::NEVER;
+            if (!r.fix.valid) early = t.vessel.fixReturnS();
+            if (r.withTrip) early = std::min<uint64_t>(early, t.vessel.nextEventS());
+            if (early != VesselTrack::NEVER && early * 1000 > d.ms && early * 1000 < next) {
+                due.push(Due{early * 1000, d.tracker, t.generation});
+            }
+        }
+
+        queue.close();
+        for (std::thread& th : threads) th.join();
+        const double wallS = std::chrono::duration<double>(SteadyClock::now() - wallStart).count();
+        const FleetReceiver::Totals after = _receiver.totals();
+
+        std::vector<uint32_t> latencies;
+        latencies.reserve(reports);
+        uint64_t failed = 0;
+        for (UploadWorker& w : workers) {
+            latencies.insert(latencies.end(), w.latencyUs.begin(), w.latencyUs.end());
+            failed += w.failed;
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        FleetResult result{};
+        result.config = config;
+        result.reports = reports;
+        result.failed = failed;
+        result.rejected = after.rejected - before.rejected;
+        result.wallS = wallS;
+        const double fleetS = endMs / 1000.0;
+        const uint64_t stored = after.requests - before.requests;
+        const uint64_t bytes = (after.bytesIn - before.bytesIn) + (after.bytesOut - before.bytesOut);
+        result.fleetRps = reports / fleetS;
+        result.fleetBytesPerS = bytes / fleetS;
+        result.bytesPerReport = reports ? (double)bytes / reports : 0;
+        result.simRps = wallS > 0 ? reports / wallS : 0;
+        result.p50Ms = percentileMs(latencies, 0.50);
+        result.p99Ms = percentileMs(latencies, 0.99);
+        result.p999Ms = percentileMs(latencies, 0.999);
+        result.maxMs = latencies.empty() ? 0 : latencies.back() / 1000.0;
+        result.cpuUsPerReport = stored ? (after.cpuNs - before.cpuNs) / 1000.0 / stored : 0;
+        result.cores = result.fleetRps * result.cpuUsPerReport / 1e6;
+        return result;
+    }
+
+private:
+    const Options& _options;
+    FleetReceiver& _receiver;
+
+    static double percentileMs(const std::vector<uint32_t>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        const size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+        return sorted[i] / 1000.0;
+    }
+};
+
+// ============================================
+// Command line
+// ============================================
+static volatile sig_atomic_t g_stop = 0;
+
+static std::vector<uint32_t> parseList(const char* arg) {
+    std::vector<uint32_t> values;
+    for (const char* p = arg; *p;) {
+        values.push_back((uint32_t)strtoul(p, (char**)&p, 10));
+        if (*p == ',') p++;
+        else break;
+    }
+    return values;
+}
+
+static bool parsePayloads(const char* arg, std::vector<Payload>& out) {
+    out.clear();
+    char buffer[64];
+    strncpy(buffer, arg, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    for (char* name = strtok(buffer, ","); name; name = strtok(nullptr, ",")) {
+        size_t i = 0;
+        while (i < 4 && strcmp(name, PAYLOAD_NAMES[i])) i++;
+        if (i == 4) return false;
+        out.push_back((Payload)i);
+    }
+    return !out.empty();
+}
+
+static void printHeader() {
+    printf("%8s %8s %7s %9s %9s %10s %8s %9s %8s %8s %8s %8s %10s %7s %7s\n",
+           "trackers", "interval", "payload", "reports", "fleet_rps", "fleet_kB_s", "B/report",
+           "sim_rps", "p50_ms", "p99_ms", "p999_ms", "max_ms", "cpu_us/rpt", "cores", "errors");
+}
+
+static void printResult(const FleetResult& r) {
+    printf("%8u %7us %7s %9llu %9.1f %10.1f %8.0f %9.0f %8.2f %8.2f %8.2f %8.2f %10.1f %7.3f %7llu\n",
+           (unsigned)r.config.trackers, (unsigned)r.config.intervalS, PAYLOAD_NAMES[(size_t)r.config.payload],
+           (unsigned long long)r.reports, r.fleetRps, r.fleetBytesPerS / 1000, r.bytesPerReport, r.simRps,
+           r.p50Ms, r.p99Ms, r.p999Ms, r.maxMs, r.cpuUsPerReport, r.cores,
+           (unsigned long long)(r.failed + r.rejected));
+}
+
+static bool writeJson(const char* path, const Options& o, const std::vector<FleetResult>& results) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\"context\":{\"firmware\":\"%s\",\"minutes\":%u,\"connections\":%u,\"receiver_threads\":%u,"
+               "\"speedup\":%g,\"dropout_pct\":%u},\n\"configurations\":[\n",
+            FIRMWARE_VERSION, (unsigned)o.minutes, (unsigned)o.connections, (unsigned)o.receiverThreads,
+            o.speedup, (unsigned)o.dropoutPct);
+    for (size_t i = 0; i < results.size(); i++) {
+        const FleetResult& r = results[i];
+        fprintf(f, "{\"trackers\":%u,\"interval_s\":%u,\"payload\":\"%s\",\"reports\":%llu,\"failed\":%llu,"
+                   "\"rejected\":%llu,\"fleet_rps\":%.2f,\"fleet_bytes_per_s\":%.0f,\"bytes_per_report\":%.1f,"
+                   "\"sim_rps\":%.1f,\"wall_s\":%.2f,\"latency_ms\":{\"p50\":%.3f,\"p99\":%.3f,\"p999\":%.3f,"
+                   "\"max\":%.3f},\"receiver_cpu_us_per_report\":%.2f,\"receiver_cores\":%.4f}%s\n",
+                (unsigned)r.config.trackers, (unsigned)r.config.intervalS, PAYLOAD_NAMES[(size_t)r.config.payload],
+                (unsigned long long)r.reports, (unsigned long long)r.failed, (unsigned long long)r.rejected,
+                r.fleetRps, r.fleetBytesPerS, r.bytesPerReport, r.simRps, r.wallS, r.p50Ms, r.p99Ms, r.p999Ms,
+                r.maxMs, r.cpuUsPerReport, r.cores, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "]}\n");
+    fclose(f);
+    return true;
+}
+
+/**
+ * Receiver alone: rates every 10 s until interrupted, then where every
+ * sequence-numbering device stands
+ */
+static int receiveOnly(FleetReceiver& receiver, uint16_t port) {
+    signal(SIGINT, [](int) { g_stop = 1; });
+    signal(SIGTERM, [](int) { g_stop = 1; });
+    printf("[fleetsim] receiving on port %u\n", (unsigned)port);
+    FleetReceiver::Totals last = receiver.totals();
+    auto lastTime = SteadyClock::now();
+    while (!g_stop) {
+        for (int i = 0; i < 100 && !g_stop; i++) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const FleetReceiver::Totals now = receiver.totals();
+        const auto nowTime = SteadyClock::now();
+        const double s = std::chrono::duration<double>(nowTime - lastTime).count();
+        const uint64_t stored = now.requests - last.requests;
+        printf("[fleetsim] %.1f req/s, %.1f kB/s in, %llu rejected, %llu duplicates, %llu unanswered, "
+               "%.1f us CPU per report\n",
+               stored / s, (now.bytesIn - last.bytesIn) / s / 1000,
+               (unsigned long long)(now.rejected - last.rejected),
+               (unsigned long long)(now.duplicates - last.duplicates),
+               (unsigned long long)(now.unanswered - last.unanswered),
+               stored ? (now.cpuNs - last.cpuNs) / 1000.0 / stored : 0.0);
+        last = now;
+        lastTime = nowTime;
+    }
+    receiver.forEachLedger([](const char* device, const FleetReceiver::Ledger& ledger) {
+        printf("[fleetsim] %s: complete up to %u, %zu stored beyond a gap\n", device,
+               (unsigned)ledger.watermark, ledger.above.size());
+    });
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        const bool more = i + 1 < argc;
+        if (!strcmp(argv[i], "--trackers") && more) o.trackers = parseList(argv[++i]);
+        else if (!strcmp(argv[i], "--interval") && more) o.intervals = parseList(argv[++i]);
+        else if (!strcmp(argv[i], "--payload") && more) {
+            if (!parsePayloads(argv[++i], o.payloads)) {
+                fprintf(stderr, "[fleetsim] payloads are base, trip, route, full\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--no-fix-interval") && more) o.noFixIntervalS = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--dropout-pct") && more) o.dropoutPct = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--minutes") && more) o.minutes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--connections") && more) o.connections = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--receiver-threads") && more) o.receiverThreads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--port") && more) o.port = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--speedup") && more) o.speedup = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--json") && more) o.jsonPath = argv[++i];
+        else if (!strcmp(argv[i], "--receive-only")) o.receiveOnly = true;
+        else if (!strcmp(argv[i], "--drop-responses") && more) o.dropResponsesPct = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "[fleetsim] unknown option %s (see tools/fleetsim/fleetsim.cpp)\n", argv[i]);
+            return 1;
+        }
+    }
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    FleetReceiver receiver;
+    receiver.dropResponses(std::min<uint32_t>(o.dropResponsesPct, 100));
+    if (!receiver.start(o.port, std::max<uint32_t>(1, o.receiverThreads))) {
+        fprintf(stderr, "[fleetsim] cannot listen on port %u\n", (unsigned)o.port);
+        return 1;
+    }
+    if (o.receiveOnly) return receiveOnly(receiver, o.port);
+    o.connections = std::max<uint32_t>(1, o.connections);
+
+    FleetSim sim(o, receiver);
+    std::vector<FleetResult> results;
+    printHeader();
+    for (uint32_t trackers : o.trackers) {
+        for (uint32_t interval : o.intervals) {
+            for (Payload payload : o.payloads) {
+                if (trackers == 0 || interval == 0) continue;
+                results.push_back(sim.run(FleetConfig{trackers, interval, payload}));
+                printResult(results.back());
+            }
+        }
+    }
+
+    if (o.jsonPath && !writeJson(o.jsonPath, o, results)) {
+        fprintf(stderr, "[fleetsim] cannot write %s\n", o.jsonPath);
+        return 1;
+    }
+    bool failed = false;
+    for (const FleetResult& r : results) failed |= r.failed + r.rejected > 0;
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,253 @@
+#ifndef VESSEL_TRACK_H
+#define VESSEL_TRACK_H
+
+/**
+ * @file vessel_track.h
+ * @brief Synthetic vessels for the fleet simulator
+ *
+ * A vessel shuttles between random anchorages in a bay: it lies at
+ * anchor for a while, then steams to the next one at a steady speed.
+ * Some legs carry a GPS dropout. Everything follows from the vessel's
+ * seed and the fleet clock, so a configuration replays identically.
+ * Queries must move forward in time.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "../../src/modules/gps_module.h"
+#include "../../src/modules/route_tracker.h"
+#include "../../src/modules/trip_analytics.h"
+
+// Jakarta Bay, like tools/nmea/sample_track.nmea
+static constexpr double VESSEL_LAT_MIN = -6.15, VESSEL_LAT_MAX = -5.85;
+static constexpr double VESSEL_LON_MIN = 106.65, VESSEL_LON_MAX = 107.05;
+static constexpr uint32_t VESSEL_DWELL_MIN_S = 600, VESSEL_DWELL_MAX_S = 5400;
+static constexpr double VESSEL_KNOTS_MIN = 6, VESSEL_KNOTS_MAX = 16;
+static constexpr uint32_t VESSEL_DROPOUT_MIN_S = 300, VESSEL_DROPOUT_MAX_S = 1200;
+static constexpr double VESSEL_M_PER_DEG = 111320.0;
+
+/**
+ * What happened since the previous query (out-of-band reports)
+ */
+struct VesselEvents {
+    bool tripStarted;
+    bool tripEnded;
+};
+
+class VesselTrack {
+public:
+    /**
+     * @param dropoutPct Share of legs with a GPS dropout
+     * @param startEpoch Unix time at fleet time 0
+     */
+    void begin(uint32_t seed, uint32_t dropoutPct, uint32_t startEpoch) {
+        _rng = seed * 2654435761u + 1;
+        _dropoutPct = dropoutPct;
+        _startEpoch = startEpoch;
+        _lat = uniform(VESSEL_LAT_MIN, VESSEL_LAT_MAX);
+        _lon = uniform(VESSEL_LON_MIN, VESSEL_LON_MAX);
+        _status = TripStatus{Motion::STOPPED, false, 0, 0, 0, {}};
+
+        // Join the fleet somewhere within a stay at anchor
+        const uint32_t dwell = (uint32_t)uniform(VESSEL_DWELL_MIN_S, VESSEL_DWELL_MAX_S);
+        _underway = false;
+        _stateSince = 0;
+        _departS = (uint32_t)uniform(0, dwell);
+        _tripEndS = NEVER;
+    }
+
+    /**
+     * Move to fleet time t (seconds)
+     */
+    VesselEvents advance(uint32_t t) {
+        VesselEvents events{false, false};
+        for (;;) {
+            if (_underway) {
+                if (_arriveS > t) break;
+                arrive();
+            } else if (_tripEndS <= t && _tripEndS <= _departS) {
+                endTrip(events);
+            } else if (_departS <= t) {
+                depart(events);
+            } else {
+                break;
+            }
+        }
+        _t = t;
+        return events;
+    }
+
+    /**
+     * The fix the receiver would report at the current time
+     */
+    void fix(GPSData& out) const {
+        out.clear();
+        out.epoch = _startEpoch + _t;
+        const GpsDateTime d = gpsBreakEpoch(out.epoch);
+        snprintf(out.datetime, sizeof(out.datetime), "%04u-%02u-%02uT%02u:%02u:%02uZ",
+                 d.year, d.month, d.day, d.hour, d.minute, d.second);
+        out.satellites = 7 + (uint8_t)(_t / 97 % 5);
+        if (_t >= _dropoutFromS && _t < _dropoutUntilS) {
+            out.satellites = 2;
+            return;
+        }
+
+        double lat = _lat, lon = _lon, knots = 0;
+        if (_underway) {
+            const double f = (double)(_t - _departS) / (_arriveS - _departS);
+            lat += (_toLat - _lat) * f;
+            lon += (_toLon - _lon) * f;
+            knots = _knots;
+        }
+        out.valid = true;
+        out.latitude = lat;
+        out.longitude = lon;
+        out.speed = knots * 1.852;
+        out.course = _course;
+        out.altitude = 2.0 + (_t % 7) * 0.1;
+        out.hdop = 0.8f + (float)(_t % 5) * 0.1f;
+        out.locationMs = _t * 1000;
+    }
+
+    /**
+     * Trip figures as TripAnalytics would publish them
+     */
+    TripStatus trip() const {
+        TripStatus s = _status;
+        s.dwellS = _t - _stateSince;
+        if (_underway) {
+            const uint32_t sailed = (uint32_t)(_legM * (_t - _departS) / (_arriveS - _departS));
+            s.odometerM += sailed;
+            s.trip.distanceM += sailed;
+            s.trip.movingS += _t - _departS;
+        }
+        return s;
+    }
+
+    /**
+     * Each leg is one route segment towards the next port
+     */
+    RouteStatus route() const {
+        RouteStatus r{};
+        r.onRoute = r.inCorridor = true;
+        r.nextPortId = (uint16_t)(_legs % 16 + 1);
+        r.crossTrackM = (float)((int32_t)(_t % 61) - 30);
+        if (_underway) {
+            r.progressM = (float)(_legM * (_t - _departS) / (_arriveS - _departS));
+            r.remainingM = (float)_legM - r.progressM;
+            r.speedMps = (float)(_knots * 0.514444);
+            r.etaSeconds = _arriveS - _t;
+        }
+        return r;
+    }
+
+    /**
+     * Fleet time of the next trip start or end, NEVER if none is
+     * planned yet (ask again later)
+     */
+    uint32_t nextEventS() const {
+        if (_underway) return _dwellS >= TRIP_END_STOP_S ? _arriveS + TRIP_END_STOP_S : NEVER;
+        if (_tripEndS != NEVER) return _tripEndS;
+        return _status.inTrip ? NEVER : _departS;
+    }
+
+    /**
+     * When a dropout in progress ends, NEVER if there is a fix
+     */
+    uint32_t fixReturnS() const { return hasFix() ? NEVER : _dropoutUntilS; }
+
+    const TripSummary& lastTrip() const { return _status.trip; }
+    bool hasFix() const { return _t < _dropoutFromS || _t >= _dropoutUntilS; }
+
+    static constexpr uint32_t NEVER = 0xFFFFFFFFu;
+
+private:
+    uint32_t _rng = 1;
+    uint32_t _dropoutPct = 0;
+    uint32_t _startEpoch = 0;
+    uint32_t _t = 0;
+
+    double _lat = 0, _lon = 0;          // Anchorage, or where the leg began
+    double _toLat = 0, _toLon = 0;
+    double _knots = 0, _course = 0, _legM = 0;
+    uint32_t _departS = 0, _arriveS = 0, _tripEndS = NEVER;
+    uint32_t _dwellS = 0;               // At the end of the current leg
+    uint32_t _dropoutFromS = NEVER, _dropoutUntilS = NEVER;
+    uint32_t _stateSince = 0;
+    uint32_t _legs = 0;
+    bool _underway = false;
+    TripStatus _status{};
+
+    uint32_t next() {
+        _rng ^= _rng << 13;
+        _rng ^= _rng >> 17;
+        _rng ^= _rng << 5;
+        return _rng;
+    }
+
+    double uniform(double lo, double hi) { return lo + (hi - lo) * (next() / 4294967296.0); }
+
+    // Next anchorage and the timing of the leg there
+    void planLeg() {
+        _toLat = uniform(VESSEL_LAT_MIN, VESSEL_LAT_MAX);
+        _toLon = uniform(VESSEL_LON_MIN, VESSEL_LON_MAX);
+        _knots = uniform(VESSEL_KNOTS_MIN, VESSEL_KNOTS_MAX);
+        const double north = (_toLat - _lat) * VESSEL_M_PER_DEG;
+        const double east = (_toLon - _lon) * VESSEL_M_PER_DEG * cos(_lat * M_PI / 180);
+        _legM = sqrt(north * north + east * east);
+        _course = fmod(atan2(east, north) * 180 / M_PI + 360, 360);
+        _arriveS = _departS + (uint32_t)(_legM / (_knots * 0.514444)) + 1;
+        _dwellS = (uint32_t)uniform(VESSEL_DWELL_MIN_S, VESSEL_DWELL_MAX_S);
+
+        _dropoutFromS = _dropoutUntilS = NEVER;
+        if (next() % 100 < _dropoutPct) {
+            _dropoutFromS = (uint32_t)uniform(_departS, _arriveS);
+            _dropoutUntilS = _dropoutFromS + (uint32_t)uniform(VESSEL_DROPOUT_MIN_S, VESSEL_DROPOUT_MAX_S);
+        }
+    }
+
+    void depart(VesselEvents& events) {
+        if (!_status.inTrip) {
+            _status.inTrip = true;
+            _status.trips++;
+            _status.trip = TripSummary{_status.trips, _startEpoch + _departS, 0, 0, 0, 0, 0, 0, 0, 0};
+            events.tripStarted = true;
+        } else {
+            _status.trip.stops++;
+            _status.trip.stoppedS += _departS - _stateSince;
+        }
+        _tripEndS = NEVER;
+        _status.motion = Motion::MOVING;
+        _stateSince = _departS;
+        _underway = true;
+        planLeg();
+    }
+
+    void arrive() {
+        const uint32_t sailed = (uint32_t)_legM;
+        const uint32_t speedCms = (uint32_t)(_knots * 51.4444);
+        _status.odometerM += sailed;
+        _status.trip.distanceM += sailed;
+        _status.trip.movingS += _arriveS - _departS;
+        if (speedCms > _status.trip.maxSpeedCms) _status.trip.maxSpeedCms = speedCms;
+        _status.trip.avgSpeedCms = _status.trip.movingS ? _status.trip.distanceM * 100 / _status.trip.movingS : 0;
+        _status.motion = Motion::STOPPED;
+        _stateSince = _arriveS;
+        _underway = false;
+        _lat = _toLat;
+        _lon = _toLon;
+        _legs++;
+
+        _tripEndS = _dwellS >= TRIP_END_STOP_S ? _arriveS + TRIP_END_STOP_S : NEVER;
+        _departS = _arriveS + _dwellS;
+    }
+
+    void endTrip(VesselEvents& events) {
+        _status.inTrip = false;
+        _status.trip.endEpoch = _startEpoch + _tripEndS;
+        _tripEndS = NEVER;
+        events.tripEnded = true;
+    }
+};
+
+#endif // VESSEL_TRACK_H
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Build the geofence blob read by src/modules/geofence.h from GeoJSON.
+
+Each Feature is a Polygon (outer ring only) with properties
+`id` (0..65535) and `kind` (port, anchorage or restricted). The blob holds
+the polygons in E7 fixed point plus a uniform grid: every cell lists the
+fences whose bounding box meets it.
+
+Usage:
+    python3 tools/geofence/build_fences.py fences.geojson --header src/geofence_data.h
+    python3 tools/geofence/build_fences.py fences.geojson --bin fences.bin
+"""
+import argparse
+import json
+import math
+import struct
+import sys
+
+MAGIC = 0x314E4647  # "GFN1"
+VERSION = 1
+KINDS = {"port": 0, "anchorage": 1, "restricted": 2}
+HEADER = struct.Struct("<IHHIiiIIHHI")
+RECORD = struct.Struct("<HBBIIiiii")
+
+
+def e7(value):
+    return int(round(value * 1e7))
+
+
+def load_fences(path):
+    with open(path) as f:
+        doc = json.load(f)
+    fences = []
+    for feature in doc["features"]:
+        geometry = feature["geometry"]
+        if geometry["type"] != "Polygon":
+            sys.exit("feature %r: only Polygon is supported" % feature.get("properties"))
+        props = feature["properties"]
+        ring = [(e7(lat), e7(lon)) for lon, lat in geometry["coordinates"][0]]
+        if ring[0] == ring[-1]:
+            ring.pop()
+        if len(ring) < 3:
+            sys.exit("fence %s: needs at least 3 vertices" % props["id"])
+        lats = [p[0] for p in ring]
+        lons = [p[1] for p in ring]
+        if max(lats) - min(lats) >= 900000000 or max(lons) - min(lons) >= 900000000:
+            sys.exit("fence %s: spans 90 degrees or more" % props["id"])
+        fences.append({
+            "id": int(props["id"]),
+            "kind": KINDS[props["kind"]],
+            "ring": ring,
+            "min": (min(lats), min(lons)),
+            "max": (max(lats), max(lons)),
+        })
+    if not fences or len(fences) > 65535:
+        sys.exit("need 1..65535 fences, got %d" % len(fences))
+    return fences
+
+
+def build(fences, cell_deg=None, max_cells=None):
+    lat0 = min(f["min"][0] for f in fences)
+    lon0 = min(f["min"][1] for f in fences)
+    lat1 = max(f["max"][0] for f in fences)
+    lon1 = max(f["max"][1] for f in fences)
+
+    if cell_deg:
+        cell_lat = cell_lon = e7(cell_deg)
+    else:
+        # About one fence per cell, never smaller than a typical fence
+        sizes = sorted(max(f["max"][0] - f["min"][0], f["max"][1] - f["min"][1]) for f in fences)
+        area = max(lat1 - lat0, 1) * max(lon1 - lon0, 1)
+        cell_lat = cell_lon = max(sizes[len(sizes) // 2], int(math.sqrt(area / len(fences))), 1)
+    max_cells = max_cells or max(4 * len(fences), 64)
+    while True:
+        rows = (lat1 - lat0) // cell_lat + 1
+        cols = (lon1 - lon0) // cell_lon + 1
+        if rows <= 65535 and cols <= 65535 and rows * cols <= max_cells:
+            break
+        cell_lat = cell_lat * 5 // 4 + 1
+        cell_lon = cell_lon * 5 // 4 + 1
+
+    cells = [[] for _ in range(rows * cols)]
+    for index, f in enumerate(fences):
+        r0 = (f["min"][0] - lat0) // cell_lat
+        r1 = (f["max"][0] - lat0) // cell_lat
+        c0 = (f["min"][1] - lon0) // cell_lon
+        c1 = (f["max"][1] - lon0) // cell_lon
+        for r in range(r0, r1 + 1):
+            for c in range(c0, c1 + 1):
+                cells[r * cols + c].append(index)
+
+    vertex_count = sum(len(f["ring"]) for f in fences)
+    entry_count = sum(len(c) for c in cells)
+    out = bytearray(HEADER.pack(MAGIC, VERSION, len(fences), vertex_count, lat0, lon0,
+                                cell_lat, cell_lon, rows, cols, entry_count))
+    first = 0
+    for f in fences:
+        out += RECORD.pack(f["id"], f["kind"], 0, first, len(f["ring"]),
+                           f["min"][0], f["min"][1], f["max"][0], f["max"][1])
+        first += len(f["ring"])
+    for f in fences:
+        for lat, lon in f["ring"]:
+            out += struct.pack("<ii", lat, lon)
+    start = 0
+    for c in cells:
+        out += struct.pack("<I", start)
+        start += len(c)
+    out += struct.pack("<I", start)
+    for c in cells:
+        out += struct.pack("<%dH" % len(c), *c)
+    while len(out) % 4:
+        out.append(0)
+    return bytes(out), rows, cols
+
+
+def write_header(path, blob, source):
+    lines = [
+        "// Generated by tools/geofence/build_fences.py from %s; do not edit" % source,
+        "#ifndef GEOFENCE_DATA_H",
+        "#define GEOFENCE_DATA_H",
+        "",
+        "#include <stdint.h>",
+        "#include <stddef.h>",
+        "",
+        "alignas(4) static const uint8_t GEOFENCE_BLOB[] = {",
+    ]
+    for i in range(0, len(blob), 16):
+        lines.append("    " + " ".join("0x%02x," % b for b in blob[i:i + 16]))
+    lines += [
+        "};",
+        "static const size_t GEOFENCE_BLOB_SIZE = sizeof(GEOFENCE_BLOB);",
+        "",
+        "#endif // GEOFENCE_DATA_H",
+        "",
+    ]
+    with open(path, "w") as f:
+        f.write("\n".join(lines))
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("geojson")
+    ap.add_argument("--header", help="write a C header with GEOFENCE_BLOB")
+    ap.add_argument("--bin", help="write the raw blob")
+    ap.add_argument("--cell-deg", type=float, help="grid cell size in degrees (default: automatic)")
+    args = ap.parse_args()
+
+    fences = load_fences(args.geojson)
+    blob, rows, cols = build(fences, args.cell_deg)
+    if args.header:
+        write_header(args.header, blob, args.geojson.split("/")[-1])
+    if args.bin:
+        with open(args.bin, "wb") as f:
+            f.write(blob)
+    print("%d fences, grid %dx%d, %d bytes" % (len(fences), rows, cols, len(blob)), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
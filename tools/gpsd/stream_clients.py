@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Load and check the tracker's GPS stream (GPSD_PORT / GPSD_NMEA_PORT).
+
+Connects many clients at once, gpsd JSON watchers (?WATCH json), gpsd
+NMEA watchers (?WATCH nmea) and raw NMEA readers, and checks everything
+they receive: NMEA checksums, JSON that parses, TPV reports in time
+order. Optionally adds clients that never read, which the tracker must
+drop without the others losing data. Prints one summary line per kind.
+
+Usage:
+    python3 tools/gpsd/stream_clients.py --json 8 --nmea 8 --raw 8 --seconds 30
+    python3 tools/gpsd/stream_clients.py --host 192.168.1.177 --raw 2 --stalled 1
+"""
+import argparse
+import json
+import select
+import socket
+import threading
+import time
+
+TCP_CLOSE = 7
+TCP_CLOSE_WAIT = 8
+
+
+def nmea_ok(line):
+    if not line.startswith("$") or "*" not in line:
+        return False
+    body, _, checksum = line[1:].partition("*")
+    value = 0
+    for c in body:
+        value ^= ord(c)
+    return checksum[:2].upper() == f"{value:02X}"
+
+
+class Reader(threading.Thread):
+    def __init__(self, kind, host, port, request, deadline):
+        super().__init__(daemon=True)
+        self.kind, self.host, self.port, self.request, self.deadline = kind, host, port, request, deadline
+        self.bytes = self.lines = self.bad = 0
+        self.closed_early = False
+        self.last_time = ""
+
+    def run(self):
+        with socket.create_connection((self.host, self.port), timeout=5) as sock:
+            if self.request:
+                sock.sendall(self.request.encode())
+            buffer = b""
+            sock.settimeout(1)
+            while time.time() < self.deadline:
+                try:
+                    data = sock.recv(65536)
+                except socket.timeout:
+                    continue
+                if not data:
+                    self.closed_early = True
+                    return
+                self.bytes += len(data)
+                buffer += data
+                *lines, buffer = buffer.split(b"\n")
+                for raw in lines:
+                    self.check(raw.decode(errors="replace").strip())
+
+    def check(self, line):
+        if not line:
+            return
+        if line.startswith("{"):
+            try:
+                report = json.loads(line)
+            except ValueError:
+                self.bad += 1
+                return
+            if report.get("class") != "TPV":
+                return
+            if report.get("time", "") < self.last_time:
+                self.bad += 1
+            self.last_time = report.get("time", self.last_time)
+        elif not nmea_ok(line):
+            self.bad += 1
+        self.lines += 1
+
+
+class Stalled(threading.Thread):
+    """Connects and never reads; reports when the tracker hangs up"""
+
+    def __init__(self, host, port, deadline):
+        super().__init__(daemon=True)
+        self.host, self.port, self.deadline = host, port, deadline
+        self.dropped_after = None
+
+    def run(self):
+        sock = socket.socket()
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024)
+        sock.connect((self.host, self.port))
+        start = time.time()
+        while time.time() < self.deadline:
+            time.sleep(0.5)
+            if self.hung_up(sock):
+                self.dropped_after = time.time() - start
+                break
+        sock.close()
+
+    @staticmethod
+    def hung_up(sock):
+        # Unread data hides the EOF from recv(); the peer's FIN shows in
+        # the socket state (Linux) or as a readable hang-up event
+        if hasattr(socket, "TCP_INFO"):
+            state = sock.getsockopt(socket.IPPROTO_TCP, socket.TCP_INFO, 1)[0]
+            return state in (TCP_CLOSE_WAIT, TCP_CLOSE)
+        poller = select.poll()
+        poller.register(sock, select.POLLHUP | getattr(select, "POLLRDHUP", 0))
+        return bool(poller.poll(0))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--gpsd-port", type=int, default=2947)
+    parser.add_argument("--nmea-port", type=int, default=10110)
+    parser.add_argument("--json", type=int, default=4, help="gpsd clients watching TPV")
+    parser.add_argument("--nmea", type=int, default=0, help="gpsd clients watching NMEA")
+    parser.add_argument("--raw", type=int, default=4, help="raw NMEA port clients")
+    parser.add_argument("--stalled", type=int, default=0, help="raw clients that never read")
+    parser.add_argument("--seconds", type=float, default=20)
+    args = parser.parse_args()
+
+    deadline = time.time() + args.seconds
+    readers = (
+        [Reader("gpsd json", args.host, args.gpsd_port, '?WATCH={"enable":true,"json":true};', deadline)
+         for _ in range(args.json)] +
+        [Reader("gpsd nmea", args.host, args.gpsd_port, '?WATCH={"enable":true,"nmea":true};', deadline)
+         for _ in range(args.nmea)] +
+        [Reader("raw nmea", args.host, args.nmea_port, "", deadline) for _ in range(args.raw)])
+    stalled = [Stalled(args.host, args.nmea_port, deadline) for _ in range(args.stalled)]
+    for t in readers + stalled:
+        t.start()
+    for t in readers + stalled:
+        t.join()
+
+    failed = False
+    for kind in ("gpsd json", "gpsd nmea", "raw nmea"):
+        group = [r for r in readers if r.kind == kind]
+        if not group:
+            continue
+        total = sum(r.bytes for r in group)
+        lines = [r.lines for r in group]
+        bad = sum(r.bad for r in group)
+        early = sum(r.closed_early for r in group)
+        print(f"{kind:9}: {len(group)} clients, {total / args.seconds:8.0f} B/s total, "
+              f"lines per client {min(lines)}-{max(lines)}, {bad} bad, {early} disconnected")
+        failed |= bad > 0 or early > 0 or min(lines) == 0
+    if stalled:
+        times = [s.dropped_after for s in stalled]
+        print(f"stalled  : {len(stalled)} clients, dropped: "
+              + ", ".join("no" if t is None else f"after {t:.1f} s" for t in times))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Generate a synthetic NMEA capture (RMC + GGA at 1 Hz) for the native build.
+
+Usage:
+    python3 tools/nmea/gen_track.py --seconds 600 > track.nmea
+"""
+import argparse
+import datetime
+import math
+import sys
+
+
+def checksum(body):
+    c = 0
+    for ch in body:
+        c ^= ord(ch)
+    return "%02X" % c
+
+
+def to_nmea(value, is_lat):
+    hemi = ("N" if value >= 0 else "S") if is_lat else ("E" if value >= 0 else "W")
+    value = abs(value)
+    deg = int(value)
+    minutes = (value - deg) * 60
+    fmt = "%02d%08.5f" if is_lat else "%03d%08.5f"
+    return fmt % (deg, minutes), hemi
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--seconds", type=int, default=300)
+    ap.add_argument("--lat", type=float, default=-6.1000)
+    ap.add_argument("--lng", type=float, default=106.8000)
+    ap.add_argument("--speed-kn", type=float, default=12.0)
+    ap.add_argument("--course", type=float, default=45.0)
+    ap.add_argument("--start", default="2024-05-01T02:00:00")
+    ap.add_argument("--stop-after", type=int, default=0,
+                    help="vessel stops (speed 0) after this many seconds")
+    args = ap.parse_args()
+
+    t0 = datetime.datetime.fromisoformat(args.start)
+    lat, lng = args.lat, args.lng
+    out = sys.stdout
+
+    for i in range(args.seconds):
+        t = t0 + datetime.timedelta(seconds=i)
+        moving = args.stop_after == 0 or i < args.stop_after
+        knots = args.speed_kn if moving else 0.0
+        meters = knots * 0.514444
+        lat += meters * math.cos(math.radians(args.course)) / 111320.0
+        lng += meters * math.sin(math.radians(args.course)) / (111320.0 * math.cos(math.radians(lat)))
+
+        la, lah = to_nmea(lat, True)
+        lo, loh = to_nmea(lng, False)
+        hms = t.strftime("%H%M%S") + ".00"
+        rmc = "GPRMC,%s,A,%s,%s,%s,%s,%.1f,%.1f,%s,,,A" % (
+            hms, la, lah, lo, loh, knots, args.course, t.strftime("%d%m%y"))
+        gga = "GPGGA,%s,%s,%s,%s,%s,1,09,0.9,12.3,M,0.0,M,," % (hms, la, lah, lo, loh)
+        for body in (rmc, gga):
+            out.write("$%s*%s\r\n" % (body, checksum(body)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+"""Build a delta firmware patch for src/modules/ota_update.h.
+
+The patch rebuilds NEW from OLD (the .bin the fleet runs now) in the
+format of src/modules/delta_patch.h: bsdiff-style blocks of "old bytes
+plus a diff" and "new bytes", where the diff of code that only moved is
+mostly zero and is stored as zero runs. Matches are found from a hash
+index of OLD and extended while at least half the bytes agree, so
+shifted code with changed addresses stays one block.
+
+The patch is applied here before it is written, and the sizes, the
+patch-size ratio and the generation time are printed.
+
+Usage:
+    python3 tools/ota/make_delta.py old.bin new.bin -o patch.bin
+    python3 tools/ota/make_delta.py old.bin new.bin -o patch.bin --json stats.json
+"""
+import argparse
+import hashlib
+import json
+import re
+import struct
+import sys
+import time
+
+MAGIC = 0x31544C44  # "DLT1"
+HEADER = struct.Struct("<III32s32s")
+SEED = 16           # Bytes hashed per index entry
+STEP = 4            # OLD is indexed every STEP bytes
+GIVE_UP = 64        # Extension stops this far past its best score
+ZERO_RUN_MIN = 3    # Shorter zero runs stay inside the diff bytes
+ZEROS = re.compile(b"\x00*")
+ZERO_RUN = re.compile(b"\x00{%d}" % ZERO_RUN_MIN)
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def index_old(old):
+    index = {}
+    for i in range(0, len(old) - SEED + 1, STEP):
+        index.setdefault(old[i:i + SEED], i)
+    return index
+
+
+def extend(old, new, o, n):
+    """Length of the approximate match at old[o], new[n] (bsdiff score:
+    matching bytes count +1, others -1, keep the best prefix)"""
+    limit = min(len(old) - o, len(new) - n)
+    i = score = best = best_len = 0
+    while i < limit and i - best_len <= GIVE_UP:
+        if i + 32 <= limit and old[o + i:o + i + 32] == new[n + i:n + i + 32]:
+            i += 32
+            score += 32
+        else:
+            score += 1 if old[o + i] == new[n + i] else -1
+            i += 1
+        if score > best:
+            best, best_len = score, i
+    return best_len
+
+
+def find_matches(old, new):
+    """Approximate matches (new_start, old_start, length), in NEW order"""
+    index = index_old(old)
+    matches = []
+    pos = prev_end = offset = 0
+    while pos + SEED <= len(new):
+        seed = new[pos:pos + SEED]
+        o = pos + offset    # Same alignment as the last match first
+        if not (0 <= o <= len(old) - SEED and old[o:o + SEED] == seed):
+            o = index.get(seed)
+            if o is None:
+                pos += 1
+                continue
+        start = pos
+        while start > prev_end and o > 0 and old[o - 1] == new[start - 1]:
+            start -= 1
+            o -= 1
+        length = extend(old, new, o, start)
+        if length < SEED:
+            pos += 1
+            continue
+        matches.append((start, o, length))
+        offset = o - start
+        pos = prev_end = start + length
+    return matches
+
+
+def encode_diff(old, new, o, n, length):
+    diff = bytes((b - a) & 0xFF for a, b in zip(old[o:o + length], new[n:n + length]))
+    out = bytearray()
+    pos = 0
+    zeros = 0
+    while pos < length:
+        if diff[pos] == 0:
+            run = ZEROS.match(diff, pos).end() - pos
+            zeros, pos = run, pos + run
+            if pos == length:
+                out += varint(zeros) + varint(0)
+                break
+        # Literals until a zero run worth a new pair
+        run = ZERO_RUN.search(diff, pos)
+        end = run.start() if run else length
+        out += varint(zeros) + varint(end - pos) + diff[pos:end]
+        zeros, pos = 0, end
+    return bytes(out)
+
+
+def make_patch(old, new):
+    matches = find_matches(old, new)
+    body = bytearray()
+    old_pos = new_pos = 0
+    first = matches[0] if matches else (len(new), 0, 0)
+    if first[0] > 0:
+        # New bytes ahead of the first match
+        body += varint(0) + varint(first[0]) + varint(zigzag(first[1])) + new[:first[0]]
+        old_pos, new_pos = first[1], first[0]
+    for k, (n, o, length) in enumerate(matches):
+        assert n == new_pos and o == old_pos
+        next_n, next_o = matches[k + 1][:2] if k + 1 < len(matches) else (len(new), o + length)
+        extra = new[n + length:next_n]
+        body += varint(length) + varint(len(extra)) + varint(zigzag(next_o - (o + length)))
+        body += encode_diff(old, new, o, n, length) + extra
+        old_pos, new_pos = next_o, next_n
+    header = HEADER.pack(MAGIC, len(old), len(new),
+                         hashlib.sha256(old).digest(), hashlib.sha256(new).digest())
+    return header + bytes(body), len(matches)
+
+
+def read_varint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def apply_patch(old, patch):
+    """Reference applier (same checks as the device)"""
+    magic, old_size, new_size, old_sha, new_sha = HEADER.unpack_from(patch)
+    if magic != MAGIC or old_size != len(old) or hashlib.sha256(old).digest() != old_sha:
+        raise ValueError("patch does not apply to this image")
+    out = bytearray()
+    pos, old_pos = HEADER.size, 0
+    while len(out) < new_size:
+        copy, pos = read_varint(patch, pos)
+        extra, pos = read_varint(patch, pos)
+        seek, pos = read_varint(patch, pos)
+        seek = (seek >> 1) ^ -(seek & 1)
+        left = copy
+        while left:
+            zeros, pos = read_varint(patch, pos)
+            count, pos = read_varint(patch, pos)
+            out += old[old_pos:old_pos + zeros]
+            old_pos += zeros
+            out += bytes((a + d) & 0xFF for a, d in zip(old[old_pos:old_pos + count], patch[pos:pos + count]))
+            old_pos += count
+            pos += count
+            left -= zeros + count
+        out += patch[pos:pos + extra]
+        pos += extra
+        old_pos += seek
+    if pos != len(patch) or hashlib.sha256(out).digest() != new_sha:
+        raise ValueError("patch does not rebuild the new image")
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("old", help="Image the devices run now (.bin)")
+    parser.add_argument("new", help="Image to update to (.bin)")
+    parser.add_argument("-o", "--output", required=True, help="Patch file to write")
+    parser.add_argument("--json", help="Also write the figures as JSON")
+    args = parser.parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+
+    start = time.perf_counter()
+    patch, blocks = make_patch(old, new)
+    elapsed = time.perf_counter() - start
+    try:
+        apply_patch(old, patch)
+    except ValueError as e:
+        sys.exit("internal error: %s" % e)
+    with open(args.output, "wb") as f:
+        f.write(patch)
+
+    stats = {
+        "old_bytes": len(old),
+        "new_bytes": len(new),
+        "patch_bytes": len(patch),
+        "ratio_pct": round(len(patch) * 100.0 / max(len(new), 1), 2),
+        "blocks": blocks,
+        "generate_s": round(elapsed, 2),
+    }
+    print("%s -> %s: %d byte patch for a %d byte image (%.1f%%), %d blocks, %.1f s"
+          % (args.old, args.new, len(patch), len(new), stats["ratio_pct"], blocks, elapsed))
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(stats, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
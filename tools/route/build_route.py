@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Build the route blob read by src/modules/route_tracker.h from GeoJSON.
+
+The GeoJSON holds one LineString (the planned route, in travel order)
+with property `corridor_m` (half-width in metres), and Point features
+with property `port_id` for the ports of call; each port is snapped to
+the nearest point on the route. Segments get their local east/north
+vector, length and distance from the start precomputed, and a uniform
+grid lists the segments whose corridor meets each cell.
+
+Usage:
+    python3 tools/route/build_route.py route.geojson --header src/route_data.h
+"""
+import argparse
+import json
+import math
+import struct
+import sys
+
+MAGIC = 0x31455452  # "RTE1"
+VERSION = 1
+HEADER = struct.Struct("<IHHIfiiIIHHI")
+SEGMENT = struct.Struct("<iiffff")
+PORT = struct.Struct("<HHf")
+METRES_PER_DEG = 111319.0
+
+
+def e7(value):
+    return int(round(value * 1e7))
+
+
+def load(path):
+    with open(path) as f:
+        doc = json.load(f)
+    line = None
+    ports = []
+    for feature in doc["features"]:
+        geometry = feature["geometry"]
+        props = feature.get("properties") or {}
+        if geometry["type"] == "LineString":
+            if line:
+                sys.exit("only one LineString (the route) is supported")
+            line = ([(e7(lat), e7(lon)) for lon, lat in geometry["coordinates"]], float(props.get("corridor_m", 200)))
+        elif geometry["type"] == "Point" and "port_id" in props:
+            lon, lat = geometry["coordinates"]
+            ports.append((int(props["port_id"]), e7(lat), e7(lon)))
+    if not line or len(line[0]) < 2:
+        sys.exit("need a LineString with at least 2 points")
+    return line[0], line[1], ports
+
+
+def segments_of(points):
+    segments = []
+    start = 0.0
+    for (lat0, lon0), (lat1, lon1) in zip(points, points[1:]):
+        kx = METRES_PER_DEG * math.cos(math.radians((lat0 + lat1) / 2e7))
+        east = (lon1 - lon0) * 1e-7 * kx
+        north = (lat1 - lat0) * 1e-7 * METRES_PER_DEG
+        length = math.hypot(east, north)
+        segments.append((lat0, lon0, lat1, lon1, east, north, length, start))
+        start += length
+    return segments
+
+
+def snap(segments, lat, lon):
+    """Route distance of the closest point to (lat, lon)"""
+    best = (float("inf"), 0.0)
+    for lat0, lon0, _, _, east, north, length, start in segments:
+        kx = METRES_PER_DEG * math.cos(math.radians(lat0 * 1e-7))
+        px = (lon - lon0) * 1e-7 * kx
+        py = (lat - lat0) * 1e-7 * METRES_PER_DEG
+        t = (px * east + py * north) / (length * length) if length else 0.0
+        t = min(max(t, 0.0), 1.0)
+        d = math.hypot(px - t * east, py - t * north)
+        if d < best[0]:
+            best = (d, start + t * length)
+    return best[1]
+
+
+def build(points, corridor, ports, cell_deg=None):
+    segments = segments_of(points)
+    margin = e7(2 * corridor / METRES_PER_DEG)
+    boxes = [(min(s[0], s[2]) - margin, min(s[1], s[3]) - margin, max(s[0], s[2]) + margin, max(s[1], s[3]) + margin)
+             for s in segments]
+    lat0 = min(b[0] for b in boxes)
+    lon0 = min(b[1] for b in boxes)
+    lat1 = max(b[2] for b in boxes)
+    lon1 = max(b[3] for b in boxes)
+
+    if cell_deg:
+        cell = e7(cell_deg)
+    else:
+        # Typical segment extent, so a cell lists a handful of segments
+        sizes = sorted(max(b[2] - b[0], b[3] - b[1]) for b in boxes)
+        cell = max(sizes[len(sizes) // 2], 1)
+    while True:
+        rows = (lat1 - lat0) // cell + 1
+        cols = (lon1 - lon0) // cell + 1
+        if rows <= 65535 and cols <= 65535 and rows * cols <= max(4 * len(segments), 64):
+            break
+        cell = cell * 5 // 4 + 1
+
+    cells = [[] for _ in range(rows * cols)]
+    for index, b in enumerate(boxes):
+        for r in range((b[0] - lat0) // cell, (b[2] - lat0) // cell + 1):
+            for c in range((b[1] - lon0) // cell, (b[3] - lon0) // cell + 1):
+                cells[r * cols + c].append(index)
+
+    port_table = sorted((snap(segments, lat, lon), pid) for pid, lat, lon in ports)
+    entry_count = sum(len(c) for c in cells)
+    out = bytearray(HEADER.pack(MAGIC, VERSION, len(port_table), len(segments), corridor,
+                                lat0, lon0, cell, cell, rows, cols, entry_count))
+    for lat, lon, _, _, east, north, length, start in segments:
+        out += SEGMENT.pack(lat, lon, east, north, length, start)
+    for distance, pid in port_table:
+        out += PORT.pack(pid, 0, distance)
+    start = 0
+    for c in cells:
+        out += struct.pack("<I", start)
+        start += len(c)
+    out += struct.pack("<I", start)
+    for c in cells:
+        out += struct.pack("<%dI" % len(c), *c)
+    total = segments[-1][7] + segments[-1][6]
+    return bytes(out), rows, cols, total, port_table
+
+
+def write_header(path, blob, source):
+    lines = [
+        "// Generated by tools/route/build_route.py from %s; do not edit" % source,
+        "#ifndef ROUTE_DATA_H",
+        "#define ROUTE_DATA_H",
+        "",
+        "#include <stdint.h>",
+        "#include <stddef.h>",
+        "",
+        "alignas(4) static const uint8_t ROUTE_BLOB[] = {",
+    ]
+    for i in range(0, len(blob), 16):
+        lines.append("    " + " ".join("0x%02x," % b for b in blob[i:i + 16]))
+    lines += [
+        "};",
+        "static const size_t ROUTE_BLOB_SIZE = sizeof(ROUTE_BLOB);",
+        "",
+        "#endif // ROUTE_DATA_H",
+        "",
+    ]
+    with open(path, "w") as f:
+        f.write("\n".join(lines))
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("geojson")
+    ap.add_argument("--header", help="write a C header with ROUTE_BLOB")
+    ap.add_argument("--bin", help="write the raw blob")
+    ap.add_argument("--cell-deg", type=float, help="grid cell size in degrees (default: automatic)")
+    args = ap.parse_args()
+
+    points, corridor, ports = load(args.geojson)
+    blob, rows, cols, total, port_table = build(points, corridor, ports, args.cell_deg)
+    if args.header:
+        write_header(args.header, blob, args.geojson.split("/")[-1])
+    if args.bin:
+        with open(args.bin, "wb") as f:
+            f.write(blob)
+    print("%d segments, %.0f m, ports %s, grid %dx%d, %d bytes" % (
+        len(points) - 1, total, ", ".join("%d@%.0f m" % (p, d) for d, p in port_table), rows, cols, len(blob)),
+        file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
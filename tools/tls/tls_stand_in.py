@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Local HTTPS stand-in for the upload server, to measure the tracker's TLS.
+
+Accepts the tracker's POSTs over TLS 1.2 with session tickets and a
+session-ID cache, answers 200, and prints one line per connection:
+whether the session was resumed, the server-side handshake time, and
+the request size. Without --cert/--key it makes a throwaway P-256
+certificate with the openssl CLI. The public key pin to put in
+TLS_PIN_SHA256 is printed at start-up.
+
+The tracker side is in its log (TLS_HANDSHAKE: full/resumed, time, heap
+peak) and in /metrics (tls_handshake_seconds, tls_handshake_heap_peak_bytes).
+
+Usage:
+    python3 tools/tls/tls_stand_in.py --port 8443
+    python3 tools/tls/tls_stand_in.py --cert server.pem --key server.key
+"""
+import argparse
+import base64
+import hashlib
+import os
+import socket
+import ssl
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+
+def make_certificate(directory, host):
+    cert = os.path.join(directory, "cert.pem")
+    key = os.path.join(directory, "key.pem")
+    subprocess.run(
+        ["openssl", "req", "-x509", "-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:prime256v1",
+         "-nodes", "-days", "30", "-subj", "/CN=" + host, "-addext", "subjectAltName=DNS:" + host,
+         "-keyout", key, "-out", cert],
+        check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    return cert, key
+
+
+def public_key_pin(cert):
+    """Base64 SHA-256 of the SubjectPublicKeyInfo, as TLS_PIN_SHA256 wants."""
+    pem = subprocess.run(["openssl", "x509", "-in", cert, "-pubkey", "-noout"],
+                         check=True, capture_output=True).stdout
+    der = subprocess.run(["openssl", "pkey", "-pubin", "-outform", "der"],
+                         input=pem, check=True, capture_output=True).stdout
+    return base64.b64encode(hashlib.sha256(der).digest()).decode()
+
+
+def read_request(conn):
+    data = b""
+    while b"\r\n\r\n" not in data:
+        chunk = conn.recv(4096)
+        if not chunk:
+            return None
+        data += chunk
+    head, _, body = data.partition(b"\r\n\r\n")
+    length = 0
+    for line in head.split(b"\r\n")[1:]:
+        name, _, value = line.partition(b":")
+        if name.strip().lower() == b"content-length":
+            length = int(value)
+    while len(body) < length:
+        chunk = conn.recv(4096)
+        if not chunk:
+            break
+        body += chunk
+    return head.split(b"\r\n", 1)[0].decode(errors="replace"), len(head) + 4 + len(body)
+
+
+def serve(context, raw, peer):
+    start = time.perf_counter()
+    try:
+        conn = context.wrap_socket(raw, server_side=True)
+    except (ssl.SSLError, OSError) as e:
+        print(f"{peer[0]} handshake failed: {e}", flush=True)
+        raw.close()
+        return
+    elapsed = (time.perf_counter() - start) * 1000
+    with conn:
+        try:
+            request = read_request(conn)
+            if request:
+                conn.sendall(b"HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n")
+        except (ssl.SSLError, OSError):
+            request = None
+        kind = "resumed" if conn.session_reused else "full"
+        line = f"{request[0]}, {request[1]} bytes" if request else "no request"
+        print(f"{peer[0]} {kind:7} handshake {elapsed:6.1f} ms  {conn.cipher()[0]}  {line}", flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--host", default="localhost", help="name for the generated certificate")
+    parser.add_argument("--cert")
+    parser.add_argument("--key")
+    parser.add_argument("--no-tickets", action="store_true", help="resume by session ID only")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        if args.cert and args.key:
+            cert, key = args.cert, args.key
+        elif args.cert or args.key:
+            sys.exit("--cert and --key go together")
+        else:
+            cert, key = make_certificate(directory, args.host)
+
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.maximum_version = ssl.TLSVersion.TLSv1_2   # As the tracker offers
+        context.load_cert_chain(cert, key)
+        if args.no_tickets:
+            context.options |= ssl.OP_NO_TICKET
+
+        print(f"TLS_PIN_SHA256 \"{public_key_pin(cert)}\"", flush=True)
+        print(f"Listening on {args.bind}:{args.port}", flush=True)
+        with socket.create_server((args.bind, args.port)) as server:
+            while True:
+                raw, peer = server.accept()
+                threading.Thread(target=serve, args=(context, raw, peer), daemon=True).start()
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass